@@ -0,0 +1,586 @@
+/*
+Title: Swept AABB-3D
+File Name: AsyncWriter.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Writes a stream of records (replays, telemetry, ...) to a file without ever making the caller
+wait on the disk. Records are copied into one of a fixed number of buffers; a full buffer, or
+the one in use when Flush() is called at the end of a step, is handed off to be written while
+the caller carries on filling the next one. On Linux the writes go through io_uring, so no extra
+thread is needed and a whole step's buffers are submitted with one system call. Elsewhere (or if
+the kernel doesn't allow io_uring) a background thread writes them with pwrite, or an ofstream
+on Windows. Memory never grows past the buffers: when they are all waiting on the disk, Write()
+either waits for one to finish or drops the record, depending on the backpressure policy.
+*/
+
+#ifndef _ASYNC_WRITER_CPP
+#define _ASYNC_WRITER_CPP
+
+#include "AsyncWriter.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#ifdef ASYNC_WRITER_POSIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef ASYNC_WRITER_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+AsyncWriter::AsyncWriter()
+{
+	bufferSize = 0;
+	current = -1;
+	fileOffset = 0;
+	inFlight = 0;
+	policy = BACKPRESSURE_BLOCK;
+	open = false;
+	failed = false;
+	bytesWritten = 0;
+	recordsDropped = 0;
+	stalls = 0;
+	submissions = 0;
+	useRing = false;
+	stopping = false;
+	threadFailed = false;
+
+#ifdef ASYNC_WRITER_POSIX
+	fd = -1;
+#endif
+#ifdef ASYNC_WRITER_IO_URING
+	ring = -1;
+	sqMemory = nullptr;
+	cqMemory = nullptr;
+	sqeMemory = nullptr;
+	unsubmitted = 0;
+#endif
+}
+
+AsyncWriter::~AsyncWriter()
+{
+	Close();
+}
+
+#ifdef ASYNC_WRITER_IO_URING
+bool AsyncWriter::SetupRing(unsigned entries)
+{
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_RW_CUR_POS)
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	// This fails if the kernel is too old, or io_uring has been switched off (some containers do); the thread takes over then.
+	ring = (int)syscall(__NR_io_uring_setup, entries, &params);
+	if (ring < 0)
+	{
+		return false;
+	}
+
+	// The plain write operation came in with the same kernel (5.6) as this feature flag.
+	if (!(params.features & IORING_FEAT_RW_CUR_POS))
+	{
+		CloseRing();
+		return false;
+	}
+
+	// Map the two rings and the array of submission entries. Newer kernels put both rings in one mapping.
+	sqMemorySize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cqMemorySize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (single)
+	{
+		sqMemorySize = cqMemorySize = std::max(sqMemorySize, cqMemorySize);
+	}
+
+	sqMemory = mmap(nullptr, sqMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+	cqMemory = single ? sqMemory : mmap(nullptr, cqMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+	sqeMemorySize = params.sq_entries * sizeof(io_uring_sqe);
+	sqeMemory = mmap(nullptr, sqeMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+	if (sqMemory == MAP_FAILED || cqMemory == MAP_FAILED || sqeMemory == MAP_FAILED)
+	{
+		CloseRing();
+		return false;
+	}
+
+	char* sq = (char*)sqMemory;
+	sqTail = (unsigned*)(sq + params.sq_off.tail);
+	sqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+	sqArray = (unsigned*)(sq + params.sq_off.array);
+
+	char* cq = (char*)cqMemory;
+	cqHead = (unsigned*)(cq + params.cq_off.head);
+	cqTail = (unsigned*)(cq + params.cq_off.tail);
+	cqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+	cqes = cq + params.cq_off.cqes;
+
+	unsubmitted = 0;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void AsyncWriter::CloseRing()
+{
+	if (sqeMemory != nullptr && sqeMemory != MAP_FAILED)
+	{
+		munmap(sqeMemory, sqeMemorySize);
+	}
+	if (cqMemory != nullptr && cqMemory != MAP_FAILED && cqMemory != sqMemory)
+	{
+		munmap(cqMemory, cqMemorySize);
+	}
+	if (sqMemory != nullptr && sqMemory != MAP_FAILED)
+	{
+		munmap(sqMemory, sqMemorySize);
+	}
+	sqMemory = cqMemory = sqeMemory = nullptr;
+
+	if (ring >= 0)
+	{
+		close(ring);
+		ring = -1;
+	}
+}
+#endif
+
+bool AsyncWriter::Open(const std::string& fileName, size_t bufferBytes, int numBuffers, BackpressurePolicy backpressure)
+{
+	Close();
+
+#ifdef ASYNC_WRITER_POSIX
+	fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		std::cout << "Can't write file: " << fileName.data() << std::endl;
+		return false;
+	}
+#else
+	file.open(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.good())
+	{
+		std::cout << "Can't write file: " << fileName.data() << std::endl;
+		return false;
+	}
+#endif
+
+	bufferSize = bufferBytes > 0 ? bufferBytes : 1;
+	policy = backpressure;
+	buffers.resize(numBuffers > 0 ? numBuffers : 1);
+	freeBuffers.clear();
+	for (int i = (int)buffers.size() - 1; i >= 0; i--)
+	{
+		buffers[i].data = (char*)malloc(bufferSize);
+		buffers[i].used = 0;
+		buffers[i].written = 0;
+		buffers[i].offset = 0;
+		freeBuffers.push_back(i);
+	}
+
+	current = -1;
+	fileOffset = 0;
+	inFlight = 0;
+	failed = false;
+	bytesWritten = 0;
+	recordsDropped = 0;
+	stalls = 0;
+	submissions = 0;
+
+	// Every buffer can be in flight at once, so the rings need at least that many entries (a power of two).
+	useRing = false;
+#ifdef ASYNC_WRITER_IO_URING
+	unsigned entries = 1;
+	while (entries < buffers.size())
+	{
+		entries *= 2;
+	}
+	useRing = SetupRing(entries);
+#endif
+
+	if (!useRing)
+	{
+		stopping = false;
+		threadFailed = false;
+		queued.clear();
+		completed.clear();
+		thread = std::thread(&AsyncWriter::ThreadLoop, this);
+	}
+
+	open = true;
+	return true;
+}
+
+void AsyncWriter::Close()
+{
+	if (!open)
+	{
+		return;
+	}
+
+	Flush();
+	while (inFlight > 0)
+	{
+		Reap(true);
+	}
+
+#ifdef ASYNC_WRITER_IO_URING
+	if (useRing)
+	{
+		CloseRing();
+	}
+#endif
+	if (!useRing)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		thread.join();
+	}
+
+#ifdef ASYNC_WRITER_POSIX
+	::close(fd);
+	fd = -1;
+#else
+	file.close();
+#endif
+
+	for (size_t i = 0; i < buffers.size(); i++)
+	{
+		free(buffers[i].data);
+	}
+	buffers.clear();
+	freeBuffers.clear();
+
+	open = false;
+}
+
+void AsyncWriter::ThreadLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		wake.wait(lock, [this]() { return stopping || !queued.empty(); });
+		if (queued.empty())
+		{
+			return;
+		}
+
+		int index = queued.front();
+		queued.pop_front();
+		lock.unlock();
+
+		// The buffer is ours until we put it on the completed list, so we don't need the lock to write it out.
+		Buffer& buffer = buffers[index];
+		bool ok = true;
+#ifdef ASYNC_WRITER_POSIX
+		while (buffer.written < buffer.used)
+		{
+			ssize_t result = pwrite(fd, buffer.data + buffer.written, buffer.used - buffer.written, buffer.offset + buffer.written);
+			if (result < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (result <= 0)
+			{
+				ok = false;
+				break;
+			}
+			buffer.written += result;
+		}
+#else
+		// Buffers come off the queue in the order they were handed off, which is file order, so we can simply append.
+		file.write(buffer.data, buffer.used);
+		ok = file.good();
+		buffer.written = buffer.used;
+#endif
+
+		lock.lock();
+		if (!ok)
+		{
+			threadFailed = true;
+		}
+		completed.push_back(index);
+		finished.notify_one();
+	}
+}
+
+#ifdef ASYNC_WRITER_IO_URING
+void AsyncWriter::PrepareWrite(int index)
+{
+	Buffer& buffer = buffers[index];
+
+	// Fill in the next submission entry for whatever of the buffer hasn't been written yet, and publish it by moving the tail along.
+	// The kernel only looks at it once we call io_uring_enter.
+	unsigned tail = *sqTail;
+	unsigned slot = tail & sqMask;
+	io_uring_sqe* sqe = (io_uring_sqe*)sqeMemory + slot;
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_WRITE;
+	sqe->fd = fd;
+	sqe->off = buffer.offset + buffer.written;
+	sqe->addr = (uint64_t)(uintptr_t)(buffer.data + buffer.written);
+	sqe->len = (uint32_t)(buffer.used - buffer.written);
+	sqe->user_data = (uint64_t)index;
+	sqArray[slot] = slot;
+	__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+	unsubmitted++;
+}
+#endif
+
+void AsyncWriter::Queue(int index)
+{
+	Buffer& buffer = buffers[index];
+	buffer.offset = fileOffset;
+	buffer.written = 0;
+	fileOffset += buffer.used;
+	inFlight++;
+
+#ifdef ASYNC_WRITER_IO_URING
+	if (useRing)
+	{
+		PrepareWrite(index);
+		return;
+	}
+#endif
+
+	std::lock_guard<std::mutex> lock(mutex);
+	queued.push_back(index);
+}
+
+void AsyncWriter::Submit()
+{
+#ifdef ASYNC_WRITER_IO_URING
+	if (useRing)
+	{
+		if (unsubmitted > 0)
+		{
+			// One system call for every write queued since the last one.
+			int result = (int)syscall(__NR_io_uring_enter, ring, unsubmitted, 0, 0, nullptr, 0);
+			if (result > 0)
+			{
+				unsubmitted -= result;
+				submissions++;
+			}
+		}
+		return;
+	}
+#endif
+
+	bool any;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		any = !queued.empty();
+	}
+	if (any)
+	{
+		wake.notify_one();
+		submissions++;
+	}
+}
+
+void AsyncWriter::Reap(bool wait)
+{
+	std::vector<int> done;
+
+#ifdef ASYNC_WRITER_IO_URING
+	if (useRing)
+	{
+		if (wait)
+		{
+			// Submit anything still queued, and sleep until at least one write has finished.
+			int result = (int)syscall(__NR_io_uring_enter, ring, unsubmitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+			if (result > 0)
+			{
+				unsubmitted -= result;
+			}
+		}
+
+		bool resubmit = false;
+		unsigned head = *cqHead;
+		unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+		for (; head != tail; head++)
+		{
+			io_uring_cqe* cqe = (io_uring_cqe*)cqes + (head & cqMask);
+			int index = (int)cqe->user_data;
+			Buffer& buffer = buffers[index];
+
+			if (cqe->res > 0)
+			{
+				buffer.written += cqe->res;
+			}
+			else if (cqe->res != -EINTR && cqe->res != -EAGAIN)
+			{
+				std::cout << "Async write failed: " << strerror(cqe->res < 0 ? -cqe->res : EIO) << std::endl;
+				failed = true;
+				done.push_back(index);
+				continue;
+			}
+
+			// A write can come back short, or interrupted. Send whatever is left again.
+			if (buffer.written < buffer.used)
+			{
+				PrepareWrite(index);
+				resubmit = true;
+				continue;
+			}
+
+			done.push_back(index);
+		}
+		__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+		if (resubmit)
+		{
+			Submit();
+		}
+	}
+#endif
+
+	if (!useRing)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (wait)
+		{
+			finished.wait(lock, [this]() { return !completed.empty(); });
+		}
+		done.swap(completed);
+		if (threadFailed)
+		{
+			std::cout << "Async write failed" << std::endl;
+			failed = true;
+			threadFailed = false;
+		}
+	}
+
+	for (size_t i = 0; i < done.size(); i++)
+	{
+		Buffer& buffer = buffers[done[i]];
+		bytesWritten += buffer.written;
+		buffer.used = 0;
+		buffer.written = 0;
+		freeBuffers.push_back(done[i]);
+		inFlight--;
+	}
+}
+
+int AsyncWriter::TakeBuffer(bool wait)
+{
+	Reap(false);
+
+	if (freeBuffers.empty() && wait)
+	{
+		// Every buffer is waiting on the disk. Make sure they're all on their way, then wait for the first one back.
+		stalls++;
+		Submit();
+		while (freeBuffers.empty())
+		{
+			Reap(true);
+		}
+	}
+
+	if (freeBuffers.empty())
+	{
+		return -1;
+	}
+
+	int index = freeBuffers.back();
+	freeBuffers.pop_back();
+	return index;
+}
+
+bool AsyncWriter::Write(const void* data, size_t size)
+{
+	if (!open || failed)
+	{
+		recordsDropped++;
+		return false;
+	}
+
+	// Dropping only works on whole records, so check there's room for all of it before copying any.
+	if (policy == BACKPRESSURE_DROP)
+	{
+		Reap(false);
+		size_t room = freeBuffers.size() * bufferSize;
+		if (current >= 0)
+		{
+			room += bufferSize - buffers[current].used;
+		}
+		if (size > room)
+		{
+			recordsDropped++;
+			return false;
+		}
+	}
+
+	// Fill buffers one after another. A record can run on from one buffer into the next; they go to the file back to back.
+	const char* bytes = (const char*)data;
+	while (size > 0)
+	{
+		if (current < 0)
+		{
+			current = TakeBuffer(policy == BACKPRESSURE_BLOCK);
+		}
+
+		Buffer& buffer = buffers[current];
+		size_t chunk = std::min(size, bufferSize - buffer.used);
+		memcpy(buffer.data + buffer.used, bytes, chunk);
+		buffer.used += chunk;
+		bytes += chunk;
+		size -= chunk;
+
+		if (buffer.used == bufferSize)
+		{
+			Queue(current);
+			current = -1;
+		}
+	}
+
+	return true;
+}
+
+void AsyncWriter::Flush()
+{
+	if (!open)
+	{
+		return;
+	}
+
+	if (current >= 0 && buffers[current].used > 0)
+	{
+		Queue(current);
+		current = -1;
+	}
+	Submit();
+
+	// Pick up whatever has finished in the meantime, so its buffers are free for the next step.
+	Reap(false);
+}
+
+#endif // _ASYNC_WRITER_CPP
@@ -0,0 +1,186 @@
+/*
+Title: Swept AABB-3D
+File Name: AsyncWriter.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Writes a stream of records (replays, telemetry, ...) to a file without ever making the caller
+wait on the disk. Records are copied into one of a fixed number of buffers; a full buffer, or
+the one in use when Flush() is called at the end of a step, is handed off to be written while
+the caller carries on filling the next one. On Linux the writes go through io_uring, so no extra
+thread is needed and a whole step's buffers are submitted with one system call. Elsewhere (or if
+the kernel doesn't allow io_uring) a background thread writes them with pwrite, or an ofstream
+on Windows. Memory never grows past the buffers: when they are all waiting on the disk, Write()
+either waits for one to finish or drops the record, depending on the backpressure policy.
+*/
+
+#ifndef _ASYNC_WRITER_H
+#define _ASYNC_WRITER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ASYNC_WRITER_IO_URING
+#endif
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ASYNC_WRITER_POSIX
+#endif
+
+// What Write() does when every buffer is still being written.
+enum BackpressurePolicy
+{
+	BACKPRESSURE_BLOCK,		// Wait for the disk. Nothing is lost, but the caller can stall.
+	BACKPRESSURE_DROP		// Drop the whole record and carry on. The caller never stalls.
+};
+
+class AsyncWriter
+{
+	struct Buffer
+	{
+		char* data;
+		size_t used;			// Bytes filled in.
+		size_t written;			// Bytes of those that have reached the file.
+		uint64_t offset;		// Where in the file the buffer goes.
+	};
+
+	std::vector<Buffer> buffers;
+	size_t bufferSize;
+	std::vector<int> freeBuffers;
+	int current;				// The buffer being filled, or -1.
+	uint64_t fileOffset;		// Where the next buffer handed off goes.
+	int inFlight;				// Buffers handed off and not finished yet.
+
+	BackpressurePolicy policy;
+	bool open;
+	bool failed;
+
+	uint64_t bytesWritten;
+	uint64_t recordsDropped;
+	uint64_t stalls;
+	uint64_t submissions;
+
+#ifdef ASYNC_WRITER_POSIX
+	int fd;
+#else
+	std::ofstream file;
+#endif
+
+	// io_uring. The rings are shared with the kernel: we add writes at the submission queue's tail, and it adds results at the completion queue's.
+	bool useRing;
+#ifdef ASYNC_WRITER_IO_URING
+	int ring;
+	void* sqMemory;
+	size_t sqMemorySize;
+	void* cqMemory;
+	size_t cqMemorySize;
+	void* sqeMemory;
+	size_t sqeMemorySize;
+	unsigned* sqTail;
+	unsigned sqMask;
+	unsigned* sqArray;
+	unsigned* cqHead;
+	unsigned* cqTail;
+	unsigned cqMask;
+	void* cqes;
+	unsigned unsubmitted;
+
+	bool SetupRing(unsigned entries);
+	void CloseRing();
+	void PrepareWrite(int buffer);
+#endif
+
+	// The fallback writer thread, and what it shares with us.
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable finished;
+	std::deque<int> queued;
+	std::vector<int> completed;
+	bool stopping;
+	bool threadFailed;
+
+	void ThreadLoop();
+
+	void Queue(int buffer);
+	void Submit();
+	void Reap(bool wait);
+	int TakeBuffer(bool wait);
+
+public:
+	AsyncWriter();
+	~AsyncWriter();
+
+	// Creates (or empties) the file. Memory use is numBuffers * bufferBytes, and a record can be any size as long as it fits in that.
+	bool Open(const std::string& fileName, size_t bufferBytes = 1 << 20, int numBuffers = 4, BackpressurePolicy backpressure = BACKPRESSURE_BLOCK);
+
+	// Copies one record in. It's written whole or (only if the policy is to drop, and there's no room) not at all; returns false if dropped.
+	// Only one thread should write at a time.
+	bool Write(const void* data, size_t size);
+
+	// Hands off whatever has been written so far, and gets every handed off buffer going. Call this once a step.
+	void Flush();
+
+	// Waits for everything to reach the file, and closes it.
+	void Close();
+
+	// Whether writes are going through io_uring (rather than the fallback thread).
+	bool UsingIoUring()
+	{
+		return useRing;
+	}
+
+	// False once a write has failed; everything after that is dropped.
+	bool Good()
+	{
+		return open && !failed;
+	}
+
+	uint64_t BytesWritten()
+	{
+		return bytesWritten;
+	}
+	uint64_t RecordsDropped()
+	{
+		return recordsDropped;
+	}
+	// How many times Write() had to wait for a buffer.
+	uint64_t Stalls()
+	{
+		return stalls;
+	}
+	// How many times writes were handed to the kernel (or the thread) as one batch.
+	uint64_t Submissions()
+	{
+		return submissions;
+	}
+};
+
+#endif //_ASYNC_WRITER_H
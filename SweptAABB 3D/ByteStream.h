@@ -0,0 +1,118 @@
+/*
+Title: Swept AABB-3D
+File Name: ByteStream.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Helpers for writing values into a byte buffer and reading them back out in the same order.
+The physics service's protocol, replay files, sector files, the shader cache and the messages
+ranks send each other are all built out of these. Like PhysicsProtocol.h, this header doesn't
+depend on anything else in the simulator.
+*/
+
+#ifndef _BYTE_STREAM_H
+#define _BYTE_STREAM_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Appends values to a byte buffer, one after another.
+class MessageWriter
+{
+	std::vector<char>* buffer;
+
+public:
+	MessageWriter(std::vector<char>* output)
+	{
+		buffer = output;
+	}
+
+	void Bytes(const void* data, size_t size)
+	{
+		const char* bytes = (const char*)data;
+		buffer->insert(buffer->end(), bytes, bytes + size);
+	}
+
+	// These copy the value's bytes as they are, which is little-endian on every platform we build for.
+	void U16(uint16_t value) { Bytes(&value, sizeof(value)); }
+	void U32(uint32_t value) { Bytes(&value, sizeof(value)); }
+	void I32(int32_t value) { Bytes(&value, sizeof(value)); }
+	void U64(uint64_t value) { Bytes(&value, sizeof(value)); }
+	void F32(float value) { Bytes(&value, sizeof(value)); }
+
+	void Vec3(float x, float y, float z)
+	{
+		F32(x);
+		F32(y);
+		F32(z);
+	}
+
+	void String(const std::string& value)
+	{
+		U32((uint32_t)value.size());
+		Bytes(value.data(), value.size());
+	}
+};
+
+// Reads values out of a payload. Reading past the end gives zeros and sets Failed(), so a request can be read in full and checked once at the end.
+class MessageReader
+{
+	const char* data;
+	size_t size;
+	size_t position;
+	bool failed;
+
+public:
+	MessageReader(const char* payload, size_t length)
+	{
+		data = payload;
+		size = length;
+		position = 0;
+		failed = false;
+	}
+
+	void Bytes(void* out, size_t count)
+	{
+		if (failed || position + count > size)
+		{
+			failed = true;
+			memset(out, 0, count);
+			return;
+		}
+		memcpy(out, data + position, count);
+		position += count;
+	}
+
+	uint16_t U16() { uint16_t value; Bytes(&value, sizeof(value)); return value; }
+	uint32_t U32() { uint32_t value; Bytes(&value, sizeof(value)); return value; }
+	int32_t I32() { int32_t value; Bytes(&value, sizeof(value)); return value; }
+	uint64_t U64() { uint64_t value; Bytes(&value, sizeof(value)); return value; }
+	float F32() { float value; Bytes(&value, sizeof(value)); return value; }
+
+	bool Failed()
+	{
+		return failed;
+	}
+};
+
+#endif //_BYTE_STREAM_H
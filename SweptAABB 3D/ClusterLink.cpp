@@ -0,0 +1,405 @@
+/*
+Title: Swept AABB-3D
+File Name: ClusterLink.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Connects the processes (ranks) of a distributed simulation to each other with Unix domain
+sockets, every rank to every other, and lets them swap one message with each other per step.
+All of the ranks can run on one machine; they find each other through socket files in a
+shared directory. Only available on POSIX systems (Linux, macOS); on Windows, Connect() fails.
+*/
+
+#ifndef _CLUSTER_LINK_CPP
+#define _CLUSTER_LINK_CPP
+
+#include "ClusterLink.h"
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+
+#ifdef CLUSTER_LINK_POSIX
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#endif
+
+#if defined(CLUSTER_LINK_POSIX) && defined(MSG_NOSIGNAL)
+#define LINK_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define LINK_SEND_FLAGS 0
+#endif
+
+ClusterLink::ClusterLink()
+{
+	rank = 0;
+	numRanks = 1;
+	listenSocket = -1;
+}
+
+ClusterLink::~ClusterLink()
+{
+#ifdef CLUSTER_LINK_POSIX
+	for (size_t i = 0; i < peers.size(); i++)
+	{
+		if (peers[i] >= 0)
+		{
+			close(peers[i]);
+		}
+	}
+	if (listenSocket >= 0)
+	{
+		close(listenSocket);
+		unlink(socketPath.c_str());
+	}
+#endif
+}
+
+#ifdef CLUSTER_LINK_POSIX
+// Reads or writes exactly size bytes on a blocking socket. Only used while connecting.
+static bool SendAll(int socket, const void* data, size_t size)
+{
+	const char* bytes = (const char*)data;
+	while (size > 0)
+	{
+		ssize_t sent = send(socket, bytes, size, LINK_SEND_FLAGS);
+		if (sent <= 0)
+		{
+			if (sent < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+		bytes += sent;
+		size -= sent;
+	}
+	return true;
+}
+
+static bool ReceiveAll(int socket, void* data, size_t size)
+{
+	char* bytes = (char*)data;
+	while (size > 0)
+	{
+		ssize_t received = recv(socket, bytes, size, 0);
+		if (received <= 0)
+		{
+			if (received < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+		bytes += received;
+		size -= received;
+	}
+	return true;
+}
+
+static std::string RankSocketPath(const std::string& directory, int rank)
+{
+	return directory + "/rank" + std::to_string(rank) + ".sock";
+}
+#endif
+
+bool ClusterLink::Connect(const std::string& directory, int myRank, int ranks, int timeout)
+{
+#ifdef CLUSTER_LINK_POSIX
+	if (ranks < 1 || myRank < 0 || myRank >= ranks)
+	{
+		std::cout << "Rank " << myRank << " doesn't fit in " << ranks << " ranks" << std::endl;
+		return false;
+	}
+
+	rank = myRank;
+	numRanks = ranks;
+	peers.assign(ranks, -1);
+
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+
+	// Listen first, so lower ranks that are already up can be connected to while we wait on the higher ones.
+	socketPath = RankSocketPath(directory, rank);
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (socketPath.size() >= sizeof(address.sun_path))
+	{
+		std::cout << "Socket path is too long: " << socketPath << std::endl;
+		return false;
+	}
+	strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+	unlink(socketPath.c_str());
+	listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenSocket < 0 || bind(listenSocket, (sockaddr*)&address, sizeof(address)) != 0 || listen(listenSocket, ranks) != 0)
+	{
+		std::cout << "Couldn't listen on " << socketPath << ": " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	// Connect to every lower rank, and tell it who we are. A rank that hasn't started yet has no socket file, so keep trying until it shows up.
+	for (int other = 0; other < rank; other++)
+	{
+		std::string otherPath = RankSocketPath(directory, other);
+		sockaddr_un otherAddress;
+		memset(&otherAddress, 0, sizeof(otherAddress));
+		otherAddress.sun_family = AF_UNIX;
+		strncpy(otherAddress.sun_path, otherPath.c_str(), sizeof(otherAddress.sun_path) - 1);
+
+		while (true)
+		{
+			int peer = socket(AF_UNIX, SOCK_STREAM, 0);
+			if (peer >= 0 && connect(peer, (sockaddr*)&otherAddress, sizeof(otherAddress)) == 0)
+			{
+				peers[other] = peer;
+				break;
+			}
+			if (peer >= 0)
+			{
+				close(peer);
+			}
+
+			if (std::chrono::steady_clock::now() > deadline)
+			{
+				std::cout << "Timed out connecting to rank " << other << std::endl;
+				return false;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+
+		uint32_t me = (uint32_t)rank;
+		if (!SendAll(peers[other], &me, sizeof(me)))
+		{
+			std::cout << "Lost rank " << other << " while connecting" << std::endl;
+			return false;
+		}
+	}
+
+	// Accept a connection from every higher rank. They tell us who they are, since they can connect in any order.
+	for (int accepted = rank + 1; accepted < ranks; accepted++)
+	{
+		int remaining = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+		pollfd entry;
+		entry.fd = listenSocket;
+		entry.events = POLLIN;
+		entry.revents = 0;
+		if (remaining <= 0 || poll(&entry, 1, remaining) <= 0)
+		{
+			std::cout << "Timed out waiting for the other ranks to connect" << std::endl;
+			return false;
+		}
+
+		int peer = accept(listenSocket, nullptr, nullptr);
+		uint32_t other = 0;
+		if (peer < 0 || !ReceiveAll(peer, &other, sizeof(other)) || other <= (uint32_t)rank || other >= (uint32_t)ranks || peers[other] >= 0)
+		{
+			std::cout << "Bad connection while waiting for the other ranks" << std::endl;
+			if (peer >= 0)
+			{
+				close(peer);
+			}
+			return false;
+		}
+		peers[other] = peer;
+	}
+
+	// From here on, Exchange() sends and receives at the same time, which needs non-blocking sockets.
+	for (int i = 0; i < ranks; i++)
+	{
+		if (peers[i] >= 0)
+		{
+			fcntl(peers[i], F_SETFL, O_NONBLOCK);
+		}
+	}
+
+	return true;
+#else
+	std::cout << "Distributed mode needs Unix domain sockets, which aren't available on this platform." << std::endl;
+	return false;
+#endif
+}
+
+bool ClusterLink::Exchange(const std::vector<std::vector<char>>& outgoing, std::vector<std::vector<char>>& incoming)
+{
+	incoming.assign(numRanks, std::vector<char>());
+
+#ifdef CLUSTER_LINK_POSIX
+	// Each message goes out as a 4 byte length followed by the bytes. We send to everybody and receive from everybody at the same time:
+	// if every rank sent everything before reading, two ranks sending each other more than a socket buffer's worth would wait on each other forever.
+	struct Transfer
+	{
+		uint32_t sendLength;
+		size_t sent;				// Counting the 4 length bytes.
+
+		char lengthBytes[4];
+		size_t received;			// Counting the 4 length bytes.
+		bool done;
+	};
+	std::vector<Transfer> transfers(numRanks);
+
+	for (int r = 0; r < numRanks; r++)
+	{
+		Transfer& t = transfers[r];
+		t.sendLength = r < (int)outgoing.size() ? (uint32_t)outgoing[r].size() : 0;
+		t.sent = 0;
+		t.received = 0;
+		t.done = peers[r] < 0;
+	}
+
+	std::vector<pollfd> polled;
+	std::vector<int> polledRanks;
+
+	while (true)
+	{
+		polled.clear();
+		polledRanks.clear();
+		for (int r = 0; r < numRanks; r++)
+		{
+			if (peers[r] < 0)
+			{
+				continue;
+			}
+			Transfer& t = transfers[r];
+			pollfd entry;
+			entry.fd = peers[r];
+			entry.events = (t.done ? 0 : POLLIN) | (t.sent < 4 + t.sendLength ? POLLOUT : 0);
+			entry.revents = 0;
+			if (entry.events != 0)
+			{
+				polled.push_back(entry);
+				polledRanks.push_back(r);
+			}
+		}
+		if (polled.empty())
+		{
+			break;
+		}
+
+		if (poll(polled.data(), polled.size(), -1) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+
+		for (size_t i = 0; i < polled.size(); i++)
+		{
+			int r = polledRanks[i];
+			Transfer& t = transfers[r];
+			short events = polled[i].revents;
+
+			if (events & POLLOUT)
+			{
+				// The length first, then the message.
+				while (t.sent < 4 + t.sendLength)
+				{
+					const char* data;
+					size_t size;
+					if (t.sent < 4)
+					{
+						data = (const char*)&t.sendLength + t.sent;
+						size = 4 - t.sent;
+					}
+					else
+					{
+						data = outgoing[r].data() + (t.sent - 4);
+						size = t.sendLength - (t.sent - 4);
+					}
+
+					ssize_t sent = send(peers[r], data, size, LINK_SEND_FLAGS);
+					if (sent > 0)
+					{
+						t.sent += sent;
+					}
+					else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+					{
+						break;
+					}
+					else if (!(sent < 0 && errno == EINTR))
+					{
+						std::cout << "Lost rank " << r << std::endl;
+						return false;
+					}
+				}
+			}
+
+			if (events & (POLLIN | POLLHUP | POLLERR))
+			{
+				while (!t.done)
+				{
+					char* data;
+					size_t size;
+					if (t.received < 4)
+					{
+						data = t.lengthBytes + t.received;
+						size = 4 - t.received;
+					}
+					else
+					{
+						data = incoming[r].data() + (t.received - 4);
+						size = incoming[r].size() - (t.received - 4);
+					}
+
+					ssize_t received = size > 0 ? recv(peers[r], data, size, 0) : 0;
+					if (received > 0)
+					{
+						t.received += received;
+						if (t.received == 4)
+						{
+							uint32_t length;
+							memcpy(&length, t.lengthBytes, 4);
+							incoming[r].resize(length);
+						}
+					}
+					else if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+					{
+						break;
+					}
+					else if (size > 0 && !(received < 0 && errno == EINTR))
+					{
+						std::cout << "Lost rank " << r << std::endl;
+						return false;
+					}
+
+					if (t.received >= 4 && t.received - 4 == incoming[r].size())
+					{
+						t.done = true;
+					}
+				}
+			}
+		}
+	}
+
+	return true;
+#else
+	return numRanks == 1;
+#endif
+}
+
+#endif // _CLUSTER_LINK_CPP
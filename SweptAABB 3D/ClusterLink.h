@@ -0,0 +1,75 @@
+/*
+Title: Swept AABB-3D
+File Name: ClusterLink.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Connects the processes (ranks) of a distributed simulation to each other with Unix domain
+sockets, every rank to every other, and lets them swap one message with each other per step.
+All of the ranks can run on one machine; they find each other through socket files in a
+shared directory. Only available on POSIX systems (Linux, macOS); on Windows, Connect() fails.
+*/
+
+#ifndef _CLUSTER_LINK_H
+#define _CLUSTER_LINK_H
+
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CLUSTER_LINK_POSIX
+#endif
+
+class ClusterLink
+{
+	int rank;
+	int numRanks;
+
+	std::string socketPath;
+	int listenSocket;
+
+	// The socket connected to each rank, or -1 for ourselves.
+	std::vector<int> peers;
+
+public:
+	ClusterLink();
+	~ClusterLink();
+
+	// Every rank calls this with the same directory and number of ranks, and its own rank (0 to numRanks - 1).
+	// Rank r listens on directory/rank<r>.sock, connects to every lower rank, and accepts a connection from every higher one.
+	// The ranks can be started in any order. Blocks until every connection is made, or timeout milliseconds have gone by.
+	bool Connect(const std::string& directory, int myRank, int ranks, int timeout = 30000);
+
+	// Sends outgoing[r] to every other rank r, and waits for one message from each of them into incoming[r].
+	// Every rank has to call this the same number of times. Returns false if any other rank has gone away.
+	bool Exchange(const std::vector<std::vector<char>>& outgoing, std::vector<std::vector<char>>& incoming);
+
+	int Rank()
+	{
+		return rank;
+	}
+	int NumRanks()
+	{
+		return numRanks;
+	}
+};
+
+#endif //_CLUSTER_LINK_H
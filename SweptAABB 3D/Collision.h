@@ -0,0 +1,63 @@
+/*
+Title: Swept AABB-3D
+File Name: Collision.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+This is a Swept Axis Aligned Bounding Box collision test. This goes beyond a
+standard AABB test to determine the time and axis of collision. This is in 3D.
+Contains two cubes, one that is stationary and one that is moving. They are bounded
+by AABBs (Axis-Aligned Bounding Boxes) and when these AABBs collide the moving object
+"bounces" on the axis of collision.
+There is a physics timestep such that every update runs at the same delta time, regardless
+of how fast or slow the computer is running. The Swept portion of this algorithm determines
+when the collision will actually happen (so if your velocity is 10, and you are a distance of
+5 away from the collision, it will detect this) and will perform the collision response
+(bounce, in this case) before the end of the frame, so you can prevent tunneling (where the
+object passes through or into the middle of the colliding object).
+*/
+
+#ifndef _COLLISION_H
+#define _COLLISION_H
+
+#include "GameObject.h"
+
+// A collision the solve handled: the ids of the two bodies, how far through the step they hit (0 to 1), and the normal of the surface that was hit.
+struct CollisionEvent
+{
+	int bodyA;
+	int bodyB;
+	float hitTime;
+	glm::vec3 normal;
+};
+
+// Regular AABB collision detection. Returns true if the boxes overlap.
+bool TestAABB(AABB a, AABB b);
+
+// Swept AABB collision detection. box1 moves by vel1 over the step while box2 stays still.
+// Returns the fraction of the step at which they first touch (or 2.0f if they don't), and passes out the normal of the surface that was hit.
+float SweptAABB(AABB* box1, AABB* box2, glm::vec3 vel1, float& normalx, float& normaly, float& normalz);
+
+// Returns the box that covers everything box touches while moving by displacement (the box at the start unioned with the box at the end).
+// If two swept boxes don't overlap, the objects can't possibly collide during the step.
+AABB SweptBounds(const AABB& box, glm::vec3 displacement);
+
+#endif //_COLLISION_H
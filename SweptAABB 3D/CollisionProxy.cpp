@@ -0,0 +1,304 @@
+/*
+Title: Swept AABB-3D
+File Name: CollisionProxy.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Builds convex collision proxies for meshes: the furthest vertex in each of a spread of
+directions, scaled out from the middle of their convex hull until it covers the whole mesh.
+*/
+
+#ifndef _COLLISION_PROXY_CPP
+#define _COLLISION_PROXY_CPP
+
+#include "CollisionProxy.h"
+#include <algorithm>
+#include <cmath>
+
+// A triangle of the hull, with its plane: dot(normal, p) == offset for points on it, and is larger for points outside.
+struct HullFace
+{
+	int a, b, c;
+	glm::vec3 normal;
+	float offset;
+};
+
+// Adds the face a, b, c, turned so that its normal points away from inside.
+static void AddHullFace(const std::vector<glm::vec3>& points, std::vector<HullFace>& faces, int a, int b, int c, const glm::vec3& inside)
+{
+	HullFace face;
+	face.a = a;
+	face.b = b;
+	face.c = c;
+	face.normal = glm::normalize(glm::cross(points[b] - points[a], points[c] - points[a]));
+	face.offset = glm::dot(face.normal, points[a]);
+
+	if (glm::dot(face.normal, inside) > face.offset)
+	{
+		std::swap(face.b, face.c);
+		face.normal = -face.normal;
+		face.offset = -face.offset;
+	}
+
+	faces.push_back(face);
+}
+
+// Builds the convex hull of points one point at a time: each point that's outside the hull so far removes every face it can see,
+// and gets joined up to the edge of the hole that leaves. That's slow for big point sets, but proxies only ever have a few dozen points.
+// Returns false if the points are all on one plane (or line), which has no hull with any volume. inside is set to a point inside the hull.
+static bool BuildHull(const std::vector<glm::vec3>& points, float epsilon, std::vector<HullFace>& faces, glm::vec3& inside)
+{
+	if (points.size() < 4)
+	{
+		return false;
+	}
+
+	// Start from a tetrahedron that's as big as we can easily find: the point furthest from the first, the point furthest from the line
+	// through those two, and the point furthest from the plane through those three.
+	int corners[4] = { 0, 0, 0, 0 };
+	float best = 0.0f;
+	for (size_t i = 1; i < points.size(); i++)
+	{
+		float distance = glm::length(points[i] - points[0]);
+		if (distance > best)
+		{
+			best = distance;
+			corners[1] = (int)i;
+		}
+	}
+	best = 0.0f;
+	glm::vec3 line = glm::normalize(points[corners[1]] - points[0]);
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		float distance = glm::length(glm::cross(points[i] - points[0], line));
+		if (distance > best)
+		{
+			best = distance;
+			corners[2] = (int)i;
+		}
+	}
+	if (best <= epsilon)
+	{
+		return false;
+	}
+	best = 0.0f;
+	glm::vec3 normal = glm::normalize(glm::cross(points[corners[1]] - points[0], points[corners[2]] - points[0]));
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		float distance = std::abs(glm::dot(points[i] - points[0], normal));
+		if (distance > best)
+		{
+			best = distance;
+			corners[3] = (int)i;
+		}
+	}
+	if (best <= epsilon)
+	{
+		return false;
+	}
+
+	// The middle of the tetrahedron is inside every hull that grows out of it.
+	inside = (points[corners[0]] + points[corners[1]] + points[corners[2]] + points[corners[3]]) * 0.25f;
+
+	faces.clear();
+	AddHullFace(points, faces, corners[0], corners[1], corners[2], inside);
+	AddHullFace(points, faces, corners[0], corners[1], corners[3], inside);
+	AddHullFace(points, faces, corners[0], corners[2], corners[3], inside);
+	AddHullFace(points, faces, corners[1], corners[2], corners[3], inside);
+
+	std::vector<HullFace> kept;
+	std::vector<std::pair<int, int>> edges;
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		const glm::vec3& point = points[i];
+
+		// Split the faces into the ones the point can see and the rest, and collect the edges of the ones it can see.
+		kept.clear();
+		edges.clear();
+		for (size_t f = 0; f < faces.size(); f++)
+		{
+			const HullFace& face = faces[f];
+			if (glm::dot(face.normal, point) - face.offset > epsilon)
+			{
+				edges.push_back(std::make_pair(std::min(face.a, face.b), std::max(face.a, face.b)));
+				edges.push_back(std::make_pair(std::min(face.b, face.c), std::max(face.b, face.c)));
+				edges.push_back(std::make_pair(std::min(face.c, face.a), std::max(face.c, face.a)));
+			}
+			else
+			{
+				kept.push_back(face);
+			}
+		}
+		if (edges.empty())
+		{
+			continue;
+		}
+
+		// An edge shared by two faces that are going away is inside the hole. The ones that only show up once are its rim.
+		std::sort(edges.begin(), edges.end());
+		faces.swap(kept);
+		for (size_t e = 0; e < edges.size(); e++)
+		{
+			if (e + 1 < edges.size() && edges[e] == edges[e + 1])
+			{
+				e++;
+				continue;
+			}
+			AddHullFace(points, faces, edges[e].first, edges[e].second, (int)i, inside);
+		}
+	}
+
+	return true;
+}
+
+std::vector<glm::vec3> BuildCollisionProxy(const VertexFormat* vertices, int numVertices, int targetVertices)
+{
+	std::vector<glm::vec3> proxy;
+
+	if (numVertices <= targetVertices)
+	{
+		for (int i = 0; i < numVertices; i++)
+		{
+			proxy.push_back(vertices[i].position);
+		}
+		return proxy;
+	}
+
+	glm::vec3 min = vertices[0].position;
+	glm::vec3 max = min;
+	for (int i = 1; i < numVertices; i++)
+	{
+		min = glm::min(min, vertices[i].position);
+		max = glm::max(max, vertices[i].position);
+	}
+	float epsilon = glm::length(max - min) * 0.00001f;
+
+	// Start with the furthest vertex in each of half as many directions as we have corners, spread evenly over the sphere (a Fibonacci spiral).
+	int numDirections = std::max(targetVertices / 2, 4);
+	std::vector<int> chosen;
+	for (int d = 0; d < numDirections; d++)
+	{
+		float y = 1.0f - 2.0f * (d + 0.5f) / numDirections;
+		float radius = std::sqrt(1.0f - y * y);
+		float angle = d * 2.39996323f;
+		glm::vec3 direction(radius * std::cos(angle), y, radius * std::sin(angle));
+
+		int furthest = 0;
+		float reach = glm::dot(vertices[0].position, direction);
+		for (int i = 1; i < numVertices; i++)
+		{
+			float distance = glm::dot(vertices[i].position, direction);
+			if (distance > reach)
+			{
+				reach = distance;
+				furthest = i;
+			}
+		}
+		chosen.push_back(furthest);
+	}
+	std::sort(chosen.begin(), chosen.end());
+	chosen.erase(std::unique(chosen.begin(), chosen.end()), chosen.end());
+
+	for (size_t i = 0; i < chosen.size(); i++)
+	{
+		proxy.push_back(vertices[chosen[i]].position);
+	}
+
+	// Vertices that fell between the directions can be outside the hull of those. How far out one is is measured by how much the hull
+	// would have to grow (from inside) to take it in. Add whichever one is furthest out, and go again, until we run out of corners.
+	// The hull only ever grows, so a vertex that's inside it once stays inside, and doesn't need checking again.
+	std::vector<int> outside(numVertices);
+	for (int i = 0; i < numVertices; i++)
+	{
+		outside[i] = i;
+	}
+
+	std::vector<HullFace> faces;
+	glm::vec3 inside;
+	float scale = 1.0f;
+	while (true)
+	{
+		if (!BuildHull(proxy, epsilon, faces, inside))
+		{
+			// A flat mesh. Its bounding box is as close as we can get with a shape that has any volume.
+			proxy.clear();
+			for (int corner = 0; corner < 8; corner++)
+			{
+				proxy.push_back(glm::vec3(corner & 1 ? max.x : min.x, corner & 2 ? max.y : min.y, corner & 4 ? max.z : min.z));
+			}
+			return proxy;
+		}
+
+		// How far each face is from inside. A vertex at the same distance out along the face's normal is exactly on it.
+		std::vector<float> faceDistances(faces.size());
+		for (size_t f = 0; f < faces.size(); f++)
+		{
+			faceDistances[f] = faces[f].offset - glm::dot(faces[f].normal, inside);
+		}
+
+		scale = 1.0f;
+		int furthest = -1;
+		size_t stillOutside = 0;
+		for (size_t o = 0; o < outside.size(); o++)
+		{
+			int i = outside[o];
+			glm::vec3 fromInside = vertices[i].position - inside;
+			float grow = 1.0f;
+			for (size_t f = 0; f < faces.size(); f++)
+			{
+				grow = std::max(grow, glm::dot(faces[f].normal, fromInside) / faceDistances[f]);
+			}
+
+			if (grow > 1.0f)
+			{
+				outside[stillOutside++] = i;
+				if (grow > scale)
+				{
+					scale = grow;
+					furthest = i;
+				}
+			}
+		}
+		outside.resize(stillOutside);
+
+		if (furthest < 0 || (int)proxy.size() >= targetVertices)
+		{
+			break;
+		}
+		proxy.push_back(vertices[furthest].position);
+	}
+
+	// Whatever is still outside gets taken in by growing the hull by however much the furthest of them needs.
+
+	if (scale > 1.0f)
+	{
+		// A little extra, so that rounding can't leave that vertex poking out.
+		scale *= 1.00001f;
+		for (size_t i = 0; i < proxy.size(); i++)
+		{
+			proxy[i] = inside + (proxy[i] - inside) * scale;
+		}
+	}
+
+	return proxy;
+}
+
+#endif // _COLLISION_PROXY_CPP
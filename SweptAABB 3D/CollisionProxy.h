@@ -0,0 +1,48 @@
+/*
+Title: Swept AABB-3D
+File Name: CollisionProxy.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Builds a simpler shape for collision to use in place of a detailed render mesh. Everything the
+physics does with a mesh comes down to finding how far it reaches in some direction (its AABB
+once it's been turned, how far it reaches from its origin), and that only ever depends on the
+corners of its convex hull. So the proxy is a convex shape with at most a set number of corners.
+It starts as the mesh's furthest vertex in each of a spread of directions, then keeps adding
+whichever vertex is furthest outside the hull of what it has so far. Once it runs out of corners,
+it's pushed out from the middle just far enough that every vertex of the mesh is inside it. Because of that push, the proxy can only ever
+be a little bigger than the mesh, never smaller, so swept tests against it can't miss a hit.
+*/
+
+#ifndef _COLLISION_PROXY_H
+#define _COLLISION_PROXY_H
+
+#include "GLIncludes.h"
+#include <vector>
+
+// How many corners a proxy can have. Meshes with this many vertices or fewer are used as they are.
+const int COLLISION_PROXY_VERTICES = 32;
+
+// Returns the corners of a convex shape that every one of the vertices is inside of, with at most targetVertices corners
+// (or 8, for flat meshes, which get their bounding box instead).
+std::vector<glm::vec3> BuildCollisionProxy(const VertexFormat* vertices, int numVertices, int targetVertices = COLLISION_PROXY_VERTICES);
+
+#endif //_COLLISION_PROXY_H
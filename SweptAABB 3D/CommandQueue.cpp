@@ -0,0 +1,135 @@
+/*
+Title: Swept AABB-3D
+File Name: CommandQueue.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+A lock-free queue that lets any number of threads (game logic, networking, ...) ask for
+changes to bodies while the physics step is running on other threads. Instead of writing to
+a GameObject directly (which would race with the step), a thread pushes a command, and the
+step applies every queued command in one batch at its start. Commands are applied in order of
+(producer, sequence number), so the result doesn't depend on how the threads happened to race.
+*/
+
+#ifndef _COMMAND_QUEUE_CPP
+#define _COMMAND_QUEUE_CPP
+
+#include "CommandQueue.h"
+#include <algorithm>
+
+CommandQueue::CommandQueue()
+{
+	head = nullptr;
+	nextProducer = 0;
+}
+
+CommandQueue::~CommandQueue()
+{
+	// Free anything that was pushed but never drained.
+	std::vector<BodyCommand*> leftovers = Drain();
+	Release(leftovers);
+}
+
+CommandQueue::Producer CommandQueue::CreateProducer()
+{
+	return Producer(this, nextProducer++);
+}
+
+void CommandQueue::Push(BodyCommand* command)
+{
+	// Point the new command at the current head, then try to swing the head over to the new command.
+	// If another thread got in first, compare_exchange_weak reloads the head into command->next and we simply try again.
+	command->next = head.load(std::memory_order_relaxed);
+	while (!head.compare_exchange_weak(command->next, command, std::memory_order_release, std::memory_order_relaxed))
+	{
+	}
+}
+
+std::vector<BodyCommand*> CommandQueue::Drain()
+{
+	// Take the whole list in one go. Producers can keep pushing onto the (now empty) head while we work on what we took.
+	BodyCommand* list = head.exchange(nullptr, std::memory_order_acquire);
+
+	std::vector<BodyCommand*> commands;
+	for (BodyCommand* c = list; c != nullptr; c = c->next)
+	{
+		commands.push_back(c);
+	}
+
+	// The list comes out newest first, and interleaved between producers in whatever order they raced.
+	// Sorting by (producer, sequence) gives the same order every time for the same set of commands.
+	std::sort(commands.begin(), commands.end(), [](const BodyCommand* a, const BodyCommand* b)
+	{
+		if (a->producer != b->producer)
+		{
+			return a->producer < b->producer;
+		}
+		return a->sequence < b->sequence;
+	});
+
+	return commands;
+}
+
+void CommandQueue::Release(std::vector<BodyCommand*>& commands)
+{
+	for (size_t i = 0; i < commands.size(); i++)
+	{
+		delete(commands[i]);
+	}
+	commands.clear();
+}
+
+CommandQueue::Producer::Producer(CommandQueue* commandQueue, unsigned int producerId)
+{
+	queue = commandQueue;
+	id = producerId;
+	sequence = 0;
+}
+
+void CommandQueue::Producer::Push(BodyCommandType type, int body, glm::vec3 value)
+{
+	BodyCommand* command = new BodyCommand();
+	command->type = type;
+	command->body = body;
+	command->value = value;
+	command->producer = id;
+	command->sequence = sequence++;
+	command->next = nullptr;
+
+	queue->Push(command);
+}
+
+void CommandQueue::Producer::SetVelocity(int body, glm::vec3 velocity)
+{
+	Push(COMMAND_SET_VELOCITY, body, velocity);
+}
+
+void CommandQueue::Producer::SetPosition(int body, glm::vec3 position)
+{
+	Push(COMMAND_SET_POSITION, body, position);
+}
+
+void CommandQueue::Producer::AddAcceleration(int body, glm::vec3 acceleration)
+{
+	Push(COMMAND_ADD_ACCELERATION, body, acceleration);
+}
+
+#endif // _COMMAND_QUEUE_CPP
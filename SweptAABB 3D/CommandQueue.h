@@ -0,0 +1,106 @@
+/*
+Title: Swept AABB-3D
+File Name: CommandQueue.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+A lock-free queue that lets any number of threads (game logic, networking, ...) ask for
+changes to bodies while the physics step is running on other threads. Instead of writing to
+a GameObject directly (which would race with the step), a thread pushes a command, and the
+step applies every queued command in one batch at its start. Commands are applied in order of
+(producer, sequence number), so the result doesn't depend on how the threads happened to race.
+*/
+
+#ifndef _COMMAND_QUEUE_H
+#define _COMMAND_QUEUE_H
+
+#include "GLIncludes.h"
+#include <atomic>
+#include <vector>
+
+enum BodyCommandType
+{
+	COMMAND_SET_VELOCITY,
+	COMMAND_SET_POSITION,
+	COMMAND_ADD_ACCELERATION
+};
+
+// One requested change to one body.
+struct BodyCommand
+{
+	BodyCommandType type;
+	int body;						// The id of the body to change (see GameObject::GetId()).
+	glm::vec3 value;
+
+	unsigned int producer;			// Which producer pushed this command.
+	unsigned long long sequence;	// The order the producer pushed its commands in.
+
+	BodyCommand* next;				// Link to the command pushed before this one.
+};
+
+class CommandQueue
+{
+	// Commands are pushed onto the front of a singly linked list. Pushing only needs a compare-and-swap on the head,
+	// and the consumer always takes the whole list at once (with a single exchange), so no thread ever has to wait on a lock.
+	std::atomic<BodyCommand*> head;
+
+	std::atomic<unsigned int> nextProducer;
+
+	void Push(BodyCommand* command);
+
+public:
+	// A handle a single thread uses to push commands. Each thread should create its own; the handle itself isn't thread-safe,
+	// but any number of handles can push at the same time.
+	class Producer
+	{
+		CommandQueue* queue;
+		unsigned int id;
+		unsigned long long sequence;
+
+		void Push(BodyCommandType type, int body, glm::vec3 value);
+
+	public:
+		Producer(CommandQueue* commandQueue, unsigned int producerId);
+
+		void SetVelocity(int body, glm::vec3 velocity);
+		void SetPosition(int body, glm::vec3 position);
+		void AddAcceleration(int body, glm::vec3 acceleration);
+
+		unsigned int GetId()
+		{
+			return id;
+		}
+	};
+
+	CommandQueue();
+	~CommandQueue();
+
+	// Producers are numbered in the order they are created, and that number decides which producer's commands are applied first.
+	Producer CreateProducer();
+
+	// Takes every command pushed so far, sorted by (producer, sequence). The caller owns the commands and must free them with Release().
+	std::vector<BodyCommand*> Drain();
+
+	// Frees commands returned by Drain().
+	static void Release(std::vector<BodyCommand*>& commands);
+};
+
+#endif //_COMMAND_QUEUE_H
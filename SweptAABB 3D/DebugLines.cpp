@@ -0,0 +1,104 @@
+/*
+Title: Swept AABB-3D
+File Name: DebugLines.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+A batched line renderer for debugging: every line of the frame goes into one dynamic vertex
+buffer and is drawn with a single call.
+*/
+
+#ifndef _DEBUG_LINES_CPP
+#define _DEBUG_LINES_CPP
+
+#include "DebugLines.h"
+
+DebugLines::DebugLines()
+{
+	glGenBuffers(1, &vbo);
+
+	// The same attribute layout as a Model (see Model::InitBuffer()), so the same shaders can draw it.
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexFormat), (void*)16);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(VertexFormat), (void*)0);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+DebugLines::~DebugLines()
+{
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &vbo);
+}
+
+void DebugLines::AddLine(const glm::vec3& from, const glm::vec3& to, const glm::vec4& color)
+{
+	vertices.push_back(VertexFormat(from, color));
+	vertices.push_back(VertexFormat(to, color));
+}
+
+void DebugLines::AddBox(const AABB& box, const glm::vec4& color)
+{
+	// Corner i takes its x from max if bit 0 is set, y if bit 1 is, and z if bit 2 is. Each edge joins two corners that differ in one bit.
+	glm::vec3 corners[8];
+	for (int i = 0; i < 8; i++)
+	{
+		corners[i] = glm::vec3(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z);
+	}
+
+	for (int i = 0; i < 8; i++)
+	{
+		for (int bit = 1; bit < 8; bit <<= 1)
+		{
+			if ((i & bit) == 0)
+			{
+				AddLine(corners[i], corners[i | bit], color);
+			}
+		}
+	}
+}
+
+void DebugLines::Draw(GLuint program, GLint mvpLocation, const glm::mat4& viewProjection)
+{
+	if (vertices.empty())
+	{
+		return;
+	}
+
+	// Passing the data to glBufferData (rather than glBufferSubData) lets the driver hand us fresh memory instead of waiting for the GPU
+	// to finish with last frame's lines.
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(VertexFormat) * vertices.size(), vertices.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glUseProgram(program);
+	glUniformMatrix4fv(mvpLocation, 1, GL_FALSE, glm::value_ptr(viewProjection));
+
+	glBindVertexArray(vao);
+	glDrawArrays(GL_LINES, 0, (GLsizei)vertices.size());
+	glBindVertexArray(0);
+}
+
+#endif // _DEBUG_LINES_CPP
@@ -0,0 +1,70 @@
+/*
+Title: Swept AABB-3D
+File Name: DebugLines.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+A batched line renderer for debugging. Lines are collected on the CPU over the frame (boxes
+are just twelve lines each), and then the whole lot is streamed into one dynamic vertex buffer
+and drawn with a single glDrawArrays(GL_LINES) call, so drawing thousands of boxes costs about
+the same as drawing one. It uses the same vertex layout and shaders as a Model, with the MVP
+uniform set to the view-projection matrix, since the lines are already in world space.
+*/
+
+#ifndef _DEBUG_LINES_H
+#define _DEBUG_LINES_H
+
+#include "GLIncludes.h"
+#include "GameObject.h"
+#include <vector>
+
+class DebugLines
+{
+	// Two vertices per line.
+	std::vector<VertexFormat> vertices;
+
+	GLuint vao;
+	GLuint vbo;
+
+public:
+	DebugLines();
+	~DebugLines();
+
+	void Clear()
+	{
+		vertices.clear();
+	}
+
+	void AddLine(const glm::vec3& from, const glm::vec3& to, const glm::vec4& color);
+
+	// The twelve edges of a box.
+	void AddBox(const AABB& box, const glm::vec4& color);
+
+	// Uploads every line added since the last Clear() and draws them all in one call. mvpLocation is where program keeps its "MVP" uniform.
+	void Draw(GLuint program, GLint mvpLocation, const glm::mat4& viewProjection);
+
+	int NumLines()
+	{
+		return (int)vertices.size() / 2;
+	}
+};
+
+#endif //_DEBUG_LINES_H
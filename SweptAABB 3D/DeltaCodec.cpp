@@ -0,0 +1,680 @@
+/*
+Title: Swept AABB-3D
+File Name: DeltaCodec.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Compresses the state of every body (position, velocity, rotation) step after step, for replays
+and anything else that records the world. Values are quantized to a grid fine enough to stay
+within the configured error, then each frame is coded as the difference from the frame before
+it, in whole grid steps. Bodies that move steadily or not at all give runs of zeros and small
+numbers, which pack into a byte or two each (zero runs and varints), and can optionally be
+squeezed further with an entropy coder (rANS). Every keyframeInterval frames a keyframe is
+coded on its own, so a reader can start there, and a dropped frame only costs until the next one.
+
+Frame layout:
+	uint8 flags				CODEC_KEYFRAME, CODEC_SAME_IDS, CODEC_ENTROPY
+	varint step
+	varint count
+	ids						Unless CODEC_SAME_IDS: the first id, then the gap to each next one, as varints.
+	tokens					Every channel's differences, one channel after another, zigzagged so small negative numbers
+							stay small, as varints. A 0 is followed by a varint run length - 1 of zeros. With CODEC_ENTROPY,
+							the tokens are instead: varint token bytes, then the rANS frequency table and stream.
+*/
+
+#ifndef _DELTA_CODEC_CPP
+#define _DELTA_CODEC_CPP
+
+#include "DeltaCodec.h"
+#include "GameObject.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Use SSE when the compiler targets it (see QueryKernels.h), for rounding without a branch on the sign.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DELTA_CODEC_SSE
+#include <emmintrin.h>
+#endif
+
+const uint8_t CODEC_KEYFRAME = 1;
+const uint8_t CODEC_SAME_IDS = 2;
+const uint8_t CODEC_ENTROPY = 4;
+
+// rANS, with 12 bit frequencies and one byte out at a time.
+const uint32_t RANS_BITS = 12;
+const uint32_t RANS_TOTAL = 1 << RANS_BITS;
+const uint32_t RANS_LOW = 1 << 23;
+
+static inline uint8_t* PutVarint(uint8_t* p, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		*p++ = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	*p++ = (uint8_t)value;
+	return p;
+}
+
+static inline bool GetVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value)
+{
+	// Most tokens are a single byte.
+	if (p < end && *p < 0x80)
+	{
+		value = *p++;
+		return true;
+	}
+
+	value = 0;
+	for (int shift = 0; shift < 64 && p < end; shift += 7)
+	{
+		uint8_t byte = *p++;
+		value |= (uint64_t)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static inline uint32_t Zigzag(int32_t value)
+{
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t Unzigzag(uint32_t value)
+{
+	return (int32_t)((value >> 1) ^ (0u - (value & 1)));
+}
+
+static void SetScales(const CodecSettings& settings, float* scale)
+{
+	// A grid step of twice the error means rounding to the nearest step is never off by more than the error.
+	float errors[CODEC_CHANNELS] =
+	{
+		settings.positionError, settings.positionError, settings.positionError,
+		settings.velocityError, settings.velocityError, settings.velocityError,
+		settings.rotationError, settings.rotationError, settings.rotationError, settings.rotationError
+	};
+	for (int c = 0; c < CODEC_CHANNELS; c++)
+	{
+		scale[c] = errors[c] > 0.0f ? errors[c] * 2.0f : 1e-6f;
+	}
+}
+
+// Quantizes one channel: count floats, stride floats apart. If signs isn't null, each value takes the sign of the matching float
+// there as well (negating it if that's negative), which is how rotations are kept to w >= 0.
+// Values too big for the grid are clamped, rather than wrapping around.
+static void QuantizeChannel(const float* values, const float* signs, size_t stride, size_t count, float inverseScale, int32_t* out)
+{
+	size_t i = 0;
+#ifdef DELTA_CODEC_SSE
+	// Four at a time. The clamps are minps/maxps, and the conversion rounds to nearest, so there are no branches at all.
+	const __m128 scale = _mm_set1_ps(inverseScale);
+	const __m128 low = _mm_set1_ps(-2147483520.0f);
+	const __m128 high = _mm_set1_ps(2147483520.0f);
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		const float* v = values + i * stride;
+		__m128 steps = _mm_mul_ps(_mm_setr_ps(v[0], v[stride], v[2 * stride], v[3 * stride]), scale);
+		if (signs != nullptr)
+		{
+			const float* s = signs + i * stride;
+			steps = _mm_xor_ps(steps, _mm_and_ps(_mm_setr_ps(s[0], s[stride], s[2 * stride], s[3 * stride]), signBit));
+		}
+		steps = _mm_min_ps(_mm_max_ps(steps, low), high);
+		_mm_storeu_si128((__m128i*)(out + i), _mm_cvtps_epi32(steps));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		float steps = values[i * stride] * inverseScale;
+		if (signs != nullptr && signs[i * stride] < 0.0f)
+		{
+			steps = -steps;
+		}
+		if (!(steps > -2147483520.0f))
+		{
+			out[i] = -2147483647;
+		}
+		else if (steps > 2147483520.0f)
+		{
+			out[i] = 2147483647;
+		}
+		else
+		{
+			out[i] = (int32_t)(steps + (steps < 0.0f ? -0.5f : 0.5f));
+		}
+	}
+}
+
+// How many values in a row, from i on, are the same in q and r.
+static inline size_t SameRun(const int32_t* q, const int32_t* r, size_t i, size_t count)
+{
+	size_t start = i;
+#ifdef DELTA_CODEC_SSE
+	// Compare four at a time, then find the first difference in the four that had one.
+	static const int trailingOnes[16] = { 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4 };
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i same = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(q + i)), _mm_loadu_si128((const __m128i*)(r + i)));
+		int mask = _mm_movemask_ps(_mm_castsi128_ps(same));
+		if (mask != 0xF)
+		{
+			return i + trailingOnes[mask] - start;
+		}
+	}
+#endif
+	while (i < count && q[i] == r[i])
+	{
+		i++;
+	}
+	return i - start;
+}
+
+// Writes the frequency table (which symbols are used, then each one's frequency) and the rANS stream for in. Returns false if it
+// didn't come out any smaller.
+static bool RansEncode(const uint8_t* in, size_t length, std::vector<uint8_t>& out)
+{
+	uint32_t counts[256] = { 0 };
+	for (size_t i = 0; i < length; i++)
+	{
+		counts[in[i]]++;
+	}
+
+	// Scale the counts so they add up to RANS_TOTAL, keeping every symbol that appears at 1 or more. The rounding is taken out of
+	// (or added to) the most common symbols.
+	uint32_t freq[256];
+	uint32_t sum = 0;
+	int largest = 0;
+	for (int s = 0; s < 256; s++)
+	{
+		freq[s] = counts[s] == 0 ? 0 : std::max<uint32_t>(1, (uint32_t)((uint64_t)counts[s] * RANS_TOTAL / length));
+		sum += freq[s];
+		if (freq[s] > freq[largest])
+		{
+			largest = s;
+		}
+	}
+	while (sum > RANS_TOTAL)
+	{
+		int biggest = 0;
+		for (int s = 1; s < 256; s++)
+		{
+			if (freq[s] > freq[biggest])
+			{
+				biggest = s;
+			}
+		}
+		uint32_t take = std::min(sum - RANS_TOTAL, freq[biggest] - 1);
+		freq[biggest] -= take;
+		sum -= take;
+	}
+	freq[largest] += RANS_TOTAL - sum;
+
+	uint32_t start[256];
+	uint32_t cumulative = 0;
+	for (int s = 0; s < 256; s++)
+	{
+		start[s] = cumulative;
+		cumulative += freq[s];
+	}
+
+	// rANS codes backwards, so fill a scratch buffer from its end.
+	std::vector<uint8_t> stream(length + length / 8 + 16);
+	uint8_t* end = stream.data() + stream.size();
+	uint8_t* p = end;
+	uint32_t x = RANS_LOW;
+	for (size_t i = length; i-- > 0;)
+	{
+		uint32_t f = freq[in[i]];
+		uint32_t limit = ((RANS_LOW >> RANS_BITS) << 8) * f;
+		while (x >= limit)
+		{
+			if (p == stream.data())
+			{
+				return false;
+			}
+			*--p = (uint8_t)x;
+			x >>= 8;
+		}
+		x = ((x / f) << RANS_BITS) + (x % f) + start[in[i]];
+	}
+	if (p - stream.data() < 4)
+	{
+		return false;
+	}
+	p -= 4;
+	p[0] = (uint8_t)x;
+	p[1] = (uint8_t)(x >> 8);
+	p[2] = (uint8_t)(x >> 16);
+	p[3] = (uint8_t)(x >> 24);
+
+	size_t streamLength = end - p;
+	out.resize(32 + 256 * 2 + 10 + streamLength);
+	uint8_t* o = out.data();
+	memset(o, 0, 32);
+	for (int s = 0; s < 256; s++)
+	{
+		if (freq[s] > 0)
+		{
+			o[s >> 3] |= (uint8_t)(1 << (s & 7));
+		}
+	}
+	o += 32;
+	for (int s = 0; s < 256; s++)
+	{
+		if (freq[s] > 0)
+		{
+			o = PutVarint(o, freq[s] - 1);
+		}
+	}
+	o = PutVarint(o, streamLength);
+	memcpy(o, p, streamLength);
+	o += streamLength;
+	out.resize(o - out.data());
+
+	return out.size() < length;
+}
+
+static bool RansDecode(const uint8_t*& p, const uint8_t* end, uint8_t* out, size_t length)
+{
+	if (end - p < 32)
+	{
+		return false;
+	}
+	const uint8_t* used = p;
+	p += 32;
+
+	uint32_t freq[256];
+	uint32_t start[256];
+	uint32_t cumulative = 0;
+	for (int s = 0; s < 256; s++)
+	{
+		freq[s] = 0;
+		if (used[s >> 3] & (1 << (s & 7)))
+		{
+			uint64_t f;
+			if (!GetVarint(p, end, f) || f >= RANS_TOTAL)
+			{
+				return false;
+			}
+			freq[s] = (uint32_t)f + 1;
+		}
+		start[s] = cumulative;
+		cumulative += freq[s];
+	}
+	if (cumulative != RANS_TOTAL)
+	{
+		return false;
+	}
+
+	uint8_t symbolAt[RANS_TOTAL];
+	for (int s = 0; s < 256; s++)
+	{
+		memset(symbolAt + start[s], s, freq[s]);
+	}
+
+	uint64_t streamLength;
+	if (!GetVarint(p, end, streamLength) || streamLength < 4 || streamLength > (uint64_t)(end - p))
+	{
+		return false;
+	}
+	const uint8_t* stream = p;
+	const uint8_t* streamEnd = p + streamLength;
+	p = streamEnd;
+
+	uint32_t x = stream[0] | (stream[1] << 8) | (stream[2] << 16) | ((uint32_t)stream[3] << 24);
+	stream += 4;
+	for (size_t i = 0; i < length; i++)
+	{
+		uint32_t slot = x & (RANS_TOTAL - 1);
+		uint8_t s = symbolAt[slot];
+		out[i] = s;
+		x = freq[s] * (x >> RANS_BITS) + slot - start[s];
+		while (x < RANS_LOW)
+		{
+			if (stream == streamEnd)
+			{
+				return false;
+			}
+			x = (x << 8) | *stream++;
+		}
+	}
+	return true;
+}
+
+// Lines up the reference's values with the bodies in ids: bodies that weren't in the reference are coded against 0.
+static const int32_t* Align(const CodecReference& reference, const std::vector<int>& ids, std::vector<int32_t>& aligned)
+{
+	if (reference.ids == ids)
+	{
+		return reference.values.data();
+	}
+
+	size_t count = ids.size();
+	size_t referenceCount = reference.ids.size();
+	aligned.assign(count * CODEC_CHANNELS, 0);
+	size_t r = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		while (r < referenceCount && reference.ids[r] < ids[i])
+		{
+			r++;
+		}
+		if (r < referenceCount && reference.ids[r] == ids[i])
+		{
+			for (int c = 0; c < CODEC_CHANNELS; c++)
+			{
+				aligned[c * count + i] = reference.values[c * referenceCount + r];
+			}
+		}
+	}
+	return aligned.data();
+}
+
+void StateFrame::Capture(uint64_t stepNumber, const std::vector<GameObject*>& bodies)
+{
+	step = stepNumber;
+
+	std::vector<std::pair<int, int>> order(bodies.size());
+	for (size_t i = 0; i < bodies.size(); i++)
+	{
+		order[i] = std::make_pair(bodies[i]->GetId(), (int)i);
+	}
+	std::sort(order.begin(), order.end());
+
+	ids.resize(bodies.size());
+	positions.resize(bodies.size());
+	velocities.resize(bodies.size());
+	rotations.resize(bodies.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		GameObject* body = bodies[order[i].second];
+		ids[i] = order[i].first;
+		positions[i] = body->GetPosition();
+		velocities[i] = body->GetVelocity();
+		rotations[i] = body->GetRotation();
+	}
+}
+
+DeltaEncoder::DeltaEncoder(const CodecSettings& codecSettings)
+{
+	settings = codecSettings;
+	SetScales(settings, scale);
+	framesSinceKeyframe = -1;
+}
+
+void DeltaEncoder::Encode(const StateFrame& frame, std::vector<char>& out)
+{
+	size_t count = frame.ids.size();
+	size_t numValues = count * CODEC_CHANNELS;
+
+	bool keyframe = framesSinceKeyframe < 0 || framesSinceKeyframe >= settings.keyframeInterval;
+	framesSinceKeyframe = keyframe ? 1 : framesSinceKeyframe + 1;
+
+	// Quantize, one channel after another, so each channel's differences sit together.
+	quantized.resize(numValues);
+	int32_t* q = quantized.data();
+	if (count > 0)
+	{
+		const size_t vec3Stride = sizeof(glm::vec3) / sizeof(float);
+		const size_t quatStride = sizeof(glm::quat) / sizeof(float);
+		const glm::vec3* positions = frame.positions.data();
+		const glm::vec3* velocities = frame.velocities.data();
+		const glm::quat* rotations = frame.rotations.data();
+		const float* channels[CODEC_CHANNELS] =
+		{
+			&positions[0].x, &positions[0].y, &positions[0].z,
+			&velocities[0].x, &velocities[0].y, &velocities[0].z,
+			&rotations[0].x, &rotations[0].y, &rotations[0].z, &rotations[0].w
+		};
+		for (int c = 0; c < CODEC_CHANNELS; c++)
+		{
+			// q and -q are the same rotation. Always picking the one with w >= 0 keeps it from flipping sign between frames.
+			const float* signs = c >= 6 ? &rotations[0].w : nullptr;
+			QuantizeChannel(channels[c], signs, c >= 6 ? quatStride : vec3Stride, count, 1.0f / scale[c], q + c * count);
+		}
+	}
+
+	const int32_t* r;
+	bool sameIds = false;
+	if (keyframe)
+	{
+		aligned.assign(numValues, 0);
+		r = aligned.data();
+	}
+	else
+	{
+		sameIds = reference.ids == frame.ids;
+		r = Align(reference, frame.ids, aligned);
+	}
+
+	// Header and ids.
+	size_t start = out.size();
+	out.resize(start + 1 + 10 + 10 + (sameIds ? 0 : count * 5));
+	uint8_t* base = (uint8_t*)out.data() + start;
+	uint8_t* p = base + 1;
+	p = PutVarint(p, frame.step);
+	p = PutVarint(p, count);
+	if (!sameIds)
+	{
+		int previous = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			p = PutVarint(p, (uint32_t)(frame.ids[i] - previous));
+			previous = frame.ids[i];
+		}
+	}
+	base[0] = (keyframe ? CODEC_KEYFRAME : 0) | (sameIds ? CODEC_SAME_IDS : 0);
+	out.resize(start + (p - base));
+
+	// The differences, with runs of zeros squashed.
+	tokens.resize(numValues * 5 + 16);
+	uint8_t* t = tokens.data();
+	for (size_t i = 0; i < numValues;)
+	{
+		uint32_t delta = (uint32_t)q[i] - (uint32_t)r[i];
+		if (delta != 0)
+		{
+			uint32_t token = Zigzag((int32_t)delta);
+			if (token < 0x80)
+			{
+				*t++ = (uint8_t)token;
+			}
+			else
+			{
+				t = PutVarint(t, token);
+			}
+			i++;
+		}
+		else
+		{
+			size_t run = SameRun(q, r, i, numValues);
+			*t++ = 0;
+			t = PutVarint(t, run - 1);
+			i += run;
+		}
+	}
+	size_t tokenLength = t - tokens.data();
+
+	std::vector<uint8_t> entropy;
+	if (settings.entropyCoding && tokenLength > 0 && RansEncode(tokens.data(), tokenLength, entropy))
+	{
+		out[start] |= CODEC_ENTROPY;
+		uint8_t lengthBytes[10];
+		uint8_t* lengthEnd = PutVarint(lengthBytes, tokenLength);
+		out.insert(out.end(), (char*)lengthBytes, (char*)lengthEnd);
+		out.insert(out.end(), (char*)entropy.data(), (char*)entropy.data() + entropy.size());
+	}
+	else
+	{
+		out.insert(out.end(), (char*)tokens.data(), (char*)tokens.data() + tokenLength);
+	}
+
+	// This frame, as the decoder will see it, is what the next one is coded against.
+	reference.ids = frame.ids;
+	reference.values.swap(quantized);
+}
+
+DeltaDecoder::DeltaDecoder(const CodecSettings& codecSettings)
+{
+	settings = codecSettings;
+	SetScales(settings, scale);
+	haveReference = false;
+}
+
+bool DeltaDecoder::Decode(const char* data, size_t size, StateFrame& frame)
+{
+	const uint8_t* p = (const uint8_t*)data;
+	const uint8_t* end = p + size;
+	if (size < 1)
+	{
+		return false;
+	}
+
+	uint8_t flags = *p++;
+	bool keyframe = (flags & CODEC_KEYFRAME) != 0;
+	if (!keyframe && !haveReference)
+	{
+		return false;
+	}
+
+	uint64_t step, count;
+	if (!GetVarint(p, end, step) || !GetVarint(p, end, count))
+	{
+		return false;
+	}
+	frame.step = step;
+
+	if (flags & CODEC_SAME_IDS)
+	{
+		if (keyframe || count != reference.ids.size())
+		{
+			return false;
+		}
+		frame.ids = reference.ids;
+	}
+	else
+	{
+		// Every id takes at least a byte, so a count bigger than that is broken (and mustn't be allocated).
+		if (count > size)
+		{
+			return false;
+		}
+		frame.ids.resize(count);
+		uint64_t id = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			uint64_t gap;
+			if (!GetVarint(p, end, gap))
+			{
+				return false;
+			}
+			id += gap;
+			frame.ids[i] = (int)id;
+		}
+	}
+
+	size_t numValues = count * CODEC_CHANNELS;
+	const int32_t* r;
+	if (keyframe)
+	{
+		aligned.assign(numValues, 0);
+		r = aligned.data();
+	}
+	else
+	{
+		r = Align(reference, frame.ids, aligned);
+	}
+
+	const uint8_t* t = p;
+	const uint8_t* tokenEnd = end;
+	if (flags & CODEC_ENTROPY)
+	{
+		uint64_t tokenLength;
+		if (!GetVarint(p, end, tokenLength) || tokenLength > numValues * 5 + 16)
+		{
+			return false;
+		}
+		tokens.resize(tokenLength);
+		if (!RansDecode(p, end, tokens.data(), tokenLength) || p != end)
+		{
+			return false;
+		}
+		t = tokens.data();
+		tokenEnd = t + tokenLength;
+	}
+
+	decoded.resize(numValues);
+	int32_t* q = decoded.data();
+	for (size_t i = 0; i < numValues;)
+	{
+		uint64_t token;
+		if (!GetVarint(t, tokenEnd, token) || token > 0xFFFFFFFFull)
+		{
+			return false;
+		}
+		if (token == 0)
+		{
+			uint64_t run;
+			if (!GetVarint(t, tokenEnd, run) || run >= numValues - i)
+			{
+				return false;
+			}
+			memcpy(q + i, r + i, (run + 1) * sizeof(int32_t));
+			i += run + 1;
+		}
+		else
+		{
+			q[i] = (int32_t)((uint32_t)r[i] + (uint32_t)Unzigzag((uint32_t)token));
+			i++;
+		}
+	}
+	if (t != tokenEnd)
+	{
+		return false;
+	}
+
+	frame.positions.resize(count);
+	frame.velocities.resize(count);
+	frame.rotations.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		frame.positions[i] = glm::vec3(q[0 * count + i] * scale[0], q[1 * count + i] * scale[1], q[2 * count + i] * scale[2]);
+		frame.velocities[i] = glm::vec3(q[3 * count + i] * scale[3], q[4 * count + i] * scale[4], q[5 * count + i] * scale[5]);
+
+		glm::quat rotation(q[9 * count + i] * scale[9], q[6 * count + i] * scale[6], q[7 * count + i] * scale[7], q[8 * count + i] * scale[8]);
+		float length = glm::length(rotation);
+		frame.rotations[i] = length > 0.0f ? rotation / length : glm::quat();
+	}
+
+	reference.ids = frame.ids;
+	reference.values.swap(decoded);
+	haveReference = true;
+
+	return true;
+}
+
+#endif // _DELTA_CODEC_CPP
@@ -0,0 +1,135 @@
+/*
+Title: Swept AABB-3D
+File Name: DeltaCodec.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Compresses the state of every body (position, velocity, rotation) step after step, for replays
+and anything else that records the world. Values are quantized to a grid fine enough to stay
+within the configured error, then each frame is coded as the difference from the frame before
+it, in whole grid steps. Bodies that move steadily or not at all give runs of zeros and small
+numbers, which pack into a byte or two each (zero runs and varints), and can optionally be
+squeezed further with an entropy coder (rANS). Every keyframeInterval frames a keyframe is
+coded on its own, so a reader can start there, and a dropped frame only costs until the next one.
+*/
+
+#ifndef _DELTA_CODEC_H
+#define _DELTA_CODEC_H
+
+#include "GLIncludes.h"
+#include <cstdint>
+#include <vector>
+
+class GameObject;
+
+struct CodecSettings
+{
+	// The most a decoded value may differ from the original. Rotations are quaternion components, which are between -1 and 1.
+	float positionError;
+	float velocityError;
+	float rotationError;
+
+	// A keyframe every this many frames.
+	int keyframeInterval;
+
+	// Entropy code each frame as well. Often halves the size again, but takes several times as long as everything else put together.
+	bool entropyCoding;
+
+	CodecSettings()
+	{
+		positionError = 0.0005f;
+		velocityError = 0.001f;
+		rotationError = 0.0005f;
+		keyframeInterval = 60;
+		entropyCoding = false;
+	}
+};
+
+// The state of every body at one step, sorted by id.
+struct StateFrame
+{
+	uint64_t step;
+	std::vector<int> ids;
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> velocities;
+	std::vector<glm::quat> rotations;
+
+	void Capture(uint64_t stepNumber, const std::vector<GameObject*>& bodies);
+};
+
+// Position, velocity and rotation, one channel per component.
+const int CODEC_CHANNELS = 10;
+
+// The frame a new frame is coded against. The encoder and decoder both keep one, and always agree on it, since it's made of
+// quantized values that both sides have exactly.
+struct CodecReference
+{
+	std::vector<int> ids;
+	std::vector<int32_t> values;		// CODEC_CHANNELS channels of ids.size() values each.
+};
+
+class DeltaEncoder
+{
+	CodecSettings settings;
+	float scale[CODEC_CHANNELS];
+
+	CodecReference reference;
+	int framesSinceKeyframe;
+
+	std::vector<int32_t> quantized;
+	std::vector<int32_t> aligned;
+	std::vector<uint8_t> tokens;
+
+public:
+	DeltaEncoder(const CodecSettings& codecSettings = CodecSettings());
+
+	// Appends one coded frame to out.
+	void Encode(const StateFrame& frame, std::vector<char>& out);
+
+	// Makes the next frame a keyframe. Call this if a frame didn't make it to the decoder, so it can pick up again from the next one.
+	void ForceKeyframe()
+	{
+		framesSinceKeyframe = -1;
+	}
+};
+
+class DeltaDecoder
+{
+	CodecSettings settings;
+	float scale[CODEC_CHANNELS];
+
+	CodecReference reference;
+	bool haveReference;
+
+	std::vector<int32_t> decoded;
+	std::vector<int32_t> aligned;
+	std::vector<uint8_t> tokens;
+
+public:
+	// The settings' errors must be the same ones the frames were encoded with.
+	DeltaDecoder(const CodecSettings& codecSettings = CodecSettings());
+
+	// Decodes one frame. Returns false if the data is broken, or is a delta frame and we don't have the frame before it
+	// (skip ahead to the next keyframe then).
+	bool Decode(const char* data, size_t size, StateFrame& frame);
+};
+
+#endif //_DELTA_CODEC_H
@@ -0,0 +1,382 @@
+/*
+Title: Swept AABB-3D
+File Name: DistributedWorld.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Runs one world across several processes (ranks), each owning one slab of space along x.
+Every rank steps only the bodies it owns. Before each step, a body that is close enough to a
+neighbouring slab to touch something there this step is copied to that neighbour as a "ghost",
+so the swept collision test on each side sees the bodies on the other. Ghosts are thrown away
+after the step; each rank keeps only what happened to its own bodies. A body that has moved into
+another rank's slab changes owner (migrates) in the same exchange.
+*/
+
+#ifndef _DISTRIBUTED_WORLD_CPP
+#define _DISTRIBUTED_WORLD_CPP
+
+#include "DistributedWorld.h"
+#include "Collision.h"
+#include <iostream>
+#include <algorithm>
+
+DistributedWorld::DistributedWorld(JobSystem* jobSystem, ClusterLink* clusterLink, Model* bodyModel, const DistributedSettings& worldSettings)
+{
+	link = clusterLink;
+	settings = worldSettings;
+	model = bodyModel;
+
+	partition = new WorldPartition(jobSystem, settings.bounds, settings.regionsX, settings.regionsY, settings.regionsZ, settings.bodiesPerRegion);
+	pipeline = new StepPipeline(partition);
+
+	// The furthest any vertex is from the model's origin. However the body is turned, nothing of it is further away than that.
+	// The collision proxy is what the AABBs are made from, so that's what to measure.
+	reach = 0.0f;
+	for (int i = 0; i < model->NumCollisionVertices(); i++)
+	{
+		reach = std::max(reach, glm::length(model->CollisionVertices()[i]));
+	}
+
+	halo = settings.haloWidth;
+	nextId = 0;
+	lastGhosts = 0;
+
+	// Equal slabs along x, one per rank.
+	int ranks = link->NumRanks();
+	float width = (settings.bounds.max.x - settings.bounds.min.x) / ranks;
+	std::vector<AABB> slabs(ranks, settings.bounds);
+	for (int r = 0; r < ranks; r++)
+	{
+		slabs[r].min.x = settings.bounds.min.x + width * r;
+		slabs[r].max.x = r == ranks - 1 ? settings.bounds.max.x : settings.bounds.min.x + width * (r + 1);
+	}
+	SetDomains(slabs);
+}
+
+DistributedWorld::~DistributedWorld()
+{
+	delete(pipeline);
+	delete(partition);
+}
+
+void DistributedWorld::SetDomains(const std::vector<AABB>& rankDomains)
+{
+	if ((int)rankDomains.size() != link->NumRanks())
+	{
+		std::cout << "Need one domain per rank, got " << rankDomains.size() << " for " << link->NumRanks() << " ranks" << std::endl;
+		return;
+	}
+	domains = rankDomains;
+}
+
+int DistributedWorld::DomainOf(glm::vec3 position)
+{
+	// The domain closest to the position wins; inside a domain counts as a distance of zero. A position right on the edge between
+	// two domains goes to the lower rank, so every rank comes to the same answer.
+	int best = 0;
+	float bestDistance = 0.0f;
+	for (size_t r = 0; r < domains.size(); r++)
+	{
+		glm::vec3 outside = glm::max(domains[r].min - position, glm::max(position - domains[r].max, glm::vec3(0.0f)));
+		float distance = glm::dot(outside, outside);
+		if (r == 0 || distance < bestDistance)
+		{
+			best = (int)r;
+			bestDistance = distance;
+		}
+	}
+	return best;
+}
+
+float DistributedWorld::ExtentOf(GameObject* body, float dt)
+{
+	glm::vec3 scale = body->GetScale();
+	return reach * std::max(fabsf(scale.x), std::max(fabsf(scale.y), fabsf(scale.z))) + glm::length(body->GetVelocity()) * dt;
+}
+
+AABB DistributedWorld::HaloBox(GameObject* body, float dt)
+{
+	glm::vec3 scale = body->GetScale();
+	glm::vec3 radius = glm::vec3(reach * std::max(fabsf(scale.x), std::max(fabsf(scale.y), fabsf(scale.z))));
+
+	AABB box = SweptBounds(AABB(body->GetPosition() - radius, body->GetPosition() + radius), body->GetVelocity() * dt);
+	box.min -= glm::vec3(halo);
+	box.max += glm::vec3(halo);
+	return box;
+}
+
+GameObject* DistributedWorld::AddBody(uint64_t id, glm::vec3 position)
+{
+	GameObject* body = partition->CreateBody(model, position);
+	if (body == nullptr)
+	{
+		return nullptr;
+	}
+
+	if (body->GetId() >= (int)globalIds.size())
+	{
+		globalIds.resize(body->GetId() + 1, 0);
+	}
+	globalIds[body->GetId()] = id;
+
+	return body;
+}
+
+uint64_t DistributedWorld::CreateBody(glm::vec3 position, glm::vec3 velocity, glm::vec3 scale)
+{
+	uint64_t id = ((uint64_t)(link->Rank() + 1) << 32) | nextId;
+
+	GameObject* body = AddBody(id, position);
+	if (body == nullptr)
+	{
+		return 0;
+	}
+	nextId++;
+
+	body->SetVelocity(velocity);
+	body->SetScale(scale);
+	localIds[id] = body->GetId();
+
+	return id;
+}
+
+GameObject* DistributedWorld::FindBody(uint64_t id)
+{
+	std::unordered_map<uint64_t, int>::iterator found = localIds.find(id);
+	if (found == localIds.end())
+	{
+		return nullptr;
+	}
+	return partition->GetBody(found->second);
+}
+
+void DistributedWorld::ForEachOwned(std::function<void(uint64_t, GameObject*)> fn)
+{
+	for (std::unordered_map<uint64_t, int>::iterator i = localIds.begin(); i != localIds.end(); i++)
+	{
+		fn(i->first, partition->GetBody(i->second));
+	}
+}
+
+// A body on the wire: uint64 global id, vec3 position, vec3 velocity, vec3 acceleration, vec3 scale, then the rotation as x, y, z, w.
+void DistributedWorld::WriteBody(MessageWriter& writer, uint64_t id, GameObject* body)
+{
+	glm::vec3 position = body->GetPosition();
+	glm::vec3 velocity = body->GetVelocity();
+	glm::vec3 acceleration = body->GetAcceleration();
+	glm::vec3 scale = body->GetScale();
+	glm::quat rotation = body->GetRotation();
+
+	writer.U64(id);
+	writer.Vec3(position.x, position.y, position.z);
+	writer.Vec3(velocity.x, velocity.y, velocity.z);
+	writer.Vec3(acceleration.x, acceleration.y, acceleration.z);
+	writer.Vec3(scale.x, scale.y, scale.z);
+	writer.F32(rotation.x);
+	writer.F32(rotation.y);
+	writer.F32(rotation.z);
+	writer.F32(rotation.w);
+}
+
+bool DistributedWorld::ReadBody(MessageReader& reader, bool owned)
+{
+	uint64_t id = reader.U64();
+	glm::vec3 position, velocity, acceleration, scale;
+	glm::quat rotation;
+	position.x = reader.F32(); position.y = reader.F32(); position.z = reader.F32();
+	velocity.x = reader.F32(); velocity.y = reader.F32(); velocity.z = reader.F32();
+	acceleration.x = reader.F32(); acceleration.y = reader.F32(); acceleration.z = reader.F32();
+	scale.x = reader.F32(); scale.y = reader.F32(); scale.z = reader.F32();
+	rotation.x = reader.F32(); rotation.y = reader.F32(); rotation.z = reader.F32(); rotation.w = reader.F32();
+	if (reader.Failed())
+	{
+		return false;
+	}
+
+	GameObject* body = AddBody(id, position);
+	if (body == nullptr)
+	{
+		std::cout << "No room for body " << id << " from another rank, " << (owned ? "it is lost." : "its ghost is skipped.") << std::endl;
+		return true;
+	}
+
+	body->SetVelocity(velocity);
+	body->SetAcceleration(acceleration);
+	body->SetScale(scale);
+	body->SetRotation(rotation);
+
+	if (owned)
+	{
+		localIds[id] = body->GetId();
+	}
+	else
+	{
+		ghosts.push_back(body->GetId());
+	}
+	return true;
+}
+
+bool DistributedWorld::Step(float dt)
+{
+	int me = link->Rank();
+	int ranks = link->NumRanks();
+
+	// Go through our bodies in order of global id, so the same world always sends the same messages.
+	std::vector<std::pair<uint64_t, int>> owned(localIds.begin(), localIds.end());
+	std::sort(owned.begin(), owned.end());
+
+	// Sort every body into what has to go where. A body is sent to its new owner if it has left our domain, and as a ghost to every
+	// other rank whose domain its halo box reaches into. If a body we're giving away can still touch our own bodies this step,
+	// we keep it here as a ghost rather than getting it sent back to us.
+	std::vector<std::vector<std::pair<uint64_t, GameObject*>>> migrants(ranks);
+	std::vector<std::vector<std::pair<uint64_t, GameObject*>>> ghostsOut(ranks);
+	std::vector<std::pair<int, bool>> leaving;
+	float extent = 0.0f;
+
+	for (size_t i = 0; i < owned.size(); i++)
+	{
+		GameObject* body = partition->GetBody(owned[i].second);
+		extent = std::max(extent, ExtentOf(body, dt));
+
+		int owner = DomainOf(body->GetPosition());
+		AABB box = HaloBox(body, dt);
+		bool keepAsGhost = false;
+
+		for (int r = 0; r < ranks; r++)
+		{
+			if (r == owner)
+			{
+				if (r != me)
+				{
+					migrants[r].push_back(std::make_pair(owned[i].first, body));
+				}
+			}
+			else if (TestAABB(box, domains[r]))
+			{
+				if (r == me)
+				{
+					keepAsGhost = true;
+				}
+				else
+				{
+					ghostsOut[r].push_back(std::make_pair(owned[i].first, body));
+				}
+			}
+		}
+
+		if (owner != me)
+		{
+			leaving.push_back(std::make_pair(owned[i].second, keepAsGhost));
+		}
+	}
+
+	// One message per rank: the biggest extent we've got (so everybody can widen their halo if needed), then the migrants, then the ghosts.
+	std::vector<std::vector<char>> outgoing(ranks);
+	std::vector<std::vector<char>> incoming;
+	for (int r = 0; r < ranks; r++)
+	{
+		if (r == me)
+		{
+			continue;
+		}
+
+		MessageWriter writer(&outgoing[r]);
+		writer.F32(extent);
+		writer.U32((uint32_t)migrants[r].size());
+		for (size_t i = 0; i < migrants[r].size(); i++)
+		{
+			WriteBody(writer, migrants[r][i].first, migrants[r][i].second);
+		}
+		writer.U32((uint32_t)ghostsOut[r].size());
+		for (size_t i = 0; i < ghostsOut[r].size(); i++)
+		{
+			WriteBody(writer, ghostsOut[r][i].first, ghostsOut[r][i].second);
+		}
+	}
+
+	// The migrants have been written out, so they aren't ours anymore.
+	for (size_t i = 0; i < leaving.size(); i++)
+	{
+		localIds.erase(globalIds[leaving[i].first]);
+		if (leaving[i].second)
+		{
+			ghosts.push_back(leaving[i].first);
+		}
+		else
+		{
+			partition->DestroyBody(leaving[i].first);
+		}
+	}
+
+	if (!link->Exchange(outgoing, incoming))
+	{
+		return false;
+	}
+
+	float widest = extent;
+	for (int r = 0; r < ranks; r++)
+	{
+		if (r == me)
+		{
+			continue;
+		}
+
+		MessageReader reader(incoming[r].data(), incoming[r].size());
+		widest = std::max(widest, reader.F32());
+
+		bool good = true;
+		uint32_t numMigrants = reader.U32();
+		for (uint32_t i = 0; i < numMigrants && good; i++)
+		{
+			good = ReadBody(reader, true);
+		}
+		uint32_t numGhosts = reader.U32();
+		for (uint32_t i = 0; i < numGhosts && good; i++)
+		{
+			good = ReadBody(reader, false);
+		}
+
+		if (!good || reader.Failed())
+		{
+			std::cout << "Bad exchange message from rank " << r << std::endl;
+			return false;
+		}
+	}
+
+	// Step everything here, ghosts included. Our bodies bounce off the ghosts just as they would off the real bodies on the other rank,
+	// and that rank does the same with ghosts of ours, so both sides agree on every collision across the border.
+	lastGhosts = (int)ghosts.size();
+	pipeline->Step(dt);
+
+	// What happened to the ghosts is the other ranks' business; they send us fresh ones next step.
+	for (size_t i = 0; i < ghosts.size(); i++)
+	{
+		partition->DestroyBody(ghosts[i]);
+	}
+	ghosts.clear();
+
+	// Every rank saw the same extents, so every rank ends up with the same halo.
+	halo = std::max(settings.haloWidth, widest);
+
+	return true;
+}
+
+#endif // _DISTRIBUTED_WORLD_CPP
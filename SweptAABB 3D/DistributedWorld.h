@@ -0,0 +1,156 @@
+/*
+Title: Swept AABB-3D
+File Name: DistributedWorld.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Runs one world across several processes (ranks), each owning one slab of space along x.
+Every rank steps only the bodies it owns. Before each step, a body that is close enough to a
+neighbouring slab to touch something there this step is copied to that neighbour as a "ghost",
+so the swept collision test on each side sees the bodies on the other. Ghosts are thrown away
+after the step; each rank keeps only what happened to its own bodies. A body that has moved into
+another rank's slab changes owner (migrates) in the same exchange.
+*/
+
+#ifndef _DISTRIBUTED_WORLD_H
+#define _DISTRIBUTED_WORLD_H
+
+#include "StepPipeline.h"
+#include "ClusterLink.h"
+#include "ByteStream.h"
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+struct DistributedSettings
+{
+	// The whole world, across every rank. Every rank builds a partition over all of it, so bodies can migrate anywhere.
+	AABB bounds;
+	int regionsX, regionsY, regionsZ;
+	int bodiesPerRegion;
+
+	// How far outside a rank's slab bodies are still copied to it as ghosts. It has to be at least as big as the biggest body plus
+	// the furthest a body moves in one step; the world widens it on its own once it has seen bigger or faster bodies.
+	float haloWidth;
+
+	DistributedSettings()
+	{
+		bounds = AABB(glm::vec3(-1.25f), glm::vec3(1.25f));
+		regionsX = regionsY = regionsZ = 2;
+		bodiesPerRegion = 256;
+		haloWidth = 0.25f;
+	}
+};
+
+class DistributedWorld
+{
+	ClusterLink* link;
+	DistributedSettings settings;
+
+	WorldPartition* partition;
+	StepPipeline* pipeline;
+
+	// Every body is made from the same model. reach is how far the model goes from its origin, at a scale of 1.
+	Model* model;
+	float reach;
+
+	// The part of space each rank owns. Every rank must have the same list.
+	std::vector<AABB> domains;
+
+	// The halo actually used: the settings' width, or the biggest reach plus movement any rank reported last step, if that's more.
+	float halo;
+
+	// Bodies are known across ranks by a global id: (creating rank + 1) << 32 | a count, so 0 is never a valid id.
+	// Only owned bodies are in localIds. globalIds is indexed by the local id of every body here, ghosts included.
+	uint64_t nextId;
+	std::unordered_map<uint64_t, int> localIds;
+	std::vector<uint64_t> globalIds;
+
+	// The local ids of the ghosts made for the current step.
+	std::vector<int> ghosts;
+	int lastGhosts;
+
+	// Box around everything a body could touch this step: its reach, swept by its velocity, and widened by the halo.
+	AABB HaloBox(GameObject* body, float dt);
+	float ExtentOf(GameObject* body, float dt);
+
+	GameObject* AddBody(uint64_t id, glm::vec3 position);
+	void WriteBody(MessageWriter& writer, uint64_t id, GameObject* body);
+	bool ReadBody(MessageReader& reader, bool owned);
+
+public:
+	// link must already be connected. The world doesn't own the model, the link, or the job system.
+	DistributedWorld(JobSystem* jobSystem, ClusterLink* clusterLink, Model* bodyModel, const DistributedSettings& worldSettings = DistributedSettings());
+	~DistributedWorld();
+
+	// By default the world is cut into equal slabs along x, one per rank. Any other split works too, as long as the boxes cover the world
+	// without overlapping, and every rank sets the same list before the same step. Bodies change owner at the next step.
+	void SetDomains(const std::vector<AABB>& rankDomains);
+	const std::vector<AABB>& GetDomains()
+	{
+		return domains;
+	}
+
+	// The rank whose domain contains position. Positions outside every domain go to the nearest one.
+	int DomainOf(glm::vec3 position);
+
+	// Creates a body on this rank and returns its global id, or 0 if there's no room for it. A body created outside this rank's domain
+	// is handed over to the right rank at the next step.
+	uint64_t CreateBody(glm::vec3 position, glm::vec3 velocity, glm::vec3 scale);
+
+	// Finds a body this rank owns. Returns nullptr for bodies owned by other ranks.
+	GameObject* FindBody(uint64_t id);
+
+	// Runs fn on every body this rank owns.
+	void ForEachOwned(std::function<void(uint64_t, GameObject*)> fn);
+
+	// Steps the whole world by dt. Every rank has to call this together: it swaps migrants and ghosts with the other ranks, steps the
+	// bodies here, and throws the ghosts away again. Returns false if another rank has gone away.
+	bool Step(float dt);
+
+	int NumOwned()
+	{
+		return (int)localIds.size();
+	}
+
+	AABB GetBounds()
+	{
+		return settings.bounds;
+	}
+	ClusterLink* GetLink()
+	{
+		return link;
+	}
+
+	// How many ghosts the last step had from the other ranks.
+	int NumGhosts()
+	{
+		return lastGhosts;
+	}
+
+	StepPipeline* GetPipeline()
+	{
+		return pipeline;
+	}
+};
+
+#endif //_DISTRIBUTED_WORLD_H
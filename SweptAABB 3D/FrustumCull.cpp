@@ -0,0 +1,224 @@
+/*
+Title: Swept AABB-3D
+File Name: FrustumCull.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+View-frustum culling against the AABBs the physics already keeps for every body, eight boxes
+per instruction with AVX (four with SSE, one at a time without either).
+*/
+
+#ifndef _FRUSTUM_CULL_CPP
+#define _FRUSTUM_CULL_CPP
+
+#include "FrustumCull.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(FRUSTUM_CULL_AVX)
+#include <immintrin.h>
+#elif defined(FRUSTUM_CULL_SSE)
+#include <emmintrin.h>
+#endif
+
+void CullBoxes::Resize(int count)
+{
+	minX.resize(count);
+	minY.resize(count);
+	minZ.resize(count);
+	maxX.resize(count);
+	maxY.resize(count);
+	maxZ.resize(count);
+}
+
+AABB CullBoxes::Bounds(int first, int last) const
+{
+	AABB bounds(glm::vec3(INFINITY), glm::vec3(-INFINITY));
+	for (int i = first; i < last; i++)
+	{
+		bounds.min.x = minX[i] < bounds.min.x ? minX[i] : bounds.min.x;
+		bounds.min.y = minY[i] < bounds.min.y ? minY[i] : bounds.min.y;
+		bounds.min.z = minZ[i] < bounds.min.z ? minZ[i] : bounds.min.z;
+		bounds.max.x = maxX[i] > bounds.max.x ? maxX[i] : bounds.max.x;
+		bounds.max.y = maxY[i] > bounds.max.y ? maxY[i] : bounds.max.y;
+		bounds.max.z = maxZ[i] > bounds.max.z ? maxZ[i] : bounds.max.z;
+	}
+	return bounds;
+}
+
+Frustum::Frustum()
+	: Frustum(glm::mat4(1.0f))
+{
+}
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+	// A point is inside clip space when -w <= x <= w, and the same for y and z. Written in terms of the matrix's rows (glm stores columns,
+	// so row i is m[0][i], m[1][i], m[2][i], m[3][i]), each of those six comparisons is a plane: row3 + row0 >= 0, row3 - row0 >= 0, and so on.
+	const glm::mat4& m = viewProjection;
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	planes[0] = row3 + row0;	// Left
+	planes[1] = row3 - row0;	// Right
+	planes[2] = row3 + row1;	// Bottom
+	planes[3] = row3 - row1;	// Top
+	planes[4] = row3 + row2;	// Near
+	planes[5] = row3 - row2;	// Far
+
+	// The tests only look at signs, so this isn't strictly needed, but it keeps the distances in world units, which is easier to debug.
+	for (int p = 0; p < 6; p++)
+	{
+		float length = glm::length(glm::vec3(planes[p]));
+		if (length > 0.0f)
+		{
+			planes[p] /= length;
+		}
+	}
+}
+
+FrustumTest Frustum::Classify(const AABB& box) const
+{
+	bool inside = true;
+	for (int p = 0; p < 6; p++)
+	{
+		const glm::vec4& plane = planes[p];
+
+		// The corner furthest along the normal. If even that is behind the plane, the whole box is.
+		glm::vec3 furthest(plane.x >= 0.0f ? box.max.x : box.min.x, plane.y >= 0.0f ? box.max.y : box.min.y, plane.z >= 0.0f ? box.max.z : box.min.z);
+		if (glm::dot(glm::vec3(plane), furthest) + plane.w < 0.0f)
+		{
+			return FRUSTUM_OUTSIDE;
+		}
+
+		// The corner nearest along the normal. If that is in front of every plane, the whole box is inside.
+		glm::vec3 nearest(plane.x >= 0.0f ? box.min.x : box.max.x, plane.y >= 0.0f ? box.min.y : box.max.y, plane.z >= 0.0f ? box.min.z : box.max.z);
+		if (glm::dot(glm::vec3(plane), nearest) + plane.w < 0.0f)
+		{
+			inside = false;
+		}
+	}
+	return inside ? FRUSTUM_INSIDE : FRUSTUM_INTERSECTS;
+}
+
+int Frustum::Cull(const CullBoxes& boxes, int first, int last, unsigned char* visible) const
+{
+	// Work out, once per plane, which of the min/max arrays hold the corner furthest along its normal. It's the same for every box.
+	const float* cornerX[6];
+	const float* cornerY[6];
+	const float* cornerZ[6];
+	for (int p = 0; p < 6; p++)
+	{
+		cornerX[p] = planes[p].x >= 0.0f ? boxes.maxX.data() : boxes.minX.data();
+		cornerY[p] = planes[p].y >= 0.0f ? boxes.maxY.data() : boxes.minY.data();
+		cornerZ[p] = planes[p].z >= 0.0f ? boxes.maxZ.data() : boxes.minZ.data();
+	}
+
+	int numVisible = 0;
+	int i = first;
+
+#if defined(FRUSTUM_CULL_AVX)
+	__m256 normalX[6], normalY[6], normalZ[6], distance[6];
+	for (int p = 0; p < 6; p++)
+	{
+		normalX[p] = _mm256_set1_ps(planes[p].x);
+		normalY[p] = _mm256_set1_ps(planes[p].y);
+		normalZ[p] = _mm256_set1_ps(planes[p].z);
+		distance[p] = _mm256_set1_ps(planes[p].w);
+	}
+	__m256 zero = _mm256_setzero_ps();
+
+	for (; i + 8 <= last; i += 8)
+	{
+		// A lane is set once its box is found behind any plane.
+		__m256 outside = _mm256_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			__m256 x = _mm256_mul_ps(_mm256_loadu_ps(cornerX[p] + i), normalX[p]);
+			__m256 y = _mm256_mul_ps(_mm256_loadu_ps(cornerY[p] + i), normalY[p]);
+			__m256 z = _mm256_mul_ps(_mm256_loadu_ps(cornerZ[p] + i), normalZ[p]);
+			__m256 signedDistance = _mm256_add_ps(_mm256_add_ps(x, y), _mm256_add_ps(z, distance[p]));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(signedDistance, zero, _CMP_LT_OQ));
+		}
+
+		int outsideMask = _mm256_movemask_ps(outside);
+		for (int lane = 0; lane < 8; lane++)
+		{
+			int laneVisible = (outsideMask >> lane & 1) ^ 1;
+			visible[i + lane] = (unsigned char)laneVisible;
+			numVisible += laneVisible;
+		}
+	}
+#elif defined(FRUSTUM_CULL_SSE)
+	__m128 normalX[6], normalY[6], normalZ[6], distance[6];
+	for (int p = 0; p < 6; p++)
+	{
+		normalX[p] = _mm_set1_ps(planes[p].x);
+		normalY[p] = _mm_set1_ps(planes[p].y);
+		normalZ[p] = _mm_set1_ps(planes[p].z);
+		distance[p] = _mm_set1_ps(planes[p].w);
+	}
+	__m128 zero = _mm_setzero_ps();
+
+	for (; i + 4 <= last; i += 4)
+	{
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 x = _mm_mul_ps(_mm_loadu_ps(cornerX[p] + i), normalX[p]);
+			__m128 y = _mm_mul_ps(_mm_loadu_ps(cornerY[p] + i), normalY[p]);
+			__m128 z = _mm_mul_ps(_mm_loadu_ps(cornerZ[p] + i), normalZ[p]);
+			__m128 signedDistance = _mm_add_ps(_mm_add_ps(x, y), _mm_add_ps(z, distance[p]));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(signedDistance, zero));
+		}
+
+		int outsideMask = _mm_movemask_ps(outside);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			int laneVisible = (outsideMask >> lane & 1) ^ 1;
+			visible[i + lane] = (unsigned char)laneVisible;
+			numVisible += laneVisible;
+		}
+	}
+#endif
+
+	// Whatever is left over (or everything, without SIMD).
+	for (; i < last; i++)
+	{
+		unsigned char isVisible = 1;
+		for (int p = 0; p < 6; p++)
+		{
+			if (cornerX[p][i] * planes[p].x + cornerY[p][i] * planes[p].y + (cornerZ[p][i] * planes[p].z + planes[p].w) < 0.0f)
+			{
+				isVisible = 0;
+				break;
+			}
+		}
+		visible[i] = isVisible;
+		numVisible += isVisible;
+	}
+
+	return numVisible;
+}
+
+#endif // _FRUSTUM_CULL_CPP
@@ -0,0 +1,102 @@
+/*
+Title: Swept AABB-3D
+File Name: FrustumCull.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+View-frustum culling against the AABBs the physics already keeps for every body. The six
+planes of the frustum are pulled straight out of the view-projection matrix. A box is outside
+if it's entirely behind any one plane, which only needs checking for the corner of the box
+that sits furthest along that plane's normal. That corner is the same min/max choice for every
+box, so boxes are kept one array per component, and eight of them (with AVX, or four with SSE)
+are tested against a plane in a handful of instructions.
+A whole group of boxes can also be tested at once through the box around all of them: if that
+box is outside, so is every box in the group, and if it's inside, so is every box in it.
+*/
+
+#ifndef _FRUSTUM_CULL_H
+#define _FRUSTUM_CULL_H
+
+#include "GameObject.h"
+#include <vector>
+
+// Use AVX (eight boxes at a time) when the compiler targets it: GCC and Clang with -mavx, MSVC with /arch:AVX. Otherwise use SSE (four at a time)
+// where we have it, the same way QueryKernels.h decides, and plain C++ where we don't.
+#if defined(__AVX__)
+#define FRUSTUM_CULL_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_CULL_SSE
+#endif
+
+enum FrustumTest
+{
+	FRUSTUM_OUTSIDE,	// Entirely outside; nothing in the box can be seen.
+	FRUSTUM_INTERSECTS,	// Partly inside.
+	FRUSTUM_INSIDE		// Entirely inside.
+};
+
+// A list of boxes, stored one array per component so they can be loaded several at a time.
+struct CullBoxes
+{
+	std::vector<float> minX, minY, minZ;
+	std::vector<float> maxX, maxY, maxZ;
+
+	void Resize(int count);
+
+	void Set(int i, const AABB& box)
+	{
+		minX[i] = box.min.x;
+		minY[i] = box.min.y;
+		minZ[i] = box.min.z;
+		maxX[i] = box.max.x;
+		maxY[i] = box.max.y;
+		maxZ[i] = box.max.z;
+	}
+
+	int Size() const
+	{
+		return (int)minX.size();
+	}
+
+	// The box around boxes first up to (but not including) last.
+	AABB Bounds(int first, int last) const;
+};
+
+class Frustum
+{
+	// Each plane is (normal, distance), with the normal pointing into the frustum: a point p is on the inside when dot(normal, p) + distance >= 0.
+	glm::vec4 planes[6];
+
+public:
+	// Everything in clip space: the frustum of an identity view-projection.
+	Frustum();
+
+	// The frustum that viewProjection maps onto clip space. Works for perspective and orthographic projections alike.
+	Frustum(const glm::mat4& viewProjection);
+
+	FrustumTest Classify(const AABB& box) const;
+
+	// Sets visible[i] to 1 for every box from first up to last that is at least partly inside, and to 0 for the rest. Returns how many are visible.
+	// A box that only just misses can still count as visible; a box that is visible never counts as outside.
+	int Cull(const CullBoxes& boxes, int first, int last, unsigned char* visible) const;
+};
+
+#endif //_FRUSTUM_CULL_H
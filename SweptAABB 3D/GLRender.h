@@ -3,6 +3,14 @@
 
 #include "GLIncludes.h"
 #include "GameObject.h"
+#include "WorldPartition.h"
+#include "StepPipeline.h"
+#include "WorldRegistry.h"
+#include "ProgramCache.h"
+#include "RenderQueue.h"
+#include "MeshArena.h"
+#include "MeshOptimizer.h"
+#include "SectorStreamer.h"
 #include <string>
 #include <iostream>
 #include <fstream>
@@ -13,6 +21,9 @@
 // This program will run on your GPU.
 GLuint program;
 
+// The program for drawing through the mesh arena. It takes its MVP matrix from an attribute instead of a uniform (see IndirectVertexShader.glsl).
+GLuint indirectProgram = 0;
+
 // These are your references to your actual compiled shaders
 GLuint vertex_shader;
 GLuint fragment_shader;
@@ -27,17 +38,57 @@ glm::mat4 view;
 // proj * view = PV
 glm::mat4 PV;
 
-// MVP is PV * Model (model is the transformation matrix of whatever object is being rendered)
-glm::mat4 MVP;
-glm::mat4 MVP2;
-
 // Variable for the speed of the moving object.
 float speed = 0.90f;
 
 // An array of vertices stored in an std::vector for our object.
 std::vector<VertexFormat> vertices;
 
-// References to our two GameObjects and the one Model we'll be using.
+// The pool of worker threads that runs the physics, and the registry of worlds that step on it. This demo only hosts one world.
+JobSystem* jobSystem;
+WorldRegistry* worlds;
+
+// The partitioned world that owns every body. Bodies live in the memory of the region they are created in, so we don't delete them ourselves.
+WorldPartition* world;
+
+// Runs the physics step, and hands us an MVP matrix (PV * Model) for every object to draw.
+StepPipeline* pipeline;
+
+// Shares the transforms of every body after each step with any other process that wants to watch, if asked to with "--publish <name>"
+// (see StatePublisher.h). It's off by default, so that two copies of the demo don't fight over the same name.
+std::string publishName;
+StatePublisher* statePublisher = nullptr;
+
+// Records every step to a replay file, if one was asked for with "--record <file>" (see ReplayRecorder.h).
+// With "--compressed" after it, the replay is delta coded with the default CodecSettings (see DeltaCodec.h).
+std::string replayFile;
+bool replayCompressed = false;
+ReplayRecorder* replayRecorder = nullptr;
+
+// Exports trajectories for offline analysis, if asked for with "--trajectories <file>" (see TrajectoryFile.h).
+std::string trajectoryFile;
+
+// Sorts each frame's draws to keep program and mesh binds down (see RenderQueue.h).
+RenderQueue* renderQueue;
+
+// Holds every model's geometry in shared buffers, so the whole scene can be drawn with one multi-draw call (see MeshArena.h).
+// Drivers without multi-draw indirect fall back to the render queue.
+MeshArena* meshArena;
+
+// Where the camera is. The view matrix looks from here at the origin.
+glm::vec3 cameraPosition = glm::vec3(0.0f, 0.0f, 2.0f);
+
+// Streams extra bodies in and out of the world around the camera, sector by sector, if asked to with "--sectors <directory>"
+// (see SectorStreamer.h). Bodies far from the camera are then also moved less often (see StepPipeline::SetUpdateTiers()).
+std::string sectorDirectory;
+SectorStreamer* sectorStreamer = nullptr;
+
+// Draws every AABB, swept box and contact normal over the scene when debugDraw is on (toggle it with the D key, see Main.cpp).
+DebugLines* debugLines;
+bool debugDraw = false;
+
+// References to our two GameObjects and the one Model we'll be using. The world moves bodies into the memory of whichever region they're in
+// at the start of every step (see WorldPartition::MigrateBodies()), so obj1 and obj2 are only good until the first step.
 GameObject* obj1;
 GameObject* obj2;
 Model* cube;
@@ -51,23 +102,43 @@ void renderScene()
 	// Clear the screen to white
 	glClearColor(1.0, 1.0, 1.0, 1.0);
 
-	// Tell OpenGL to use the shader program you've created.
-	glUseProgram(program);
+	const std::vector<RenderItem>& items = pipeline->GetRenderItems();
 
-	// Set the uniform matrix in our shader to our MVP matrix for the first object.
-	glUniformMatrix4fv(uniMVP, 1, GL_FALSE, glm::value_ptr(MVP));
-
-	// Draw the cube.
-	cube->Draw();
+	// If we can, draw everything from the mesh arena in a single call, whatever model each object uses. The step pipeline has already
+	// sorted the objects and packed their matrices on the worker threads, so all that's left to do here is upload them and draw.
+	if (meshArena->IsSupported())
+	{
+		meshArena->Submit(pipeline->GetRenderCommands(), indirectProgram);
+	}
+	else
+	{
+		// Otherwise, queue up every object with the shader program you've created, and the MVP matrix the step pipeline made for it.
+		// The queue sorts the draws by program and then by model, so each one only gets bound once however many objects use it.
+		// Objects outside the view were already culled against their AABBs by the step pipeline, so we skip those.
+		renderQueue->Clear();
+		for (size_t i = 0; i < items.size(); i++)
+		{
+			if (items[i].visible)
+			{
+				renderQueue->Add(program, items[i].model, items[i].mvp);
+			}
+		}
+		renderQueue->Submit();
+	}
 
-	// Set the uniform matrix in our shader to our MVP matrix for the second object.
-	glUniformMatrix4fv(uniMVP, 1, GL_FALSE, glm::value_ptr(MVP2));
+	// We're using the same model here to draw, but different transformation matrices so that we can use less data overall.
+	// This is a technique called instancing, although "true" instancing (which the mesh arena does) passes all of the matrices in at once and draws them with one call.
 
-	// Draw the cube again.
-	cube->Draw();
+	// Draw the boxes, sweeps and contacts on top of everything, so none of them are hidden inside the cubes.
+	if (debugDraw)
+	{
+		debugLines->Clear();
+		pipeline->AddDebugLines(debugLines);
 
-	// We're using the same model here to draw, but different transformation matrices so that we can use less data overall.
-	// This is a technique called instancing, although "true" instancing involves binding a matrix array to the uniform variable and using DrawInstanced in place of draw.
+		glDisable(GL_DEPTH_TEST);
+		debugLines->Draw(program, uniMVP, PV);
+		glEnable(GL_DEPTH_TEST);
+	}
 }
 
 // This method reads the text from a file.
@@ -174,18 +245,22 @@ void setupCube()
 	vertices.push_back(VertexFormat(glm::vec3(-0.25, -0.25, -0.25),		// Back, Bottom, Left		7
 		glm::vec4(0.0, 1.0, 0.0, 1.0))); //blue
 
+	// Put the triangles and vertices in the order the GPU's vertex cache likes best (see MeshOptimizer.h). With 8 vertices this hardly matters,
+	// but it's what every mesh we load goes through, so the cube goes through it too.
+	std::vector<GLuint> indices(elements, elements + 36);
+	OptimizeMesh(vertices, indices);
+
 										 // Create our cube model from the calculated data.
-	cube = new Model(vertices.size(), vertices.data(), 36, elements);
+	cube = new Model(vertices.size(), vertices.data(), indices.size(), indices.data());
 
 	// Create two GameObjects based off of the cube model (note that they are both holding pointers to the cube, not actual copies of the cube vertex data).
-	obj1 = new GameObject(cube);
-	obj2 = new GameObject(cube);
+	// The world creates them inside the region that contains their starting position, which also sets that position.
+	obj1 = world->CreateBody(cube, glm::vec3(0.0f, 0.0f, 0.0f));
+	obj2 = world->CreateBody(cube, glm::vec3(0.7f, 0.7f, 0.7f));
 
 	// Set beginning properties of GameObjects.
 	obj1->SetVelocity(glm::vec3(0, 0.0f, 0.0f)); // The first object doesn't move.
 	obj2->SetVelocity(glm::vec3(-speed, -speed, -speed));
-	obj1->SetPosition(glm::vec3(0.0f, 0.0f, 0.0f));
-	obj2->SetPosition(glm::vec3(0.7f, 0.7f, 0.7f));
 	obj1->SetScale(glm::vec3(0.75f, 0.75f, 0.75f));
 	obj2->SetScale(glm::vec3(0.25f, 0.25f, 0.25f));
 }
@@ -199,24 +274,83 @@ void init()
 	// Enables the depth test, which you will want in most cases. You can disable this in the render loop if you need to.
 	glEnable(GL_DEPTH_TEST);
 
+	// Start the worker threads. We keep one core for this (the render) thread and pin it there, and give every other core a
+	// worker pinned to it, so the scheduler doesn't bounce our threads around between cores.
+	JobSystemConfig jobConfig;
+	jobConfig.reservedCores = 1;
+	jobConfig.pinToCores = true;
+	jobConfig.priority = PRIORITY_NORMAL;
+	jobSystem = new JobSystem(jobConfig);
+	jobSystem->PinCallingThreadToReservedCores();
+
+	// Split the world into regions. The world is a little larger than the boundary the moving cube bounces around in (see update()),
+	// and is cut in half along each axis. On a multi-socket machine the regions are shared out between the sockets.
+	// The registry creates the world and its step pipeline, and steps it alongside any other worlds we might host.
+	worlds = new WorldRegistry(jobSystem);
+	WorldSettings settings;
+	settings.bounds = AABB(glm::vec3(-1.25f), glm::vec3(1.25f));
+	settings.regionsX = settings.regionsY = settings.regionsZ = 2;
+	settings.bodiesPerRegion = 64;
+	HostedWorld* hosted = worlds->CreateWorld("main", settings);
+	world = hosted->partition;
+	pipeline = hosted->pipeline;
+
 	setupCube();
+	renderQueue = new RenderQueue();
+	debugLines = new DebugLines();
 
 	// Read in the shader code from a file.
 	std::string vertShader = readShader("../VertexShader.glsl");
 	std::string fragShader = readShader("../FragmentShader.glsl");
 
-	// createShader consolidates all of the shader compilation code
-	vertex_shader = createShader(vertShader, GL_VERTEX_SHADER);
-	fragment_shader = createShader(fragShader, GL_FRAGMENT_SHADER);
-
-	// A shader is a program that runs on your GPU instead of your CPU. In this sense, OpenGL refers to your groups of shaders as "programs".
-	// Using glCreateProgram creates a shader program and returns a GLuint reference to it.
-	program = glCreateProgram();
-	glAttachShader(program, vertex_shader);		// This attaches our vertex shader to our program.
-	glAttachShader(program, fragment_shader);	// This attaches our fragment shader to our program.
+	// Compiling and linking from source is slow, so the linked program is cached next to the shaders (see ProgramCache.h).
+	// If this driver has already linked these exact sources on an earlier launch, we can skip straight past the compile.
+	ProgramCache programCache("../");
+	program = programCache.Load(vertShader, fragShader);
+	if (program == 0)
+	{
+		// createShader consolidates all of the shader compilation code
+		vertex_shader = createShader(vertShader, GL_VERTEX_SHADER);
+		fragment_shader = createShader(fragShader, GL_FRAGMENT_SHADER);
+
+		// A shader is a program that runs on your GPU instead of your CPU. In this sense, OpenGL refers to your groups of shaders as "programs".
+		// Using glCreateProgram creates a shader program and returns a GLuint reference to it.
+		program = glCreateProgram();
+		glAttachShader(program, vertex_shader);		// This attaches our vertex shader to our program.
+		glAttachShader(program, fragment_shader);	// This attaches our fragment shader to our program.
+
+		// This links the program, using the vertex and fragment shaders to create executables to run on the GPU.
+		programCache.PrepareForStore(program);
+		glLinkProgram(program);
+		programCache.Store(program, vertShader, fragShader);
+	}
 
-												// This links the program, using the vertex and fragment shaders to create executables to run on the GPU.
-	glLinkProgram(program);
+	// The mesh arena's program uses its own vertex shader, and the same fragment shader.
+	meshArena = new MeshArena();
+	if (meshArena->IsSupported())
+	{
+		pipeline->SetMeshArena(meshArena);
+
+		std::string indirectShader = readShader("../IndirectVertexShader.glsl");
+		indirectProgram = programCache.Load(indirectShader, fragShader);
+		if (indirectProgram == 0)
+		{
+			GLuint indirectVertex = createShader(indirectShader, GL_VERTEX_SHADER);
+			GLuint indirectFragment = createShader(fragShader, GL_FRAGMENT_SHADER);
+
+			indirectProgram = glCreateProgram();
+			glAttachShader(indirectProgram, indirectVertex);
+			glAttachShader(indirectProgram, indirectFragment);
+
+			programCache.PrepareForStore(indirectProgram);
+			glLinkProgram(indirectProgram);
+			programCache.Store(indirectProgram, indirectShader, fragShader);
+
+			// The shaders are only flagged for deletion here; they stay alive for as long as they're attached to the program.
+			glDeleteShader(indirectVertex);
+			glDeleteShader(indirectFragment);
+		}
+	}
 	// End of shader and program creation
 
 	// This gets us a reference to the uniform variable in the vertex shader, which is called "MVP".
@@ -226,7 +360,7 @@ void init()
 
 	// Creates the view matrix using glm::lookAt.
 	// First parameter is camera position, second parameter is point to be centered on-screen, and the third paramter is the up axis.
-	view = glm::lookAt(glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	view = glm::lookAt(cameraPosition, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 
 	// Creates a projection matrix using glm::perspective.
 	// First parameter is the vertical FoV (Field of View), second paramter is the aspect ratio, 3rd parameter is the near clipping plane, 4th parameter is the far clipping plane.
@@ -235,9 +369,61 @@ void init()
 	// Allows us to make one less calculation per frame, as long as we don't update the projection and view matrices every frame.
 	PV = proj * view;
 
+	// Let other processes follow along. Keep the last 8 steps around, so a reader that's a little slow doesn't lose its place.
+	if (!publishName.empty())
+	{
+		statePublisher = new StatePublisher();
+		if (statePublisher->Create(publishName, 8, settings.regionsX * settings.regionsY * settings.regionsZ * settings.bodiesPerRegion))
+		{
+			pipeline->SetStatePublisher(statePublisher);
+		}
+	}
+
+	// Stream sectors in around the camera. The camera doesn't move, so its position only needs setting once.
+	// Streamed meshes get buffers so they can be drawn, which is why the streamer is updated on this thread (see update() in Main.cpp).
+	if (!sectorDirectory.empty())
+	{
+		StreamerSettings streamerSettings;
+		streamerSettings.directory = sectorDirectory;
+		streamerSettings.createBuffers = true;
+		sectorStreamer = new SectorStreamer(world, streamerSettings);
+		if (meshArena->IsSupported())
+		{
+			sectorStreamer->SetMeshArena(meshArena);
+		}
+
+		std::vector<glm::vec3> points(1, cameraPosition);
+		sectorStreamer->SetPointsOfInterest(points);
+
+		// Nothing beyond the far side of the world needs to move every step to look right from here.
+		std::vector<UpdateTier> tiers;
+		UpdateTier tier;
+		tier.distance = 3.5f;
+		tier.interval = 2;
+		tiers.push_back(tier);
+		tier.distance = 5.0f;
+		tier.interval = 4;
+		tiers.push_back(tier);
+		pipeline->SetUpdateTiers(tiers);
+		pipeline->SetPointsOfInterest(points);
+	}
+
+	if (!replayFile.empty() || !trajectoryFile.empty())
+	{
+		CodecSettings codec;
+		replayRecorder = new ReplayRecorder();
+		bool recording = !replayFile.empty() && replayRecorder->Open(replayFile, BACKPRESSURE_DROP, replayCompressed ? &codec : nullptr);
+		bool exporting = !trajectoryFile.empty() && replayRecorder->OpenTrajectories(trajectoryFile);
+		if (recording || exporting)
+		{
+			pipeline->SetReplayRecorder(replayRecorder);
+		}
+	}
+
 	// Create your MVP matrices based on the objects' transforms.
-	MVP = PV * *obj1->GetTransform();
-	MVP2 = PV * *obj2->GetTransform();
+	pipeline->SetViewProjection(PV);
+	pipeline->CaptureRenderSnapshot();
+	pipeline->FlushRenderSnapshot();
 
 	
 
@@ -264,10 +450,23 @@ void cleanup()
 	glDeleteShader(vertex_shader);
 	glDeleteShader(fragment_shader);
 	glDeleteProgram(program);
+	glDeleteProgram(indirectProgram);
 	// Note: If at any point you stop using a "program" or shaders, you should free the data up then and there.
 
-	delete(obj1);
-	delete(obj2);
+	// Write out where the time went in the slowest physics step. Render it with "dot -Tsvg StepCriticalPath.dot -o StepCriticalPath.svg".
+	pipeline->WriteSlowestStep("StepCriticalPath.dot");
+
+	// The streamer takes its bodies out of the world and its models out of the mesh arena, so it goes before both.
+	delete(sectorStreamer);
+
+	// The registry owns the worlds, and each world owns its GameObjects, so deleting it cleans them all up. Delete it before the job system it was built on.
+	delete(worlds);
+	delete(statePublisher);
+	delete(replayRecorder);
+	delete(renderQueue);
+	delete(meshArena);
+	delete(debugLines);
+	delete(jobSystem);
 	delete(cube);
 
 	// Frees up GLFW memory
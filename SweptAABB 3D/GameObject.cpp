@@ -59,6 +59,11 @@ GameObject::GameObject(Model* inModel)
 
 	// And a default quaternion.
 	quaternion = glm::quat();
+
+	// We don't have an id until something (like the world) gives us one.
+	id = -1;
+
+	boxPosition = glm::vec3();
 }
 
 void GameObject::Update(float dt)
@@ -73,22 +78,23 @@ void GameObject::Update(float dt)
 
 void GameObject::CalculateAABB()
 {
-	// Create local variables for the vertices of the model.
-	VertexFormat* vertexArray = model->Vertices();
-	int numVertexArray = model->NumVertices();
+	// Create local variables for the vertices of the model's collision proxy. Its corners reach at least as far as the model does
+	// in every direction, and there are far fewer of them.
+	glm::vec3* vertexArray = model->CollisionVertices();
+	int numVertexArray = model->NumCollisionVertices();
 
 	// Create a temporary AABB that uses vec4 for the purposes of matrix multiplication.
 	CalculatorAABB newBox;
 
 	// Set the min and max equal to the first vertex in the object times the transformation matrix.
-	newBox.min = transformation * glm::vec4(vertexArray[0].position, 1.0f);
+	newBox.min = transformation * glm::vec4(vertexArray[0], 1.0f);
 	newBox.max = newBox.min;
 
 	// Loop through the rest of the vertices.
 	for (int i = 1; i < numVertexArray; i++)
 	{
 		// Create a temporary vertex that is the vertices at index i turned into a vector4 and modified by the transformation matrix.
-		glm::vec4 tempVert = transformation * glm::vec4(vertexArray[i].position, 1.0f);
+		glm::vec4 tempVert = transformation * glm::vec4(vertexArray[i], 1.0f);
 
 		// If this vertex has a value larger than the max value of our newBox, replace the newBox max value with that value.
 		if (tempVert.x > newBox.max.x)
@@ -126,6 +132,16 @@ void GameObject::CalculateAABB()
 	box.max.x = newBox.max.x;
 	box.max.y = newBox.max.y;
 	box.max.z = newBox.max.z;
+
+	boxPosition = position;
+}
+
+void GameObject::MoveAABB()
+{
+	glm::vec3 moved = position - boxPosition;
+	box.min += moved;
+	box.max += moved;
+	boxPosition = position;
 }
 
 // Calculates the transformation matrix based on translation, then rotation, then scale.
@@ -216,6 +232,18 @@ void GameObject::SetRotation(glm::vec3 rotFactor)
 	CalculateMatrices();
 }
 
+// Sets the rotation to exactly the given quaternion.
+void GameObject::SetRotation(glm::quat rotQuat)
+{
+	quaternion = rotQuat;
+
+	// Turn our quaternion into a mat4.
+	rotation = glm::toMat4(quaternion);
+
+	// Then we have to recalculate the transformation matrix.
+	CalculateMatrices();
+}
+
 // Translates in the x, y, and z directions based on the given values.
 void GameObject::Translate(glm::vec3 transFactor)
 {
@@ -90,9 +90,24 @@ class GameObject
 	Model* model;
 	AABB box;
 
+	// Where the object was when box was calculated.
+	glm::vec3 boxPosition;
+
+	// A number that identifies this object to code that can't hold on to a pointer to it (see CommandQueue). -1 if it hasn't been given one.
+	int id;
+
 public:
 	GameObject(Model*);
 
+	int GetId()
+	{
+		return id;
+	}
+	void SetId(int newId)
+	{
+		id = newId;
+	}
+
 	void CalculateMatrices();
 
 	void Update(float);
@@ -104,6 +119,10 @@ public:
 
 	void CalculateAABB();
 
+	// Moves the AABB along by however far the object has moved since it was calculated. This is all an object that has moved
+	// but not turned or changed size needs, and is much cheaper than CalculateAABB().
+	void MoveAABB();
+
 	Model* GetModel()
 	{
 		return model;
@@ -124,6 +143,14 @@ public:
 	{
 		return acceleration;
 	}
+	glm::quat GetRotation()
+	{
+		return quaternion;
+	}
+	glm::vec3 GetScale()
+	{
+		return glm::vec3(scale[0][0], scale[1][1], scale[2][2]);
+	}
 
 	void AddPosition(glm::vec3);
 	void SetPosition(glm::vec3 pos)
@@ -155,6 +182,7 @@ public:
 	// Sets yhr rotation matrix to a given value.
 	void SetRotation(glm::mat4*);
 	void SetRotation(glm::vec3);
+	void SetRotation(glm::quat);
 
 	// Translates in the x, y, and z directions based on the given values.
 	void Translate(glm::vec3);
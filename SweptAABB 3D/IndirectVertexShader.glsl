@@ -0,0 +1,42 @@
+/*
+Title: Swept AABB-3D
+File Name: IndirectVertexShader.glsl
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+The vertex shader for drawing through the mesh arena (see MeshArena.h). It's the same as
+VertexShader.glsl, except that the MVP matrix comes in as a per-instance attribute, since a
+single multi-draw call covers many objects and a uniform can only hold one matrix.
+*/
+
+#version 400 core // Identifies the version of the shader, this line must be on a separate line from the rest of the shader code
+
+layout(location = 0) in vec3 in_position;	// Get in a vec3 for position
+layout(location = 1) in vec4 in_color;		// Get in a vec4 for color
+layout(location = 2) in mat4 in_mvp;		// Get in this object's MVP matrix. A mat4 takes up four locations, 2 to 5.
+
+out vec4 color; // Our vec4 color variable containing r, g, b, a
+
+void main(void)
+{
+	color = in_color;	// Pass the color through
+	gl_Position = in_mvp * vec4(in_position, 1.0); //w is 1.0, also notice cast to a vec4
+}
\ No newline at end of file
@@ -0,0 +1,326 @@
+/*
+Title: Swept AABB-3D
+File Name: JobSystem.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+A small pool of worker threads that runs physics jobs. Workers are grouped by NUMA node,
+and every job can either be pinned to a node (so it runs next to the memory it reads) or
+be left for any worker to pick up. Callers group jobs with a JobCounter and then wait on it.
+The size of the pool, which CPUs each worker may run on, the workers' priority and how many
+cores are kept free for the render thread are all set through a JobSystemConfig.
+*/
+
+#ifndef _JOB_SYSTEM_CPP
+#define _JOB_SYSTEM_CPP
+
+#include "JobSystem.h"
+#include <iostream>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Each worker remembers which node it is bound to, so jobs can find out where they're running.
+static thread_local int currentWorkerNode = JobSystem::AnyNode;
+
+JobSystem::JobSystem(const JobSystemConfig& inConfig)
+{
+	config = inConfig;
+	running = true;
+
+	int numNodes = topology.NumNodes();
+	nodeQueues.resize(numNodes);
+	nodeWorkerCounts.resize(numNodes, 0);
+
+	// Build the list of CPUs the workers may use, in node order, holding back the reserved cores from the start of the first node.
+	std::vector<int> available;
+	for (int n = 0; n < numNodes; n++)
+	{
+		std::vector<int>& cpus = topology.GetNode(n).cpus;
+		for (size_t c = 0; c < cpus.size(); c++)
+		{
+			if ((int)reservedCpus.size() < config.reservedCores)
+			{
+				reservedCpus.push_back(cpus[c]);
+			}
+			else
+			{
+				available.push_back(cpus[c]);
+			}
+		}
+	}
+
+	// If we reserved every CPU there's nothing left for the workers, so give them everything and let them share.
+	if (available.empty())
+	{
+		std::cout << "Not enough CPUs to reserve " << config.reservedCores << " for the render thread, workers will share them." << std::endl;
+		available = reservedCpus;
+	}
+
+	// By default, one worker per available CPU.
+	int numWorkers = config.numWorkers > 0 ? config.numWorkers : (int)available.size();
+	if (numWorkers < (int)config.affinityMasks.size())
+	{
+		numWorkers = (int)config.affinityMasks.size();
+	}
+
+	for (int i = 0; i < numWorkers; i++)
+	{
+		std::vector<int> cpus;
+
+		if (i < (int)config.affinityMasks.size() && !config.affinityMasks[i].empty())
+		{
+			// The caller told us exactly where this worker goes.
+			cpus = config.affinityMasks[i];
+		}
+		else
+		{
+			// Spread the workers evenly over the available CPUs. Because the list is in node order, this also gives
+			// each node a share of the workers in proportion to how many CPUs it has.
+			int cpu = available[((size_t)i * available.size() / numWorkers) % available.size()];
+
+			if (config.pinToCores)
+			{
+				cpus.push_back(cpu);
+			}
+			else
+			{
+				// Let the worker float over every available CPU of its node.
+				std::vector<int>& nodeCpus = topology.GetNode(topology.NodeOfCpu(cpu)).cpus;
+				for (size_t c = 0; c < nodeCpus.size(); c++)
+				{
+					if (std::find(available.begin(), available.end(), nodeCpus[c]) != available.end())
+					{
+						cpus.push_back(nodeCpus[c]);
+					}
+				}
+			}
+		}
+
+		// A worker belongs to the node of the first CPU it's allowed on.
+		int node = topology.NodeOfCpu(cpus[0]);
+
+		workerCpus.push_back(cpus);
+		workerNodes.push_back(node);
+		nodeWorkerCounts[node]++;
+	}
+
+	for (int i = 0; i < numWorkers; i++)
+	{
+		workers.push_back(std::thread(&JobSystem::WorkerLoop, this, i));
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	// Tell every worker to stop, then wake them all up so they notice.
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	signal.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+}
+
+void JobSystem::WorkerLoop(int workerIndex)
+{
+	int node = workerNodes[workerIndex];
+
+	// Keep this thread on its CPUs (which all belong to one node). The operating system allocates a page on the node of the thread that
+	// first writes to it, so any memory this worker touches first will end up local to it.
+	NumaTopology::BindCurrentThreadToCpus(workerCpus[workerIndex]);
+	currentWorkerNode = node;
+
+	if (config.priority != PRIORITY_NORMAL && !SetCurrentThreadPriority(config.priority))
+	{
+		std::cout << "Couldn't change the priority of worker " << workerIndex << ", leaving it at normal." << std::endl;
+	}
+
+	while (true)
+	{
+		QueuedJob queued;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			// Sleep until there is something for this node to do, or we are told to shut down.
+			while (running && !PopJob(node, queued))
+			{
+				signal.wait(lock);
+			}
+
+			if (!running && !queued.job)
+			{
+				return;
+			}
+		}
+
+		Execute(queued);
+	}
+}
+
+bool JobSystem::PopJob(int node, QueuedJob& out)
+{
+	// Jobs pinned to our own node come first, since nobody else is allowed to run them.
+	if (node >= 0 && !nodeQueues[node].empty())
+	{
+		out = nodeQueues[node].front();
+		nodeQueues[node].pop_front();
+		return true;
+	}
+
+	if (!anyQueue.empty())
+	{
+		out = anyQueue.front();
+		anyQueue.pop_front();
+		return true;
+	}
+
+	return false;
+}
+
+void JobSystem::Execute(QueuedJob& queued)
+{
+	queued.job();
+
+	// If this was the last job in its group, wake up whoever is waiting on the counter.
+	// We take the lock before notifying so a waiter can't miss the wake up between checking the counter and going to sleep.
+	if (queued.counter != nullptr && --queued.counter->pending == 0)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		signal.notify_all();
+	}
+}
+
+void JobSystem::Submit(Job job, JobCounter* counter, int node)
+{
+	if (counter != nullptr)
+	{
+		counter->pending++;
+	}
+
+	QueuedJob queued;
+	queued.job = job;
+	queued.counter = counter;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		// If a node ended up without any workers (for example, because of custom affinity masks), nobody could run its jobs,
+		// so they go to the shared queue instead.
+		if (node >= 0 && node < (int)nodeQueues.size() && nodeWorkerCounts[node] > 0)
+		{
+			nodeQueues[node].push_back(queued);
+		}
+		else
+		{
+			anyQueue.push_back(queued);
+		}
+	}
+
+	// Workers on every node share one condition variable, so wake them all and let the right one take it.
+	signal.notify_all();
+}
+
+void JobSystem::Wait(JobCounter* counter)
+{
+	int node = currentWorkerNode;
+
+	while (counter->pending > 0)
+	{
+		QueuedJob queued;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			// Rather than just sleeping, run jobs we're allowed to run. This also keeps a worker waiting on its own sub-jobs from deadlocking.
+			while (counter->pending > 0 && !PopJob(node, queued))
+			{
+				signal.wait(lock);
+			}
+		}
+
+		if (queued.job)
+		{
+			Execute(queued);
+		}
+	}
+}
+
+int JobSystem::CurrentNode()
+{
+	return currentWorkerNode;
+}
+
+bool JobSystem::PinCallingThreadToReservedCores()
+{
+	if (reservedCpus.empty())
+	{
+		return false;
+	}
+	return NumaTopology::BindCurrentThreadToCpus(reservedCpus);
+}
+
+bool JobSystem::SetCurrentThreadPriority(WorkerPriority priority)
+{
+#ifdef _WIN32
+	int level = THREAD_PRIORITY_NORMAL;
+	if (priority == PRIORITY_LOW)
+	{
+		level = THREAD_PRIORITY_BELOW_NORMAL;
+	}
+	else if (priority == PRIORITY_HIGH)
+	{
+		level = THREAD_PRIORITY_ABOVE_NORMAL;
+	}
+	return SetThreadPriority(GetCurrentThread(), level) != 0;
+#elif defined(__linux__)
+	// On Linux every thread has its own nice value, which we set through the thread id. Lower is more important.
+	// Going below zero usually needs CAP_SYS_NICE, so PRIORITY_HIGH can fail on an unprivileged account.
+	int nice = 0;
+	if (priority == PRIORITY_LOW)
+	{
+		nice = 10;
+	}
+	else if (priority == PRIORITY_HIGH)
+	{
+		nice = -5;
+	}
+	return setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), nice) == 0;
+#else
+	return priority == PRIORITY_NORMAL;
+#endif
+}
+
+#endif // _JOB_SYSTEM_CPP
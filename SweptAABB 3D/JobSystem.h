@@ -0,0 +1,179 @@
+/*
+Title: Swept AABB-3D
+File Name: JobSystem.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+A small pool of worker threads that runs physics jobs. Workers are grouped by NUMA node,
+and every job can either be pinned to a node (so it runs next to the memory it reads) or
+be left for any worker to pick up. Callers group jobs with a JobCounter and then wait on it.
+The size of the pool, which CPUs each worker may run on, the workers' priority and how many
+cores are kept free for the render thread are all set through a JobSystemConfig.
+*/
+
+#ifndef _JOB_SYSTEM_H
+#define _JOB_SYSTEM_H
+
+#include "NumaTopology.h"
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <vector>
+
+// A job is just a function with no parameters. Use a lambda to capture whatever data it needs.
+typedef std::function<void()> Job;
+
+// How the operating system should prioritize the worker threads against everything else on the machine.
+enum WorkerPriority
+{
+	PRIORITY_LOW,		// Let other processes go first (good for shared hosts that run more than just us).
+	PRIORITY_NORMAL,	// Leave the priority alone.
+	PRIORITY_HIGH		// Ask to run ahead of normal threads. This may need elevated permissions, and is ignored if we don't have them.
+};
+
+// Everything that can be tuned about the worker pool.
+struct JobSystemConfig
+{
+	// Number of worker threads. 0 means one per available CPU (after reserving cores below).
+	int numWorkers;
+
+	// Number of CPUs kept away from the workers, so the render (main) thread always has somewhere to run.
+	// These are taken from the start of the first NUMA node.
+	int reservedCores;
+
+	// If true, each worker is pinned to a single CPU. If false, workers are only pinned to their NUMA node and may move between its CPUs.
+	// Pinning to a core stops the scheduler from migrating workers around, which is what causes step times to jump around on busy machines.
+	bool pinToCores;
+
+	// Optional explicit CPU list per worker. If a worker has an entry here it is used instead of the automatic placement,
+	// and numWorkers is raised to at least the number of entries.
+	std::vector<std::vector<int>> affinityMasks;
+
+	WorkerPriority priority;
+
+	JobSystemConfig()
+	{
+		numWorkers = 0;
+		reservedCores = 1;
+		pinToCores = false;
+		priority = PRIORITY_NORMAL;
+	}
+};
+
+// Counts how many jobs in a group are still running, so that we can wait for the whole group at once.
+struct JobCounter
+{
+	std::atomic<int> pending;
+
+	JobCounter()
+	{
+		pending = 0;
+	}
+};
+
+class JobSystem
+{
+	// A job waiting in a queue, along with the counter it should decrement when it's done.
+	struct QueuedJob
+	{
+		Job job;
+		JobCounter* counter;
+	};
+
+	NumaTopology topology;
+
+	// One queue per NUMA node for pinned jobs, plus a shared queue for jobs any worker can run.
+	std::vector<std::deque<QueuedJob>> nodeQueues;
+	std::deque<QueuedJob> anyQueue;
+
+	// A single lock protects all of the queues. The job counts here are small, so contention isn't a concern.
+	std::mutex mutex;
+	std::condition_variable signal;
+
+	std::vector<std::thread> workers;
+	std::vector<int> workerNodes;				// The node index each worker is bound to.
+	std::vector<std::vector<int>> workerCpus;	// The CPUs each worker is allowed to run on.
+	std::vector<int> nodeWorkerCounts;
+	std::vector<int> reservedCpus;				// CPUs the workers stay away from.
+	JobSystemConfig config;
+	bool running;
+
+	void WorkerLoop(int workerIndex);
+
+	// Pops a job that the given node is allowed to run (own node first, then the shared queue). Must hold the mutex.
+	bool PopJob(int node, QueuedJob& out);
+
+	// Runs a job and signals its counter.
+	void Execute(QueuedJob& queued);
+
+public:
+	// Use this as the node parameter to let any worker pick up the job.
+	static const int AnyNode = -1;
+
+	// Creates the worker threads described by config, spread across the NUMA nodes.
+	JobSystem(const JobSystemConfig& config = JobSystemConfig());
+	~JobSystem();
+
+	// Pins the calling thread (normally the render thread) to the reserved cores. Returns false if there are none, or the platform refused.
+	bool PinCallingThreadToReservedCores();
+
+	// Applies a priority to the calling thread. Returns false if the platform refused (for example, raising priority without permission).
+	static bool SetCurrentThreadPriority(WorkerPriority priority);
+
+	// Queues a job. If node is a valid node index, only workers bound to that node will run it.
+	void Submit(Job job, JobCounter* counter, int node = AnyNode);
+
+	// Blocks until every job tracked by counter has finished. The calling thread helps out with any jobs it's allowed to run while it waits.
+	void Wait(JobCounter* counter);
+
+	// Returns the node index of the worker running the calling code, or AnyNode if this isn't a worker thread.
+	static int CurrentNode();
+
+	NumaTopology& Topology()
+	{
+		return topology;
+	}
+	int NumNodes()
+	{
+		return (int)nodeQueues.size();
+	}
+	int NumWorkers()
+	{
+		return (int)workers.size();
+	}
+	int WorkersOnNode(int node)
+	{
+		return nodeWorkerCounts[node];
+	}
+	const std::vector<int>& WorkerCpus(int worker)
+	{
+		return workerCpus[worker];
+	}
+	const JobSystemConfig& GetConfig()
+	{
+		return config;
+	}
+};
+
+#endif //_JOB_SYSTEM_H
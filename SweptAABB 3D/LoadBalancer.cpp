@@ -0,0 +1,247 @@
+/*
+Title: Swept AABB-3D
+File Name: LoadBalancer.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Keeps the ranks of a distributed world equally busy. Each rank measures what its steps cost.
+Every so often, the ranks share those costs, along with a sample of where their bodies are.
+If one rank is doing noticeably more than the average, the world is cut up again by recursive
+coordinate bisection: split the ranks into two groups, cut space along its longest axis where
+the cost on each side matches the group sizes, and repeat on each side. Each cut only moves a
+little per rebalance, so bodies change owner a few at a time instead of all at once.
+*/
+
+#ifndef _LOAD_BALANCER_CPP
+#define _LOAD_BALANCER_CPP
+
+#include "LoadBalancer.h"
+#include <iostream>
+#include <algorithm>
+
+LoadBalancer::LoadBalancer(DistributedWorld* distributedWorld, const LoadBalancerSettings& balancerSettings)
+{
+	world = distributedWorld;
+	settings = balancerSettings;
+
+	measuredCost = 0.0;
+	measuredSteps = 0;
+	imbalance = 1.0f;
+	rebalances = 0;
+
+	// With no samples, every cut splits space in proportion to the number of ranks on each side.
+	std::vector<Sample> none;
+	Rebalance(none, false);
+}
+
+float LoadBalancer::FindCut(std::vector<Sample>& samples, int axis, float low, float high, float fraction)
+{
+	float total = 0.0f;
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		total += samples[i].weight;
+	}
+	if (total <= 0.0f)
+	{
+		return low + (high - low) * fraction;
+	}
+
+	// Every rank sorts the same samples the same way, so every rank finds the same cut. Ties are broken by the order the samples came in.
+	std::stable_sort(samples.begin(), samples.end(), [axis](const Sample& a, const Sample& b)
+	{
+		return a.position[axis] < b.position[axis];
+	});
+
+	// Walk along the axis until the lower side has its share of the cost, and cut halfway to the next sample.
+	float wanted = total * fraction;
+	float sum = 0.0f;
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		sum += samples[i].weight;
+		if (sum >= wanted)
+		{
+			float position = samples[i].position[axis];
+			if (i + 1 < samples.size())
+			{
+				position = (position + samples[i + 1].position[axis]) * 0.5f;
+			}
+			return std::min(std::max(position, low), high);
+		}
+	}
+	return high;
+}
+
+void LoadBalancer::Split(AABB box, int first, int count, std::vector<Sample>& samples, size_t& cut, bool limitShift, std::vector<AABB>& domains)
+{
+	if (count == 1)
+	{
+		domains[first] = box;
+		return;
+	}
+
+	// Cut the longest axis, so the domains stay roughly cube shaped and their borders (where the ghosts are) stay short.
+	glm::vec3 extent = box.max - box.min;
+	int axis = 0;
+	if (extent.y > extent[axis])
+	{
+		axis = 1;
+	}
+	if (extent.z > extent[axis])
+	{
+		axis = 2;
+	}
+
+	int lowerCount = count / 2;
+	float position = FindCut(samples, axis, box.min[axis], box.max[axis], (float)lowerCount / count);
+
+	// Move the existing cut towards where it should be, but only so far, so only a slice of bodies changes owner at a time.
+	// If the cut is along a different axis now, the old one is no help, and we jump straight to the new one.
+	if (cut < cuts.size())
+	{
+		if (limitShift && cuts[cut].axis == axis)
+		{
+			float maxMove = extent[axis] * settings.maxShift;
+			float old = std::min(std::max(cuts[cut].position, box.min[axis]), box.max[axis]);
+			position = old + std::min(std::max(position - old, -maxMove), maxMove);
+		}
+		cuts[cut].axis = axis;
+		cuts[cut].position = position;
+	}
+	else
+	{
+		Cut made;
+		made.axis = axis;
+		made.position = position;
+		cuts.push_back(made);
+	}
+	cut++;
+
+	AABB lower = box;
+	AABB upper = box;
+	lower.max[axis] = position;
+	upper.min[axis] = position;
+
+	std::vector<Sample> lowerSamples;
+	std::vector<Sample> upperSamples;
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		if (samples[i].position[axis] < position)
+		{
+			lowerSamples.push_back(samples[i]);
+		}
+		else
+		{
+			upperSamples.push_back(samples[i]);
+		}
+	}
+
+	Split(lower, first, lowerCount, lowerSamples, cut, limitShift, domains);
+	Split(upper, first + lowerCount, count - lowerCount, upperSamples, cut, limitShift, domains);
+}
+
+void LoadBalancer::Rebalance(std::vector<Sample>& samples, bool limitShift)
+{
+	std::vector<AABB> domains(world->GetLink()->NumRanks());
+	size_t cut = 0;
+	Split(world->GetBounds(), 0, (int)domains.size(), samples, cut, limitShift, domains);
+	world->SetDomains(domains);
+}
+
+bool LoadBalancer::Update()
+{
+	measuredCost += world->GetPipeline()->GetLastStepWork();
+	measuredSteps++;
+	if (measuredSteps < settings.interval)
+	{
+		return true;
+	}
+
+	ClusterLink* link = world->GetLink();
+	int me = link->Rank();
+	int ranks = link->NumRanks();
+
+	// Our message: average cost per step, then a sample of our bodies' positions, evenly spread through them.
+	std::vector<glm::vec3> positions;
+	world->ForEachOwned([&positions](uint64_t, GameObject* body)
+	{
+		positions.push_back(body->GetPosition());
+	});
+	int stride = std::max(1, ((int)positions.size() + settings.maxSamples - 1) / settings.maxSamples);
+
+	std::vector<char> message;
+	MessageWriter writer(&message);
+	writer.F32((float)(measuredCost / measuredSteps));
+	writer.U32((uint32_t)((positions.size() + stride - 1) / stride));
+	for (size_t i = 0; i < positions.size(); i += stride)
+	{
+		writer.Vec3(positions[i].x, positions[i].y, positions[i].z);
+	}
+
+	measuredCost = 0.0;
+	measuredSteps = 0;
+
+	std::vector<std::vector<char>> outgoing(ranks, message);
+	std::vector<std::vector<char>> incoming;
+	if (!link->Exchange(outgoing, incoming))
+	{
+		return false;
+	}
+	incoming[me] = message;
+
+	// Each rank's samples share its cost between them. Everybody reads the messages in rank order, so everybody builds the same tree.
+	std::vector<Sample> samples;
+	rankCosts.assign(ranks, 0.0f);
+	float totalCost = 0.0f;
+	for (int r = 0; r < ranks; r++)
+	{
+		MessageReader reader(incoming[r].data(), incoming[r].size());
+		rankCosts[r] = reader.F32();
+		uint32_t count = reader.U32();
+		for (uint32_t i = 0; i < count && !reader.Failed(); i++)
+		{
+			Sample sample;
+			sample.position.x = reader.F32();
+			sample.position.y = reader.F32();
+			sample.position.z = reader.F32();
+			sample.weight = rankCosts[r] / count;
+			samples.push_back(sample);
+		}
+		if (reader.Failed())
+		{
+			std::cout << "Bad load balancing message from rank " << r << std::endl;
+			return false;
+		}
+		totalCost += rankCosts[r];
+	}
+
+	// A step takes as long as the slowest rank, so that's what we compare against the average.
+	float average = totalCost / ranks;
+	imbalance = average > 0.0f ? *std::max_element(rankCosts.begin(), rankCosts.end()) / average : 1.0f;
+	if (imbalance > settings.tolerance)
+	{
+		Rebalance(samples, true);
+		rebalances++;
+	}
+
+	return true;
+}
+
+#endif // _LOAD_BALANCER_CPP
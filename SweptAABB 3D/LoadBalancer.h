@@ -0,0 +1,117 @@
+/*
+Title: Swept AABB-3D
+File Name: LoadBalancer.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Keeps the ranks of a distributed world equally busy. Each rank measures what its steps cost.
+Every so often, the ranks share those costs, along with a sample of where their bodies are.
+If one rank is doing noticeably more than the average, the world is cut up again by recursive
+coordinate bisection: split the ranks into two groups, cut space along its longest axis where
+the cost on each side matches the group sizes, and repeat on each side. Each cut only moves a
+little per rebalance, so bodies change owner a few at a time instead of all at once.
+*/
+
+#ifndef _LOAD_BALANCER_H
+#define _LOAD_BALANCER_H
+
+#include "DistributedWorld.h"
+#include <vector>
+
+struct LoadBalancerSettings
+{
+	// How many steps to measure over between rebalances.
+	int interval;
+
+	// Only rebalance once the busiest rank costs this many times the average.
+	float tolerance;
+
+	// How far a cut may move per rebalance, as a fraction of the width of the space it cuts.
+	float maxShift;
+
+	// The most body positions each rank sends. More gives better cuts, but a bigger message.
+	int maxSamples;
+
+	LoadBalancerSettings()
+	{
+		interval = 100;
+		tolerance = 1.1f;
+		maxShift = 0.1f;
+		maxSamples = 512;
+	}
+};
+
+class LoadBalancer
+{
+	// A body position, weighted by its share of its rank's cost.
+	struct Sample
+	{
+		glm::vec3 position;
+		float weight;
+	};
+
+	// One cut of the bisection tree, in the order the tree is built (depth first, lower ranks first).
+	struct Cut
+	{
+		int axis;
+		float position;
+	};
+
+	DistributedWorld* world;
+	LoadBalancerSettings settings;
+
+	std::vector<Cut> cuts;
+
+	double measuredCost;
+	int measuredSteps;
+
+	// What each rank's steps cost on average over the last interval, in milliseconds, and the busiest one over the average.
+	std::vector<float> rankCosts;
+	float imbalance;
+	int rebalances;
+
+	float FindCut(std::vector<Sample>& samples, int axis, float low, float high, float fraction);
+	void Split(AABB box, int first, int count, std::vector<Sample>& samples, size_t& cut, bool limitShift, std::vector<AABB>& domains);
+	void Rebalance(std::vector<Sample>& samples, bool limitShift);
+
+public:
+	// Replaces the world's domains with an even split of the bisection tree straight away.
+	LoadBalancer(DistributedWorld* distributedWorld, const LoadBalancerSettings& balancerSettings = LoadBalancerSettings());
+
+	// Call once after every step of the world. Every settings.interval steps the ranks swap their costs, so, like
+	// DistributedWorld::Step(), every rank has to call this together. Returns false if another rank has gone away.
+	bool Update();
+
+	const std::vector<float>& GetRankCosts()
+	{
+		return rankCosts;
+	}
+	float GetImbalance()
+	{
+		return imbalance;
+	}
+	int NumRebalances()
+	{
+		return rebalances;
+	}
+};
+
+#endif //_LOAD_BALANCER_H
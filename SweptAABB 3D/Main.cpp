@@ -37,7 +37,16 @@ object passes through or into the middle of the colliding object).
 
 #include "GLIncludes.h"
 #include "GameObject.h"
+#include "Collision.h"
 #include "GLRender.h"
+#include "PhysicsService.h"
+#include "LoadBalancer.h"
+#include "StatePublisher.h"
+#include "ReplayRecorder.h"
+#include "TrajectoryFile.h"
+#include <csignal>
+#include <chrono>
+#include <thread>
 #include <iostream>
 #include <fstream>
 #include <vector>
@@ -62,355 +71,371 @@ GLFWwindow* window;
 
 
 
-// Regular AABB collision detection. (Not used in this demo, but should work just fine.)
-bool TestAABB(AABB a, AABB b)
+// This runs once every physics timestep.
+void update(float dt)
 {
-	// If any axis is separated, exit with no intersection.
-	if (a.max.x < b.min.x || a.min.x > b.max.x) return false;
-	if (a.max.y < b.min.y || a.min.y > b.max.y) return false;
-	if (a.max.z < b.min.z || a.min.z > b.max.z) return false;
-	
-	return true;
+	// The step runs as a graph of tasks on the worker threads: every region bounces, rotates and recalculates the AABBs of its bodies,
+	// then the broadphase finds out which bodies could possibly collide, and every group of bodies that could collide is solved with
+	// the SweptAABB algorithm (see Collision.cpp). See StepPipeline.cpp for the details.
+	// Sectors that have finished loading go into the world between steps, and ones out of range come out.
+	if (sectorStreamer != nullptr)
+	{
+		sectorStreamer->Update();
+	}
+
+	// The registry runs the step for every world it hosts, and gives up on any it can't fit in once a physics timestep's worth of time has gone by.
+	worlds->Tick(dt, physicsStep * 1000.0);
 }
 
-// Swept AABB collision detection, giving you the time of collision and thus allowing you to even calculate the point of collision and collision responses (such as bounce).
-float SweptAABB(AABB* box1, AABB* box2, glm::vec3 vel1, float& normalx, float& normaly, float& normalz)
+// This runs once every frame to determine the FPS and how often to call update based on the physics step.
+void checkTime()
 {
-	// These variables stand for the distance in each axis between the moving object and the stationary object in terms of when the moving object would "enter" the colliding object.
-	float xDistanceEntry, yDistanceEntry, zDistanceEntry;
+	// Get the current time.
+	time = glfwGetTime();
 
-	// These variables stand for the distance in each axis in terms of when the moving object would "exit" the colliding object.
-	float xDistanceExit, yDistanceExit, zDistanceExit;
+	// Get the time since we last ran an update.
+	double dt = time - timebase;
 
-	// Find the distance between the objects on the near and far sides for both x and y
-	// Depending on the direction of the velocity, we'll reverse the calculation order to maintain the right sign (positive/negative).
-	if (vel1.x > 0.0f)
-	{
-		xDistanceEntry = (*box2).min.x - (*box1).max.x;
-		xDistanceExit = (*box2).max.x - (*box1).min.x;
-	}
-	else
+	// If more time has passed than our physics timestep.
+	if (dt > physicsStep)
 	{
-		xDistanceEntry = (*box2).max.x - (*box1).min.x;
-		xDistanceExit = (*box2).min.x - (*box1).max.x;
-	}
+		// Calculate FPS: Take the number of frames (frame) since the last time we calculated FPS, and divide by the amount of time that has passed since the 
+		// last time we calculated FPS (time - FPSTime).
+		if (time - FPSTime > 1.0)
+		{
+			fps = frame / (time - FPSTime);
 
-	if (vel1.y > 0.0f)
-	{
-		yDistanceEntry = (*box2).min.y - (*box1).max.y;
-		yDistanceExit = (*box2).max.y - (*box1).min.y;
-	}
-	else
-	{
-		yDistanceEntry = (*box2).max.y - (*box1).min.y;
-		yDistanceExit = (*box2).min.y - (*box1).max.y;
-	}
+			FPSTime = time; // Now we set FPSTime = time, so that we have a reference for when we calculated the FPS
+			
+			frame = 0; // Reset our frame counter to 0, to mark that 0 frames have passed since we calculated FPS (since we literally just did it)
 
-	if (vel1.z > 0.0f)
-	{
-		zDistanceEntry = (*box2).min.z - (*box1).max.z;
-		zDistanceExit = (*box2).max.z - (*box1).min.z;
-	}
-	else
-	{
-		zDistanceEntry = (*box2).max.z - (*box1).min.z;
-		zDistanceExit = (*box2).min.z - (*box1).max.z;
-	}
+			std::string s = "FPS: " + std::to_string(fps); // This just creates a string that looks like "FPS: 60" or however much.
+
+			glfwSetWindowTitle(window, s.c_str()); // This will set the window title to that string, displaying the FPS as the window title.
+		}
 
-	// These variables stand for the time at which the moving object would enter/exit the stationary object.
-	float xEntryTime, yEntryTime, zEntryTime;
-	float xExitTime, yExitTime, zExitTime;
+		timebase = time; // Set timebase = time so we have a reference for when we ran the last physics timestep.
 
-	// Find time of collision and time of leaving for each axis (if statement is to prevent divide by zero)
-	if (vel1.x == 0.0f)
-	{
-		// If the largest distance (entry or exit) between the two objects is greater than the size of both objects combined, then the objects are clearly not colliding.
-		if (std::max(fabsf(xDistanceEntry), fabsf(xDistanceExit)) > (((*box1).max.x - (*box1).min.x) + ((*box2).max.x - (*box2).min.x)))
+		// Limit dt so that we if we experience any sort of delay in processing power or the window is resizing/moving or anything, it doesn't update a bunch of times while the player can't see.
+		// This will limit it to a .25 seconds.
+		if (dt > 0.25)
 		{
-			// Setting this to 2.0f will cause an absence of collision later in this function.
-			xEntryTime = 2.0f;
+			dt = 0.25;
 		}
-		else
+
+		// The accumulator is here so that we can track the amount of time that needs to be updated based on dt, but not actually update at dt intervals and instead use our physicsStep.
+		accumulator += dt;
+
+		// Run a while loop, that runs update(physicsStep) until the accumulator no longer has any time left in it (or the time left is less than physicsStep, at which point it save that 
+		// leftover time and use it in the next checkTime() call.
+		while (accumulator >= physicsStep)
 		{
-			// Otherwise, pass negative infinity to basically ignore this variable.
-			xEntryTime = -std::numeric_limits<float>::infinity();
+			// Only the last step before we draw needs its MVP matrices worked out, so let the pipeline do that one while it steps.
+			if (accumulator - physicsStep < physicsStep)
+			{
+				pipeline->DrawAfterNextStep();
+			}
+
+			update(physicsStep);
+
+			accumulator -= physicsStep;
 		}
-		
-		// Setting this to postivie infinity will ignore this variable.
-		xExitTime = std::numeric_limits<float>::infinity();
+
+		// If the last step didn't get to run (or there wasn't one), make sure the matrices we're about to draw are ready now.
+		pipeline->FlushRenderSnapshot();
 	}
-	else
+}
+
+// Called by GLFW whenever a key is pressed, repeated or released.
+void keyPressed(GLFWwindow*, int key, int, int action, int)
+{
+	// D turns drawing the AABBs, swept boxes and contact normals on and off.
+	if (key == GLFW_KEY_D && action == GLFW_PRESS)
 	{
-		// If there is a velocity in the x-axis, then we can determine the time of collision based on the distance divided by the velocity. (Assuming velocity does not change.)
-		xEntryTime = xDistanceEntry / vel1.x;
-		xExitTime = xDistanceExit / vel1.x;
+		debugDraw = !debugDraw;
 	}
+}
+
+
+
+// The service, when we run as one (see runService()).
+PhysicsService* service = nullptr;
+
+void stopService(int)
+{
+	service->Stop();
+}
 
-	if (vel1.y == 0.0f)
+// Runs with no window, as a physics service other processes talk to over a Unix domain socket at socketPath. See PhysicsProtocol.h for the protocol.
+int runService(const char* socketPath)
+{
+	// This thread does all of the stepping for the clients, so leave its core free, like the render thread's.
+	JobSystemConfig jobConfig;
+	jobConfig.reservedCores = 1;
+	jobConfig.pinToCores = true;
+	jobSystem = new JobSystem(jobConfig);
+	jobSystem->PinCallingThreadToReservedCores();
+
+	worlds = new WorldRegistry(jobSystem);
+	service = new PhysicsService(worlds);
+
+	int result = 1;
+	if (service->Start(socketPath))
 	{
-		if (std::max(fabsf(yDistanceEntry), fabsf(yDistanceExit)) > (((*box1).max.y - (*box1).min.y) + ((*box2).max.y - (*box2).min.y)))
-		{
-			yEntryTime = 2.0f;
-		}
-		else
-		{
-			yEntryTime = -std::numeric_limits<float>::infinity();
-		}
+		// Ctrl+C shuts the service down cleanly, so the socket file and shared memory get removed.
+		signal(SIGINT, stopService);
+		signal(SIGTERM, stopService);
 
-		yExitTime = std::numeric_limits<float>::infinity();
+		std::cout << "Physics service listening on " << socketPath << std::endl;
+		service->Run();
+		result = 0;
 	}
-	else
+
+	delete(service);
+	delete(worlds);
+	delete(jobSystem);
+
+	return result;
+}
+
+// Set by Ctrl+C while running as one rank of a distributed world, or following another process with runSubscriber().
+volatile std::sig_atomic_t stopRequested = 0;
+
+void stopDistributed(int)
+{
+	stopRequested = 1;
+}
+
+// Runs with no window, as one rank of a world split across numRanks processes. Every rank is started with the same directory, which
+// is where they find each other (see ClusterLink), and its own rank. Each rank fills its slab of the world with boxes, and then they
+// all step together until one of them is stopped.
+int runDistributed(const char* directory, int rank, int numRanks)
+{
+	jobSystem = new JobSystem(JobSystemConfig());
+
+	ClusterLink* link = new ClusterLink();
+	if (!link->Connect(directory, rank, numRanks))
 	{
-		yEntryTime = yDistanceEntry / vel1.y;
-		yExitTime = yDistanceExit / vel1.y;
+		delete(link);
+		delete(jobSystem);
+		return 1;
 	}
 
-	if (vel1.z == 0.0f)
+	// A unit cube, which is never drawn, so it doesn't need any buffers.
+	VertexFormat corners[8];
+	for (int i = 0; i < 8; i++)
 	{
-		if (std::max(fabsf(zDistanceEntry), fabsf(zDistanceExit)) > (((*box1).max.z - (*box1).min.z) + ((*box2).max.z - (*box2).min.z)))
-		{
-			zEntryTime = 2.0f;
-		}
-		else
-		{
-			zEntryTime = -std::numeric_limits<float>::infinity();
-		}
-
-		zExitTime = std::numeric_limits<float>::infinity();
+		corners[i] = VertexFormat(glm::vec3(i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f, i & 4 ? 0.5f : -0.5f), glm::vec4(1.0f));
 	}
-	else
+	Model* box = new Model(8, corners, 0, nullptr, false);
+
+	DistributedWorld* distributed = new DistributedWorld(jobSystem, link, box);
+	LoadBalancer* balancer = new LoadBalancer(distributed);
+
+	AABB domain = distributed->GetDomains()[rank];
+	srand(rank + 1);
+	for (int i = 0; i < 200; i++)
 	{
-		zEntryTime = zDistanceEntry / vel1.z;
-		zExitTime = zDistanceExit / vel1.z;
+		glm::vec3 t = glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX;
+		glm::vec3 position = domain.min + (domain.max - domain.min) * (0.1f + 0.8f * t);
+		glm::vec3 velocity = (glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX - 0.5f) * 0.5f;
+		distributed->CreateBody(position, velocity, glm::vec3(0.05f));
 	}
 
-	// Get the maximum entry time to determine the latest collision, which is actually when the objects are colliding. (Because all 3 axes must collide.)
-	float entryTime = std::max(std::max(xEntryTime, yEntryTime), zEntryTime);
-
-	// Get the minimum exit time to determine when the objects are no longer colliding. (AKA the objects passed through one another.)
-	float exitTime = std::min(std::min(xExitTime, yExitTime), zExitTime);
+	signal(SIGINT, stopDistributed);
+	signal(SIGTERM, stopDistributed);
 
-	// If anything in the following statement is true, there's no collision.
-	// If entryTime > exitTime, that means that one of the axes is exiting the "collision" before the other axes are crossing, thus they don't cross the object in unison and there's no collison.
-	// If all three of the entry times are less than zero, then the collision already happened (or we missed it, but either way..)
-	// If any of the entry times are greater than 1.0f, then the collision isn't happening this update/physics step so we'll move on.
-	if (entryTime > exitTime || xEntryTime < 0.0f && yEntryTime < 0.0f && zEntryTime < 0.0f || xEntryTime > 1.0f || yEntryTime > 1.0f || zEntryTime > 1.0f)
-	{
-		// With no collision, we pass out zero'd normals.
-		normalx = 0.0f;
-		normaly = 0.0f;
-		normalz = 0.0f;
-
-		// If collision detection isn't working, try uncommenting the if statemente and putting a break point on the std::cout statement.
-		// Then you can check variable values within this algorithm to make sure everything is in order.
-		/*if (glm::distance(obj1->GetPosition(), obj2->GetPosition()) < 0.1)
-		{
-			std::cout << "Something went wrong, and the objects are inside of each other but haven't been detected as a collision.";
-		}*/
+	std::cout << "Rank " << rank << " of " << numRanks << " running" << std::endl;
 
-		// 2.0f signifies that there was no collision.
-		return 2.0f;
-	}
-	else // If there was a collision
+	// Step at the same rate as the window would. The ranks keep each other in step, since each one waits on the others every step.
+	int result = 0;
+	std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+	for (unsigned long long step = 0; !stopRequested; step++)
 	{
-		// Calculate normal of collided surface
-		if (xEntryTime > yEntryTime && xEntryTime > zEntryTime) // If the x-axis is the last to cross, then that is the colliding axis.
+		if (!distributed->Step((float)physicsStep) || !balancer->Update())
 		{
-			if (xDistanceEntry < 0.0f) // Determine the normal based on positive or negative.
-			{
-				normalx = 1.0f;
-				normaly = 0.0f;
-				normalz = 0.0f;
-			}
-			else
-			{
-				normalx = -1.0f;
-				normaly = 0.0f;
-				normalz = 0.0f;
-			}
+			result = 1;
+			break;
 		}
-		else if (yEntryTime > xEntryTime && yEntryTime > zEntryTime)
+
+		if (step % 500 == 0)
 		{
-			if (yDistanceEntry < 0.0f)
-			{
-				normalx = 0.0f;
-				normaly = 1.0f;
-				normalz = 0.0f;
-			}
-			else
-			{
-				normalx = 0.0f;
-				normaly = -1.0f;
-				normalz = 0.0f;
-			}
-		}
-		else if (zEntryTime > xEntryTime && zEntryTime > yEntryTime)
-		{
-			if (zDistanceEntry < 0.0f)
-			{
-				normalx = 0.0f;
-				normaly = 0.0f;
-				normalz = 1.0f;
-			}
-			else
-			{
-				normalx = 0.0f;
-				normaly = 0.0f;
-				normalz = -1.0f;
-			}
+			std::cout << "Step " << step << ": " << distributed->NumOwned() << " bodies owned, " << distributed->NumGhosts() << " ghosts, busiest rank at "
+				<< balancer->GetImbalance() << "x the average" << std::endl;
 		}
 
-		// Return the time of collision
-		return entryTime;
+		next += std::chrono::microseconds((long long)(physicsStep * 1000000.0));
+		std::this_thread::sleep_until(next);
 	}
+
+	delete(balancer);
+	delete(distributed);
+	delete(box);
+	delete(link);
+	delete(jobSystem);
+
+	return result;
 }
 
-// This runs once every physics timestep.
-void update(float dt)
+// Follows a demo started with "--publish <name>" from another process, and prints where its bodies are every so often, until Ctrl+C.
+int runSubscriber(const char* name)
 {
-	// This section just checks to make sure the object stays within a certain boundary. This is not really collision detection.
-	glm::vec3 tempPos = obj2->GetPosition();
-	
-	if (fabsf(tempPos.x) > 0.9f)
-	{
-		glm::vec3 tempVel = obj2->GetVelocity();
-
-		// "Bounce" the velocity along the axis that was over-extended.
-		obj2->SetVelocity(glm::vec3(-1.0f * tempVel.x, tempVel.y, tempVel.z));
-	}
-	if (fabsf(tempPos.y) > 0.8f)
-	{
-		glm::vec3 tempVel = obj2->GetVelocity();
-		obj2->SetVelocity(glm::vec3(tempVel.x, -1.0f * tempVel.y, tempVel.z));
-	}
-	if (fabsf(tempPos.z) > 1.0f)
+	StateSubscriber subscriber;
+	if (!subscriber.Open(name))
 	{
-		glm::vec3 tempVel = obj2->GetVelocity();
-		obj2->SetVelocity(glm::vec3(tempVel.x, tempVel.y, -1.0f * tempVel.z));
+		return 1;
 	}
 
-	// Rotate the objects. This helps illustrate how the AABB recalculates as an object's orientation changes.
-	obj1->Rotate(glm::vec3(glm::radians(1.0f), glm::radians(1.0f), glm::radians(0.0f)));
-	obj2->Rotate(glm::vec3(glm::radians(1.0f), glm::radians(1.0f), glm::radians(0.0f)));
-
-	// Re-calculate the Axis-Aligned Bounding Box for your object.
-	// We do this because if the object's orientation changes, we should update the bounding box as well.
-	// Be warned: For some objects this can actually cause a collision to be missed, so be careful.
-	// (This is because we determine the time of the collision based on the AABB, but if the AABB changes significantly, the time of collision can change between frames,
-	// and if that lines up just right you'll miss the collision altogether.)
-	obj1->CalculateAABB();
-	obj2->CalculateAABB();
-
-	// Our normals will be passed out of the SweptAABB algorithm and used to determine where to "bounce" the object.
-	float normalx, normaly, normalz;
-
-	// This function requires that the moving object be passed in first, the second object be stationary, and that the velocity refers to the 
-	// velocity of the moving object this frame. For perfection, you should have some sort of physics timestep setup. (See the checkTime() function).
-	float collisionTime = SweptAABB(&obj2->GetAABB(), &obj1->GetAABB(), obj2->GetVelocity() * dt, normalx, normaly, normalz);
-	
-	// Since we know we'll collide at collisionTime * dt, we can define that 1.0f - collisionTime is the remaining time this frame after that collision.
-	// Thus, we'll "bounce" off the collided object, then update the rest of the object's movement by remainingTime * dt.
-	float remainingTime = 1.0f - collisionTime;
+	signal(SIGINT, stopDistributed);
+	signal(SIGTERM, stopDistributed);
 
-	// If remaining time is less than zero, there's no collision this frame (because collisionTime is > 1).
-	// If remaining time = 0, then the collision happens exactly at the end of this frame.
-	if (remainingTime >= 0.0f)
+	// Follow every step in order. If we fall behind far enough that a step has left the ring, skip ahead to the newest.
+	uint64_t next = subscriber.NextStep();
+	while (!stopRequested)
 	{
-		// Create a local velocity variable based off of the moving object's velocity.
-		glm::vec3 velocity = obj2->GetVelocity();
-
-		// If the normal is not some ridiculously small (or zero) value.
-		if (abs(normalx) > 0.0001f)
+		if (next >= subscriber.NextStep())
 		{
-			// Bounce the velocity along that axis.
-			velocity.x *= -1;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
 		}
-		if (abs(normaly) > 0.0001f)
+
+		StateView view;
+		if (!subscriber.Step(next, view))
 		{
-			velocity.y *= -1;
+			next = subscriber.NextStep();
+			continue;
 		}
-		if (abs(normalz) > 0.0001f)
+
+		uint64_t step = view.step;
+		uint32_t count = view.count;
+		glm::vec3 first = count > 0 ? glm::vec3(view.positionX[0], view.positionY[0], view.positionZ[0]) : glm::vec3(0.0f);
+		if (!subscriber.Valid(view))
 		{
-			velocity.z *= -1;
+			next = subscriber.NextStep();
+			continue;
 		}
 
-		// Update the objects by the collisionTime * dt (which is the part of the update before it collides with the object).
-		obj1->Update(collisionTime * dt);
-		obj2->Update(collisionTime * dt);
+		if (step % 500 == 0)
+		{
+			std::cout << "Step " << step << ": " << count << " bodies, the first at (" << first.x << ", " << first.y << ", " << first.z << ")" << std::endl;
+		}
+		next++;
+	}
 
-		// Then change the velocity to be the "bounced" velocity.
-		obj2->SetVelocity(velocity);
+	return 0;
+}
 
-		// Now update the objects by the remainingTime * dt (which is the part of the update after the collision).
-		obj1->Update(remainingTime * dt);
-		obj2->Update(remainingTime * dt);
+// Reads back a replay made with "--record <file>", and prints how far every step's bodies spread out.
+int runReplay(const char* fileName)
+{
+	ReplayReader reader;
+	if (!reader.Open(fileName))
+	{
+		return 1;
 	}
-	else
+
+	StateFrame frame;
+	unsigned long long frames = 0;
+	while (reader.Next(frame))
 	{
-		// No collision, update normally.
-		obj1->Update(dt);
-		obj2->Update(dt);
+		if (frames % 500 == 0)
+		{
+			AABB spread(glm::vec3(INFINITY), glm::vec3(-INFINITY));
+			for (size_t i = 0; i < frame.positions.size(); i++)
+			{
+				spread.min = glm::min(spread.min, frame.positions[i]);
+				spread.max = glm::max(spread.max, frame.positions[i]);
+			}
+			std::cout << "Step " << frame.step << ": " << frame.ids.size() << " bodies, between (" << spread.min.x << ", " << spread.min.y << ", " << spread.min.z
+				<< ") and (" << spread.max.x << ", " << spread.max.y << ", " << spread.max.z << ")" << std::endl;
+		}
+		frames++;
 	}
 
-	// Update your MVP matrices based on the objects' transforms.
-	MVP = PV * *obj1->GetTransform();
-	MVP2 = PV * *obj2->GetTransform();
+	std::cout << frames << " steps in " << fileName << std::endl;
+	return 0;
 }
 
-// This runs once every frame to determine the FPS and how often to call update based on the physics step.
-void checkTime()
+// Prints what's in a trajectory file made with "--trajectories <file>": every chunk's steps, and the collisions in all of them.
+int runTrajectories(const char* fileName)
 {
-	// Get the current time.
-	time = glfwGetTime();
-
-	// Get the time since we last ran an update.
-	double dt = time - timebase;
-
-	// If more time has passed than our physics timestep.
-	if (dt > physicsStep)
+	TrajectoryReader reader;
+	if (!reader.Open(fileName))
 	{
-		// Calculate FPS: Take the number of frames (frame) since the last time we calculated FPS, and divide by the amount of time that has passed since the 
-		// last time we calculated FPS (time - FPSTime).
-		if (time - FPSTime > 1.0)
-		{
-			fps = frame / (time - FPSTime);
+		return 1;
+	}
 
-			FPSTime = time; // Now we set FPSTime = time, so that we have a reference for when we calculated the FPS
-			
-			frame = 0; // Reset our frame counter to 0, to mark that 0 frames have passed since we calculated FPS (since we literally just did it)
+	for (uint32_t i = 0; i < reader.NumChunks(); i++)
+	{
+		const TrajectoryChunk& chunk = reader.GetChunk(i);
+		std::cout << "Chunk " << i << ": steps " << chunk.firstStep << " to " << chunk.lastStep << ", " << chunk.rows << " rows, " << chunk.events << " collisions" << std::endl;
+	}
 
-			std::string s = "FPS: " + std::to_string(fps); // This just creates a string that looks like "FPS: 60" or however much.
+	std::vector<TrajectoryEvent> collisions;
+	reader.ScanCollisions(0, UINT64_MAX, collisions);
+	for (size_t i = 0; i < collisions.size() && i < 10; i++)
+	{
+		std::cout << "Step " << collisions[i].step << ": " << collisions[i].collision.bodyA << " hit " << collisions[i].collision.bodyB << std::endl;
+	}
+	std::cout << collisions.size() << " collisions in " << fileName << std::endl;
+	return 0;
+}
 
-			glfwSetWindowTitle(window, s.c_str()); // This will set the window title to that string, displaying the FPS as the window title.
-		}
+int main(int argc, char **argv)
+{
+	// "--service <socket path>" runs the simulator for other processes instead of opening a window.
+	if (argc >= 3 && std::string(argv[1]) == "--service")
+	{
+		return runService(argv[2]);
+	}
 
-		timebase = time; // Set timebase = time so we have a reference for when we ran the last physics timestep.
+	// "--distributed <directory> <rank> <number of ranks>" runs as one process of a distributed world.
+	if (argc >= 5 && std::string(argv[1]) == "--distributed")
+	{
+		return runDistributed(argv[2], atoi(argv[3]), atoi(argv[4]));
+	}
 
-		// Limit dt so that we if we experience any sort of delay in processing power or the window is resizing/moving or anything, it doesn't update a bunch of times while the player can't see.
-		// This will limit it to a .25 seconds.
-		if (dt > 0.25)
-		{
-			dt = 0.25;
-		}
+	// "--subscribe <name>" follows a demo started with "--publish <name>", with no window of its own.
+	if (argc >= 3 && std::string(argv[1]) == "--subscribe")
+	{
+		return runSubscriber(argv[2]);
+	}
 
-		// The accumulator is here so that we can track the amount of time that needs to be updated based on dt, but not actually update at dt intervals and instead use our physicsStep.
-		accumulator += dt;
+	// "--play <file>" and "--query <file>" read back a replay or a trajectory file, with no window.
+	if (argc >= 3 && std::string(argv[1]) == "--play")
+	{
+		return runReplay(argv[2]);
+	}
+	if (argc >= 3 && std::string(argv[1]) == "--query")
+	{
+		return runTrajectories(argv[2]);
+	}
 
-		// Run a while loop, that runs update(physicsStep) until the accumulator no longer has any time left in it (or the time left is less than physicsStep, at which point it save that 
-		// leftover time and use it in the next checkTime() call.
-		while (accumulator >= physicsStep)
-		{
-			update(physicsStep);
+	// "--record <file> [--compressed]" records every step to a replay file while the window is open.
+	if (argc >= 3 && std::string(argv[1]) == "--record")
+	{
+		replayFile = argv[2];
+		replayCompressed = argc >= 4 && std::string(argv[3]) == "--compressed";
+	}
 
-			accumulator -= physicsStep;
-		}
+	// "--sectors <directory>" streams in the sector files in directory around the camera (see SectorFile.h for how to make them).
+	if (argc >= 3 && std::string(argv[1]) == "--sectors")
+	{
+		sectorDirectory = argv[2];
 	}
-}
 
+	// "--publish <name>" shares every step's transforms in shared memory under that name, for other processes to read (see StatePublisher.h).
+	if (argc >= 3 && std::string(argv[1]) == "--publish")
+	{
+		publishName = argv[2];
+	}
 
+	// "--trajectories <file>" exports every body's trajectory, and every collision, while the window is open.
+	if (argc >= 3 && std::string(argv[1]) == "--trajectories")
+	{
+		trajectoryFile = argv[2];
+	}
 
-int main(int argc, char **argv)
-{
 	// Initializes the GLFW library
 	glfwInit();
 
@@ -430,6 +455,9 @@ int main(int argc, char **argv)
 	// Initializes most things needed before the main loop
 	init();
 
+	// Let us know about key presses, so keys can turn things on and off.
+	glfwSetKeyCallback(window, keyPressed);
+
 	// Calculate the Axis-Aligned Bounding Box for your object.
 	obj1->CalculateAABB();
 	obj2->CalculateAABB();
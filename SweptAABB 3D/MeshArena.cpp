@@ -0,0 +1,266 @@
+/*
+Title: Swept AABB-3D
+File Name: MeshArena.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Puts the vertices and indices of every Model into one shared vertex buffer and one shared
+index buffer, so that the whole scene draws from a single vertex array, and submits each frame
+with one glMultiDrawElementsIndirect call built from a command buffer filled in on the CPU.
+*/
+
+#ifndef _MESH_ARENA_CPP
+#define _MESH_ARENA_CPP
+
+#include "MeshArena.h"
+#include <algorithm>
+#include <utility>
+
+MeshArena::MeshArena()
+{
+	// Every command after the first starts at a nonzero baseInstance, which drivers without base instance support ignore, so they'd read
+	// every mesh's matrices from the start of the buffer.
+	supported = (GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect) && (GLEW_VERSION_4_2 || GLEW_ARB_base_instance);
+	geometryChanged = false;
+	largestMesh = 0;
+	indexType = GL_UNSIGNED_INT;
+	submittedCommands = 0;
+	vao = 0;
+	vbo = 0;
+	ebo = 0;
+	mvpBuffer = 0;
+	commandBuffer = 0;
+
+	if (!supported)
+	{
+		return;
+	}
+
+	glGenBuffers(1, &vbo);
+	glGenBuffers(1, &ebo);
+	glGenBuffers(1, &mvpBuffer);
+	glGenBuffers(1, &commandBuffer);
+
+	// One vertex array for everything. Attributes 0 and 1 are the same as a Model's (see Model::InitBuffer()).
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexFormat), (void*)16);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(VertexFormat), (void*)0);
+
+	// The MVP matrix takes up attributes 2 to 5, one column each. A divisor of 1 moves on to the next matrix once per instance
+	// rather than once per vertex, and each command's baseInstance says which matrix its first instance starts at.
+	glBindBuffer(GL_ARRAY_BUFFER, mvpBuffer);
+	for (int column = 0; column < 4; column++)
+	{
+		glEnableVertexAttribArray(2 + column);
+		glVertexAttribPointer(2 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4) * column));
+		glVertexAttribDivisor(2 + column, 1);
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+MeshArena::~MeshArena()
+{
+	if (vao != 0)
+	{
+		glDeleteVertexArrays(1, &vao);
+		glDeleteBuffers(1, &vbo);
+		glDeleteBuffers(1, &ebo);
+		glDeleteBuffers(1, &mvpBuffer);
+		glDeleteBuffers(1, &commandBuffer);
+	}
+}
+
+void MeshArena::Append(ArenaMesh& mesh)
+{
+	mesh.firstIndex = (GLuint)indices.size();
+	mesh.baseVertex = (GLint)vertices.size();
+	mesh.numIndices = (GLuint)mesh.indices.size();
+
+	vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+	indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+	largestMesh = std::max(largestMesh, (int)mesh.vertices.size());
+
+	meshIds[mesh.modelSerial] = (int)meshes.size();
+	meshes.push_back(std::move(mesh));
+	geometryChanged = true;
+}
+
+int MeshArena::AddMesh(Model* model)
+{
+	std::unordered_map<uint64_t, int>::iterator found = meshIds.find(model->GetSerial());
+	if (found != meshIds.end())
+	{
+		return found->second;
+	}
+
+	ArenaMesh mesh;
+	mesh.modelSerial = model->GetSerial();
+	mesh.vertices.assign(model->Vertices(), model->Vertices() + model->NumVertices());
+	mesh.indices.assign(model->Indices(), model->Indices() + model->NumIndices());
+	Append(mesh);
+	return (int)meshes.size() - 1;
+}
+
+void MeshArena::Rebuild()
+{
+	std::vector<ArenaMesh> kept;
+	kept.swap(meshes);
+
+	vertices.clear();
+	indices.clear();
+	meshIds.clear();
+	largestMesh = 0;
+	for (size_t i = 0; i < kept.size(); i++)
+	{
+		Append(kept[i]);
+	}
+
+	geometryChanged = true;
+}
+
+void MeshArena::Remove(Model* model)
+{
+	std::unordered_map<uint64_t, int>::iterator found = meshIds.find(model->GetSerial());
+	if (found == meshIds.end())
+	{
+		return;
+	}
+
+	// Take it out of the list, then pack everything else back together from our copies, so there's no gap left behind.
+	meshes.erase(meshes.begin() + found->second);
+	Rebuild();
+}
+
+void MeshArena::Add(Model* model, const glm::mat4& mvp)
+{
+	if (!supported || model->NumIndices() == 0)
+	{
+		return;
+	}
+
+	drawMeshes.push_back(AddMesh(model));
+	drawMVPs.push_back(mvp);
+}
+
+void MeshArena::Upload(const RenderCommandList& list)
+{
+	if (geometryChanged)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(VertexFormat) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+
+		// The element buffer binding belongs to the vertex array, so it has to be bound to get at the buffer.
+		glBindVertexArray(vao);
+		if (largestMesh <= 65536)
+		{
+			indexType = GL_UNSIGNED_SHORT;
+
+			std::vector<GLushort> shortIndices(indices.begin(), indices.end());
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * shortIndices.size(), shortIndices.data(), GL_STATIC_DRAW);
+		}
+		else
+		{
+			indexType = GL_UNSIGNED_INT;
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.size(), indices.data(), GL_STATIC_DRAW);
+		}
+		glBindVertexArray(0);
+
+		geometryChanged = false;
+	}
+
+	// The matrices and commands are new every frame. Passing the data to glBufferData (rather than glBufferSubData) lets the driver hand us
+	// fresh memory instead of waiting for the GPU to finish with last frame's.
+	glBindBuffer(GL_ARRAY_BUFFER, mvpBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4) * list.instances.size(), list.instances.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * list.commands.size(), list.commands.data(), GL_STREAM_DRAW);
+}
+
+void MeshArena::Submit(GLuint program)
+{
+	frame.commands.clear();
+	frame.instances.clear();
+	if (!supported || drawMeshes.empty())
+	{
+		submittedCommands = 0;
+		return;
+	}
+
+	// Count the draws of each mesh, and turn the counts into where each mesh's matrices start. This groups the draws by mesh in one pass
+	// over them, without sorting, and keeps the draws of each mesh in the order they were added.
+	meshStarts.assign(meshes.size() + 1, 0);
+	for (size_t i = 0; i < drawMeshes.size(); i++)
+	{
+		meshStarts[drawMeshes[i] + 1]++;
+	}
+	for (size_t m = 0; m < meshes.size(); m++)
+	{
+		if (meshStarts[m + 1] > 0)
+		{
+			DrawElementsIndirectCommand command;
+			command.count = meshes[m].numIndices;
+			command.instanceCount = (GLuint)meshStarts[m + 1];
+			command.firstIndex = meshes[m].firstIndex;
+			command.baseVertex = meshes[m].baseVertex;
+			command.baseInstance = (GLuint)meshStarts[m];
+			frame.commands.push_back(command);
+		}
+		meshStarts[m + 1] += meshStarts[m];
+	}
+
+	frame.instances.resize(drawMVPs.size());
+	for (size_t i = 0; i < drawMeshes.size(); i++)
+	{
+		frame.instances[meshStarts[drawMeshes[i]]++] = drawMVPs[i];
+	}
+
+	Submit(frame, program);
+}
+
+void MeshArena::Submit(const RenderCommandList& list, GLuint program)
+{
+	submittedCommands = (int)list.commands.size();
+	if (!supported || list.commands.empty())
+	{
+		return;
+	}
+
+	Upload(list);
+
+	// The indirect buffer is still bound from Upload(). The commands are read from it, starting at offset 0.
+	glUseProgram(program);
+	glBindVertexArray(vao);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)0, (GLsizei)list.commands.size(), 0);
+	glBindVertexArray(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+#endif // _MESH_ARENA_CPP
@@ -0,0 +1,178 @@
+/*
+Title: Swept AABB-3D
+File Name: MeshArena.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Puts the vertices and indices of every Model into one shared vertex buffer and one shared
+index buffer, so that the whole scene draws from a single vertex array. Each model keeps its
+own range of the buffers (its first index and base vertex). Every frame, the draws are grouped
+by model, and their MVP matrices are written into a per-draw attribute buffer, in that order.
+Then a command buffer is built on the CPU with one entry per model:
+	count			How many indices the model has.
+	instanceCount	How many times it's drawn this frame.
+	firstIndex		Where its indices start in the shared index buffer.
+	baseVertex		Where its vertices start in the shared vertex buffer.
+	baseInstance	Where its MVP matrices start in the per-draw buffer.
+glMultiDrawElementsIndirect then draws the whole list in one call, however many different
+models are in it. The vertex shader reads its MVP matrix from an attribute rather than a
+uniform (see IndirectVertexShader.glsl).
+The command list can also be built somewhere else, off the GL thread (see RenderPrep.h), and
+handed to Submit() ready to go.
+This needs OpenGL 4.3 or ARB_multi_draw_indirect, and 4.2 or ARB_base_instance for each command to
+find its matrices; check IsSupported() before using it.
+*/
+
+#ifndef _MESH_ARENA_H
+#define _MESH_ARENA_H
+
+#include "GLIncludes.h"
+#include "Model.h"
+#include <unordered_map>
+#include <vector>
+
+// The layout glMultiDrawElementsIndirect expects for each command. It can't be changed.
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// Everything one multi-draw call needs: a command per mesh, and the MVP matrices of every instance, in command order.
+struct RenderCommandList
+{
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<glm::mat4> instances;
+};
+
+// Where a model's geometry went in the arena, and a copy of it. The arena packs itself back together from the copies, so it never
+// has to read a model again once it has been added (it may have been deleted by then).
+struct ArenaMesh
+{
+	uint64_t modelSerial;	// Which model it came from (see Model::GetSerial()).
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint numIndices;
+	std::vector<VertexFormat> vertices;
+	std::vector<GLuint> indices;
+};
+
+class MeshArena
+{
+	bool supported;
+
+	// Every model's vertices and indices, one after another. Indices are left relative to the model's own vertices; baseVertex offsets them.
+	std::vector<VertexFormat> vertices;
+	std::vector<GLuint> indices;
+	std::vector<ArenaMesh> meshes;
+
+	// Mesh ids by model serial, rather than by address: a new model can get the address of a deleted one, but never its serial.
+	std::unordered_map<uint64_t, int> meshIds;
+
+	// The most vertices any one mesh has. Since indices are relative to their own mesh, the index buffer can be 16-bit as long as this is
+	// at most 65536, no matter how many vertices there are in total (see Model::GetIndexType()).
+	int largestMesh;
+	GLenum indexType;
+
+	// Set when the geometry has changed since it was last uploaded.
+	bool geometryChanged;
+
+	GLuint vao;
+	GLuint vbo;
+	GLuint ebo;
+	GLuint mvpBuffer;
+	GLuint commandBuffer;
+
+	// This frame's draws: which mesh, and the matrix to draw it with.
+	std::vector<int> drawMeshes;
+	std::vector<glm::mat4> drawMVPs;
+
+	// Built by Submit(). The matrices are sorted by mesh, so that each command's instances are next to each other.
+	std::vector<int> meshStarts;
+	RenderCommandList frame;
+
+	// How many commands the last submitted list had.
+	int submittedCommands;
+
+	void Append(ArenaMesh& mesh);
+	void Rebuild();
+	void Upload(const RenderCommandList& list);
+
+public:
+	MeshArena();
+	~MeshArena();
+
+	// Whether this driver can do multi-draw indirect with a base instance per command. If not, the arena does nothing, and the scene should be drawn some other way (see RenderQueue.h).
+	bool IsSupported()
+	{
+		return supported;
+	}
+
+	// Call this before deleting a model that has been drawn through the arena, or after changing its vertices or indices.
+	// Its geometry is dropped, and the rest is packed back together before the next draw. Only call this between a Submit() and the next Add().
+	// A model deleted without this is never drawn again, even if a new model gets its address, but its geometry stays in the arena.
+	void Remove(Model* model);
+
+	void Clear()
+	{
+		drawMeshes.clear();
+		drawMVPs.clear();
+	}
+
+	// Queues a model to be drawn with the given MVP matrix. A model the arena hasn't seen before gets its geometry copied in.
+	void Add(Model* model, const glm::mat4& mvp);
+
+	// Draws everything that was added since the last Clear() with one glMultiDrawElementsIndirect call, using the given program.
+	// The program has to take its MVP matrix from the attribute at location 2, not from a uniform.
+	void Submit(GLuint program);
+
+	// Draws a command list that was built elsewhere, against this arena's meshes, with one glMultiDrawElementsIndirect call.
+	void Submit(const RenderCommandList& list, GLuint program);
+
+	// The mesh id of a model, or -1 if the arena hasn't seen it yet. This only reads, so any number of threads can call it at once,
+	// as long as nothing is adding or removing meshes at the same time.
+	int FindMesh(Model* model)
+	{
+		std::unordered_map<uint64_t, int>::iterator found = meshIds.find(model->GetSerial());
+		return found != meshIds.end() ? found->second : -1;
+	}
+
+	// The mesh id of a model, copying its geometry in if the arena hasn't seen it yet. Only one thread at a time.
+	int AddMesh(Model* model);
+
+	const ArenaMesh& GetMesh(int mesh)
+	{
+		return meshes[mesh];
+	}
+	int NumMeshes()
+	{
+		return (int)meshes.size();
+	}
+	int NumCommands()
+	{
+		return submittedCommands;
+	}
+};
+
+#endif //_MESH_ARENA_H
@@ -0,0 +1,386 @@
+/*
+Title: Swept AABB-3D
+File Name: MeshOptimizer.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Reorders triangle meshes for the post-transform vertex cache (Tipsify) and for vertex fetch
+(vertices in the order the triangles first use them), and welds duplicate vertices together.
+*/
+
+#ifndef _MESH_OPTIMIZER_CPP
+#define _MESH_OPTIMIZER_CPP
+
+#include "MeshOptimizer.h"
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+void OptimizeVertexCache(GLuint* indices, int numIndices, int numVertices, int cacheSize)
+{
+	if (numIndices % 3 != 0 || numIndices == 0)
+	{
+		return;
+	}
+	int numTriangles = numIndices / 3;
+
+	// Which triangles use each vertex: vertex v's triangles are adjacency[adjacencyStart[v]] up to adjacency[adjacencyStart[v + 1]].
+	// live[v] is how many of them haven't been output yet.
+	std::vector<int> live(numVertices, 0);
+	for (int i = 0; i < numIndices; i++)
+	{
+		live[indices[i]]++;
+	}
+	std::vector<int> adjacencyStart(numVertices + 1, 0);
+	for (int v = 0; v < numVertices; v++)
+	{
+		adjacencyStart[v + 1] = adjacencyStart[v] + live[v];
+	}
+	std::vector<int> adjacency(numIndices);
+	std::vector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (int i = 0; i < numIndices; i++)
+	{
+		adjacency[fill[indices[i]]++] = i / 3;
+	}
+
+	// cacheTime[v] is when v last went into the cache. A vertex is still in the cache if fewer than cacheSize vertices have gone in since.
+	std::vector<int> cacheTime(numVertices, 0);
+	int now = cacheSize + 1;
+
+	std::vector<bool> emitted(numTriangles, false);
+	std::vector<GLuint> output;
+	output.reserve(numIndices);
+
+	// Vertices we've recently output, to fall back on when the fan we're on runs out (a "dead end").
+	std::vector<int> deadEnd;
+	std::vector<int> candidates;
+	int cursor = 0;
+
+	int fanning = 0;
+	while (fanning >= 0)
+	{
+		// Output every triangle around the fanning vertex that hasn't been output yet.
+		candidates.clear();
+		for (int a = adjacencyStart[fanning]; a < adjacencyStart[fanning + 1]; a++)
+		{
+			int triangle = adjacency[a];
+			if (emitted[triangle])
+			{
+				continue;
+			}
+			emitted[triangle] = true;
+
+			for (int corner = 0; corner < 3; corner++)
+			{
+				int v = indices[triangle * 3 + corner];
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (now - cacheTime[v] > cacheSize)
+				{
+					cacheTime[v] = now;
+					now++;
+				}
+			}
+		}
+
+		// Fan around whichever of those vertices will still be in the cache after its own remaining triangles are drawn, preferring the
+		// one that went in the longest ago (it's about to drop out). Vertices that would drop out anyway aren't worth chasing.
+		int next = -1;
+		int bestPriority = -1;
+		for (size_t c = 0; c < candidates.size(); c++)
+		{
+			int v = candidates[c];
+			if (live[v] <= 0)
+			{
+				continue;
+			}
+			int priority = 0;
+			if (now - cacheTime[v] + 2 * live[v] <= cacheSize)
+			{
+				priority = now - cacheTime[v];
+			}
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = v;
+			}
+		}
+
+		// Dead end: go back to the most recent vertex that still has triangles left, or failing that, the next one in order that does.
+		while (next < 0 && !deadEnd.empty())
+		{
+			int v = deadEnd.back();
+			deadEnd.pop_back();
+			if (live[v] > 0)
+			{
+				next = v;
+			}
+		}
+		while (next < 0 && cursor < numVertices)
+		{
+			if (live[cursor] > 0)
+			{
+				next = cursor;
+			}
+			cursor++;
+		}
+
+		fanning = next;
+	}
+
+	memcpy(indices, output.data(), sizeof(GLuint) * numIndices);
+}
+
+int OptimizeVertexFetch(VertexFormat* vertices, int numVertices, GLuint* indices, int numIndices)
+{
+	std::vector<int> remap(numVertices, -1);
+	std::vector<VertexFormat> reordered;
+	reordered.reserve(numVertices);
+
+	for (int i = 0; i < numIndices; i++)
+	{
+		GLuint v = indices[i];
+		if (remap[v] < 0)
+		{
+			remap[v] = (int)reordered.size();
+			reordered.push_back(vertices[v]);
+		}
+		indices[i] = remap[v];
+	}
+
+	if (!reordered.empty())
+	{
+		memcpy(vertices, reordered.data(), sizeof(VertexFormat) * reordered.size());
+	}
+	return (int)reordered.size();
+}
+
+// Which grid cell a position is in, and a hash of that cell for the table. With no cell size, only identical positions can match,
+// so the bits of the position itself are used as the cell.
+static void WeldCell(const glm::vec3& position, float cellSize, long long cell[3])
+{
+	if (cellSize > 0.0f)
+	{
+		cell[0] = (long long)std::floor(position.x / cellSize);
+		cell[1] = (long long)std::floor(position.y / cellSize);
+		cell[2] = (long long)std::floor(position.z / cellSize);
+	}
+	else
+	{
+		int bits[3];
+		memcpy(bits, &position.x, sizeof(bits));
+		cell[0] = bits[0];
+		cell[1] = bits[1];
+		cell[2] = bits[2];
+	}
+}
+
+static size_t WeldHash(long long x, long long y, long long z, size_t mask)
+{
+	unsigned long long h = (unsigned long long)x * 73856093ULL ^ (unsigned long long)y * 19349663ULL ^ (unsigned long long)z * 83492791ULL;
+	return (size_t)(h ^ (h >> 29)) & mask;
+}
+
+bool VerticesMatch(const VertexFormat& a, const VertexFormat& b, float positionTolerance, float colorTolerance)
+{
+	glm::vec3 dp = glm::abs(a.position - b.position);
+	glm::vec4 dc = glm::abs(a.color - b.color);
+	return dp.x <= positionTolerance && dp.y <= positionTolerance && dp.z <= positionTolerance &&
+		dc.x <= colorTolerance && dc.y <= colorTolerance && dc.z <= colorTolerance && dc.w <= colorTolerance;
+}
+
+WeldTable::WeldTable(float positionTolerance, float colorTolerance)
+{
+	this->positionTolerance = positionTolerance;
+	this->colorTolerance = colorTolerance;
+
+	// With no tolerance, only identical positions match, and they always land in the same cell, so there's no need to look in any others.
+	cellSize = std::max(positionTolerance, 0.0f);
+	reach = cellSize > 0.0f ? 1 : 0;
+}
+
+void WeldTable::Reserve(const VertexFormat* vertices, int numVertices)
+{
+	// Keep the table at least twice as big as what's in it, so the chains stay short.
+	size_t tableSize = std::max(buckets.size(), (size_t)16);
+	while (tableSize < (size_t)numVertices * 2)
+	{
+		tableSize *= 2;
+	}
+	if (tableSize == buckets.size())
+	{
+		return;
+	}
+
+	// Everything has to go into a different bucket in the bigger table, so put it all back in again.
+	int size = (int)next.size();
+	buckets.assign(tableSize, -1);
+	next.clear();
+	for (int i = 0; i < size; i++)
+	{
+		Insert(vertices, i);
+	}
+}
+
+int WeldTable::Find(const VertexFormat* vertices, const VertexFormat& vertex)
+{
+	if (buckets.empty())
+	{
+		return -1;
+	}
+
+	long long cell[3];
+	WeldCell(vertex.position, cellSize, cell);
+
+	// Anything within the tolerance is at most one cell away on each axis.
+	for (int dx = -reach; dx <= reach; dx++)
+	{
+		for (int dy = -reach; dy <= reach; dy++)
+		{
+			for (int dz = -reach; dz <= reach; dz++)
+			{
+				size_t bucket = WeldHash(cell[0] + dx, cell[1] + dy, cell[2] + dz, buckets.size() - 1);
+				for (int j = buckets[bucket]; j >= 0; j = next[j])
+				{
+					if (VerticesMatch(vertices[j], vertex, positionTolerance, colorTolerance))
+					{
+						return j;
+					}
+				}
+			}
+		}
+	}
+	return -1;
+}
+
+void WeldTable::Insert(const VertexFormat* vertices, int index)
+{
+	if ((size_t)(index + 1) * 2 > buckets.size())
+	{
+		Reserve(vertices, index + 1);
+	}
+
+	long long cell[3];
+	WeldCell(vertices[index].position, cellSize, cell);
+	size_t bucket = WeldHash(cell[0], cell[1], cell[2], buckets.size() - 1);
+	next.push_back(buckets[bucket]);
+	buckets[bucket] = index;
+}
+
+void WeldVertices(VertexFormat* vertices, int& numVertices, GLuint* indices, int& numIndices, float positionTolerance, float colorTolerance)
+{
+	if (numVertices == 0)
+	{
+		return;
+	}
+
+	// Everything in the table is a vertex we're keeping, at the spot it's been packed down to.
+	WeldTable table(positionTolerance, colorTolerance);
+	table.Reserve(vertices, numVertices);
+	std::vector<int> remap(numVertices);
+
+	int kept = 0;
+	for (int i = 0; i < numVertices; i++)
+	{
+		int match = table.Find(vertices, vertices[i]);
+		if (match >= 0)
+		{
+			remap[i] = match;
+			continue;
+		}
+
+		// A new vertex. It can only move down, onto a spot we've already finished with.
+		vertices[kept] = vertices[i];
+		table.Insert(vertices, kept);
+		remap[i] = kept;
+		kept++;
+	}
+	numVertices = kept;
+
+	for (int i = 0; i < numIndices; i++)
+	{
+		indices[i] = remap[indices[i]];
+	}
+
+	// Triangles that were smaller than the tolerance are now just a line or a point, and would never draw anything.
+	if (numIndices % 3 == 0)
+	{
+		int keptIndices = 0;
+		for (int i = 0; i < numIndices; i += 3)
+		{
+			GLuint a = indices[i];
+			GLuint b = indices[i + 1];
+			GLuint c = indices[i + 2];
+			if (a == b || b == c || c == a)
+			{
+				continue;
+			}
+			indices[keptIndices++] = a;
+			indices[keptIndices++] = b;
+			indices[keptIndices++] = c;
+		}
+		numIndices = keptIndices;
+	}
+}
+
+void OptimizeMesh(std::vector<VertexFormat>& vertices, std::vector<GLuint>& indices)
+{
+	if (vertices.empty() || indices.empty())
+	{
+		return;
+	}
+
+	// The vertex cache only helps triangles that actually share vertices, so weld first.
+	int numVertices = (int)vertices.size();
+	int numIndices = (int)indices.size();
+	WeldVertices(vertices.data(), numVertices, indices.data(), numIndices);
+	vertices.resize(numVertices);
+	indices.resize(numIndices);
+
+	OptimizeVertexCache(indices.data(), (int)indices.size(), (int)vertices.size());
+	vertices.resize(OptimizeVertexFetch(vertices.data(), (int)vertices.size(), indices.data(), (int)indices.size()));
+}
+
+float AverageCacheMissRatio(const GLuint* indices, int numIndices, int numVertices, int cacheSize)
+{
+	if (numIndices < 3)
+	{
+		return 0.0f;
+	}
+
+	// The same timestamp trick as above: a vertex is in the cache if fewer than cacheSize misses have happened since it went in.
+	std::vector<int> cacheTime(numVertices, -cacheSize - 1);
+	int misses = 0;
+	for (int i = 0; i < numIndices; i++)
+	{
+		GLuint v = indices[i];
+		if (misses - cacheTime[v] > cacheSize)
+		{
+			cacheTime[v] = misses;
+			misses++;
+		}
+	}
+	return (float)misses / (float)(numIndices / 3);
+}
+
+#endif // _MESH_OPTIMIZER_CPP
@@ -0,0 +1,111 @@
+/*
+Title: Swept AABB-3D
+File Name: MeshOptimizer.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Reorders a triangle mesh so the GPU does less work drawing it, without changing what it looks
+like. The GPU keeps the last few transformed vertices in a small cache, so a vertex shared by
+neighbouring triangles only gets transformed once if those triangles are drawn close together.
+OptimizeVertexCache() reorders the triangles with Tipsify (Sander, Nehab and Barczak, "Fast
+Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007): it fans out around one
+vertex at a time, and picks the next vertex to fan around from the ones still in the cache.
+It runs in linear time, which matters for meshes that are loaded while the game is running.
+OptimizeVertexFetch() then renumbers the vertices in the order the triangles first use them,
+so the vertex buffer is read front to back rather than jumping around, and drops any vertices
+no triangle uses.
+WeldVertices() merges vertices that are the same (or close enough) into one. Meshes from other
+tools often repeat a vertex for every triangle that uses it, which wastes memory, makes
+everything that loops over the vertices slower, and stops the vertex cache from helping at all.
+It hashes every vertex into a grid of cells the size of the tolerance, so that each vertex only
+has to be compared against the ones in the cells around it.
+*/
+
+#ifndef _MESH_OPTIMIZER_H
+#define _MESH_OPTIMIZER_H
+
+#include "GLIncludes.h"
+#include <vector>
+
+// The cache size to optimize for. Real hardware varies; anything from about 12 to 32 gives most of the benefit on all of it.
+const int VERTEX_CACHE_SIZE = 16;
+
+// How far apart two vertices can be, on every axis, and still be welded together, and the same for each channel of their colors.
+// Half a step of an 8-bit color channel still looks the same once it's on screen.
+const float WELD_POSITION_TOLERANCE = 0.00001f;
+const float WELD_COLOR_TOLERANCE = 0.5f / 255.0f;
+
+// Whether two vertices are within the tolerances of each other.
+bool VerticesMatch(const VertexFormat& a, const VertexFormat& b, float positionTolerance = WELD_POSITION_TOLERANCE, float colorTolerance = WELD_COLOR_TOLERANCE);
+
+// Finds vertices that are within the tolerances of a given one, by hashing them into a grid of cells the size of the position tolerance.
+// Vertices are added by their index in an array the caller keeps; they have to be added in order, starting from 0, and mustn't move.
+class WeldTable
+{
+	float positionTolerance;
+	float colorTolerance;
+	float cellSize;
+	int reach;
+
+	// The first vertex in each bucket, and the next vertex in the same bucket as each vertex (-1 for none).
+	std::vector<int> buckets;
+	std::vector<int> next;
+
+public:
+	WeldTable(float positionTolerance = WELD_POSITION_TOLERANCE, float colorTolerance = WELD_COLOR_TOLERANCE);
+
+	// Makes room for numVertices vertices, so that adding them doesn't have to grow the table.
+	void Reserve(const VertexFormat* vertices, int numVertices);
+
+	// The index of an added vertex that matches vertex, or -1 if there isn't one.
+	int Find(const VertexFormat* vertices, const VertexFormat& vertex);
+
+	// Adds vertices[index]. index has to be Size().
+	void Insert(const VertexFormat* vertices, int index);
+
+	// How many vertices have been added.
+	int Size()
+	{
+		return (int)next.size();
+	}
+};
+
+// Merges vertices within the tolerances of each other, keeping the first of them, and points the indices at whichever vertex was kept.
+// The vertices that are left are packed to the front, in their original order. Triangles that end up with two corners on the same vertex
+// are taken out (as long as numIndices is a multiple of three). Updates numVertices and numIndices to match.
+void WeldVertices(VertexFormat* vertices, int& numVertices, GLuint* indices, int& numIndices,
+	float positionTolerance = WELD_POSITION_TOLERANCE, float colorTolerance = WELD_COLOR_TOLERANCE);
+
+// Reorders the triangles (every three indices) of a triangle list for the post-transform vertex cache. Does nothing if numIndices isn't a multiple of three.
+void OptimizeVertexCache(GLuint* indices, int numIndices, int numVertices, int cacheSize = VERTEX_CACHE_SIZE);
+
+// Renumbers the vertices in the order the indices first use them, moving the vertices to match. Returns the new number of vertices,
+// which is less than numVertices if some of them were never used.
+int OptimizeVertexFetch(VertexFormat* vertices, int numVertices, GLuint* indices, int numIndices);
+
+// All of the above: welds, then reorders for the vertex cache, then for vertex fetch.
+void OptimizeMesh(std::vector<VertexFormat>& vertices, std::vector<GLuint>& indices);
+
+// The average number of vertices transformed per triangle with a first-in, first-out cache of cacheSize vertices. 3 is the worst it can be,
+// and about 0.5 to 0.7 is as good as it gets for a regular mesh.
+float AverageCacheMissRatio(const GLuint* indices, int numIndices, int numVertices, int cacheSize = VERTEX_CACHE_SIZE);
+
+#endif //_MESH_OPTIMIZER_H
@@ -39,12 +39,32 @@ object passes through or into the middle of the colliding object).
 #define _MODEL_CPP
 
 #include "Model.h"
+#include "MeshOptimizer.h"
+#include "CollisionProxy.h"
+#include <vector>
+
+// Handed out to every model in turn (see Model::GetSerial()).
+static std::atomic<uint64_t> nextSerial(1);
 
 // Creates a new model with a given vertices and indices.
 // If no vertices are passed in (numVerts = 0) then it will skip initialization completely.
 // If no indices are passed in (numInds = 0) but vertices are, it will set the indices equal to the vertices in order. (So just 0, 1, 2, 3, 4, etc.)
-Model::Model(int numVerts, VertexFormat* verts, int numInds, GLuint* inds)
+// Duplicate vertices are welded together (see MeshOptimizer.h), so the model may end up with fewer vertices and indices than it was given.
+Model::Model(int numVerts, VertexFormat* verts, int numInds, GLuint* inds, bool createBuffers, int numProxy, const glm::vec3* proxy)
 {
+	vertices = nullptr;
+	indices = nullptr;
+	numVertices = 0;
+	numIndices = 0;
+	vbo = 0;
+	ebo = 0;
+	vao = 0;
+	serial = nextSerial++;
+	indexType = GL_UNSIGNED_INT;
+	numCollisionVertices = 0;
+	collisionVertices = nullptr;
+	collisionProxyDirty = false;
+
 	if (numVerts > 0)
 	{
 		// Allocate space for the size of the vertices array.
@@ -82,8 +102,17 @@ Model::Model(int numVerts, VertexFormat* verts, int numInds, GLuint* inds)
 			numIndices = numVerts;
 		}
 
+		// Merge any repeated vertices, so that everything that loops over them (calculating AABBs, uploading) has less to do.
+		// The arrays keep their original size; only the counts shrink.
+		WeldVertices(vertices, numVertices, indices, numIndices);
+
+		SetCollisionProxy(numProxy, proxy);
+
 		// Initialize the buffer.
-		InitBuffer();
+		if (createBuffers)
+		{
+			InitBuffer();
+		}
 	}
 }
 
@@ -92,12 +121,18 @@ Model::~Model()
 	// Free up any remaining data.
 	free(vertices);
 	free(indices);
+	free(collisionVertices);
 
 	numVertices = 0;
 	numIndices = 0;
 
-	glDeleteBuffers(1, &vbo);
-	glDeleteBuffers(1, &ebo);
+	// A model that never made any buffers has nothing to delete, and may not even have an OpenGL context to delete them with.
+	if (vbo != 0)
+	{
+		glDeleteVertexArrays(1, &vao);
+		glDeleteBuffers(1, &vbo);
+		glDeleteBuffers(1, &ebo);
+	}
 }
 
 void Model::InitBuffer()
@@ -108,6 +143,12 @@ void Model::InitBuffer()
 	glGenBuffers(1, &vbo);
 	glGenBuffers(1, &ebo);
 
+	// Everything below, up to unbinding it at the end, is recorded into this model's vertex array object: the element buffer binding
+	// and the attribute layout (which also remembers the vertex buffer it was set up with). Without one, all of it would be global state,
+	// and whichever model set it up last would be the one every model draws with.
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
 	//// Binds a named buffer object to the specified buffer binding point. Give it a target (GL_ARRAY_BUFFER) to determine where to bind the buffer.
 	//// There are several different target parameters, GL_ARRAY_BUFFER is for vertex attributes, feel free to Google the others to find out what else there is.
 	//// The second paramter is the buffer object reference. If no buffer object with the given name exists, it will create one.
@@ -126,7 +167,7 @@ void Model::InitBuffer()
 	//// will be modified repeatedly, and used a lot. Draw means that the data is modified by the application, and used as a source for GL drawing. Read means the data is modified by 
 	//// reading data from GL, and used to return that data when queried by the application. Copy means that the data is modified by reading from the GL, and used as a source for drawing.
 	glBufferData(GL_ARRAY_BUFFER, sizeof(VertexFormat) * numVertices, vertices, GL_STATIC_DRAW);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * numIndices, indices, GL_STATIC_DRAW);
+	UploadIndices();
 
 	//// By default, all client-side capabilities are disabled, including all generic vertex attribute arrays.
 	//// When enabled, the values in a generic vertex attribute array will be accessed and used for rendering when calls are made to vertex array commands (like glDrawArrays/glDrawElements)
@@ -147,10 +188,23 @@ void Model::InitBuffer()
 	//// This is our color attribute, so the offset is 0, and the size is 4 since there are 4 floats for color.
 	glEnableVertexAttribArray(1);
 	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(VertexFormat), (void*)0);
+
+	// Unbind it, so nothing else that gets set up afterwards ends up recorded into it by accident.
+	glBindVertexArray(0);
 }
 
 void Model::UpdateBuffer()
 {
+	// Models that were only made for collision have no buffers to update.
+	if (vao == 0)
+	{
+		return;
+	}
+
+	// The element buffer binding belongs to the vertex array object, so bind ours to get at it. The vertex buffer has to be bound on its own.
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
 	//// Creates and initializes a buffer object's data.
 	//// First parameter is the target, second parameter is the size of the buffer, third parameter is a pointer to the data that will copied into the buffer, and fourth parameter is the 
 	//// expected usage pattern of the data. Possible usage patterns: GL_STREAM_DRAW, GL_STREAM_READ, GL_STREAM_COPY, GL_STATIC_DRAW, GL_STATIC_READ, GL_STATIC_COPY, GL_DYNAMIC_DRAW, 
@@ -159,10 +213,83 @@ void Model::UpdateBuffer()
 	//// will be modified repeatedly, and used a lot. Draw means that the data is modified by the application, and used as a source for GL drawing. Read means the data is modified by 
 	//// reading data from GL, and used to return that data when queried by the application. Copy means that the data is modified by reading from the GL, and used as a source for drawing.
 	glBufferData(GL_ARRAY_BUFFER, sizeof(VertexFormat) * numVertices, vertices, GL_STATIC_DRAW);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * numIndices, indices, GL_STATIC_DRAW);
+	UploadIndices();
+
+	glBindVertexArray(0);
+}
+
+void Model::UploadIndices()
+{
+	// With 65536 vertices or fewer, every index fits in a GLushort. That halves the element buffer, and the bandwidth the GPU spends reading it.
+	if (numVertices <= 65536)
+	{
+		indexType = GL_UNSIGNED_SHORT;
+
+		std::vector<GLushort> shortIndices(numIndices);
+		for (int i = 0; i < numIndices; i++)
+		{
+			shortIndices[i] = (GLushort)indices[i];
+		}
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * numIndices, shortIndices.data(), GL_STATIC_DRAW);
+	}
+	else
+	{
+		indexType = GL_UNSIGNED_INT;
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * numIndices, indices, GL_STATIC_DRAW);
+	}
+}
+
+void Model::SetCollisionProxy(int numProxy, const glm::vec3* proxy)
+{
+	std::vector<glm::vec3> built;
+	if (numProxy == 0)
+	{
+		built = BuildCollisionProxy(vertices, numVertices);
+		numProxy = (int)built.size();
+		proxy = built.data();
+	}
+
+	free(collisionVertices);
+	collisionVertices = (glm::vec3*)malloc(sizeof(glm::vec3) * numProxy);
+	memcpy(collisionVertices, proxy, sizeof(glm::vec3) * numProxy);
+	numCollisionVertices = numProxy;
+}
+
+void Model::UpdateCollisionProxy()
+{
+	if (!collisionProxyDirty)
+	{
+		return;
+	}
+
+	// Whoever gets the lock first does the rebuild; anyone who was waiting on it finds it already done.
+	std::lock_guard<std::mutex> lock(collisionProxyMutex);
+	if (collisionProxyDirty)
+	{
+		SetCollisionProxy(0, nullptr);
+		collisionProxyDirty = false;
+	}
+}
+
+int Model::NumCollisionVertices()
+{
+	UpdateCollisionProxy();
+	return numCollisionVertices;
+}
+
+glm::vec3* Model::CollisionVertices()
+{
+	UpdateCollisionProxy();
+	return collisionVertices;
 }
 
 void Model::Draw()
+{
+	Bind();
+	DrawBound();
+}
+
+void Model::DrawBound()
 {
 	// Draw vertices from the buffer as GL_TRIANGLES
 	// There are several different drawing modes, GL_TRIANGLES takes every 3 vertices and makes them a triangle.
@@ -178,18 +305,31 @@ void Model::Draw()
 	// For reference, GL_TRIANGLE_STRIP would take each additional vertex after the first 3 and consider that a 
 	// triangle with the previous 2 vertices (so you could make 2 triangles with 4 vertices)
 	// The second parameter is the number of vertices, the third parameter is the type of the element buffer data, and the fourth parameter is the offset.
-	glDrawElements(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, 0);
+	glDrawElements(GL_TRIANGLES, numIndices, indexType, 0);
 }
 
 GLuint Model::AddVertex(VertexFormat* vert)
 {
+	// Catch the weld table up with the vertices we already have (the ones from the constructor, the first time through).
+	while (weldTable.Size() < numVertices)
+	{
+		weldTable.Insert(vertices, weldTable.Size());
+	}
+
+	// If we already have this vertex (or one close enough to it), hand back that one rather than storing it twice.
+	int match = weldTable.Find(vertices, *vert);
+	if (match >= 0)
+	{
+		return match;
+	}
+
 	if (numVertices > 0)
 	{
 		// Allocate space equivalent to our current vertices array.
 		VertexFormat* tempVerts = (VertexFormat*)malloc(sizeof(VertexFormat) * numVertices);
 		
 		// Copy our current vertices array into our temporary array.
-		memcpy(tempVerts, vertices, numVertices);
+		memcpy(tempVerts, vertices, sizeof(VertexFormat) * numVertices);
 
 		// Increase the number of vertices count by 1.
 		numVertices++;
@@ -201,16 +341,18 @@ GLuint Model::AddVertex(VertexFormat* vert)
 		vertices = (VertexFormat*)malloc(sizeof(VertexFormat) * numVertices);
 
 		// Copy the data from the temporary array back into the vertices array.
-		memcpy(vertices, tempVerts, numVertices - 1);
+		memcpy(vertices, tempVerts, sizeof(VertexFormat) * (numVertices - 1));
 
 		// Free the temporary array.
 		free(tempVerts);
 
 		// Set the last value in the vertices array to the new vertex.
 		vertices[numVertices - 1] = *vert;
+		weldTable.Insert(vertices, numVertices - 1);
 
-		// Update our buffer to match this change.
+		// Update our buffer to match this change, and let the collision proxy know it needs rebuilding.
 		UpdateBuffer();
+		collisionProxyDirty = true;
 
 		// Return the index reference to this vertex.
 		return numVertices - 1;
@@ -222,12 +364,14 @@ GLuint Model::AddVertex(VertexFormat* vert)
 
 		// Set the value to the new vertex.
 		vertices[0] = *vert;
+		weldTable.Insert(vertices, 0);
 
 		// Set the number of vertices to 1.
 		numVertices = 1;
 
-		// Initialize the buffer.
+		// Initialize the buffer, and let the collision proxy know it needs building.
 		InitBuffer();
+		collisionProxyDirty = true;
 
 		// Return the index reference to this vertex (zero).
 		return 0;
@@ -241,7 +385,7 @@ void Model::AddIndex(GLuint index)
 		GLuint* tempInds = (GLuint*)malloc(sizeof(GLuint) * numIndices);
 
 		// Copy our current indices array into our temporary array.
-		memcpy(tempInds, indices, numIndices);
+		memcpy(tempInds, indices, sizeof(GLuint) * numIndices);
 
 		// Increase the number of indices count by 1.
 		numIndices++;
@@ -253,7 +397,7 @@ void Model::AddIndex(GLuint index)
 		indices = (GLuint*)malloc(sizeof(GLuint) * numIndices);
 
 		// Copy the data from the temporary array back into the indices array.
-		memcpy(indices, tempInds, numIndices - 1);
+		memcpy(indices, tempInds, sizeof(GLuint) * (numIndices - 1));
 
 		// Free the temporary array.
 		free(tempInds);
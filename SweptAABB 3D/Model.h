@@ -39,6 +39,9 @@ object passes through or into the middle of the colliding object).
 #define _MODEL_H
 
 #include "GLIncludes.h"
+#include "MeshOptimizer.h"
+#include <atomic>
+#include <mutex>
 
 class Model
 {
@@ -49,24 +52,79 @@ private:
 	int numIndices;
 	GLuint* indices;
 
+	// GL_UNSIGNED_SHORT if every index fits in 16 bits, so the element buffer is half the size. Otherwise GL_UNSIGNED_INT.
+	// The indices kept here are always GLuint either way; only the copy in the element buffer is narrowed.
+	GLenum indexType;
+
+	// A simpler convex shape around the vertices, which collision uses instead of them (see CollisionProxy.h). Rendering still uses the vertices.
+	int numCollisionVertices;
+	glm::vec3* collisionVertices;
+
+	// AddVertex only marks the proxy as out of date, since building one is far too slow to do for every vertex.
+	// It's rebuilt the next time someone asks for it, which can be from several physics jobs at once, hence the lock.
+	std::atomic<bool> collisionProxyDirty;
+	std::mutex collisionProxyMutex;
+
+	// Lets AddVertex find a matching vertex without comparing against every one. It's filled in lazily, the first time AddVertex is called.
+	WeldTable weldTable;
+
 	GLuint vbo;
 	GLuint ebo;
 
+	// The vertex array object remembers which buffers and attribute layout this model uses, so drawing it only takes one bind.
+	GLuint vao;
+
+	// A number no other model has ever had, so code that keeps things per model (see MeshArena) can't mistake a new model for a deleted one
+	// that happened to have the same address.
+	uint64_t serial;
+
 	//GLuint shaderProgram;
 	//GLuint m_Buffer;
 
+	// Picks the index type and uploads the indices into the element buffer, which must be bound.
+	void UploadIndices();
+
+	// Copies proxy in as the collision proxy, or builds one from the vertices if numProxy is 0.
+	void SetCollisionProxy(int numProxy, const glm::vec3* proxy);
+
+	// Rebuilds the collision proxy if vertices have been added since it was last built.
+	void UpdateCollisionProxy();
+
 public:
-	Model(int numVerts = 0, VertexFormat* verts = nullptr, int numInds = 0, GLuint* inds = nullptr);
+	// Pass false for createBuffers for a model that is only used for collision (on a server with no window, say). It never touches OpenGL.
+	// A collision proxy that was built earlier (and saved with the mesh, say) can be passed in, so it doesn't have to be built again.
+	Model(int numVerts = 0, VertexFormat* verts = nullptr, int numInds = 0, GLuint* inds = nullptr, bool createBuffers = true,
+		int numProxy = 0, const glm::vec3* proxy = nullptr);
 	~Model();
 
+	// Returns the index of the vertex, which is an existing one if the model already has a vertex that matches it (see VerticesMatch()).
 	GLuint AddVertex(VertexFormat*);
 	void AddIndex(GLuint);
 
 	void InitBuffer();
 	void UpdateBuffer();
 
+	// Binds the model's vertex array, then draws it.
 	void Draw();
 
+	// Draws without binding anything, for when the model's vertex array is already bound (see RenderQueue).
+	void DrawBound();
+
+	void Bind()
+	{
+		glBindVertexArray(vao);
+	}
+
+	uint64_t GetSerial()
+	{
+		return serial;
+	}
+
+	GLuint GetVAO()
+	{
+		return vao;
+	}
+
 	// Our get variables.
 	int NumVertices()
 	{
@@ -84,6 +142,14 @@ public:
 	{
 		return indices;
 	}
+	GLenum GetIndexType()
+	{
+		return indexType;
+	}
+
+	// Everything on the CPU side that asks how far the model reaches (AABBs and so on) should use these rather than Vertices().
+	int NumCollisionVertices();
+	glm::vec3* CollisionVertices();
 
 	/*Model(int p_nVertices = 3, float _size = 1.0f, float _originX = 0.0f, float _originY = 0.0f, float _originZ = 0.0f)
 	{
@@ -0,0 +1,227 @@
+/*
+Title: Swept AABB-3D
+File Name: NumaTopology.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Describes the NUMA (Non-Uniform Memory Access) layout of the machine we are running on.
+On a multi-socket machine each socket has its own bank of memory, and reading memory that
+belongs to another socket is noticeably slower than reading local memory. This file finds
+out which CPUs belong to which memory node, so that the job system can keep a worker (and the
+data that worker touches) on the same node.
+*/
+
+#ifndef _NUMA_TOPOLOGY_CPP
+#define _NUMA_TOPOLOGY_CPP
+
+#include "NumaTopology.h"
+#include <thread>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+NumaTopology::NumaTopology()
+{
+#ifdef _WIN32
+	// Windows tells us the highest node number, and then a processor mask per node.
+	// Note: This only looks at the first processor group (64 CPUs), which covers the machines we run on.
+	ULONG highestNode = 0;
+	if (GetNumaHighestNodeNumber(&highestNode))
+	{
+		for (ULONG n = 0; n <= highestNode; n++)
+		{
+			ULONGLONG mask = 0;
+			if (!GetNumaNodeProcessorMask((UCHAR)n, &mask) || mask == 0)
+			{
+				continue;
+			}
+
+			NumaNode node;
+			node.id = (int)n;
+			for (int cpu = 0; cpu < 64; cpu++)
+			{
+				if (mask & (1ULL << cpu))
+				{
+					node.cpus.push_back(cpu);
+				}
+			}
+			nodes.push_back(node);
+		}
+	}
+#elif defined(__linux__)
+	// Linux exposes every node as /sys/devices/system/node/nodeN, with a "cpulist" file inside.
+	// Node numbers can have gaps (for example on machines with memory-only nodes), so we keep looking for a while after a miss.
+	int misses = 0;
+	for (int n = 0; misses < 8; n++)
+	{
+		std::ifstream file("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist");
+		if (!file.good())
+		{
+			misses++;
+			continue;
+		}
+
+		std::string list;
+		std::getline(file, list);
+
+		NumaNode node;
+		node.id = n;
+		node.cpus = ParseCpuList(list.c_str());
+
+		// Memory-only nodes have no CPUs, and there is nothing to schedule on them.
+		if (!node.cpus.empty())
+		{
+			nodes.push_back(node);
+		}
+	}
+#endif
+
+	// If we couldn't find anything (or the platform doesn't support NUMA), treat the whole machine as one node.
+	if (nodes.empty())
+	{
+		NumaNode node;
+		int numCpus = (int)std::thread::hardware_concurrency();
+		if (numCpus < 1)
+		{
+			numCpus = 1;
+		}
+		for (int cpu = 0; cpu < numCpus; cpu++)
+		{
+			node.cpus.push_back(cpu);
+		}
+		nodes.push_back(node);
+	}
+}
+
+int NumaTopology::NumCpus()
+{
+	int count = 0;
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		count += (int)nodes[i].cpus.size();
+	}
+	return count;
+}
+
+int NumaTopology::NodeOfCpu(int cpu)
+{
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		for (size_t j = 0; j < nodes[i].cpus.size(); j++)
+		{
+			if (nodes[i].cpus[j] == cpu)
+			{
+				return (int)i;
+			}
+		}
+	}
+	return 0;
+}
+
+bool NumaTopology::BindCurrentThreadToNode(int nodeIndex)
+{
+	if (nodeIndex < 0 || nodeIndex >= (int)nodes.size())
+	{
+		return false;
+	}
+	return BindCurrentThreadToCpus(nodes[nodeIndex].cpus);
+}
+
+bool NumaTopology::BindCurrentThreadToCpus(const std::vector<int>& cpus)
+{
+	if (cpus.empty())
+	{
+		return false;
+	}
+
+#ifdef _WIN32
+	DWORD_PTR mask = 0;
+	for (size_t i = 0; i < cpus.size(); i++)
+	{
+		if (cpus[i] < (int)(sizeof(DWORD_PTR) * 8))
+		{
+			mask |= ((DWORD_PTR)1) << cpus[i];
+		}
+	}
+	return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (size_t i = 0; i < cpus.size(); i++)
+	{
+		if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE)
+		{
+			CPU_SET(cpus[i], &set);
+		}
+	}
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	// No affinity support on this platform, the scheduler will place the thread wherever it likes.
+	return false;
+#endif
+}
+
+std::vector<int> NumaTopology::ParseCpuList(const char* list)
+{
+	std::vector<int> cpus;
+	const char* c = list;
+
+	while (*c != '\0')
+	{
+		// Skip anything that isn't the start of a number (commas, whitespace, newlines).
+		if (*c < '0' || *c > '9')
+		{
+			c++;
+			continue;
+		}
+
+		char* end;
+		int first = (int)strtol(c, &end, 10);
+		int last = first;
+
+		// A dash means this is a range, like "8-11".
+		if (*end == '-')
+		{
+			last = (int)strtol(end + 1, &end, 10);
+		}
+
+		for (int cpu = first; cpu <= last; cpu++)
+		{
+			cpus.push_back(cpu);
+		}
+
+		c = end;
+	}
+
+	return cpus;
+}
+
+#endif // _NUMA_TOPOLOGY_CPP
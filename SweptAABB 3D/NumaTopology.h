@@ -0,0 +1,83 @@
+/*
+Title: Swept AABB-3D
+File Name: NumaTopology.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Describes the NUMA (Non-Uniform Memory Access) layout of the machine we are running on.
+On a multi-socket machine each socket has its own bank of memory, and reading memory that
+belongs to another socket is noticeably slower than reading local memory. This file finds
+out which CPUs belong to which memory node, so that the job system can keep a worker (and the
+data that worker touches) on the same node.
+*/
+
+#ifndef _NUMA_TOPOLOGY_H
+#define _NUMA_TOPOLOGY_H
+
+#include <vector>
+
+// A single memory node and the logical CPUs that sit next to it.
+struct NumaNode
+{
+	int id;					// The operating system's number for this node.
+	std::vector<int> cpus;	// Logical CPU indices that belong to this node.
+
+	NumaNode()
+	{
+		id = 0;
+	}
+};
+
+class NumaTopology
+{
+	std::vector<NumaNode> nodes;
+
+public:
+	// Detects the topology of the current machine.
+	// If the platform doesn't expose NUMA information we report a single node holding every CPU.
+	NumaTopology();
+
+	int NumNodes()
+	{
+		return (int)nodes.size();
+	}
+	NumaNode& GetNode(int index)
+	{
+		return nodes[index];
+	}
+
+	// Total number of logical CPUs across all nodes.
+	int NumCpus();
+
+	// Returns the index (into our node list, not the OS id) of the node that owns the given CPU, or 0 if it's unknown.
+	int NodeOfCpu(int cpu);
+
+	// Pins the calling thread to the CPUs of the given node. Returns false if the platform refused.
+	bool BindCurrentThreadToNode(int nodeIndex);
+
+	// Pins the calling thread to a specific set of logical CPUs. Returns false if the platform refused.
+	static bool BindCurrentThreadToCpus(const std::vector<int>& cpus);
+
+	// Parses a Linux style CPU list such as "0-3,8-11" into individual CPU indices.
+	static std::vector<int> ParseCpuList(const char* list);
+};
+
+#endif //_NUMA_TOPOLOGY_H
@@ -0,0 +1,134 @@
+/*
+Title: Swept AABB-3D
+File Name: PhysicsProtocol.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+The binary protocol spoken by the physics service (see PhysicsService.h). This header only
+depends on ByteStream.h, so other programs can include the two of them on their own to talk
+to the service without linking the simulator.
+
+Every message, in either direction, is a 12 byte header followed by a payload:
+	uint32 length		Bytes of payload that follow the header.
+	uint16 type			One of MessageType. Replies have MESSAGE_REPLY added.
+	uint16 flags		Unused, send 0.
+	uint32 requestId	Picked by the client, and copied into the reply.
+All values are little-endian; floats are 32-bit IEEE, and a vec3 is three floats.
+A client can send as many requests as it likes without waiting for replies (pipelining).
+Requests are handled in the order they arrive, and replies come back in the same order.
+Every reply payload starts with a uint32 status (one of ReplyStatus). The rest of the reply
+is only there if the status is STATUS_OK.
+*/
+
+#ifndef _PHYSICS_PROTOCOL_H
+#define _PHYSICS_PROTOCOL_H
+
+#include "ByteStream.h"
+#include <cstdint>
+
+const uint32_t PROTOCOL_VERSION = 1;
+
+// Messages bigger than this are refused, and the connection is closed.
+const uint32_t MAX_MESSAGE_LENGTH = 1 << 20;
+
+// The biggest world a client can ask for: regions along each axis, bodies per region, and bodies in total (regions times bodies per region).
+const uint32_t MAX_WORLD_REGIONS = 64;
+const uint32_t MAX_BODIES_PER_REGION = 1 << 16;
+const uint32_t MAX_WORLD_BODIES = 1 << 18;
+
+// The most steps one MESSAGE_STEP request can ask for, so that one request can't keep the service busy for hours.
+const uint32_t MAX_STEPS_PER_REQUEST = 1000;
+
+// Pass as the world of a MESSAGE_STEP request to step every world.
+const uint32_t ALL_WORLDS = 0xFFFFFFFF;
+
+// Request payloads, and what the reply has after its status.
+enum MessageType
+{
+	// Request: nothing. Reply: uint32 version, uint32 name length, name bytes, uint32 shared memory size.
+	// The name is the shared memory object (for shm_open) that this connection's MESSAGE_READ_STATE replies are written to.
+	MESSAGE_HELLO = 1,
+
+	// Request: vec3 bounds min, vec3 bounds max, uint32 regions x, y, z, uint32 bodies per region, uint32 priority (1, 2 or 4),
+	// float step budget in ms (more than 0). Reply: uint32 world.
+	MESSAGE_CREATE_WORLD = 2,
+
+	// Request: uint32 world. Reply: nothing.
+	MESSAGE_DESTROY_WORLD = 3,
+
+	// Request: uint32 world, vec3 position, vec3 velocity, vec3 size (the body is a box). Reply: int32 body.
+	MESSAGE_CREATE_BODY = 4,
+
+	// Request: uint32 world (or ALL_WORLDS), float dt, uint32 steps. Reply: uint32 steps taken.
+	MESSAGE_STEP = 5,
+
+	// Request: uint32 world, int32 body, vec3 value. Reply: nothing. The change is applied at the start of the world's next step.
+	MESSAGE_SET_VELOCITY = 6,
+	MESSAGE_SET_POSITION = 7,
+	MESSAGE_ADD_ACCELERATION = 8,
+
+	// Request: uint32 world, vec3 origin, vec3 direction, float max distance. Reply: int32 body (-1 for a miss), float distance, vec3 point.
+	MESSAGE_RAYCAST = 9,
+
+	// Request: uint32 world, vec3 min, vec3 max. Reply: uint32 count, then count int32 bodies.
+	MESSAGE_OVERLAP = 10,
+
+	// Request: uint32 world. Reply: uint32 offset, uint32 bytes, uint32 count, uint64 step.
+	// The state of every body is written to the shared memory region at offset, as count int32 ids followed by twelve arrays of count
+	// floats: position x, y, z, velocity x, y, z, AABB min x, y, z and AABB max x, y, z. The region is split in two halves that replies
+	// take turns using, so a reply's data stays valid until the reply after the next MESSAGE_READ_STATE.
+	MESSAGE_READ_STATE = 11
+};
+
+const uint16_t MESSAGE_REPLY = 0x8000;
+
+enum ReplyStatus
+{
+	STATUS_OK = 0,
+	STATUS_MALFORMED = 1,		// The payload was too short for the request type, or a value in it is out of range (see the limits above).
+	STATUS_UNKNOWN_TYPE = 2,
+	STATUS_NO_SUCH_WORLD = 3,
+	STATUS_NO_SUCH_BODY = 4,
+	STATUS_FULL = 5,			// The world has no room for another body there.
+	STATUS_TOO_LARGE = 6,		// The state doesn't fit in the shared memory region.
+	STATUS_UNAVAILABLE = 7		// The service couldn't set up what the request needs (e.g. shared memory).
+};
+
+const int MESSAGE_HEADER_SIZE = 12;
+
+struct MessageHeader
+{
+	uint32_t length;
+	uint16_t type;
+	uint16_t flags;
+	uint32_t requestId;
+};
+
+// Writes a message header, in protocol order.
+inline void WriteMessageHeader(MessageWriter& writer, uint32_t length, uint16_t type, uint32_t requestId)
+{
+	writer.U32(length);
+	writer.U16(type);
+	writer.U16(0);
+	writer.U32(requestId);
+}
+
+#endif //_PHYSICS_PROTOCOL_H
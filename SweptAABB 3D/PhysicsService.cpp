@@ -0,0 +1,791 @@
+/*
+Title: Swept AABB-3D
+File Name: PhysicsService.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Runs the simulator as a service for other processes on the same machine. Clients connect to a
+Unix domain socket and send requests in the binary protocol described in PhysicsProtocol.h:
+create worlds and bodies, step, change bodies, and run queries. Reading the state of every
+body at once doesn't go through the socket; the service writes it to a shared memory region
+that each connection gets for itself, and the reply only says where to look.
+This is only available on POSIX systems (Linux, macOS); on Windows, Start() fails.
+*/
+
+#ifndef _PHYSICS_SERVICE_CPP
+#define _PHYSICS_SERVICE_CPP
+
+#include "PhysicsService.h"
+#include <iostream>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+
+#ifdef PHYSICS_SERVICE_POSIX
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <csignal>
+#endif
+
+// Don't let a client hanging up on us kill the process with SIGPIPE. Linux has a flag for that on send(); elsewhere we ignore the signal in Start().
+#if defined(PHYSICS_SERVICE_POSIX) && defined(MSG_NOSIGNAL)
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+// How many bytes of replies a connection can have waiting to be sent before we stop handling its requests, and how many bytes of requests
+// we read ahead of handling them. The input has room for the largest message there can be, so one is never left waiting for the rest of itself.
+static const size_t MAX_PENDING_OUTPUT = 4 << 20;
+static const size_t MAX_PENDING_INPUT = MAX_MESSAGE_LENGTH + MESSAGE_HEADER_SIZE;
+
+PhysicsService::PhysicsService(WorldRegistry* registry, size_t sharedMemoryBytes, int maxClients)
+{
+	worlds = registry;
+	sharedMemorySize = sharedMemoryBytes;
+	maxConnections = maxClients;
+
+	listenSocket = -1;
+	wakePipe[0] = -1;
+	wakePipe[1] = -1;
+	running = false;
+	nextConnection = 0;
+
+	// A unit cube, centered on the origin. Only its corners matter for the AABB, and it's never drawn, so it doesn't need any buffers.
+	VertexFormat corners[8];
+	for (int i = 0; i < 8; i++)
+	{
+		corners[i] = VertexFormat(glm::vec3(i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f, i & 4 ? 0.5f : -0.5f), glm::vec4(1.0f));
+	}
+	box = new Model(8, corners, 0, nullptr, false);
+}
+
+PhysicsService::~PhysicsService()
+{
+	while (!connections.empty())
+	{
+		CloseConnection(connections.back());
+		connections.pop_back();
+	}
+
+#ifdef PHYSICS_SERVICE_POSIX
+	if (listenSocket >= 0)
+	{
+		close(listenSocket);
+		unlink(socketPath.c_str());
+	}
+	if (wakePipe[0] >= 0)
+	{
+		close(wakePipe[0]);
+		close(wakePipe[1]);
+	}
+#endif
+
+	// The bodies made from the box belong to worlds in the registry, which outlives us. Nothing steps them after this, so they never look at it again.
+	delete(box);
+}
+
+bool PhysicsService::Start(const std::string& path)
+{
+#ifdef PHYSICS_SERVICE_POSIX
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+
+	if (path.size() >= sizeof(address.sun_path))
+	{
+		std::cout << "Socket path is too long: " << path << std::endl;
+		return false;
+	}
+
+#ifndef MSG_NOSIGNAL
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	if (pipe(wakePipe) != 0)
+	{
+		std::cout << "Couldn't create the wake-up pipe: " << strerror(errno) << std::endl;
+		return false;
+	}
+	fcntl(wakePipe[0], F_SETFL, O_NONBLOCK);
+	fcntl(wakePipe[1], F_SETFL, O_NONBLOCK);
+
+	listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenSocket < 0)
+	{
+		std::cout << "Couldn't create a socket: " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	// A socket file left behind by a service that didn't shut down cleanly would make bind() fail.
+	unlink(path.c_str());
+
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+	if (bind(listenSocket, (sockaddr*)&address, sizeof(address)) != 0 || listen(listenSocket, 16) != 0)
+	{
+		std::cout << "Couldn't listen on " << path << ": " << strerror(errno) << std::endl;
+		close(listenSocket);
+		listenSocket = -1;
+		return false;
+	}
+	fcntl(listenSocket, F_SETFL, O_NONBLOCK);
+
+	socketPath = path;
+	running = true;
+	return true;
+#else
+	std::cout << "The physics service needs Unix domain sockets, which aren't available on this platform." << std::endl;
+	return false;
+#endif
+}
+
+void PhysicsService::Run()
+{
+#ifdef PHYSICS_SERVICE_POSIX
+	std::vector<pollfd> polled;
+
+	while (running)
+	{
+		// Wait until a client connects, sends something, or has room for the replies we are waiting to send.
+		polled.clear();
+		pollfd entry;
+		entry.fd = listenSocket;
+		entry.events = POLLIN;
+		entry.revents = 0;
+		polled.push_back(entry);
+		entry.fd = wakePipe[0];
+		polled.push_back(entry);
+		for (size_t i = 0; i < connections.size(); i++)
+		{
+			entry.fd = connections[i]->socket;
+			entry.events = (WantsInput(connections[i]) ? POLLIN : 0) | (connections[i]->output.empty() ? 0 : POLLOUT);
+			polled.push_back(entry);
+		}
+
+		if (poll(polled.data(), polled.size(), -1) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			std::cout << "poll() failed: " << strerror(errno) << std::endl;
+			break;
+		}
+
+		if (polled[1].revents != 0)
+		{
+			char drain[64];
+			while (read(wakePipe[0], drain, sizeof(drain)) > 0)
+			{
+			}
+		}
+
+		// Only the connections that were polled; Accept() below may add more.
+		size_t polledConnections = polled.size() - 2;
+		for (size_t i = 0; i < polledConnections; i++)
+		{
+			Connection* connection = connections[i];
+			short events = polled[i + 2].revents;
+
+			if ((events & (POLLHUP | POLLERR)) || ((events & POLLIN) && WantsInput(connection)))
+			{
+				if (!Receive(connection))
+				{
+					connection->closing = true;
+				}
+			}
+
+			// Handle what we've read, and try to send the replies straight away; most fit in the socket buffer, so there's no need to wait
+			// for POLLOUT. Requests left over from when the client was behind on reading get handled here too, once it has caught up.
+			// Keep going for as long as the socket takes everything we give it, since nothing else would wake us up to handle the rest.
+			while (!connection->closing)
+			{
+				size_t pending = connection->input.size();
+				HandleMessages(connection);
+				if (!connection->output.empty() && !Send(connection))
+				{
+					connection->closing = true;
+				}
+				if (!connection->output.empty() || connection->input.size() == pending)
+				{
+					break;
+				}
+			}
+		}
+
+		for (size_t i = 0; i < connections.size();)
+		{
+			if (connections[i]->closing)
+			{
+				CloseConnection(connections[i]);
+				connections.erase(connections.begin() + i);
+			}
+			else
+			{
+				i++;
+			}
+		}
+
+		if (polled[0].revents & POLLIN)
+		{
+			Accept();
+		}
+	}
+#endif
+}
+
+void PhysicsService::Stop()
+{
+	running = false;
+
+#ifdef PHYSICS_SERVICE_POSIX
+	// write() is safe to call from a signal handler.
+	if (wakePipe[1] >= 0)
+	{
+		char wake = 1;
+		ssize_t written = write(wakePipe[1], &wake, 1);
+		(void)written;
+	}
+#endif
+}
+
+void PhysicsService::Accept()
+{
+#ifdef PHYSICS_SERVICE_POSIX
+	while (true)
+	{
+		int client = accept(listenSocket, nullptr, nullptr);
+		if (client < 0)
+		{
+			return;
+		}
+		if ((int)connections.size() >= maxConnections)
+		{
+			std::cout << "Already have " << maxConnections << " clients, turning another one away" << std::endl;
+			close(client);
+			continue;
+		}
+		fcntl(client, F_SETFL, O_NONBLOCK);
+
+		Connection* connection = new Connection();
+		connection->number = nextConnection++;
+		connection->socket = client;
+		connection->memoryHandle = -1;
+		connection->memory = nullptr;
+		connection->memorySize = 0;
+		connection->nextHalf = 0;
+		connection->closing = false;
+
+		connections.push_back(connection);
+	}
+#endif
+}
+
+bool PhysicsService::WantsInput(Connection* connection)
+{
+	return connection->output.size() < MAX_PENDING_OUTPUT && connection->input.size() < MAX_PENDING_INPUT;
+}
+
+bool PhysicsService::Receive(Connection* connection)
+{
+#ifdef PHYSICS_SERVICE_POSIX
+	// Read everything that's there, up to what we're willing to hold on to. A client that pipelines its requests may have sent many at once.
+	char chunk[64 * 1024];
+	while (connection->input.size() < MAX_PENDING_INPUT)
+	{
+		ssize_t received = recv(connection->socket, chunk, sizeof(chunk), 0);
+		if (received > 0)
+		{
+			connection->input.insert(connection->input.end(), chunk, chunk + received);
+		}
+		else if (received == 0)
+		{
+			// The client hung up.
+			return false;
+		}
+		else if (errno == EINTR)
+		{
+			continue;
+		}
+		else
+		{
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+		}
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool PhysicsService::Send(Connection* connection)
+{
+#ifdef PHYSICS_SERVICE_POSIX
+	size_t sent = 0;
+	bool ok = true;
+
+	while (sent < connection->output.size())
+	{
+		ssize_t result = send(connection->socket, connection->output.data() + sent, connection->output.size() - sent, SEND_FLAGS);
+		if (result > 0)
+		{
+			sent += result;
+		}
+		else if (result < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		else
+		{
+			// If the socket buffer is full, the rest waits for the next POLLOUT.
+			ok = result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+			break;
+		}
+	}
+
+	connection->output.erase(connection->output.begin(), connection->output.begin() + sent);
+	return ok;
+#else
+	return false;
+#endif
+}
+
+void PhysicsService::CloseConnection(Connection* connection)
+{
+#ifdef PHYSICS_SERVICE_POSIX
+	if (connection->memory != nullptr)
+	{
+		munmap(connection->memory, connection->memorySize);
+		close(connection->memoryHandle);
+		shm_unlink(connection->memoryName.c_str());
+	}
+	close(connection->socket);
+#endif
+
+	delete(connection);
+}
+
+bool PhysicsService::OpenSharedMemory(Connection* connection)
+{
+	if (connection->memory != nullptr)
+	{
+		return true;
+	}
+
+#ifdef PHYSICS_SERVICE_POSIX
+	std::string name = "/sweptaabb-" + std::to_string(getpid()) + "-" + std::to_string(connection->number);
+
+	int handle = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (handle < 0)
+	{
+		std::cout << "Couldn't create shared memory " << name << ": " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	void* memory = MAP_FAILED;
+	if (ftruncate(handle, sharedMemorySize) == 0)
+	{
+		memory = mmap(nullptr, sharedMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
+	}
+	if (memory == MAP_FAILED)
+	{
+		std::cout << "Couldn't map shared memory " << name << ": " << strerror(errno) << std::endl;
+		close(handle);
+		shm_unlink(name.c_str());
+		return false;
+	}
+
+	connection->memoryName = name;
+	connection->memoryHandle = handle;
+	connection->memory = (char*)memory;
+	connection->memorySize = sharedMemorySize;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void PhysicsService::HandleMessages(Connection* connection)
+{
+	std::vector<char>& input = connection->input;
+	std::vector<char> body;
+	size_t offset = 0;
+
+	while (input.size() - offset >= MESSAGE_HEADER_SIZE && connection->output.size() < MAX_PENDING_OUTPUT)
+	{
+		MessageReader headerReader(input.data() + offset, MESSAGE_HEADER_SIZE);
+		MessageHeader header;
+		header.length = headerReader.U32();
+		header.type = headerReader.U16();
+		header.flags = headerReader.U16();
+		header.requestId = headerReader.U32();
+
+		if (header.length > MAX_MESSAGE_LENGTH)
+		{
+			// We can't tell where the next message starts, so there's no way to carry on with this client.
+			std::cout << "Message of " << header.length << " bytes is too big, closing the connection" << std::endl;
+			connection->closing = true;
+			break;
+		}
+
+		// Wait for the rest of the message.
+		if (input.size() - offset - MESSAGE_HEADER_SIZE < header.length)
+		{
+			break;
+		}
+
+		MessageReader request(input.data() + offset + MESSAGE_HEADER_SIZE, header.length);
+		body.clear();
+		MessageWriter bodyWriter(&body);
+		uint32_t status = Handle(connection, header.type, request, bodyWriter);
+
+		if (status != STATUS_OK)
+		{
+			body.clear();
+		}
+
+		MessageWriter reply(&connection->output);
+		WriteMessageHeader(reply, (uint32_t)(sizeof(uint32_t) + body.size()), header.type | MESSAGE_REPLY, header.requestId);
+		reply.U32(status);
+		reply.Bytes(body.data(), body.size());
+
+		offset += MESSAGE_HEADER_SIZE + header.length;
+	}
+
+	input.erase(input.begin(), input.begin() + offset);
+}
+
+HostedWorld* PhysicsService::FindWorld(uint32_t id)
+{
+	if (id > (uint32_t)std::numeric_limits<int>::max())
+	{
+		return nullptr;
+	}
+	return worlds->GetWorld((int)id);
+}
+
+// A NaN or infinity from a client would spread to everything the body touches, so they're turned away at the door.
+static bool IsFinite(const glm::vec3& value)
+{
+	return std::isfinite(value.x) && std::isfinite(value.y) && std::isfinite(value.z);
+}
+
+uint32_t PhysicsService::Handle(Connection* connection, uint16_t type, MessageReader& request, MessageWriter& reply)
+{
+	switch (type)
+	{
+	case MESSAGE_HELLO:
+	{
+		// A client that can't get shared memory can still do everything except MESSAGE_READ_STATE, so it gets an empty name.
+		bool shared = OpenSharedMemory(connection);
+		reply.U32(PROTOCOL_VERSION);
+		reply.String(shared ? connection->memoryName : std::string());
+		reply.U32(shared ? (uint32_t)connection->memorySize : 0);
+		return STATUS_OK;
+	}
+
+	case MESSAGE_CREATE_WORLD:
+	{
+		WorldSettings settings;
+		glm::vec3 low, high;
+		low.x = request.F32(); low.y = request.F32(); low.z = request.F32();
+		high.x = request.F32(); high.y = request.F32(); high.z = request.F32();
+		settings.bounds = AABB(low, high);
+		uint32_t regionsX = request.U32();
+		uint32_t regionsY = request.U32();
+		uint32_t regionsZ = request.U32();
+		uint32_t bodiesPerRegion = request.U32();
+		uint32_t priority = request.U32();
+		float stepBudget = request.F32();
+
+		// Check every count on its own before multiplying them, so the product can't overflow.
+		if (request.Failed() || regionsX < 1 || regionsY < 1 || regionsZ < 1 || bodiesPerRegion < 1 ||
+			regionsX > MAX_WORLD_REGIONS || regionsY > MAX_WORLD_REGIONS || regionsZ > MAX_WORLD_REGIONS || bodiesPerRegion > MAX_BODIES_PER_REGION ||
+			(uint64_t)regionsX * regionsY * regionsZ * bodiesPerRegion > MAX_WORLD_BODIES ||
+			!IsFinite(low) || !IsFinite(high) || !(low.x < high.x && low.y < high.y && low.z < high.z) ||
+			!std::isfinite(stepBudget) || stepBudget <= 0.0f)
+		{
+			return STATUS_MALFORMED;
+		}
+		settings.stepBudget = stepBudget;
+		settings.regionsX = (int)regionsX;
+		settings.regionsY = (int)regionsY;
+		settings.regionsZ = (int)regionsZ;
+		settings.bodiesPerRegion = (int)bodiesPerRegion;
+		settings.priority = priority == WORLD_PRIORITY_LOW || priority == WORLD_PRIORITY_HIGH ? (WorldPriority)priority : WORLD_PRIORITY_NORMAL;
+
+		HostedWorld* world = worlds->CreateWorld("service", settings);
+		if (world == nullptr)
+		{
+			return STATUS_UNAVAILABLE;
+		}
+		producers.insert(std::make_pair(world->id, world->pipeline->GetCommandQueue()->CreateProducer()));
+
+		reply.U32((uint32_t)world->id);
+		return STATUS_OK;
+	}
+
+	case MESSAGE_DESTROY_WORLD:
+	{
+		HostedWorld* world = FindWorld(request.U32());
+		if (request.Failed())
+		{
+			return STATUS_MALFORMED;
+		}
+		if (world == nullptr)
+		{
+			return STATUS_NO_SUCH_WORLD;
+		}
+
+		producers.erase(world->id);
+		worlds->DestroyWorld(world->id);
+		return STATUS_OK;
+	}
+
+	case MESSAGE_CREATE_BODY:
+	{
+		HostedWorld* world = FindWorld(request.U32());
+		glm::vec3 position, velocity, size;
+		position.x = request.F32(); position.y = request.F32(); position.z = request.F32();
+		velocity.x = request.F32(); velocity.y = request.F32(); velocity.z = request.F32();
+		size.x = request.F32(); size.y = request.F32(); size.z = request.F32();
+		if (request.Failed() || !IsFinite(position) || !IsFinite(velocity) || !IsFinite(size))
+		{
+			return STATUS_MALFORMED;
+		}
+		if (world == nullptr)
+		{
+			return STATUS_NO_SUCH_WORLD;
+		}
+
+		// Nothing is stepping while we're in here (we do all the stepping ourselves), so it's safe to add bodies directly.
+		GameObject* body = world->partition->CreateBody(box, position);
+		if (body == nullptr)
+		{
+			return STATUS_FULL;
+		}
+		body->SetScale(size);
+		body->SetVelocity(velocity);
+
+		reply.I32(body->GetId());
+		return STATUS_OK;
+	}
+
+	case MESSAGE_STEP:
+	{
+		uint32_t id = request.U32();
+		float dt = request.F32();
+		uint32_t steps = request.U32();
+		if (request.Failed() || steps > MAX_STEPS_PER_REQUEST || !std::isfinite(dt))
+		{
+			return STATUS_MALFORMED;
+		}
+
+		if (id == ALL_WORLDS)
+		{
+			// No frame budget here; the client asked for these steps, so every world takes every one of them.
+			for (uint32_t i = 0; i < steps; i++)
+			{
+				worlds->Tick(dt, std::numeric_limits<double>::max());
+			}
+		}
+		else
+		{
+			HostedWorld* world = FindWorld(id);
+			if (world == nullptr)
+			{
+				return STATUS_NO_SUCH_WORLD;
+			}
+			for (uint32_t i = 0; i < steps; i++)
+			{
+				world->pipeline->Step(dt);
+			}
+		}
+
+		reply.U32(steps);
+		return STATUS_OK;
+	}
+
+	case MESSAGE_SET_VELOCITY:
+	case MESSAGE_SET_POSITION:
+	case MESSAGE_ADD_ACCELERATION:
+	{
+		HostedWorld* world = FindWorld(request.U32());
+		int body = request.I32();
+		glm::vec3 value;
+		value.x = request.F32(); value.y = request.F32(); value.z = request.F32();
+		if (request.Failed() || !IsFinite(value))
+		{
+			return STATUS_MALFORMED;
+		}
+		if (world == nullptr)
+		{
+			return STATUS_NO_SUCH_WORLD;
+		}
+		if (world->partition->GetBody(body) == nullptr)
+		{
+			return STATUS_NO_SUCH_BODY;
+		}
+
+		CommandQueue::Producer& producer = producers.find(world->id)->second;
+		if (type == MESSAGE_SET_VELOCITY)
+		{
+			producer.SetVelocity(body, value);
+		}
+		else if (type == MESSAGE_SET_POSITION)
+		{
+			producer.SetPosition(body, value);
+		}
+		else
+		{
+			producer.AddAcceleration(body, value);
+		}
+		return STATUS_OK;
+	}
+
+	case MESSAGE_RAYCAST:
+	{
+		HostedWorld* world = FindWorld(request.U32());
+		glm::vec3 origin, direction;
+		origin.x = request.F32(); origin.y = request.F32(); origin.z = request.F32();
+		direction.x = request.F32(); direction.y = request.F32(); direction.z = request.F32();
+		float maxDistance = request.F32();
+		if (request.Failed())
+		{
+			return STATUS_MALFORMED;
+		}
+		if (world == nullptr)
+		{
+			return STATUS_NO_SUCH_WORLD;
+		}
+
+		SnapshotManager::Reader snapshot = world->pipeline->GetSnapshots()->Read();
+		RayHit hit;
+		snapshot->Raycast(origin, direction, maxDistance, hit);
+
+		reply.I32(hit.body);
+		reply.F32(hit.distance);
+		reply.Vec3(hit.point.x, hit.point.y, hit.point.z);
+		return STATUS_OK;
+	}
+
+	case MESSAGE_OVERLAP:
+	{
+		HostedWorld* world = FindWorld(request.U32());
+		glm::vec3 low, high;
+		low.x = request.F32(); low.y = request.F32(); low.z = request.F32();
+		high.x = request.F32(); high.y = request.F32(); high.z = request.F32();
+		if (request.Failed())
+		{
+			return STATUS_MALFORMED;
+		}
+		if (world == nullptr)
+		{
+			return STATUS_NO_SUCH_WORLD;
+		}
+
+		SnapshotManager::Reader snapshot = world->pipeline->GetSnapshots()->Read();
+		std::vector<int> found;
+		snapshot->Overlap(AABB(low, high), found);
+
+		reply.U32((uint32_t)found.size());
+		for (size_t i = 0; i < found.size(); i++)
+		{
+			reply.I32(found[i]);
+		}
+		return STATUS_OK;
+	}
+
+	case MESSAGE_READ_STATE:
+	{
+		HostedWorld* world = FindWorld(request.U32());
+		if (request.Failed())
+		{
+			return STATUS_MALFORMED;
+		}
+		if (world == nullptr)
+		{
+			return STATUS_NO_SUCH_WORLD;
+		}
+		return ReadState(connection, world, reply);
+	}
+
+	default:
+		return STATUS_UNKNOWN_TYPE;
+	}
+}
+
+uint32_t PhysicsService::ReadState(Connection* connection, HostedWorld* world, MessageWriter& reply)
+{
+	if (!OpenSharedMemory(connection))
+	{
+		return STATUS_UNAVAILABLE;
+	}
+
+	SnapshotManager::Reader snapshot = world->pipeline->GetSnapshots()->Read();
+	size_t count = (size_t)snapshot->NumBodies();
+	size_t bytes = count * (sizeof(int32_t) + 12 * sizeof(float));
+
+	size_t half = connection->memorySize / 2;
+	if (bytes > half)
+	{
+		return STATUS_TOO_LARGE;
+	}
+
+	size_t offset = connection->nextHalf * half;
+	connection->nextHalf ^= 1;
+
+	// The snapshot is already laid out one array per component, so this is just a row of copies.
+	char* out = connection->memory + offset;
+	const std::vector<float>* columns[12] =
+	{
+		&snapshot->positionX, &snapshot->positionY, &snapshot->positionZ,
+		&snapshot->velocityX, &snapshot->velocityY, &snapshot->velocityZ,
+		&snapshot->minX, &snapshot->minY, &snapshot->minZ,
+		&snapshot->maxX, &snapshot->maxY, &snapshot->maxZ
+	};
+
+	if (count > 0)
+	{
+		memcpy(out, snapshot->ids.data(), count * sizeof(int32_t));
+		out += count * sizeof(int32_t);
+		for (int i = 0; i < 12; i++)
+		{
+			memcpy(out, columns[i]->data(), count * sizeof(float));
+			out += count * sizeof(float);
+		}
+	}
+
+	reply.U32((uint32_t)offset);
+	reply.U32((uint32_t)bytes);
+	reply.U32((uint32_t)count);
+	reply.U64(snapshot->step);
+	return STATUS_OK;
+}
+
+#endif // _PHYSICS_SERVICE_CPP
@@ -0,0 +1,122 @@
+/*
+Title: Swept AABB-3D
+File Name: PhysicsService.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Runs the simulator as a service for other processes on the same machine. Clients connect to a
+Unix domain socket and send requests in the binary protocol described in PhysicsProtocol.h:
+create worlds and bodies, step, change bodies, and run queries. Reading the state of every
+body at once doesn't go through the socket; the service writes it to a shared memory region
+that each connection gets for itself, and the reply only says where to look.
+This is only available on POSIX systems (Linux, macOS); on Windows, Start() fails.
+*/
+
+#ifndef _PHYSICS_SERVICE_H
+#define _PHYSICS_SERVICE_H
+
+#include "PhysicsProtocol.h"
+#include "WorldRegistry.h"
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+// Unix domain sockets and POSIX shared memory are all this needs, so it builds anywhere those are.
+#if defined(__unix__) || defined(__APPLE__)
+#define PHYSICS_SERVICE_POSIX
+#endif
+
+class PhysicsService
+{
+	// One connected client.
+	struct Connection
+	{
+		int number;					// Counts up from 0, in the order clients connected.
+		int socket;
+		std::vector<char> input;	// Bytes read but not handled yet. May end with part of a message.
+		std::vector<char> output;	// Replies not sent yet.
+
+		// The connection's shared memory region, created the first time it's needed.
+		std::string memoryName;
+		int memoryHandle;
+		char* memory;
+		size_t memorySize;
+		int nextHalf;				// Which half of the region the next MESSAGE_READ_STATE reply uses.
+
+		bool closing;
+	};
+
+	WorldRegistry* worlds;
+
+	// Every body the service creates is a box. It's a unit cube scaled to the requested size.
+	Model* box;
+
+	// One producer per world, used to push changes from clients onto the world's command queue.
+	std::map<int, CommandQueue::Producer> producers;
+
+	std::string socketPath;
+	int listenSocket;
+	int wakePipe[2];		// Writing to wakePipe[1] wakes Run() up, so another thread can stop it.
+	std::atomic<bool> running;
+
+	std::vector<Connection*> connections;
+	size_t sharedMemorySize;
+	int maxConnections;
+	int nextConnection;
+
+	// Whether to read from the connection. A client that sends requests but doesn't read the replies would otherwise make us
+	// buffer them forever, so we stop reading (and handling) its requests until it has caught up.
+	bool WantsInput(Connection* connection);
+
+	void Accept();
+	bool Receive(Connection* connection);
+	bool Send(Connection* connection);
+	void CloseConnection(Connection* connection);
+
+	// Handles every complete message in the connection's input, in order, queuing a reply for each one.
+	// Stops early, leaving the rest in the input, if the replies waiting to be sent get too big (see WantsInput()).
+	void HandleMessages(Connection* connection);
+
+	// Handles one request, and returns the reply's status. Everything after the status goes in reply (and is thrown away unless the status is STATUS_OK).
+	uint32_t Handle(Connection* connection, uint16_t type, MessageReader& request, MessageWriter& reply);
+
+	bool OpenSharedMemory(Connection* connection);
+	uint32_t ReadState(Connection* connection, HostedWorld* world, MessageWriter& reply);
+	HostedWorld* FindWorld(uint32_t id);
+
+public:
+	// sharedMemoryBytes is the size of each connection's shared memory region. Clients that connect while maxClients are already
+	// connected are hung up on straight away, since each one can hold a region of its own.
+	PhysicsService(WorldRegistry* registry, size_t sharedMemoryBytes = 16 << 20, int maxClients = 64);
+	~PhysicsService();
+
+	// Starts listening on a Unix domain socket at path (any old socket file there is replaced). Returns false if that failed.
+	bool Start(const std::string& path);
+
+	// Handles clients until Stop() is called. Runs on the calling thread, and that thread does all of the stepping.
+	void Run();
+
+	// Makes Run() return. Safe to call from any thread, or from a signal handler.
+	void Stop();
+};
+
+#endif //_PHYSICS_SERVICE_H
@@ -0,0 +1,226 @@
+/*
+Title: Swept AABB-3D
+File Name: ProgramCache.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Caches linked shader programs on disk, so that later launches can skip compiling and linking
+them from source. See ProgramCache.h for how it works and the file layout.
+*/
+
+#ifndef _PROGRAM_CACHE_CPP
+#define _PROGRAM_CACHE_CPP
+
+#include "ProgramCache.h"
+#include "ByteStream.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+// FNV-1a. Not cryptographic, but the file also keeps the whole driver string, and a stale or colliding entry only costs a
+// rejected binary (and a recompile), never a wrong program: the driver checks the blob when it's loaded.
+static uint64_t HashBytes(uint64_t hash, const char* data, size_t length)
+{
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= (uint8_t)data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+ProgramCache::ProgramCache(const std::string& cacheDirectory)
+{
+	directory = cacheDirectory;
+	if (!directory.empty() && directory.back() != '/' && directory.back() != '\\')
+	{
+		directory += "/";
+	}
+
+	// The same sources give a different binary on a different GPU, driver, or driver version.
+	const char* vendor = (const char*)glGetString(GL_VENDOR);
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	const char* version = (const char*)glGetString(GL_VERSION);
+	driver = std::string(vendor != nullptr ? vendor : "") + "\n" + (renderer != nullptr ? renderer : "") + "\n" + (version != nullptr ? version : "");
+
+	GLint formats = 0;
+	supported = GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary;
+	if (supported)
+	{
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	}
+	supported = supported && formats > 0;
+}
+
+uint64_t ProgramCache::Key(const std::string& vertexSource, const std::string& fragmentSource)
+{
+	// The lengths go in too, so that moving text from the end of one source to the start of the next changes the key.
+	uint64_t lengths[3] = { driver.size(), vertexSource.size(), fragmentSource.size() };
+	uint64_t hash = 14695981039346656037ull;
+	hash = HashBytes(hash, (const char*)lengths, sizeof(lengths));
+	hash = HashBytes(hash, driver.data(), driver.size());
+	hash = HashBytes(hash, vertexSource.data(), vertexSource.size());
+	hash = HashBytes(hash, fragmentSource.data(), fragmentSource.size());
+	return hash;
+}
+
+std::string ProgramCache::FileName(uint64_t key)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "program_%016llx.bin", (unsigned long long)key);
+	return directory + name;
+}
+
+GLuint ProgramCache::Load(const std::string& vertexSource, const std::string& fragmentSource)
+{
+	if (!supported)
+	{
+		return 0;
+	}
+
+	// No file just means this is the first launch with these sources; no need to say anything.
+	uint64_t key = Key(vertexSource, fragmentSource);
+	std::ifstream file(FileName(key), std::ios::in | std::ios::binary);
+	if (!file.good())
+	{
+		return 0;
+	}
+	std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	file.close();
+
+	MessageReader reader(data.data(), data.size());
+	char magic[4];
+	reader.Bytes(magic, 4);
+	uint32_t version = reader.U32();
+	uint32_t driverLength = reader.U32();
+	if (reader.Failed() || memcmp(magic, "PBIN", 4) != 0 || version != PROGRAM_CACHE_VERSION || driverLength > data.size())
+	{
+		return 0;
+	}
+	std::string fileDriver(driverLength, '\0');
+	reader.Bytes(&fileDriver[0], driverLength);
+	uint64_t fileKey = reader.U64();
+	GLenum format = (GLenum)reader.U32();
+	uint32_t length = reader.U32();
+	if (reader.Failed() || fileDriver != driver || fileKey != key || length > data.size())
+	{
+		return 0;
+	}
+	std::vector<char> binary(length);
+	reader.Bytes(binary.data(), length);
+	if (reader.Failed())
+	{
+		return 0;
+	}
+
+	// The driver can still turn the binary down (after an update it didn't change its version string for, say). That's fine; we compile.
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, format, binary.data(), (GLsizei)length);
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked != GL_TRUE)
+	{
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	return program;
+}
+
+void ProgramCache::PrepareForStore(GLuint program)
+{
+	if (supported)
+	{
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+}
+
+bool ProgramCache::Store(GLuint program, const std::string& vertexSource, const std::string& fragmentSource)
+{
+	if (!supported)
+	{
+		return false;
+	}
+
+	GLint linked = GL_FALSE;
+	GLint length = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (linked != GL_TRUE || length <= 0)
+	{
+		return false;
+	}
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	GLsizei written = 0;
+	glGetProgramBinary(program, length, &written, &format, binary.data());
+	if (written <= 0)
+	{
+		return false;
+	}
+
+	std::vector<char> data;
+	MessageWriter writer(&data);
+	writer.Bytes("PBIN", 4);
+	writer.U32(PROGRAM_CACHE_VERSION);
+	writer.U32((uint32_t)driver.size());
+	writer.Bytes(driver.data(), driver.size());
+	writer.U64(Key(vertexSource, fragmentSource));
+	writer.U32((uint32_t)format);
+	writer.U32((uint32_t)written);
+	writer.Bytes(binary.data(), written);
+
+	// Write to a temporary file and only rename it into place once it's all there, so a crash or a full disk partway through
+	// can't leave a half-written entry behind for the next run to load.
+	std::string fileName = FileName(Key(vertexSource, fragmentSource));
+	std::string tempName = fileName + ".tmp";
+	std::ofstream file(tempName, std::ios::out | std::ios::binary);
+	if (!file.good())
+	{
+		std::cout << "Can't write file: " << tempName.data() << std::endl;
+		return false;
+	}
+	file.write(data.data(), data.size());
+	file.close();
+	if (file.fail())
+	{
+		std::cout << "Can't write file: " << tempName.data() << std::endl;
+		std::remove(tempName.data());
+		return false;
+	}
+
+	// rename won't replace an existing file on Windows, so clear the old entry out of the way first.
+	std::remove(fileName.data());
+	if (std::rename(tempName.data(), fileName.data()) != 0)
+	{
+		std::cout << "Can't write file: " << fileName.data() << std::endl;
+		std::remove(tempName.data());
+		return false;
+	}
+
+	return true;
+}
+
+#endif // _PROGRAM_CACHE_CPP
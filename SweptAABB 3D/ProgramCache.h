@@ -0,0 +1,82 @@
+/*
+Title: Swept AABB-3D
+File Name: ProgramCache.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Caches linked shader programs on disk, so that later launches can skip compiling and linking
+them from source. The driver hands back the linked program as a binary blob
+(glGetProgramBinary), which is saved in a file named after a hash of the shader sources and
+the driver (vendor, renderer and version strings). The next launch loads the blob straight
+back in (glProgramBinary). A blob is only good for the exact driver that made it, so if the
+driver has changed, or rejects the blob for any other reason, the program is compiled from
+source as usual and the cache is rewritten.
+
+Cache file (little-endian):
+	char[4] magic			"PBIN"
+	uint32 version			PROGRAM_CACHE_VERSION
+	uint32 length, then the driver string
+	uint64 key				Hash of the driver string and the sources.
+	uint32 format			The binary format, as returned by glGetProgramBinary.
+	uint32 length, then the binary
+*/
+
+#ifndef _PROGRAM_CACHE_H
+#define _PROGRAM_CACHE_H
+
+#include "GLIncludes.h"
+#include <cstdint>
+#include <string>
+
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+class ProgramCache
+{
+	std::string directory;
+	std::string driver;
+	bool supported;
+
+	uint64_t Key(const std::string& vertexSource, const std::string& fragmentSource);
+	std::string FileName(uint64_t key);
+
+public:
+	// Needs a current GL context. Cache files go in directory, which has to exist already.
+	ProgramCache(const std::string& cacheDirectory);
+
+	// Returns a linked program for these sources from the cache, or 0 if there isn't a usable one. Then compile and link the program
+	// from source, calling PrepareForStore() before linking it, and pass it to Store() so the next launch can use it.
+	GLuint Load(const std::string& vertexSource, const std::string& fragmentSource);
+
+	// Tells the driver we'll want the program's binary. Call this before glLinkProgram().
+	void PrepareForStore(GLuint program);
+
+	// Saves a linked program's binary. Returns false if the driver can't give us one, or the file couldn't be written.
+	bool Store(GLuint program, const std::string& vertexSource, const std::string& fragmentSource);
+
+	// False if the driver can't save programs at all (no GL_ARB_get_program_binary, or no binary formats), in which case
+	// Load() and Store() do nothing.
+	bool IsSupported()
+	{
+		return supported;
+	}
+};
+
+#endif //_PROGRAM_CACHE_H
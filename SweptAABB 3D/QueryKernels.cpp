@@ -0,0 +1,247 @@
+/*
+Title: Swept AABB-3D
+File Name: QueryKernels.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Batch query kernels: test a group of rays (or moving boxes) against the bodies of a world
+snapshot in one go. The boxes near the whole group are copied into a small, tightly packed
+buffer once, and then each ray is tested against four boxes per instruction with SSE (or one
+at a time where SSE isn't available).
+*/
+
+#ifndef _QUERY_KERNELS_CPP
+#define _QUERY_KERNELS_CPP
+
+#include "QueryKernels.h"
+#include <algorithm>
+#include <cstdlib>
+
+#ifdef QUERY_KERNELS_SSE
+#include <emmintrin.h>
+#endif
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+static float* AllocateAligned(int count)
+{
+	// 16-byte alignment lets SSE load four floats at once.
+#ifdef _WIN32
+	return (float*)_aligned_malloc(count * sizeof(float), 16);
+#else
+	void* memory = nullptr;
+	if (posix_memalign(&memory, 16, count * sizeof(float)) != 0)
+	{
+		return nullptr;
+	}
+	return (float*)memory;
+#endif
+}
+
+static void FreeAligned(float* memory)
+{
+#ifdef _WIN32
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+QueryCandidates::QueryCandidates()
+{
+	minX = minY = minZ = nullptr;
+	maxX = maxY = maxZ = nullptr;
+	count = 0;
+	padded = 0;
+	capacity = 0;
+}
+
+QueryCandidates::~QueryCandidates()
+{
+	FreeAligned(minX); FreeAligned(minY); FreeAligned(minZ);
+	FreeAligned(maxX); FreeAligned(maxY); FreeAligned(maxZ);
+}
+
+void QueryCandidates::Gather(const WorldSnapshot& snapshot, const AABB& bounds)
+{
+	ids.clear();
+
+	// Find the boxes first, so we know how much room we need. The snapshot is sorted by min x, so we can stop early.
+	std::vector<int> found;
+	for (int i = 0; i < snapshot.NumBodies(); i++)
+	{
+		if (snapshot.minX[i] > bounds.max.x)
+		{
+			break;
+		}
+		if (snapshot.maxX[i] < bounds.min.x || snapshot.maxY[i] < bounds.min.y || snapshot.minY[i] > bounds.max.y ||
+			snapshot.maxZ[i] < bounds.min.z || snapshot.minZ[i] > bounds.max.z)
+		{
+			continue;
+		}
+		found.push_back(i);
+	}
+
+	count = (int)found.size();
+	padded = (count + 3) & ~3;
+
+	if (padded > capacity)
+	{
+		FreeAligned(minX); FreeAligned(minY); FreeAligned(minZ);
+		FreeAligned(maxX); FreeAligned(maxY); FreeAligned(maxZ);
+
+		capacity = padded;
+		minX = AllocateAligned(capacity); minY = AllocateAligned(capacity); minZ = AllocateAligned(capacity);
+		maxX = AllocateAligned(capacity); maxY = AllocateAligned(capacity); maxZ = AllocateAligned(capacity);
+	}
+
+	ids.resize(padded);
+	for (int i = 0; i < padded; i++)
+	{
+		int s = found[std::min(i, count - 1)];
+		ids[i] = snapshot.ids[s];
+		minX[i] = snapshot.minX[s]; minY[i] = snapshot.minY[s]; minZ[i] = snapshot.minZ[s];
+		maxX[i] = snapshot.maxX[s]; maxY[i] = snapshot.maxY[s]; maxZ[i] = snapshot.maxZ[s];
+	}
+}
+
+AABB QueryBounds(const QueryRay* rays, int numRays)
+{
+	AABB bounds(glm::vec3(0.0f), glm::vec3(0.0f));
+
+	for (int i = 0; i < numRays; i++)
+	{
+		glm::vec3 end = rays[i].origin + rays[i].direction * rays[i].maxDistance;
+		glm::vec3 low = glm::min(rays[i].origin, end) - rays[i].halfExtents;
+		glm::vec3 high = glm::max(rays[i].origin, end) + rays[i].halfExtents;
+
+		if (i == 0)
+		{
+			bounds = AABB(low, high);
+		}
+		else
+		{
+			bounds = AABB(glm::min(bounds.min, low), glm::max(bounds.max, high));
+		}
+	}
+
+	return bounds;
+}
+
+void RaycastBatch(const QueryCandidates& candidates, const QueryRay* rays, int numRays, RayHit* hits)
+{
+	for (int r = 0; r < numRays; r++)
+	{
+		const QueryRay& ray = rays[r];
+		hits[r] = RayHit();
+
+		if (candidates.count == 0)
+		{
+			continue;
+		}
+
+		// The same slab test as WorldSnapshot::Raycast(), with each box grown by the ray's half extents.
+		// Like that function, when two boxes are hit at exactly the same distance, the later one wins, so both give the same answers.
+		glm::vec3 inverse = 1.0f / ray.direction;
+		float closest = ray.maxDistance;
+		int closestIndex = -1;
+
+#ifdef QUERY_KERNELS_SSE
+		__m128 originX = _mm_set1_ps(ray.origin.x), originY = _mm_set1_ps(ray.origin.y), originZ = _mm_set1_ps(ray.origin.z);
+		__m128 inverseX = _mm_set1_ps(inverse.x), inverseY = _mm_set1_ps(inverse.y), inverseZ = _mm_set1_ps(inverse.z);
+		__m128 halfX = _mm_set1_ps(ray.halfExtents.x), halfY = _mm_set1_ps(ray.halfExtents.y), halfZ = _mm_set1_ps(ray.halfExtents.z);
+		__m128 zero = _mm_setzero_ps();
+
+		// Each lane keeps its own closest hit, and the lanes are compared at the end.
+		__m128 best = _mm_set1_ps(ray.maxDistance);
+		__m128i bestIndex = _mm_set1_epi32(-1);
+		__m128i index = _mm_setr_epi32(0, 1, 2, 3);
+		__m128i four = _mm_set1_epi32(4);
+
+		for (int i = 0; i < candidates.padded; i += 4)
+		{
+			__m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_load_ps(candidates.minX + i), halfX), originX), inverseX);
+			__m128 x2 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_load_ps(candidates.maxX + i), halfX), originX), inverseX);
+			__m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_load_ps(candidates.minY + i), halfY), originY), inverseY);
+			__m128 y2 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_load_ps(candidates.maxY + i), halfY), originY), inverseY);
+			__m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_load_ps(candidates.minZ + i), halfZ), originZ), inverseZ);
+			__m128 z2 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_load_ps(candidates.maxZ + i), halfZ), originZ), inverseZ);
+
+			__m128 entry = _mm_max_ps(_mm_max_ps(_mm_min_ps(x1, x2), _mm_min_ps(y1, y2)), _mm_min_ps(z1, z2));
+			__m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(x1, x2), _mm_max_ps(y1, y2)), _mm_max_ps(z1, z2));
+			entry = _mm_max_ps(entry, zero);
+
+			// A lane takes the hit if the ray is inside the box for some stretch, and that stretch starts no further than the lane's best so far.
+			__m128 hit = _mm_and_ps(_mm_cmple_ps(entry, exit), _mm_cmple_ps(entry, best));
+			best = _mm_or_ps(_mm_and_ps(hit, entry), _mm_andnot_ps(hit, best));
+			__m128i hitMask = _mm_castps_si128(hit);
+			bestIndex = _mm_or_si128(_mm_and_si128(hitMask, index), _mm_andnot_si128(hitMask, bestIndex));
+
+			index = _mm_add_epi32(index, four);
+		}
+
+		alignas(16) float laneBest[4];
+		alignas(16) int laneIndex[4];
+		_mm_store_ps(laneBest, best);
+		_mm_store_si128((__m128i*)laneIndex, bestIndex);
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			if (laneIndex[lane] >= 0 && (closestIndex < 0 || laneBest[lane] < closest || (laneBest[lane] == closest && laneIndex[lane] > closestIndex)))
+			{
+				closest = laneBest[lane];
+				closestIndex = laneIndex[lane];
+			}
+		}
+#else
+		for (int i = 0; i < candidates.count; i++)
+		{
+			float x1 = (candidates.minX[i] - ray.halfExtents.x - ray.origin.x) * inverse.x;
+			float x2 = (candidates.maxX[i] + ray.halfExtents.x - ray.origin.x) * inverse.x;
+			float y1 = (candidates.minY[i] - ray.halfExtents.y - ray.origin.y) * inverse.y;
+			float y2 = (candidates.maxY[i] + ray.halfExtents.y - ray.origin.y) * inverse.y;
+			float z1 = (candidates.minZ[i] - ray.halfExtents.z - ray.origin.z) * inverse.z;
+			float z2 = (candidates.maxZ[i] + ray.halfExtents.z - ray.origin.z) * inverse.z;
+
+			float entry = std::max(std::max(std::min(x1, x2), std::min(y1, y2)), std::min(z1, z2));
+			float exit = std::min(std::min(std::max(x1, x2), std::max(y1, y2)), std::max(z1, z2));
+			entry = std::max(entry, 0.0f);
+
+			if (entry <= exit && entry <= closest)
+			{
+				closest = entry;
+				closestIndex = i;
+			}
+		}
+#endif
+
+		if (closestIndex >= 0)
+		{
+			hits[r].body = candidates.ids[closestIndex];
+			hits[r].distance = closest;
+			hits[r].point = ray.origin + ray.direction * closest;
+		}
+	}
+}
+
+#endif // _QUERY_KERNELS_CPP
@@ -0,0 +1,75 @@
+/*
+Title: Swept AABB-3D
+File Name: QueryKernels.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Batch query kernels: test a group of rays (or moving boxes) against the bodies of a world
+snapshot in one go. The boxes near the whole group are copied into a small, tightly packed
+buffer once, and then each ray is tested against four boxes per instruction with SSE (or one
+at a time where SSE isn't available).
+*/
+
+#ifndef _QUERY_KERNELS_H
+#define _QUERY_KERNELS_H
+
+#include "WorldSnapshot.h"
+#include <vector>
+
+// Use SSE when the compiler targets it. GCC and Clang define __SSE2__; MSVC always has it on x64, and on x86 when /arch:SSE2 (the default) is on.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QUERY_KERNELS_SSE
+#endif
+
+// A ray, or a box moving along a line. For a moving box, origin is the box's center and halfExtents is half its size;
+// testing a box against another box is the same as testing its center against the other box grown by halfExtents.
+struct QueryRay
+{
+	glm::vec3 origin;
+	glm::vec3 direction;
+	float maxDistance;		// In multiples of direction.
+	glm::vec3 halfExtents;	// Zero for a plain ray.
+};
+
+// Boxes copied out of a snapshot into aligned arrays whose length is a multiple of four.
+struct QueryCandidates
+{
+	std::vector<int> ids;
+	float* minX; float* minY; float* minZ;
+	float* maxX; float* maxY; float* maxZ;
+	int count;		// Real boxes.
+	int padded;		// count rounded up to a multiple of four. The extra slots repeat the last real box, so they can never change a result.
+	int capacity;
+
+	QueryCandidates();
+	~QueryCandidates();
+
+	// Copies every box in the snapshot that overlaps bounds.
+	void Gather(const WorldSnapshot& snapshot, const AABB& bounds);
+};
+
+// The box that contains every ray in the list over its whole length (grown by its halfExtents).
+AABB QueryBounds(const QueryRay* rays, int numRays);
+
+// Finds the closest hit for each ray among the candidates. hits[i] gets the result for rays[i].
+void RaycastBatch(const QueryCandidates& candidates, const QueryRay* rays, int numRays, RayHit* hits);
+
+#endif //_QUERY_KERNELS_H
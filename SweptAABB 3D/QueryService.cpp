@@ -0,0 +1,214 @@
+/*
+Title: Swept AABB-3D
+File Name: QueryService.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Collects raycasts and box sweeps from any number of threads and answers them in batches, once
+per physics step, on the worker pool. Queries are sorted so that queries close to each other in
+space end up in the same batch, and each batch only has to look at the bodies near it. Every
+query is answered against the last finished step (see SnapshotManager). The answer comes back
+through a std::future, or a callback that runs on a worker thread.
+*/
+
+#ifndef _QUERY_SERVICE_CPP
+#define _QUERY_SERVICE_CPP
+
+#include "QueryService.h"
+#include <algorithm>
+#include <string>
+
+QueryService::QueryService(const AABB& worldBounds, int batchSize)
+{
+	head = nullptr;
+	bounds = worldBounds;
+	queriesPerJob = std::max(batchSize, 1);
+}
+
+QueryService::~QueryService()
+{
+	// Anyone still waiting on a future gets an empty hit rather than waiting forever.
+	Collect();
+	for (size_t i = 0; i < batch.size(); i++)
+	{
+		if (batch[i]->promise != nullptr)
+		{
+			batch[i]->promise->set_value(RayHit());
+			delete(batch[i]->promise);
+		}
+		delete(batch[i]);
+	}
+}
+
+void QueryService::Push(Query* query)
+{
+	query->next = head.load(std::memory_order_relaxed);
+	while (!head.compare_exchange_weak(query->next, query, std::memory_order_release, std::memory_order_relaxed))
+	{
+	}
+}
+
+std::future<RayHit> QueryService::Raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance)
+{
+	Query* query = new Query();
+	query->ray.origin = origin;
+	query->ray.direction = direction;
+	query->ray.maxDistance = maxDistance;
+	query->ray.halfExtents = glm::vec3(0.0f);
+	query->promise = new std::promise<RayHit>();
+
+	std::future<RayHit> result = query->promise->get_future();
+	Push(query);
+	return result;
+}
+
+void QueryService::Raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, QueryCallback callback)
+{
+	Query* query = new Query();
+	query->ray.origin = origin;
+	query->ray.direction = direction;
+	query->ray.maxDistance = maxDistance;
+	query->ray.halfExtents = glm::vec3(0.0f);
+	query->promise = nullptr;
+	query->callback = callback;
+
+	Push(query);
+}
+
+std::future<RayHit> QueryService::Sweep(const AABB& box, glm::vec3 displacement)
+{
+	Query* query = new Query();
+	query->ray.origin = (box.min + box.max) * 0.5f;
+	query->ray.direction = displacement;
+	query->ray.maxDistance = 1.0f;
+	query->ray.halfExtents = (box.max - box.min) * 0.5f;
+	query->promise = new std::promise<RayHit>();
+
+	std::future<RayHit> result = query->promise->get_future();
+	Push(query);
+	return result;
+}
+
+void QueryService::Sweep(const AABB& box, glm::vec3 displacement, QueryCallback callback)
+{
+	Query* query = new Query();
+	query->ray.origin = (box.min + box.max) * 0.5f;
+	query->ray.direction = displacement;
+	query->ray.maxDistance = 1.0f;
+	query->ray.halfExtents = (box.max - box.min) * 0.5f;
+	query->promise = nullptr;
+	query->callback = callback;
+
+	Push(query);
+}
+
+unsigned int QueryService::Key(glm::vec3 position)
+{
+	// Squash the position into 10 bits per axis inside the world bounds (anything outside is clamped to the edge),
+	// then interleave the bits, x y z x y z ... Sorting by the result keeps points that are close in space close in the list.
+	glm::vec3 size = glm::max(bounds.max - bounds.min, glm::vec3(0.0001f));
+	glm::vec3 unit = glm::clamp((position - bounds.min) / size, glm::vec3(0.0f), glm::vec3(1.0f));
+
+	unsigned int cell[3] = { (unsigned int)(unit.x * 1023.0f), (unsigned int)(unit.y * 1023.0f), (unsigned int)(unit.z * 1023.0f) };
+
+	unsigned int key = 0;
+	for (int bit = 0; bit < 10; bit++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			key |= ((cell[axis] >> bit) & 1) << (bit * 3 + axis);
+		}
+	}
+	return key;
+}
+
+bool QueryService::Collect()
+{
+	batch.clear();
+
+	Query* list = head.exchange(nullptr, std::memory_order_acquire);
+	for (Query* q = list; q != nullptr; q = q->next)
+	{
+		batch.push_back(q);
+	}
+
+	return !batch.empty();
+}
+
+void QueryService::Run(TaskGraph* graph, const WorldSnapshot* snapshot)
+{
+	// Key each query by the middle of its path, and sort. Keys that are equal keep the order the list came out in.
+	for (size_t i = 0; i < batch.size(); i++)
+	{
+		QueryRay& ray = batch[i]->ray;
+		float reach = std::min(ray.maxDistance, glm::length(bounds.max - bounds.min));
+		batch[i]->key = Key(ray.origin + ray.direction * (reach * 0.5f));
+	}
+	std::stable_sort(batch.begin(), batch.end(), [](const Query* a, const Query* b)
+	{
+		return a->key < b->key;
+	});
+
+	for (int first = 0; first < (int)batch.size(); first += queriesPerJob)
+	{
+		int last = std::min(first + queriesPerJob, (int)batch.size());
+		graph->Spawn("queries[" + std::to_string(first / queriesPerJob) + "]", [this, snapshot, first, last]()
+		{
+			RunJob(snapshot, first, last);
+		});
+	}
+}
+
+void QueryService::RunJob(const WorldSnapshot* snapshot, int first, int last)
+{
+	int count = last - first;
+
+	std::vector<QueryRay> rays(count);
+	for (int i = 0; i < count; i++)
+	{
+		rays[i] = batch[first + i]->ray;
+	}
+
+	// The queries in this job are close together, so only a few bodies are anywhere near them. Pull just those out once,
+	// and test every query against that short list.
+	QueryCandidates candidates;
+	candidates.Gather(*snapshot, QueryBounds(rays.data(), count));
+
+	std::vector<RayHit> hits(count);
+	RaycastBatch(candidates, rays.data(), count, hits.data());
+
+	for (int i = 0; i < count; i++)
+	{
+		Query* query = batch[first + i];
+		if (query->promise != nullptr)
+		{
+			query->promise->set_value(hits[i]);
+			delete(query->promise);
+		}
+		else if (query->callback)
+		{
+			query->callback(hits[i]);
+		}
+		delete(query);
+	}
+}
+
+#endif // _QUERY_SERVICE_CPP
@@ -0,0 +1,93 @@
+/*
+Title: Swept AABB-3D
+File Name: QueryService.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Collects raycasts and box sweeps from any number of threads and answers them in batches, once
+per physics step, on the worker pool. Queries are sorted so that queries close to each other in
+space end up in the same batch, and each batch only has to look at the bodies near it. Every
+query is answered against the last finished step (see SnapshotManager). The answer comes back
+through a std::future, or a callback that runs on a worker thread.
+*/
+
+#ifndef _QUERY_SERVICE_H
+#define _QUERY_SERVICE_H
+
+#include "QueryKernels.h"
+#include "TaskGraph.h"
+#include <atomic>
+#include <future>
+#include <functional>
+#include <vector>
+
+// Called on a worker thread with the result of a query. Keep it short; the step may be waiting on it.
+typedef std::function<void(const RayHit&)> QueryCallback;
+
+class QueryService
+{
+	struct Query
+	{
+		QueryRay ray;
+		std::promise<RayHit>* promise;	// Set for queries that return a future.
+		QueryCallback callback;			// Set for queries that use a callback.
+		unsigned int key;				// Where the query is in space, as a Morton code (see Key()).
+		Query* next;
+	};
+
+	// Queries are pushed onto a lock-free list the same way commands are (see CommandQueue).
+	std::atomic<Query*> head;
+
+	// The queries taken for the current batch.
+	std::vector<Query*> batch;
+
+	// Used to turn positions into Morton codes.
+	AABB bounds;
+
+	// How many queries each job answers.
+	int queriesPerJob;
+
+	void Push(Query* query);
+	unsigned int Key(glm::vec3 position);
+	void RunJob(const WorldSnapshot* snapshot, int first, int last);
+
+public:
+	QueryService(const AABB& worldBounds, int batchSize = 32);
+	~QueryService();
+
+	// Casts a ray from origin along direction, up to maxDistance times the length of direction.
+	std::future<RayHit> Raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance);
+	void Raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, QueryCallback callback);
+
+	// Moves box by displacement and reports the first body it touches. The distance in the hit is the fraction of the displacement
+	// travelled before touching (0 to 1, like the time SweptAABB() returns), and the point is where the box's center is at that moment.
+	std::future<RayHit> Sweep(const AABB& box, glm::vec3 displacement);
+	void Sweep(const AABB& box, glm::vec3 displacement, QueryCallback callback);
+
+	// For the physics step: takes every query pushed so far into the next batch. Returns false if there weren't any.
+	bool Collect();
+
+	// For the physics step, from inside a running task: sorts the collected batch and spawns a child task per group of queries,
+	// each answering its queries against snapshot. The snapshot has to stay alive until the graph has finished.
+	void Run(TaskGraph* graph, const WorldSnapshot* snapshot);
+};
+
+#endif //_QUERY_SERVICE_H
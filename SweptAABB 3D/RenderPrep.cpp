@@ -0,0 +1,220 @@
+/*
+Title: Swept AABB-3D
+File Name: RenderPrep.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Gets a frame ready to draw on the worker pool: culls against the view frustum, packs the MVP
+matrices, groups the draws by mesh and builds the indirect command list, one chunk of objects
+per job.
+*/
+
+#ifndef _RENDER_PREP_CPP
+#define _RENDER_PREP_CPP
+
+#include "RenderPrep.h"
+#include <cstring>
+
+RenderPrep::RenderPrep(JobSystem* jobSystem, int chunkSize)
+{
+	jobs = jobSystem;
+	itemsPerChunk = chunkSize > 0 ? chunkSize : 1;
+	numVisible = 0;
+}
+
+void RenderPrep::ForEachChunk(int numChunks, const std::function<void(int)>& work)
+{
+	// Not worth waking anyone up for.
+	if (numChunks == 1)
+	{
+		work(0);
+		return;
+	}
+
+	JobCounter counter;
+	for (int chunk = 0; chunk < numChunks; chunk++)
+	{
+		jobs->Submit([&work, chunk]()
+		{
+			work(chunk);
+		}, &counter);
+	}
+	jobs->Wait(&counter);
+}
+
+void RenderPrep::Prepare(const std::vector<Model*>& models, const std::vector<glm::mat4>& transforms, const CullBoxes* boxes,
+	const glm::mat4& viewProjection, std::vector<RenderItem>& items, MeshArena* arena)
+{
+	int numItems = (int)transforms.size();
+	int numChunks = (numItems + itemsPerChunk - 1) / itemsPerChunk;
+
+	items.resize(numItems);
+	commandList.commands.clear();
+	commandList.instances.clear();
+	numVisible = 0;
+	if (numItems == 0)
+	{
+		return;
+	}
+
+	Frustum frustum(viewProjection);
+	itemVisible.resize(numItems);
+	chunkVisible.resize(numChunks);
+
+	bool buildCommands = arena != nullptr && arena->IsSupported();
+	int knownMeshes = buildCommands ? arena->NumMeshes() : 0;
+	if (buildCommands)
+	{
+		itemMeshes.resize(numItems);
+		chunkSlots.resize(numChunks);
+		chunkMisses.resize(numChunks);
+	}
+
+	// 1. Cull, pack the matrices, and count each chunk's items by mesh. Looking meshes up only reads the arena, so every chunk can do it at once.
+	ForEachChunk(numChunks, [&](int chunk)
+	{
+		int first = chunk * itemsPerChunk;
+		int last = first + itemsPerChunk < numItems ? first + itemsPerChunk : numItems;
+
+		// The bodies come in region order, so the boxes in a chunk tend to be close together, and the box around all of them is often
+		// entirely inside or outside the frustum. Then there's no need to test them one by one.
+		FrustumTest chunkTest = boxes != nullptr ? frustum.Classify(boxes->Bounds(first, last)) : FRUSTUM_INSIDE;
+		if (chunkTest == FRUSTUM_INTERSECTS)
+		{
+			chunkVisible[chunk] = frustum.Cull(*boxes, first, last, itemVisible.data());
+		}
+		else
+		{
+			memset(itemVisible.data() + first, chunkTest == FRUSTUM_INSIDE ? 1 : 0, last - first);
+			chunkVisible[chunk] = chunkTest == FRUSTUM_INSIDE ? last - first : 0;
+		}
+
+		for (int i = first; i < last; i++)
+		{
+			items[i].model = models[i];
+			items[i].visible = itemVisible[i] != 0;
+			if (items[i].visible)
+			{
+				items[i].mvp = viewProjection * transforms[i];
+			}
+		}
+
+		if (!buildCommands)
+		{
+			return;
+		}
+
+		std::vector<int>& slots = chunkSlots[chunk];
+		std::vector<int>& misses = chunkMisses[chunk];
+		slots.assign(knownMeshes, 0);
+		misses.clear();
+		for (int i = first; i < last; i++)
+		{
+			bool drawn = itemVisible[i] != 0 && models[i]->NumIndices() > 0;
+			int mesh = drawn ? arena->FindMesh(models[i]) : -1;
+			itemMeshes[i] = mesh;
+			if (mesh >= 0)
+			{
+				slots[mesh]++;
+			}
+			else if (drawn)
+			{
+				misses.push_back(i);
+			}
+		}
+	});
+
+	for (int chunk = 0; chunk < numChunks; chunk++)
+	{
+		numVisible += chunkVisible[chunk];
+	}
+
+	if (!buildCommands)
+	{
+		return;
+	}
+
+	// Add any models the arena hasn't seen yet. This changes the arena, so it's done here, on one thread. New models are rare after the first frame.
+	for (int chunk = 0; chunk < numChunks; chunk++)
+	{
+		std::vector<int>& misses = chunkMisses[chunk];
+		for (size_t j = 0; j < misses.size(); j++)
+		{
+			int i = misses[j];
+			itemMeshes[i] = arena->AddMesh(models[i]);
+		}
+	}
+
+	// 2. Lay the instances out mesh by mesh, and within each mesh chunk by chunk, so they come out in the order the items came in.
+	// Each chunk's count for a mesh turns into where its first item of that mesh goes. Every mesh with any instances gets a command.
+	int numMeshes = arena->NumMeshes();
+	int next = 0;
+	for (int chunk = 0; chunk < numChunks; chunk++)
+	{
+		chunkSlots[chunk].resize(numMeshes, 0);
+
+		std::vector<int>& misses = chunkMisses[chunk];
+		for (size_t j = 0; j < misses.size(); j++)
+		{
+			chunkSlots[chunk][itemMeshes[misses[j]]]++;
+		}
+	}
+	for (int mesh = 0; mesh < numMeshes; mesh++)
+	{
+		int start = next;
+		for (int chunk = 0; chunk < numChunks; chunk++)
+		{
+			int count = chunkSlots[chunk][mesh];
+			chunkSlots[chunk][mesh] = next;
+			next += count;
+		}
+
+		if (next > start)
+		{
+			const ArenaMesh& arenaMesh = arena->GetMesh(mesh);
+			DrawElementsIndirectCommand command;
+			command.count = arenaMesh.numIndices;
+			command.instanceCount = (GLuint)(next - start);
+			command.firstIndex = arenaMesh.firstIndex;
+			command.baseVertex = arenaMesh.baseVertex;
+			command.baseInstance = (GLuint)start;
+			commandList.commands.push_back(command);
+		}
+	}
+
+	// 3. Copy the matrices into place. Each chunk writes to its own slots, so they don't get in each other's way.
+	commandList.instances.resize(next);
+	ForEachChunk(numChunks, [&](int chunk)
+	{
+		int first = chunk * itemsPerChunk;
+		int last = first + itemsPerChunk < numItems ? first + itemsPerChunk : numItems;
+		std::vector<int>& slots = chunkSlots[chunk];
+		for (int i = first; i < last; i++)
+		{
+			if (itemMeshes[i] >= 0)
+			{
+				commandList.instances[slots[itemMeshes[i]]++] = items[i].mvp;
+			}
+		}
+	});
+}
+
+#endif // _RENDER_PREP_CPP
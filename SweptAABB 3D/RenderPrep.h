@@ -0,0 +1,103 @@
+/*
+Title: Swept AABB-3D
+File Name: RenderPrep.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Gets a frame ready to draw on the worker pool, so that the GL thread only has to hand over the
+result. The captured transforms are split into chunks, and each chunk is a job:
+	1. Cull the chunk's boxes against the view frustum (see FrustumCull.h), first all together
+	   through the box around the whole chunk, and then one by one if that was inconclusive.
+	   Turn each visible transform into an MVP matrix, look up the model's mesh in the mesh
+	   arena, and count how many of the chunk's visible items use each mesh.
+	2. Once every chunk is counted, work out where each chunk's items of each mesh go, so that
+	   every mesh's instances end up next to each other, in the order the items came in.
+	3. Copy each chunk's MVP matrices into place.
+The result is a flat command list (see MeshArena.h): one indirect draw command per mesh and one
+matrix per instance. Drawing it is an upload and a single call, however many objects there are.
+Models the arena hasn't seen before are added between steps 1 and 2, on one thread.
+*/
+
+#ifndef _RENDER_PREP_H
+#define _RENDER_PREP_H
+
+#include "JobSystem.h"
+#include "MeshArena.h"
+#include "FrustumCull.h"
+#include <functional>
+#include <vector>
+
+// Everything the renderer needs to draw one object.
+struct RenderItem
+{
+	Model* model;
+	glm::mat4 mvp;
+
+	// False if the object is outside the view frustum. Its mvp isn't worked out then, so don't draw it.
+	bool visible;
+};
+
+class RenderPrep
+{
+	JobSystem* jobs;
+	int itemsPerChunk;
+
+	// Per item: whether it's inside the view frustum, and the mesh it draws (or -1 if it has nothing to draw, or isn't visible).
+	std::vector<unsigned char> itemVisible;
+	std::vector<int> itemMeshes;
+
+	// Per chunk: how many of its items are visible.
+	std::vector<int> chunkVisible;
+	int numVisible;
+
+	// Per chunk: how many of its items use each mesh, which is then turned into where its next item of each mesh goes.
+	std::vector<std::vector<int>> chunkSlots;
+
+	// Per chunk: the items whose models the arena didn't have yet.
+	std::vector<std::vector<int>> chunkMisses;
+
+	RenderCommandList commandList;
+
+	// Runs work(chunk) for every chunk on the worker pool, and waits for all of them. The waiting thread helps out.
+	void ForEachChunk(int numChunks, const std::function<void(int)>& work);
+
+public:
+	RenderPrep(JobSystem* jobSystem, int chunkSize = 1024);
+
+	// Turns every model and transform into a render item (MVP = viewProjection * transform). If boxes are given (boxes[i] being the world
+	// AABB of item i), items outside the view frustum are marked as not visible and left out. If an arena is given, also builds the
+	// command list for drawing the visible items from it. Blocks until it's done. Don't run this while the arena is being drawn from or changed.
+	void Prepare(const std::vector<Model*>& models, const std::vector<glm::mat4>& transforms, const CullBoxes* boxes,
+		const glm::mat4& viewProjection, std::vector<RenderItem>& items, MeshArena* arena);
+
+	// How many items the last Prepare() found inside the view frustum.
+	int NumVisible()
+	{
+		return numVisible;
+	}
+
+	const RenderCommandList& GetCommandList()
+	{
+		return commandList;
+	}
+};
+
+#endif //_RENDER_PREP_H
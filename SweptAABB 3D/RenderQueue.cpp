@@ -0,0 +1,108 @@
+/*
+Title: Swept AABB-3D
+File Name: RenderQueue.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Collects everything to be drawn in a frame, then sorts it so that draws that share a shader
+program, and within that a mesh, end up next to each other. See RenderQueue.h.
+*/
+
+#ifndef _RENDER_QUEUE_CPP
+#define _RENDER_QUEUE_CPP
+
+#include "RenderQueue.h"
+#include <algorithm>
+
+RenderQueue::RenderQueue()
+{
+	programBinds = 0;
+	meshBinds = 0;
+}
+
+GLint RenderQueue::MVPLocation(GLuint program)
+{
+	// There are only ever a handful of programs, so a short list beats a map.
+	for (size_t i = 0; i < mvpLocations.size(); i++)
+	{
+		if (mvpLocations[i].first == program)
+		{
+			return mvpLocations[i].second;
+		}
+	}
+
+	GLint location = glGetUniformLocation(program, "MVP");
+	mvpLocations.push_back(std::make_pair(program, location));
+	return location;
+}
+
+void RenderQueue::Add(GLuint program, Model* model, const glm::mat4& mvp)
+{
+	DrawItem item;
+	item.key = ((uint64_t)program << 32) | model->GetVAO();
+	item.program = program;
+	item.model = model;
+	item.mvp = mvp;
+	items.push_back(item);
+}
+
+void RenderQueue::Submit()
+{
+	std::stable_sort(items.begin(), items.end(), [](const DrawItem& a, const DrawItem& b)
+	{
+		return a.key < b.key;
+	});
+
+	programBinds = 0;
+	meshBinds = 0;
+
+	GLuint boundProgram = 0;
+	GLuint boundMesh = 0;
+	GLint mvpLocation = -1;
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		const DrawItem& item = items[i];
+
+		// Only touch the program and the vertex array when they change. A new program doesn't unbind the vertex array, so the mesh can
+		// carry on from one program into the next.
+		if (i == 0 || item.program != boundProgram)
+		{
+			glUseProgram(item.program);
+			boundProgram = item.program;
+			mvpLocation = MVPLocation(item.program);
+			programBinds++;
+		}
+		if (i == 0 || item.model->GetVAO() != boundMesh)
+		{
+			item.model->Bind();
+			boundMesh = item.model->GetVAO();
+			meshBinds++;
+		}
+
+		glUniformMatrix4fv(mvpLocation, 1, GL_FALSE, glm::value_ptr(item.mvp));
+		item.model->DrawBound();
+	}
+
+	// Leave no vertex array bound, so later buffer updates can't change one by accident.
+	glBindVertexArray(0);
+}
+
+#endif // _RENDER_QUEUE_CPP
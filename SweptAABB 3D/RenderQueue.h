@@ -0,0 +1,89 @@
+/*
+Title: Swept AABB-3D
+File Name: RenderQueue.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Collects everything to be drawn in a frame, then sorts it so that draws that share a shader
+program, and within that a mesh, end up next to each other. Switching programs and vertex
+arrays is far more expensive for the driver than a draw, so submitting in that order binds
+each program and each mesh once per run of draws that use it, rather than once per object.
+*/
+
+#ifndef _RENDER_QUEUE_H
+#define _RENDER_QUEUE_H
+
+#include "GLIncludes.h"
+#include "Model.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+struct DrawItem
+{
+	// Program in the high 32 bits and vertex array in the low, so sorting by key groups by program first, then by mesh.
+	uint64_t key;
+	GLuint program;
+	Model* model;
+	glm::mat4 mvp;
+};
+
+class RenderQueue
+{
+	std::vector<DrawItem> items;
+
+	// Where each program's "MVP" uniform is, looked up the first time the program is used.
+	std::vector<std::pair<GLuint, GLint>> mvpLocations;
+
+	// What the last Submit() had to do.
+	int programBinds;
+	int meshBinds;
+
+	GLint MVPLocation(GLuint program);
+
+public:
+	RenderQueue();
+
+	void Clear()
+	{
+		items.clear();
+	}
+
+	void Add(GLuint program, Model* model, const glm::mat4& mvp);
+
+	// Sorts by program, then mesh, and draws everything. Draws of the same mesh keep the order they were added in.
+	void Submit();
+
+	int NumItems()
+	{
+		return (int)items.size();
+	}
+	int NumProgramBinds()
+	{
+		return programBinds;
+	}
+	int NumMeshBinds()
+	{
+		return meshBinds;
+	}
+};
+
+#endif //_RENDER_QUEUE_H
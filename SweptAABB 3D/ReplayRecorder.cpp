@@ -0,0 +1,290 @@
+/*
+Title: Swept AABB-3D
+File Name: ReplayRecorder.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Records the transform of every body after each step to a replay file, through an AsyncWriter,
+so recording never makes the step wait on the disk. See ReplayRecorder.h for the layout.
+*/
+
+#ifndef _REPLAY_RECORDER_CPP
+#define _REPLAY_RECORDER_CPP
+
+#include "ReplayRecorder.h"
+#include "GameObject.h"
+#include "ByteStream.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+ReplayRecorder::ReplayRecorder()
+{
+	encoder = nullptr;
+	recordingReplay = false;
+	trajectories = nullptr;
+}
+
+ReplayRecorder::~ReplayRecorder()
+{
+	Close();
+}
+
+bool ReplayRecorder::Open(const std::string& fileName, BackpressurePolicy backpressure, const CodecSettings* codec)
+{
+	if (!writer.Open(fileName, 1 << 20, 4, backpressure))
+	{
+		return false;
+	}
+
+	// The header has to be there whatever happens, so it's written even if the policy would drop.
+	std::vector<char> header;
+	MessageWriter headerWriter(&header);
+	headerWriter.Bytes("RPLY", 4);
+	if (codec != nullptr)
+	{
+		headerWriter.U32(REPLAY_VERSION_COMPRESSED);
+		headerWriter.F32(codec->positionError);
+		headerWriter.F32(codec->velocityError);
+		headerWriter.F32(codec->rotationError);
+		headerWriter.U32((uint32_t)codec->keyframeInterval);
+
+		delete(encoder);
+		encoder = new DeltaEncoder(*codec);
+	}
+	else
+	{
+		headerWriter.U32(REPLAY_VERSION);
+	}
+	writer.Write(header.data(), header.size());
+	writer.Flush();
+
+	recordingReplay = true;
+	return true;
+}
+
+bool ReplayRecorder::OpenTrajectories(const std::string& fileName, int stepsPerChunk)
+{
+	delete(trajectories);
+	trajectories = new TrajectoryWriter();
+	if (!trajectories->Open(fileName, stepsPerChunk))
+	{
+		delete(trajectories);
+		trajectories = nullptr;
+		return false;
+	}
+	return true;
+}
+
+void ReplayRecorder::Close()
+{
+	writer.Close();
+	recordingReplay = false;
+
+	delete(encoder);
+	encoder = nullptr;
+
+	// Deleting the writer closes it, which writes out the last chunk and the directory.
+	delete(trajectories);
+	trajectories = nullptr;
+}
+
+void ReplayRecorder::Record(uint64_t step, const std::vector<GameObject*>& bodies, const std::vector<CollisionEvent>& collisions)
+{
+	if (trajectories != nullptr)
+	{
+		trajectories->Record(step, bodies, collisions);
+	}
+	if (!recordingReplay)
+	{
+		return;
+	}
+
+	record.clear();
+	MessageWriter out(&record);
+
+	if (encoder != nullptr)
+	{
+		// Leave room for the length, and fill it in once we know it.
+		out.U32(0);
+		frame.Capture(step, bodies);
+		encoder->Encode(frame, record);
+		uint32_t length = (uint32_t)(record.size() - 4);
+		memcpy(record.data(), &length, 4);
+
+		// The next frame would be coded against one the reader never sees, so start over from a keyframe.
+		if (!writer.Write(record.data(), record.size()))
+		{
+			encoder->ForceKeyframe();
+		}
+		writer.Flush();
+		return;
+	}
+
+	out.U32((uint32_t)(8 + 4 + bodies.size() * 32));
+	out.U64(step);
+	out.U32((uint32_t)bodies.size());
+	for (size_t i = 0; i < bodies.size(); i++)
+	{
+		glm::vec3 position = bodies[i]->GetPosition();
+		glm::quat rotation = bodies[i]->GetRotation();
+		out.I32(bodies[i]->GetId());
+		out.Vec3(position.x, position.y, position.z);
+		out.F32(rotation.x);
+		out.F32(rotation.y);
+		out.F32(rotation.z);
+		out.F32(rotation.w);
+	}
+
+	writer.Write(record.data(), record.size());
+	writer.Flush();
+}
+
+ReplayReader::ReplayReader()
+{
+	version = 0;
+	fileSize = 0;
+	decoder = nullptr;
+}
+
+ReplayReader::~ReplayReader()
+{
+	delete(decoder);
+}
+
+bool ReplayReader::Open(const std::string& fileName)
+{
+	file.open(fileName, std::ios::in | std::ios::binary);
+	if (!file.good())
+	{
+		std::cout << "Can't read file: " << fileName.data() << std::endl;
+		return false;
+	}
+
+	file.seekg(0, std::ios::end);
+	fileSize = file.tellg();
+	file.seekg(0, std::ios::beg);
+
+	char header[8];
+	file.read(header, sizeof(header));
+	MessageReader in(header, file.gcount());
+	char magic[4];
+	in.Bytes(magic, 4);
+	version = in.U32();
+	if (in.Failed() || memcmp(magic, "RPLY", 4) != 0 || (version != REPLAY_VERSION && version != REPLAY_VERSION_COMPRESSED))
+	{
+		std::cout << "Not a replay file: " << fileName.data() << std::endl;
+		return false;
+	}
+
+	if (version == REPLAY_VERSION_COMPRESSED)
+	{
+		char settingsBytes[16];
+		file.read(settingsBytes, sizeof(settingsBytes));
+		MessageReader settingsIn(settingsBytes, file.gcount());
+		CodecSettings codec;
+		codec.positionError = settingsIn.F32();
+		codec.velocityError = settingsIn.F32();
+		codec.rotationError = settingsIn.F32();
+		codec.keyframeInterval = (int)settingsIn.U32();
+		if (settingsIn.Failed())
+		{
+			std::cout << "Not a replay file: " << fileName.data() << std::endl;
+			return false;
+		}
+
+		delete(decoder);
+		decoder = new DeltaDecoder(codec);
+	}
+
+	return true;
+}
+
+bool ReplayReader::Next(StateFrame& frame)
+{
+	while (true)
+	{
+		uint32_t length;
+		if (!file.read((char*)&length, 4))
+		{
+			return false;
+		}
+
+		// Check the length against the file before trusting it, so a broken one can't make us allocate gigabytes for nothing.
+		if ((std::streamoff)length > fileSize - file.tellg())
+		{
+			return false;
+		}
+		record.resize(length);
+		if (!file.read(record.data(), length))
+		{
+			return false;
+		}
+
+		if (decoder != nullptr)
+		{
+			// A delta frame without the frame before it can't be decoded; skip ahead to the next keyframe.
+			if (decoder->Decode(record.data(), record.size(), frame))
+			{
+				return true;
+			}
+			continue;
+		}
+
+		MessageReader in(record.data(), record.size());
+		frame.step = in.U64();
+		uint32_t count = std::min<uint32_t>(in.U32(), (uint32_t)(record.size() / 32));
+
+		std::vector<std::pair<int, int>> order(count);
+		std::vector<glm::vec3> positions(count);
+		std::vector<glm::quat> rotations(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			order[i] = std::make_pair(in.I32(), (int)i);
+			positions[i].x = in.F32();
+			positions[i].y = in.F32();
+			positions[i].z = in.F32();
+			rotations[i].x = in.F32();
+			rotations[i].y = in.F32();
+			rotations[i].z = in.F32();
+			rotations[i].w = in.F32();
+		}
+		if (in.Failed())
+		{
+			return false;
+		}
+		std::sort(order.begin(), order.end());
+
+		frame.ids.resize(count);
+		frame.positions.resize(count);
+		frame.velocities.assign(count, glm::vec3(0.0f));
+		frame.rotations.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			frame.ids[i] = order[i].first;
+			frame.positions[i] = positions[order[i].second];
+			frame.rotations[i] = rotations[order[i].second];
+		}
+		return true;
+	}
+}
+
+#endif // _REPLAY_RECORDER_CPP
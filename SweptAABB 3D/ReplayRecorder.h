@@ -0,0 +1,134 @@
+/*
+Title: Swept AABB-3D
+File Name: ReplayRecorder.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Records the transform of every body after each step to a replay file, through an AsyncWriter,
+so recording never makes the step wait on the disk. Replays can be recorded compressed (see
+DeltaCodec.h), which also records velocities, and read back with a ReplayReader.
+
+Replay file (little-endian):
+	char[4] magic			"RPLY"
+	uint32 version			REPLAY_VERSION, or REPLAY_VERSION_COMPRESSED
+	Compressed only:
+	float positionError		The CodecSettings the frames were encoded with.
+	float velocityError
+	float rotationError
+	uint32 keyframeInterval
+then one record per step:
+	uint32 length			Bytes in the rest of the record.
+	Uncompressed:
+	uint64 step
+	uint32 count
+	count times: int32 id, vec3 position, quat rotation (x, y, z, w)
+	Compressed:
+	One frame from DeltaEncoder.
+If the writer dropped steps (see BACKPRESSURE_DROP), the step numbers jump. A compressed replay
+makes the frame after a dropped one a keyframe.
+
+The recorder can also export every step's positions, velocities and collisions to a columnar
+trajectory file for offline analysis (see TrajectoryFile.h), with or without a replay.
+*/
+
+#ifndef _REPLAY_RECORDER_H
+#define _REPLAY_RECORDER_H
+
+#include "AsyncWriter.h"
+#include "DeltaCodec.h"
+#include "TrajectoryFile.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+class GameObject;
+
+const uint32_t REPLAY_VERSION = 1;
+const uint32_t REPLAY_VERSION_COMPRESSED = 2;
+
+class ReplayRecorder
+{
+	AsyncWriter writer;
+
+	// The record being put together, kept between steps so it doesn't have to be allocated every time.
+	std::vector<char> record;
+
+	// Only used for compressed replays.
+	DeltaEncoder* encoder;
+	StateFrame frame;
+
+	bool recordingReplay;
+	TrajectoryWriter* trajectories;
+
+public:
+	ReplayRecorder();
+	~ReplayRecorder();
+
+	// By default a step is dropped, rather than holding up the simulation, if the disk can't keep up.
+	// Pass codec settings to record compressed, to within the errors they ask for.
+	bool Open(const std::string& fileName, BackpressurePolicy backpressure = BACKPRESSURE_DROP, const CodecSettings* codec = nullptr);
+
+	// Also (or only, if Open() isn't called) exports trajectories, in chunks of stepsPerChunk steps.
+	bool OpenTrajectories(const std::string& fileName, int stepsPerChunk = 64);
+
+	// Closes the replay and the trajectory file, whichever are open.
+	void Close();
+
+	// Writes one step. Call this from one thread at a time, once the step's solve is done.
+	void Record(uint64_t step, const std::vector<GameObject*>& bodies, const std::vector<CollisionEvent>& collisions);
+
+	AsyncWriter* GetWriter()
+	{
+		return &writer;
+	}
+};
+
+// Plays back a replay file, compressed or not, one step at a time.
+class ReplayReader
+{
+	std::ifstream file;
+	uint32_t version;
+
+	// How big the file was when it was opened. A record can't be longer than what's left of it.
+	std::streamoff fileSize;
+	std::vector<char> record;
+
+	// Only used for compressed replays.
+	DeltaDecoder* decoder;
+
+public:
+	ReplayReader();
+	~ReplayReader();
+
+	bool Open(const std::string& fileName);
+
+	// Reads the next step into frame (sorted by id; velocities are zero in an uncompressed replay). Returns false at the end of the
+	// file, or if the rest of it is broken (a replay that was still being written can end halfway through a record).
+	bool Next(StateFrame& frame);
+
+	uint32_t GetVersion()
+	{
+		return version;
+	}
+};
+
+#endif //_REPLAY_RECORDER_H
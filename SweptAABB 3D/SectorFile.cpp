@@ -0,0 +1,268 @@
+/*
+Title: Swept AABB-3D
+File Name: SectorFile.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Reads and writes the binary scene format that streamed worlds are stored in. The world is cut
+into cube-shaped sectors, and each sector is one file holding the meshes its bodies use and
+the bodies themselves. See SectorFile.h for the layout.
+*/
+
+#ifndef _SECTOR_FILE_CPP
+#define _SECTOR_FILE_CPP
+
+#include "SectorFile.h"
+#include "CollisionProxy.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+void WriteMesh(MessageWriter& writer, const SectorMesh& mesh)
+{
+	writer.U32((uint32_t)mesh.vertices.size());
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+	{
+		const VertexFormat& vertex = mesh.vertices[i];
+		writer.Vec3(vertex.position.x, vertex.position.y, vertex.position.z);
+		writer.F32(vertex.color.r);
+		writer.F32(vertex.color.g);
+		writer.F32(vertex.color.b);
+		writer.F32(vertex.color.a);
+	}
+
+	writer.U32((uint32_t)mesh.indices.size());
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+	{
+		writer.U32(mesh.indices[i]);
+	}
+
+	std::vector<glm::vec3> proxy = mesh.collisionProxy;
+	if (proxy.empty() && !mesh.vertices.empty())
+	{
+		proxy = BuildCollisionProxy(mesh.vertices.data(), (int)mesh.vertices.size());
+	}
+	writer.U32((uint32_t)proxy.size());
+	for (size_t i = 0; i < proxy.size(); i++)
+	{
+		writer.Vec3(proxy[i].x, proxy[i].y, proxy[i].z);
+	}
+}
+
+bool ReadMesh(MessageReader& reader, size_t length, SectorMesh& mesh, uint32_t version)
+{
+	// Check each count against the length of the data before making room for it, so a broken file can't make us allocate gigabytes.
+	uint32_t numVertices = reader.U32();
+	if (reader.Failed() || numVertices > length / 28)
+	{
+		return false;
+	}
+	mesh.vertices.resize(numVertices);
+	for (uint32_t i = 0; i < numVertices; i++)
+	{
+		VertexFormat& vertex = mesh.vertices[i];
+		vertex.position.x = reader.F32();
+		vertex.position.y = reader.F32();
+		vertex.position.z = reader.F32();
+		vertex.color.r = reader.F32();
+		vertex.color.g = reader.F32();
+		vertex.color.b = reader.F32();
+		vertex.color.a = reader.F32();
+	}
+
+	uint32_t numIndices = reader.U32();
+	if (reader.Failed() || numIndices > length / 4)
+	{
+		return false;
+	}
+	mesh.indices.resize(numIndices);
+	for (uint32_t i = 0; i < numIndices; i++)
+	{
+		mesh.indices[i] = reader.U32();
+		if (mesh.indices[i] >= numVertices)
+		{
+			return false;
+		}
+	}
+
+	mesh.collisionProxy.clear();
+	if (version >= 2)
+	{
+		uint32_t numProxy = reader.U32();
+		if (reader.Failed() || numProxy > length / 12)
+		{
+			return false;
+		}
+		mesh.collisionProxy.resize(numProxy);
+		for (uint32_t i = 0; i < numProxy; i++)
+		{
+			mesh.collisionProxy[i].x = reader.F32();
+			mesh.collisionProxy[i].y = reader.F32();
+			mesh.collisionProxy[i].z = reader.F32();
+		}
+	}
+
+	return !reader.Failed();
+}
+
+bool ReadSector(const std::string& fileName, SectorData& sector)
+{
+	std::ifstream file(fileName, std::ios::in | std::ios::binary);
+
+	if (!file.good())
+	{
+		std::cout << "Can't read file: " << fileName.data() << std::endl;
+		return false;
+	}
+
+	std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	file.close();
+
+	MessageReader reader(data.data(), data.size());
+
+	char magic[4];
+	reader.Bytes(magic, 4);
+	uint32_t version = reader.U32();
+	if (reader.Failed() || memcmp(magic, "SCTR", 4) != 0 || version < 1 || version > SECTOR_FILE_VERSION)
+	{
+		std::cout << "Not a version 1 to " << SECTOR_FILE_VERSION << " sector file: " << fileName.data() << std::endl;
+		return false;
+	}
+
+	sector.x = reader.I32();
+	sector.y = reader.I32();
+	sector.z = reader.I32();
+
+	uint32_t numMeshes = reader.U32();
+	if (reader.Failed() || numMeshes > data.size() / 8)
+	{
+		std::cout << "Broken sector file: " << fileName.data() << std::endl;
+		return false;
+	}
+	sector.meshes.resize(numMeshes);
+	for (uint32_t i = 0; i < numMeshes; i++)
+	{
+		if (!ReadMesh(reader, data.size(), sector.meshes[i], version))
+		{
+			std::cout << "Broken mesh in sector file: " << fileName.data() << std::endl;
+			return false;
+		}
+	}
+
+	uint32_t numBodies = reader.U32();
+	if (reader.Failed() || numBodies > data.size() / 56)
+	{
+		std::cout << "Broken sector file: " << fileName.data() << std::endl;
+		return false;
+	}
+	sector.bodies.resize(numBodies);
+	for (uint32_t i = 0; i < numBodies; i++)
+	{
+		SectorBody& body = sector.bodies[i];
+		body.mesh = (int)reader.U32();
+		body.position.x = reader.F32(); body.position.y = reader.F32(); body.position.z = reader.F32();
+		body.velocity.x = reader.F32(); body.velocity.y = reader.F32(); body.velocity.z = reader.F32();
+		body.scale.x = reader.F32(); body.scale.y = reader.F32(); body.scale.z = reader.F32();
+		body.rotation.x = reader.F32(); body.rotation.y = reader.F32(); body.rotation.z = reader.F32(); body.rotation.w = reader.F32();
+
+		if (body.mesh < 0 || body.mesh >= (int)numMeshes)
+		{
+			std::cout << "Body uses a mesh that isn't there in sector file: " << fileName.data() << std::endl;
+			return false;
+		}
+	}
+
+	if (reader.Failed())
+	{
+		std::cout << "Sector file is cut short: " << fileName.data() << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool WriteSector(const std::string& fileName, const SectorData& sector)
+{
+	std::vector<char> data;
+	MessageWriter writer(&data);
+
+	writer.Bytes("SCTR", 4);
+	writer.U32(SECTOR_FILE_VERSION);
+	writer.I32(sector.x);
+	writer.I32(sector.y);
+	writer.I32(sector.z);
+
+	writer.U32((uint32_t)sector.meshes.size());
+	for (size_t i = 0; i < sector.meshes.size(); i++)
+	{
+		WriteMesh(writer, sector.meshes[i]);
+	}
+
+	writer.U32((uint32_t)sector.bodies.size());
+	for (size_t i = 0; i < sector.bodies.size(); i++)
+	{
+		const SectorBody& body = sector.bodies[i];
+		writer.U32((uint32_t)body.mesh);
+		writer.Vec3(body.position.x, body.position.y, body.position.z);
+		writer.Vec3(body.velocity.x, body.velocity.y, body.velocity.z);
+		writer.Vec3(body.scale.x, body.scale.y, body.scale.z);
+		writer.F32(body.rotation.x);
+		writer.F32(body.rotation.y);
+		writer.F32(body.rotation.z);
+		writer.F32(body.rotation.w);
+	}
+
+	// Write to a temporary file and only rename it into place once it's all there, so a streamer loading this sector never sees half of it,
+	// and a crash or a full disk partway through leaves the old sector as it was.
+	std::string tempName = fileName + ".tmp";
+	std::ofstream file(tempName, std::ios::out | std::ios::binary);
+
+	if (!file.good())
+	{
+		std::cout << "Can't write file: " << tempName.data() << std::endl;
+		return false;
+	}
+
+	file.write(data.data(), data.size());
+	file.close();
+	if (file.fail())
+	{
+		std::cout << "Can't write file: " << tempName.data() << std::endl;
+		std::remove(tempName.data());
+		return false;
+	}
+
+	// rename won't replace an existing file on Windows, so clear the old sector out of the way first. Elsewhere rename replaces it in one go.
+#ifdef _WIN32
+	std::remove(fileName.data());
+#endif
+	if (std::rename(tempName.data(), fileName.data()) != 0)
+	{
+		std::cout << "Can't write file: " << fileName.data() << std::endl;
+		std::remove(tempName.data());
+		return false;
+	}
+
+	return true;
+}
+
+#endif // _SECTOR_FILE_CPP
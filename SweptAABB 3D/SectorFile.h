@@ -0,0 +1,90 @@
+/*
+Title: Swept AABB-3D
+File Name: SectorFile.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Reads and writes the binary scene format that streamed worlds are stored in. The world is cut
+into cube-shaped sectors, and each sector is one file holding the meshes its bodies use and
+the bodies themselves. Static geometry is just bodies with no velocity.
+Each mesh also carries the collision proxy built from it, so that loading a sector doesn't have
+to build them all over again. Version 1 files don't have them; they're built as those load.
+
+Sector file (all values little-endian, floats 32-bit, vec3 is three floats, quat is x, y, z, w):
+	char[4] magic			"SCTR"
+	uint32 version			SECTOR_FILE_VERSION
+	int32 x, y, z			Which sector this is.
+	uint32 meshCount, then meshCount meshes:
+		uint32 vertexCount, then per vertex: vec3 position, float r, g, b, a
+		uint32 indexCount, then indexCount uint32 indices
+		uint32 proxyCount, then proxyCount vec3 positions	The collision proxy (see CollisionProxy.h). Not in version 1 files.
+	uint32 bodyCount, then bodyCount bodies:
+		uint32 mesh				Index into this file's meshes.
+		vec3 position			In world space.
+		vec3 velocity
+		vec3 scale
+		quat rotation
+*/
+
+#ifndef _SECTOR_FILE_H
+#define _SECTOR_FILE_H
+
+#include "GLIncludes.h"
+#include "ByteStream.h"
+#include <string>
+#include <vector>
+
+const uint32_t SECTOR_FILE_VERSION = 2;
+
+struct SectorMesh
+{
+	std::vector<VertexFormat> vertices;
+	std::vector<GLuint> indices;
+
+	// Empty if the mesh was read from a file that didn't have one.
+	std::vector<glm::vec3> collisionProxy;
+};
+
+struct SectorBody
+{
+	int mesh;
+	glm::vec3 position;
+	glm::vec3 velocity;
+	glm::vec3 scale;
+	glm::quat rotation;
+};
+
+struct SectorData
+{
+	int x, y, z;
+	std::vector<SectorMesh> meshes;
+	std::vector<SectorBody> bodies;
+};
+
+// A mesh on its own, in the same layout as in a sector file. A mesh with no collision proxy gets one built for it as it's written.
+void WriteMesh(MessageWriter& writer, const SectorMesh& mesh);
+bool ReadMesh(MessageReader& reader, size_t length, SectorMesh& mesh, uint32_t version = SECTOR_FILE_VERSION);
+
+// Returns false, and says why, if the file can't be read or isn't a valid sector. Files from any earlier version can still be read.
+bool ReadSector(const std::string& fileName, SectorData& sector);
+bool WriteSector(const std::string& fileName, const SectorData& sector);
+
+#endif //_SECTOR_FILE_H
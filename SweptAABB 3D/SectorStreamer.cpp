@@ -0,0 +1,310 @@
+/*
+Title: Swept AABB-3D
+File Name: SectorStreamer.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Streams a world in and out in sectors (see SectorFile.h), so only the part near the points
+of interest (players, cameras, ...) is in memory. Sector files are read on background I/O
+threads. The bodies they hold are only added to the world in Update(), which is called
+between steps, so a whole sector goes into the next step's broadphase at once and no step
+ever sees half of one. Sectors that every point of interest has moved far away from are
+evicted, along with their bodies and meshes.
+*/
+
+#ifndef _SECTOR_STREAMER_CPP
+#define _SECTOR_STREAMER_CPP
+
+#include "SectorStreamer.h"
+#include "MeshOptimizer.h"
+#include "CollisionProxy.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+SectorStreamer::SectorStreamer(WorldPartition* partition, const StreamerSettings& streamerSettings)
+{
+	world = partition;
+	settings = streamerSettings;
+	updates = 0;
+	stopping = false;
+	meshArena = nullptr;
+
+	for (int i = 0; i < std::max(settings.ioThreads, 1); i++)
+	{
+		threads.push_back(std::thread(&SectorStreamer::IoLoop, this));
+	}
+}
+
+SectorStreamer::~SectorStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		queue.clear();
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i].join();
+	}
+
+	for (size_t i = 0; i < finished.size(); i++)
+	{
+		delete(finished[i].data);
+	}
+	while (!loaded.empty())
+	{
+		Evict(loaded.begin());
+	}
+	for (size_t i = 0; i < retiredModels.size(); i++)
+	{
+		DeleteModel(retiredModels[i].second);
+	}
+}
+
+std::string SectorStreamer::FileName(int x, int y, int z)
+{
+	return settings.directory + "/sector_" + std::to_string(x) + "_" + std::to_string(y) + "_" + std::to_string(z) + ".bin";
+}
+
+void SectorStreamer::IoLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		wake.wait(lock, [this]() { return stopping || !queue.empty(); });
+		if (stopping)
+		{
+			return;
+		}
+
+		SectorKey key = queue.front();
+		queue.pop_front();
+
+		// Read without holding the lock, so the stepping thread never waits on the disk.
+		lock.unlock();
+
+		SectorData* data = new SectorData();
+		std::string fileName = FileName(key.x, key.y, key.z);
+		if (std::ifstream(fileName).good() && !ReadSector(fileName, *data))
+		{
+			// ReadSector() has already said what was wrong; load the sector empty, so we don't keep trying.
+			delete(data);
+			data = new SectorData();
+		}
+
+		// Reorder the meshes for the vertex cache while we're still off the stepping thread. Collision doesn't care what order the
+		// triangles are in, so meshes that are never drawn are left alone.
+		if (settings.createBuffers)
+		{
+			for (size_t i = 0; i < data->meshes.size(); i++)
+			{
+				OptimizeMesh(data->meshes[i].vertices, data->meshes[i].indices);
+			}
+		}
+
+		// Older files don't have collision proxies saved with their meshes. Build them here too, rather than in Insert().
+		for (size_t i = 0; i < data->meshes.size(); i++)
+		{
+			SectorMesh& mesh = data->meshes[i];
+			if (mesh.collisionProxy.empty() && !mesh.vertices.empty())
+			{
+				mesh.collisionProxy = BuildCollisionProxy(mesh.vertices.data(), (int)mesh.vertices.size());
+			}
+		}
+
+		lock.lock();
+		FinishedLoad load;
+		load.key = key;
+		load.data = data;
+		finished.push_back(load);
+	}
+}
+
+float SectorStreamer::DistanceTo(const SectorKey& key)
+{
+	// Distance from the nearest point of interest to the nearest point of the sector.
+	glm::vec3 min = glm::vec3(key.x, key.y, key.z) * settings.sectorSize;
+	glm::vec3 max = min + glm::vec3(settings.sectorSize);
+
+	float nearest = INFINITY;
+	for (size_t i = 0; i < pointsOfInterest.size(); i++)
+	{
+		glm::vec3 outside = glm::max(min - pointsOfInterest[i], glm::max(pointsOfInterest[i] - max, glm::vec3(0.0f)));
+		nearest = std::min(nearest, glm::length(outside));
+	}
+	return nearest;
+}
+
+void SectorStreamer::Insert(const SectorKey& key, SectorData* data)
+{
+	LoadedSector& sector = loaded[key];
+
+	for (size_t i = 0; i < data->meshes.size(); i++)
+	{
+		SectorMesh& mesh = data->meshes[i];
+		sector.models.push_back(new Model((int)mesh.vertices.size(), mesh.vertices.data(), (int)mesh.indices.size(), mesh.indices.data(), settings.createBuffers,
+			(int)mesh.collisionProxy.size(), mesh.collisionProxy.data()));
+	}
+
+	for (size_t i = 0; i < data->bodies.size(); i++)
+	{
+		SectorBody& source = data->bodies[i];
+		GameObject* body = world->CreateBody(sector.models[source.mesh], source.position);
+		if (body == nullptr)
+		{
+			// CreateBody() has already said the region is full.
+			continue;
+		}
+
+		body->SetVelocity(source.velocity);
+		body->SetScale(source.scale);
+		body->SetRotation(source.rotation);
+		body->CalculateAABB();
+		sector.bodies.push_back(body->GetId());
+	}
+}
+
+void SectorStreamer::Evict(std::map<SectorKey, LoadedSector>::iterator sector)
+{
+	// A body is evicted with the sector it was loaded from, wherever it has moved to since.
+	for (size_t i = 0; i < sector->second.bodies.size(); i++)
+	{
+		world->DestroyBody(sector->second.bodies[i]);
+	}
+	for (size_t i = 0; i < sector->second.models.size(); i++)
+	{
+		retiredModels.push_back(std::make_pair(updates, sector->second.models[i]));
+	}
+	loaded.erase(sector);
+}
+
+void SectorStreamer::DeleteModel(Model* model)
+{
+	if (meshArena != nullptr)
+	{
+		meshArena->Remove(model);
+	}
+	delete(model);
+}
+
+void SectorStreamer::Update()
+{
+	updates++;
+
+	// Models evicted two updates ago can't be in anyone's render items anymore.
+	for (size_t i = 0; i < retiredModels.size();)
+	{
+		if (retiredModels[i].first + 2 <= updates)
+		{
+			DeleteModel(retiredModels[i].second);
+			retiredModels[i] = retiredModels.back();
+			retiredModels.pop_back();
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	// Take whatever the I/O threads have finished, and add it to the world all in one go.
+	std::vector<FinishedLoad> arrived;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		arrived.swap(finished);
+	}
+	for (size_t i = 0; i < arrived.size(); i++)
+	{
+		requested.erase(arrived[i].key);
+
+		// Something may have moved away again while the sector was loading.
+		if (DistanceTo(arrived[i].key) <= settings.unloadRadius)
+		{
+			Insert(arrived[i].key, arrived[i].data);
+		}
+		delete(arrived[i].data);
+	}
+
+	// Evict sectors that are out of range of every point of interest.
+	for (std::map<SectorKey, LoadedSector>::iterator i = loaded.begin(); i != loaded.end();)
+	{
+		std::map<SectorKey, LoadedSector>::iterator next = std::next(i);
+		if (DistanceTo(i->first) > settings.unloadRadius)
+		{
+			Evict(i);
+		}
+		i = next;
+	}
+
+	// Find every sector in range that we don't have yet, closest first.
+	std::vector<std::pair<float, SectorKey>> wanted;
+	for (size_t p = 0; p < pointsOfInterest.size(); p++)
+	{
+		glm::ivec3 low = glm::ivec3(glm::floor((pointsOfInterest[p] - settings.loadRadius) / settings.sectorSize));
+		glm::ivec3 high = glm::ivec3(glm::floor((pointsOfInterest[p] + settings.loadRadius) / settings.sectorSize));
+		for (int x = low.x; x <= high.x; x++)
+		{
+			for (int y = low.y; y <= high.y; y++)
+			{
+				for (int z = low.z; z <= high.z; z++)
+				{
+					SectorKey key = { x, y, z };
+					float distance = DistanceTo(key);
+					if (distance <= settings.loadRadius && loaded.find(key) == loaded.end())
+					{
+						wanted.push_back(std::make_pair(distance, key));
+					}
+				}
+			}
+		}
+	}
+	std::sort(wanted.begin(), wanted.end(), [](const std::pair<float, SectorKey>& a, const std::pair<float, SectorKey>& b)
+	{
+		return a.first < b.first || (a.first == b.first && a.second < b.second);
+	});
+
+	// Replace the I/O threads' queue with what we want now. Anything that was queued and isn't wanted anymore is dropped before it's read.
+	// Sectors an I/O thread has already started on stay requested until they come back.
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < queue.size(); i++)
+		{
+			requested.erase(queue[i]);
+		}
+		queue.clear();
+
+		for (size_t i = 0; i < wanted.size(); i++)
+		{
+			if ((int)(loaded.size() + requested.size()) >= settings.maxSectors)
+			{
+				break;
+			}
+			if (requested.insert(wanted[i].second).second)
+			{
+				queue.push_back(wanted[i].second);
+			}
+		}
+	}
+	wake.notify_all();
+}
+
+#endif // _SECTOR_STREAMER_CPP
@@ -0,0 +1,181 @@
+/*
+Title: Swept AABB-3D
+File Name: SectorStreamer.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Streams a world in and out in sectors (see SectorFile.h), so only the part near the points
+of interest (players, cameras, ...) is in memory. Sector files are read on background I/O
+threads. The bodies they hold are only added to the world in Update(), which is called
+between steps, so a whole sector goes into the next step's broadphase at once and no step
+ever sees half of one. Sectors that every point of interest has moved far away from are
+evicted, along with their bodies and meshes.
+*/
+
+#ifndef _SECTOR_STREAMER_H
+#define _SECTOR_STREAMER_H
+
+#include "WorldPartition.h"
+#include "SectorFile.h"
+#include "MeshArena.h"
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct StreamerSettings
+{
+	// Where the sector files are. Sector (x, y, z) is in "sector_x_y_z.bin"; a missing file is an empty sector.
+	std::string directory;
+
+	// Sector (x, y, z) covers sectorSize * (x, y, z) to sectorSize * (x + 1, y + 1, z + 1).
+	float sectorSize;
+
+	// Sectors closer than loadRadius to a point of interest are loaded. They're evicted once they're further than unloadRadius
+	// from all of them; the gap keeps a sector from being loaded and evicted over and over by something moving along its edge.
+	float loadRadius;
+	float unloadRadius;
+
+	// The most sectors loaded (or being loaded) at once. The closest sectors go first when there are more than this in range.
+	int maxSectors;
+
+	int ioThreads;
+
+	// Whether the meshes get OpenGL buffers, so they can be drawn. Update() then has to be called on the thread that owns the context.
+	bool createBuffers;
+
+	StreamerSettings()
+	{
+		directory = "Sectors";
+		sectorSize = 1.0f;
+		loadRadius = 2.0f;
+		unloadRadius = 3.0f;
+		maxSectors = 64;
+		ioThreads = 1;
+		createBuffers = false;
+	}
+};
+
+class SectorStreamer
+{
+	struct SectorKey
+	{
+		int x, y, z;
+
+		bool operator<(const SectorKey& other) const
+		{
+			if (x != other.x)
+			{
+				return x < other.x;
+			}
+			if (y != other.y)
+			{
+				return y < other.y;
+			}
+			return z < other.z;
+		}
+	};
+
+	// What a loaded sector put into the world, so it can all be taken out again.
+	struct LoadedSector
+	{
+		std::vector<Model*> models;
+		std::vector<int> bodies;
+	};
+
+	// A sector the I/O threads have read. Empty if the file was missing or broken.
+	struct FinishedLoad
+	{
+		SectorKey key;
+		SectorData* data;
+	};
+
+	WorldPartition* world;
+	StreamerSettings settings;
+
+	std::vector<glm::vec3> pointsOfInterest;
+
+	std::map<SectorKey, LoadedSector> loaded;
+
+	// Sectors we've asked the I/O threads for and haven't had back yet.
+	std::set<SectorKey> requested;
+
+	// Models of evicted sectors, and the update they were evicted on. The last couple of steps' render items can still point at them.
+	std::vector<std::pair<unsigned long long, Model*>> retiredModels;
+	unsigned long long updates;
+
+	// The arena the models are drawn through, if any, which has to let go of a model before it's deleted.
+	MeshArena* meshArena;
+
+	// Shared with the I/O threads.
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<SectorKey> queue;
+	std::vector<FinishedLoad> finished;
+	bool stopping;
+
+	std::vector<std::thread> threads;
+
+	void IoLoop();
+	float DistanceTo(const SectorKey& key);
+	void Insert(const SectorKey& key, SectorData* data);
+	void Evict(std::map<SectorKey, LoadedSector>::iterator sector);
+	void DeleteModel(Model* model);
+
+public:
+	SectorStreamer(WorldPartition* partition, const StreamerSettings& streamerSettings = StreamerSettings());
+
+	// Evicts every sector, so the world is left with only the bodies that weren't streamed in.
+	~SectorStreamer();
+
+	void SetPointsOfInterest(const std::vector<glm::vec3>& points)
+	{
+		pointsOfInterest = points;
+	}
+
+	// If the streamed models are drawn through a mesh arena, set it here, and each model is removed from it (see MeshArena::Remove())
+	// before it's deleted. Update() then has to be called where it's safe to change the arena: between steps, and not while it's drawing.
+	void SetMeshArena(MeshArena* arena)
+	{
+		meshArena = arena;
+	}
+
+	// Adds the sectors that have finished loading to the world, evicts the ones that are too far away, and asks for the ones that are
+	// coming into range. Only call this between steps.
+	void Update();
+
+	std::string FileName(int x, int y, int z);
+
+	int NumLoaded()
+	{
+		return (int)loaded.size();
+	}
+	int NumPending()
+	{
+		return (int)requested.size();
+	}
+};
+
+#endif //_SECTOR_STREAMER_H
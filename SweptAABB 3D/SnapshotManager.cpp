@@ -0,0 +1,178 @@
+/*
+Title: Swept AABB-3D
+File Name: SnapshotManager.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Hands out the latest world snapshot to reader threads (AI, gameplay, ...) without any locks,
+while the physics step publishes a new one at the end of every step. Old snapshots are freed
+using epochs: each reader writes down the epoch it started reading in, and a snapshot that was
+replaced in some epoch is only freed once no reader that started in or before that epoch is
+still reading.
+*/
+
+#ifndef _SNAPSHOT_MANAGER_CPP
+#define _SNAPSHOT_MANAGER_CPP
+
+#include "SnapshotManager.h"
+#include <thread>
+#include <functional>
+
+SnapshotManager::SnapshotManager()
+{
+	// Readers always get something back, even before the first step has published anything.
+	current = new WorldSnapshot();
+	globalEpoch = 1;
+
+	for (int i = 0; i < MaxReaders; i++)
+	{
+		readers[i].epoch = 0;
+	}
+}
+
+SnapshotManager::~SnapshotManager()
+{
+	// Nobody should be reading anymore by the time the manager goes away.
+	delete(current.load());
+
+	for (size_t i = 0; i < retired.size(); i++)
+	{
+		delete(retired[i].snapshot);
+	}
+	for (size_t i = 0; i < spare.size(); i++)
+	{
+		delete(spare[i]);
+	}
+}
+
+SnapshotManager::Reader SnapshotManager::Read()
+{
+	// Claim a free slot by writing the current epoch into it. The slot must be claimed before we load the snapshot pointer:
+	// that way, if a publish swaps the pointer after we've loaded it, the publisher is guaranteed to see our epoch and won't free it.
+	// Everything here uses sequentially consistent atomics, which is what makes "claim, then load" and "swap, then scan" safe against each other.
+	int start = (int)(std::hash<std::thread::id>()(std::this_thread::get_id()) % MaxReaders);
+
+	while (true)
+	{
+		for (int i = 0; i < MaxReaders; i++)
+		{
+			int slot = (start + i) % MaxReaders;
+			unsigned long long expected = 0;
+
+			if (readers[slot].epoch.load(std::memory_order_relaxed) == 0 && readers[slot].epoch.compare_exchange_strong(expected, globalEpoch.load() + 1))
+			{
+				return Reader(this, slot, current.load());
+			}
+		}
+
+		// Every slot is taken; let somebody else finish.
+		std::this_thread::yield();
+	}
+}
+
+void SnapshotManager::Leave(int slot)
+{
+	readers[slot].epoch.store(0, std::memory_order_release);
+}
+
+WorldSnapshot* SnapshotManager::Acquire()
+{
+	if (spare.empty())
+	{
+		return new WorldSnapshot();
+	}
+
+	WorldSnapshot* snapshot = spare.back();
+	spare.pop_back();
+	return snapshot;
+}
+
+void SnapshotManager::Publish(WorldSnapshot* snapshot)
+{
+	// Swap in the new snapshot, and retire the old one in the current epoch. Then move everybody on to the next epoch.
+	WorldSnapshot* old = current.exchange(snapshot);
+
+	Retired entry;
+	entry.snapshot = old;
+	entry.epoch = globalEpoch.fetch_add(1);
+	retired.push_back(entry);
+
+	// Find the oldest epoch any reader is still in. A reader that started in epoch e may have loaded any snapshot that was still current
+	// during e, which is every snapshot retired in e or later. Anything retired before the oldest reader's epoch is safe to free.
+	unsigned long long oldest = globalEpoch.load();
+	for (int i = 0; i < MaxReaders; i++)
+	{
+		unsigned long long epoch = readers[i].epoch.load();
+		if (epoch != 0 && epoch - 1 < oldest)
+		{
+			oldest = epoch - 1;
+		}
+	}
+
+	size_t kept = 0;
+	for (size_t i = 0; i < retired.size(); i++)
+	{
+		if (retired[i].epoch < oldest)
+		{
+			spare.push_back(retired[i].snapshot);
+		}
+		else
+		{
+			retired[kept++] = retired[i];
+		}
+	}
+	retired.resize(kept);
+
+	// Two spares are enough for the publisher to never allocate in steady state; free the rest.
+	while (spare.size() > 2)
+	{
+		delete(spare.back());
+		spare.pop_back();
+	}
+}
+
+SnapshotManager::Reader::Reader(SnapshotManager* snapshotManager, int readerSlot, const WorldSnapshot* worldSnapshot)
+{
+	manager = snapshotManager;
+	slot = readerSlot;
+	snapshot = worldSnapshot;
+}
+
+SnapshotManager::Reader::Reader(Reader&& other)
+{
+	manager = other.manager;
+	slot = other.slot;
+	snapshot = other.snapshot;
+
+	// The moved-from reader no longer owns the slot.
+	other.manager = nullptr;
+	other.snapshot = nullptr;
+}
+
+SnapshotManager::Reader::~Reader()
+{
+	if (manager != nullptr)
+	{
+		manager->Leave(slot);
+	}
+}
+
+#endif // _SNAPSHOT_MANAGER_CPP
@@ -0,0 +1,118 @@
+/*
+Title: Swept AABB-3D
+File Name: SnapshotManager.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Hands out the latest world snapshot to reader threads (AI, gameplay, ...) without any locks,
+while the physics step publishes a new one at the end of every step. Old snapshots are freed
+using epochs: each reader writes down the epoch it started reading in, and a snapshot that was
+replaced in some epoch is only freed once no reader that started in or before that epoch is
+still reading.
+*/
+
+#ifndef _SNAPSHOT_MANAGER_H
+#define _SNAPSHOT_MANAGER_H
+
+#include "WorldSnapshot.h"
+#include <atomic>
+#include <vector>
+
+class SnapshotManager
+{
+public:
+	// The most threads that can be reading at the same time. A reader that finds every slot taken waits for one to free up.
+	static const int MaxReaders = 64;
+
+	// Holds on to one snapshot for as long as it exists, and keeps that snapshot from being freed. Readers should keep these
+	// short-lived (one query, or one batch of queries); a reader that holds on forever keeps every newer snapshot alive too.
+	class Reader
+	{
+		SnapshotManager* manager;
+		int slot;
+		const WorldSnapshot* snapshot;
+
+		Reader(const Reader&);
+		Reader& operator=(const Reader&);
+
+	public:
+		Reader(SnapshotManager* snapshotManager, int readerSlot, const WorldSnapshot* worldSnapshot);
+		Reader(Reader&& other);
+		~Reader();
+
+		const WorldSnapshot* operator->() const
+		{
+			return snapshot;
+		}
+		const WorldSnapshot& operator*() const
+		{
+			return *snapshot;
+		}
+	};
+
+private:
+	// Each slot sits on its own cache line, so readers on different cores don't fight over the same line.
+	struct alignas(64) ReaderSlot
+	{
+		// 0 when the slot is free, otherwise the epoch the reader started in, plus one.
+		std::atomic<unsigned long long> epoch;
+	};
+
+	// A snapshot that has been replaced, and the epoch it was replaced in.
+	struct Retired
+	{
+		WorldSnapshot* snapshot;
+		unsigned long long epoch;
+	};
+
+	std::atomic<WorldSnapshot*> current;
+	std::atomic<unsigned long long> globalEpoch;
+	ReaderSlot readers[MaxReaders];
+
+	// Only touched by the thread that publishes, so it needs no lock.
+	std::vector<Retired> retired;
+
+	// Snapshots that have been freed, kept so the next publish can reuse their memory instead of allocating.
+	std::vector<WorldSnapshot*> spare;
+
+	void Leave(int slot);
+
+public:
+	SnapshotManager();
+	~SnapshotManager();
+
+	// Returns the latest published snapshot. Any thread can call this at any time, including while a step is running.
+	Reader Read();
+
+	// For the publishing thread only: returns an empty (or recycled) snapshot to fill in and then pass to Publish().
+	WorldSnapshot* Acquire();
+
+	// For the publishing thread only: makes snapshot the one new readers see, and frees any old snapshots nobody is reading anymore.
+	void Publish(WorldSnapshot* snapshot);
+
+	// How many replaced snapshots are still waiting for readers to leave.
+	int NumRetired()
+	{
+		return (int)retired.size();
+	}
+};
+
+#endif //_SNAPSHOT_MANAGER_H
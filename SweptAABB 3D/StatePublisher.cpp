@@ -0,0 +1,418 @@
+/*
+Title: Swept AABB-3D
+File Name: StatePublisher.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Publishes the transform (position and rotation) of every body after each step into a ring of
+slots in named shared memory, so that other processes (visualizers, recorders, analytics) can
+follow the simulation without copying anything through a socket and without ever making the
+step wait on them. Each slot is guarded by a sequence number, seqlock style: the publisher
+makes it odd while writing and even when done, and a reader knows what it read is good if the
+number was even and hadn't changed by the time it finished reading.
+StateSubscriber is the reading side, for use in the other process.
+*/
+
+#ifndef _STATE_PUBLISHER_CPP
+#define _STATE_PUBLISHER_CPP
+
+#include "StatePublisher.h"
+#include "GameObject.h"
+#include <iostream>
+#include <cstring>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#endif
+
+// The number of arrays in a slot: ids, then position x, y, z, then rotation x, y, z, w.
+static const int SLOT_ARRAYS = 8;
+
+static StateSlot* SlotAt(StateHeader* header, uint64_t step)
+{
+	return (StateSlot*)((char*)header + sizeof(StateHeader) + (step % header->slotCount) * header->slotSize);
+}
+
+// Every array is maxBodies 4-byte values long, one after the other, right after the slot's own header.
+static void* SlotArray(const StateSlot* slot, uint32_t maxBodies, int array)
+{
+	return (char*)slot + sizeof(StateSlot) + (size_t)array * maxBodies * 4;
+}
+
+// POSIX shared memory names have to start with a slash.
+static std::string SharedName(const std::string& name)
+{
+#ifdef _WIN32
+	return name;
+#else
+	return name.empty() || name[0] != '/' ? "/" + name : name;
+#endif
+}
+
+StatePublisher::StatePublisher()
+{
+	header = nullptr;
+	mappedSize = 0;
+	warnedFull = false;
+#ifdef _WIN32
+	mapping = nullptr;
+#else
+	handle = -1;
+#endif
+}
+
+StatePublisher::~StatePublisher()
+{
+	if (header == nullptr)
+	{
+		return;
+	}
+
+	// Readers that still have the memory mapped keep their copy of it; the name just goes away.
+#ifdef _WIN32
+	UnmapViewOfFile(header);
+	CloseHandle((HANDLE)mapping);
+#else
+	munmap(header, mappedSize);
+	close(handle);
+	shm_unlink(name.c_str());
+#endif
+}
+
+bool StatePublisher::Create(const std::string& sharedName, int slotCount, int maxBodies)
+{
+	if (header != nullptr || slotCount < 1 || maxBodies < 1)
+	{
+		return false;
+	}
+
+	name = SharedName(sharedName);
+
+	// Round each slot up to a whole number of cache lines, so the publisher writing one slot never shares a line with a reader reading another.
+	uint64_t slotSize = sizeof(StateSlot) + (uint64_t)SLOT_ARRAYS * maxBodies * 4;
+	slotSize = (slotSize + 63) & ~(uint64_t)63;
+	mappedSize = (size_t)(sizeof(StateHeader) + slotSize * slotCount);
+
+	void* memory = nullptr;
+
+#ifdef _WIN32
+	uint64_t size = mappedSize;
+	mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)(size & 0xFFFFFFFF), name.c_str());
+	if (mapping == nullptr)
+	{
+		std::cout << "Couldn't create shared memory " << name << std::endl;
+		return false;
+	}
+
+	// Windows frees a mapping once nothing has it open, so one that already exists belongs to somebody else.
+	if (GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		std::cout << "Shared memory " << name << " is already in use" << std::endl;
+		CloseHandle((HANDLE)mapping);
+		mapping = nullptr;
+		return false;
+	}
+	memory = MapViewOfFile((HANDLE)mapping, FILE_MAP_ALL_ACCESS, 0, 0, mappedSize);
+	if (memory == nullptr)
+	{
+		std::cout << "Couldn't map shared memory " << name << std::endl;
+		CloseHandle((HANDLE)mapping);
+		mapping = nullptr;
+		return false;
+	}
+#else
+	// A publisher holds a lock on its memory for as long as it has it, so memory we can lock was left behind by an earlier run that crashed.
+	// Remove that and start from scratch, but leave alone memory that another publisher is still writing to.
+	int existing = shm_open(name.c_str(), O_RDWR, 0);
+	if (existing >= 0)
+	{
+		bool inUse = flock(existing, LOCK_EX | LOCK_NB) != 0;
+		close(existing);
+		if (inUse)
+		{
+			std::cout << "Shared memory " << name << " is already in use" << std::endl;
+			return false;
+		}
+		shm_unlink(name.c_str());
+	}
+
+	handle = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (handle < 0 || flock(handle, LOCK_EX | LOCK_NB) != 0)
+	{
+		std::cout << "Couldn't create shared memory " << name << std::endl;
+		if (handle >= 0)
+		{
+			close(handle);
+			handle = -1;
+		}
+		return false;
+	}
+	if (ftruncate(handle, mappedSize) != 0 || (memory = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0)) == MAP_FAILED)
+	{
+		std::cout << "Couldn't map shared memory " << name << std::endl;
+		close(handle);
+		shm_unlink(name.c_str());
+		handle = -1;
+		return false;
+	}
+#endif
+
+	memset(memory, 0, mappedSize);
+
+	header = (StateHeader*)memory;
+	header->version = STATE_VERSION;
+	header->slotCount = (uint32_t)slotCount;
+	header->maxBodies = (uint32_t)maxBodies;
+	header->slotSize = slotSize;
+	header->latest.store(0);
+
+	// Readers check the magic number to see whether the memory is ready, so it goes in last.
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = STATE_MAGIC;
+
+	return true;
+}
+
+void StatePublisher::Publish(uint64_t step, const std::vector<GameObject*>& bodies)
+{
+	if (header == nullptr)
+	{
+		return;
+	}
+
+	uint32_t count = (uint32_t)bodies.size();
+	if (count > header->maxBodies)
+	{
+		if (!warnedFull)
+		{
+			std::cout << "Only room to publish " << header->maxBodies << " of " << count << " bodies" << std::endl;
+			warnedFull = true;
+		}
+		count = header->maxBodies;
+	}
+
+	StateSlot* slot = SlotAt(header, step);
+
+	// Make the sequence odd before touching anything, so a reader that starts now (or is halfway through) knows to throw away what it reads.
+	uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+	slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot->step = step;
+	slot->count = count;
+
+	int32_t* ids = (int32_t*)SlotArray(slot, header->maxBodies, 0);
+	float* arrays[7];
+	for (int i = 0; i < 7; i++)
+	{
+		arrays[i] = (float*)SlotArray(slot, header->maxBodies, i + 1);
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		glm::vec3 position = bodies[i]->GetPosition();
+		glm::quat rotation = bodies[i]->GetRotation();
+
+		ids[i] = bodies[i]->GetId();
+		arrays[0][i] = position.x;
+		arrays[1][i] = position.y;
+		arrays[2][i] = position.z;
+		arrays[3][i] = rotation.x;
+		arrays[4][i] = rotation.y;
+		arrays[5][i] = rotation.z;
+		arrays[6][i] = rotation.w;
+	}
+
+	// Even again: the slot is complete. Only then point readers at it.
+	slot->sequence.store(sequence + 2, std::memory_order_release);
+	header->latest.store(step + 1, std::memory_order_release);
+}
+
+StateSubscriber::StateSubscriber()
+{
+	header = nullptr;
+	mappedSize = 0;
+#ifdef _WIN32
+	mapping = nullptr;
+#else
+	handle = -1;
+#endif
+}
+
+StateSubscriber::~StateSubscriber()
+{
+	if (header == nullptr)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(header);
+	CloseHandle((HANDLE)mapping);
+#else
+	munmap(header, mappedSize);
+	close(handle);
+#endif
+}
+
+bool StateSubscriber::Open(const std::string& sharedName)
+{
+	if (header != nullptr)
+	{
+		return false;
+	}
+
+	std::string name = SharedName(sharedName);
+	void* memory = nullptr;
+
+#ifdef _WIN32
+	mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+	if (mapping == nullptr)
+	{
+		std::cout << "Couldn't open shared memory " << name << std::endl;
+		return false;
+	}
+
+	// Mapping zero bytes maps the whole thing.
+	memory = MapViewOfFile((HANDLE)mapping, FILE_MAP_READ, 0, 0, 0);
+	if (memory == nullptr)
+	{
+		std::cout << "Couldn't map shared memory " << name << std::endl;
+		CloseHandle((HANDLE)mapping);
+		mapping = nullptr;
+		return false;
+	}
+	MEMORY_BASIC_INFORMATION info;
+	VirtualQuery(memory, &info, sizeof(info));
+	mappedSize = info.RegionSize;
+#else
+	handle = shm_open(name.c_str(), O_RDONLY, 0);
+	if (handle < 0)
+	{
+		std::cout << "Couldn't open shared memory " << name << std::endl;
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(handle, &info) != 0 || info.st_size < (off_t)sizeof(StateHeader) ||
+		(memory = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, handle, 0)) == MAP_FAILED)
+	{
+		std::cout << "Couldn't map shared memory " << name << std::endl;
+		close(handle);
+		handle = -1;
+		return false;
+	}
+	mappedSize = (size_t)info.st_size;
+#endif
+
+	header = (StateHeader*)memory;
+
+	// The publisher writes the magic number last, so if it's there, the rest of the header is too.
+	bool ready = header->magic == STATE_MAGIC;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (!ready || header->version != STATE_VERSION || sizeof(StateHeader) + header->slotSize * header->slotCount > mappedSize)
+	{
+		std::cout << "Shared memory " << name << " isn't published state (or isn't ready yet)" << std::endl;
+#ifdef _WIN32
+		UnmapViewOfFile(header);
+		CloseHandle((HANDLE)mapping);
+		mapping = nullptr;
+#else
+		munmap(header, mappedSize);
+		close(handle);
+		handle = -1;
+#endif
+		header = nullptr;
+		return false;
+	}
+
+	return true;
+}
+
+uint64_t StateSubscriber::NextStep()
+{
+	return header == nullptr ? 0 : header->latest.load(std::memory_order_acquire);
+}
+
+bool StateSubscriber::Latest(StateView& view)
+{
+	uint64_t next = NextStep();
+	return next != 0 && View(next - 1, view);
+}
+
+bool StateSubscriber::Step(uint64_t step, StateView& view)
+{
+	uint64_t next = NextStep();
+
+	// Too new, or so old that its slot has been reused since.
+	if (step >= next || next - step > header->slotCount)
+	{
+		return false;
+	}
+	return View(step, view);
+}
+
+bool StateSubscriber::View(uint64_t step, StateView& view)
+{
+	const StateSlot* slot = SlotAt(header, step);
+
+	uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+	if (sequence & 1)
+	{
+		return false;
+	}
+
+	view.slot = slot;
+	view.sequence = sequence;
+	view.step = slot->step;
+
+	// The count could be garbage if the slot is being overwritten; Valid() would catch that afterwards, but we can't let it send us past the arrays first.
+	view.count = slot->count < header->maxBodies ? slot->count : header->maxBodies;
+
+	uint32_t maxBodies = header->maxBodies;
+	view.ids = (const int32_t*)SlotArray(slot, maxBodies, 0);
+	view.positionX = (const float*)SlotArray(slot, maxBodies, 1);
+	view.positionY = (const float*)SlotArray(slot, maxBodies, 2);
+	view.positionZ = (const float*)SlotArray(slot, maxBodies, 3);
+	view.rotationX = (const float*)SlotArray(slot, maxBodies, 4);
+	view.rotationY = (const float*)SlotArray(slot, maxBodies, 5);
+	view.rotationZ = (const float*)SlotArray(slot, maxBodies, 6);
+	view.rotationW = (const float*)SlotArray(slot, maxBodies, 7);
+
+	// The slot may already hold a newer step than the one asked for.
+	return view.step == step && Valid(view);
+}
+
+bool StateSubscriber::Valid(const StateView& view)
+{
+	// Everything read from the slot has to happen before we look at the sequence number again.
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return view.slot->sequence.load(std::memory_order_relaxed) == view.sequence;
+}
+
+#endif // _STATE_PUBLISHER_CPP
@@ -0,0 +1,148 @@
+/*
+Title: Swept AABB-3D
+File Name: StatePublisher.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Publishes the transform (position and rotation) of every body after each step into a ring of
+slots in named shared memory, so that other processes (visualizers, recorders, analytics) can
+follow the simulation without copying anything through a socket and without ever making the
+step wait on them. Each slot is guarded by a sequence number, seqlock style: the publisher
+makes it odd while writing and even when done, and a reader knows what it read is good if the
+number was even and hadn't changed by the time it finished reading.
+StateSubscriber is the reading side, for use in the other process.
+*/
+
+#ifndef _STATE_PUBLISHER_H
+#define _STATE_PUBLISHER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class GameObject;
+
+const uint32_t STATE_MAGIC = 0x53414142;	// "BAAS"
+const uint32_t STATE_VERSION = 1;
+
+// The start of the shared memory. The slots follow it, each slotSize bytes long.
+struct alignas(64) StateHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slotCount;
+	uint32_t maxBodies;
+	uint64_t slotSize;
+
+	// The step number of the newest finished slot, plus one (0 means nothing has been published yet). Step n is in slot n % slotCount.
+	std::atomic<uint64_t> latest;
+};
+
+// The start of every slot. After it come maxBodies int32 ids, then seven arrays of maxBodies floats:
+// position x, y, z and rotation (quaternion) x, y, z, w. Only the first count entries of each are used.
+struct alignas(64) StateSlot
+{
+	std::atomic<uint64_t> sequence;		// Odd while the publisher is writing this slot.
+	uint64_t step;
+	uint32_t count;
+};
+
+// Where a slot's arrays are. Pointers into shared memory.
+struct StateView
+{
+	uint64_t step;
+	uint32_t count;
+	const int32_t* ids;
+	const float* positionX; const float* positionY; const float* positionZ;
+	const float* rotationX; const float* rotationY; const float* rotationZ; const float* rotationW;
+
+	// Used by StateSubscriber::Valid().
+	const StateSlot* slot;
+	uint64_t sequence;
+};
+
+class StatePublisher
+{
+	std::string name;
+	StateHeader* header;
+	size_t mappedSize;
+	bool warnedFull;
+
+#ifdef _WIN32
+	void* mapping;
+#else
+	int handle;
+#endif
+
+public:
+	StatePublisher();
+	~StatePublisher();
+
+	// Creates the shared memory, with room for slotCount steps of up to maxBodies bodies. Memory left over from an earlier run that
+	// crashed is replaced, but if another publisher is still using the name this fails rather than take it away from that publisher.
+	// More slots let slow readers fall further behind before the step they're reading gets overwritten.
+	bool Create(const std::string& sharedName, int slotCount, int maxBodies);
+
+	// Writes the bodies' transforms as the given step. Only one thread may publish at a time. Bodies past maxBodies are left out.
+	void Publish(uint64_t step, const std::vector<GameObject*>& bodies);
+
+	bool IsOpen()
+	{
+		return header != nullptr;
+	}
+};
+
+class StateSubscriber
+{
+	StateHeader* header;
+	size_t mappedSize;
+
+#ifdef _WIN32
+	void* mapping;
+#else
+	int handle;
+#endif
+
+	bool View(uint64_t step, StateView& view);
+
+public:
+	StateSubscriber();
+	~StateSubscriber();
+
+	// Opens shared memory made by a StatePublisher, read-only.
+	bool Open(const std::string& sharedName);
+
+	// Points view at the newest published step. Returns false if there isn't one yet, or it's being rewritten right now (try again).
+	// The data isn't copied: read what you need straight out of the view, then call Valid() to check it wasn't overwritten while you read.
+	bool Latest(StateView& view);
+
+	// Points view at a given step, if it's still in the ring. Use this to follow every step in order rather than skipping to the newest.
+	bool Step(uint64_t step, StateView& view);
+
+	// True if nothing has overwritten the view's slot since Latest() or Step() returned it. If this returns false, throw away what you read.
+	bool Valid(const StateView& view);
+
+	// The newest published step plus one, or 0 if nothing has been published.
+	uint64_t NextStep();
+};
+
+#endif //_STATE_PUBLISHER_H
@@ -0,0 +1,766 @@
+/*
+Title: Swept AABB-3D
+File Name: StepPipeline.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Runs one physics step as a task graph instead of one phase after another.
+For every region: boundary bounce -> rotate -> recalculate AABB. Once every region is done,
+the broadphase finds the pairs of bodies whose swept boxes overlap and groups them into islands
+(sets of bodies that could touch each other this step). Each island is then solved (swept test,
+bounce, integrate) as its own independent task. If something draws the world, the solve also
+captures a copy of the transforms, and the step that's drawn straight afterwards turns them into
+MVP matrices alongside the publish; steps that aren't drawn leave that to FlushRenderSnapshot().
+Changes that other threads asked for through the command queue are applied at the very start
+of the step, by a task on each region's node, before anything else touches that region.
+*/
+
+#ifndef _STEP_PIPELINE_CPP
+#define _STEP_PIPELINE_CPP
+
+#include "StepPipeline.h"
+#include "Collision.h"
+#include <algorithm>
+#include <cmath>
+
+StepPipeline::StepPipeline(WorldPartition* partition)
+{
+	world = partition;
+	jobs = partition->GetJobSystem();
+
+	viewProjection = glm::mat4();
+	boundary = glm::vec3(0.9f, 0.8f, 1.0f);
+	spin = glm::vec3(glm::radians(1.0f), glm::radians(1.0f), glm::radians(0.0f));
+
+	capturePending = false;
+	rendering = false;
+	drawNext = false;
+	frustumCulling = true;
+	stepCount = 0;
+	queries = new QueryService(partition->GetBounds());
+	statePublisher = nullptr;
+	replayRecorder = nullptr;
+	renderPrep = new RenderPrep(jobs);
+	meshArena = nullptr;
+	slowestGraph = nullptr;
+	lastStepWork = 0.0;
+}
+
+StepPipeline::~StepPipeline()
+{
+	delete(queries);
+	delete(renderPrep);
+	delete(slowestGraph);
+}
+
+void StepPipeline::Step(float dt)
+{
+	TaskGraph* graph = new TaskGraph(jobs);
+
+	stepCount++;
+
+	// Bodies that crossed into another region last step move into that region's memory, so this step processes them on the node that
+	// owns where they are now. This has to happen before anything below looks up a body or its region.
+	world->MigrateBodies();
+
+	// Take every command pushed since the last step. They come out in (producer, sequence) order, and sorting them into
+	// per-region lists keeps that order, so each body sees its commands in a repeatable order.
+	std::vector<BodyCommand*> drained = commands.Drain();
+	regionCommands.assign(world->NumRegions(), std::vector<BodyCommand*>());
+	for (size_t i = 0; i < drained.size(); i++)
+	{
+		// Commands for bodies that don't exist are dropped.
+		if (world->GetBody(drained[i]->body) != nullptr)
+		{
+			regionCommands[world->RegionOfBody(drained[i]->body)].push_back(drained[i]);
+		}
+	}
+
+	// Make room to schedule every body by id. A body we haven't seen before counts as having moved last step.
+	if ((int)lastMoved.size() < world->IdLimit())
+	{
+		lastMoved.resize(world->IdLimit(), stepCount - 1);
+		lastMovedGenerations.resize(world->IdLimit(), 0);
+		idSteps.resize(world->IdLimit(), 1);
+	}
+
+	// The broadphase needs every AABB to be up to date, so it waits on the last task of every region's chain.
+	TaskGraph::TaskId broadphase = graph->AddTask("broadphase", [this, dt]()
+	{
+		Broadphase(dt);
+	});
+
+	for (int r = 0; r < world->NumRegions(); r++)
+	{
+		WorldRegion* region = &world->GetRegion(r);
+		if (region->bodies.empty())
+		{
+			continue;
+		}
+
+		// Each region gets its own chain of tasks, pinned to the node that owns the region's memory.
+		// Different regions don't touch each other's bodies, so the chains run side by side.
+		std::string suffix = "[" + std::to_string(r) + "]";
+		TaskGraph::TaskId bounce = graph->AddTask("bounce" + suffix, [this, region]() { Schedule(*region); Bounce(*region); }, region->node);
+		TaskGraph::TaskId rotate = graph->AddTask("rotate" + suffix, [this, region]() { Rotate(*region); }, region->node);
+		TaskGraph::TaskId aabb = graph->AddTask("aabb" + suffix, [this, region]() { RecalculateAABBs(*region); }, region->node);
+
+		// Apply this region's commands before anything else reads its bodies.
+		if (!regionCommands[r].empty())
+		{
+			TaskGraph::TaskId apply = graph->AddTask("commands" + suffix, [this, r]() { ApplyCommands(r); }, region->node);
+			graph->AddDependency(apply, bounce);
+		}
+
+		graph->AddDependency(bounce, rotate);
+		graph->AddDependency(rotate, aabb);
+		graph->AddDependency(aabb, broadphase);
+	}
+
+	// Solving moves the bodies, so it has to wait for the broadphase.
+	TaskGraph::TaskId solve = graph->AddTask("solve", [this, graph, dt]()
+	{
+		Solve(graph, dt);
+	});
+	graph->AddDependency(broadphase, solve);
+
+	// Publishing reads the bodies where the solve left them.
+	TaskGraph::TaskId publish = graph->AddTask("publish", [this]()
+	{
+		PublishSnapshot();
+	});
+	graph->AddDependency(solve, publish);
+
+	// Sharing the transforms with other processes also only reads the bodies, so it runs next to the snapshot.
+	if (statePublisher != nullptr)
+	{
+		StatePublisher* publisher = statePublisher;
+		unsigned long long step = stepCount;
+		TaskGraph::TaskId share = graph->AddTask("share", [this, publisher, step]()
+		{
+			publisher->Publish(step, bodies);
+		});
+		graph->AddDependency(solve, share);
+	}
+
+	// So does recording. The recorder only copies the transforms into a buffer; the disk is written to in the background.
+	if (replayRecorder != nullptr)
+	{
+		ReplayRecorder* recorder = replayRecorder;
+		unsigned long long step = stepCount;
+		TaskGraph::TaskId record = graph->AddTask("record", [this, recorder, step]()
+		{
+			collisions.clear();
+			for (size_t i = 0; i < islandCollisions.size(); i++)
+			{
+				if (islandCollisions[i].bodyA >= 0)
+				{
+					collisions.push_back(islandCollisions[i]);
+				}
+			}
+			recorder->Record(step, bodies, collisions);
+		});
+		graph->AddDependency(solve, record);
+	}
+
+	// If a frame is drawn straight after this step, turn the transforms the solve captured into render items next to the publish.
+	// Any other step's render items would be overwritten by the next step's before anyone drew them, so those steps skip it.
+	bool prepare = rendering && drawNext;
+	if (prepare)
+	{
+		TaskGraph::TaskId snapshot = graph->AddTask("snapshot", [this]()
+		{
+			PrepareRenderSnapshot();
+		});
+		graph->AddDependency(solve, snapshot);
+	}
+	drawNext = false;
+
+	// Answer any queued queries against the last step's snapshot. We hold on to that snapshot for the whole step, so it can't be freed
+	// when this step publishes its own. The queries don't touch the live bodies, so they don't need to wait on anything.
+	SnapshotManager::Reader previous = snapshots.Read();
+	if (queries->Collect())
+	{
+		const WorldSnapshot* snapshot = &*previous;
+		graph->AddTask("queries", [this, graph, snapshot]()
+		{
+			queries->Run(graph, snapshot);
+		});
+	}
+
+	graph->Run();
+
+	CommandQueue::Release(drained);
+
+	// If this step captured its transforms but didn't prepare them, FlushRenderSnapshot() does that before they're drawn.
+	capturePending = rendering && !prepare;
+
+	lastStepWork = graph->GetWorkTime();
+
+	// Hang on to the slowest step we've seen, so we can look at where its time went.
+	if (slowestGraph == nullptr || graph->GetDuration() > slowestGraph->GetDuration())
+	{
+		delete(slowestGraph);
+		slowestGraph = graph;
+	}
+	else
+	{
+		delete(graph);
+	}
+}
+
+void StepPipeline::ApplyCommands(int region)
+{
+	std::vector<BodyCommand*>& list = regionCommands[region];
+
+	for (size_t i = 0; i < list.size(); i++)
+	{
+		GameObject* body = world->GetBody(list[i]->body);
+
+		switch (list[i]->type)
+		{
+		case COMMAND_SET_VELOCITY:
+			body->SetVelocity(list[i]->value);
+			break;
+		case COMMAND_SET_POSITION:
+			body->SetPosition(list[i]->value);
+			break;
+		case COMMAND_ADD_ACCELERATION:
+			body->AddAcceleration(list[i]->value);
+			break;
+		}
+	}
+}
+
+void StepPipeline::SetUpdateTiers(const std::vector<UpdateTier>& updateTiers)
+{
+	tiers = updateTiers;
+	std::sort(tiers.begin(), tiers.end(), [](const UpdateTier& a, const UpdateTier& b)
+	{
+		return a.distance < b.distance;
+	});
+}
+
+void StepPipeline::Schedule(WorldRegion& region)
+{
+	for (size_t i = 0; i < region.bodies.size(); i++)
+	{
+		GameObject* body = region.bodies[i];
+		int id = body->GetId();
+
+		// Find how often the body should move: the slowest tier whose distance it is past.
+		int interval = 1;
+		if (!tiers.empty() && !pointsOfInterest.empty())
+		{
+			float nearest = glm::distance(body->GetPosition(), pointsOfInterest[0]);
+			for (size_t p = 1; p < pointsOfInterest.size(); p++)
+			{
+				nearest = std::min(nearest, glm::distance(body->GetPosition(), pointsOfInterest[p]));
+			}
+			for (size_t t = 0; t < tiers.size() && nearest >= tiers[t].distance; t++)
+			{
+				interval = std::max(tiers[t].interval, 1);
+			}
+		}
+
+		// A body that's new on this id (the id was reused after its last body was destroyed) counts as having moved last step.
+		if (lastMovedGenerations[id] != world->IdGeneration(id))
+		{
+			lastMovedGenerations[id] = world->IdGeneration(id);
+			lastMoved[id] = stepCount - 1;
+		}
+
+		// A body moves once it has waited its interval, or earlier on its turn in the rotation, so a tier's bodies don't all move on
+		// the same step. Either way it moves by every step it missed, even if it has just come closer and its interval is now shorter.
+		unsigned long long waited = stepCount - lastMoved[id];
+		if (waited >= (unsigned long long)interval || (stepCount + id) % interval == 0)
+		{
+			idSteps[id] = (int)waited;
+			lastMoved[id] = stepCount;
+		}
+		else
+		{
+			idSteps[id] = 0;
+		}
+	}
+}
+
+void StepPipeline::Bounce(WorldRegion& region)
+{
+	for (size_t i = 0; i < region.bodies.size(); i++)
+	{
+		GameObject* body = region.bodies[i];
+		if (idSteps[body->GetId()] == 0)
+		{
+			continue;
+		}
+
+		// This section just checks to make sure the object stays within a certain boundary. This is not really collision detection.
+		glm::vec3 tempPos = body->GetPosition();
+
+		if (fabsf(tempPos.x) > boundary.x)
+		{
+			glm::vec3 tempVel = body->GetVelocity();
+
+			// "Bounce" the velocity along the axis that was over-extended.
+			body->SetVelocity(glm::vec3(-1.0f * tempVel.x, tempVel.y, tempVel.z));
+		}
+		if (fabsf(tempPos.y) > boundary.y)
+		{
+			glm::vec3 tempVel = body->GetVelocity();
+			body->SetVelocity(glm::vec3(tempVel.x, -1.0f * tempVel.y, tempVel.z));
+		}
+		if (fabsf(tempPos.z) > boundary.z)
+		{
+			glm::vec3 tempVel = body->GetVelocity();
+			body->SetVelocity(glm::vec3(tempVel.x, tempVel.y, -1.0f * tempVel.z));
+		}
+	}
+}
+
+void StepPipeline::Rotate(WorldRegion& region)
+{
+	// Rotate the objects. This helps illustrate how the AABB recalculates as an object's orientation changes.
+	for (size_t i = 0; i < region.bodies.size(); i++)
+	{
+		int steps = idSteps[region.bodies[i]->GetId()];
+		if (steps > 0)
+		{
+			region.bodies[i]->Rotate(spin * (float)steps);
+		}
+	}
+}
+
+void StepPipeline::RecalculateAABBs(WorldRegion& region)
+{
+	// Re-calculate the Axis-Aligned Bounding Box for your object.
+	// We do this because if the object's orientation changes, we should update the bounding box as well.
+	// Be warned: For some objects this can actually cause a collision to be missed, so be careful.
+	// (This is because we determine the time of the collision based on the AABB, but if the AABB changes significantly, the time of collision can change between frames,
+	// and if that lines up just right you'll miss the collision altogether.)
+	for (size_t i = 0; i < region.bodies.size(); i++)
+	{
+		// A body that isn't moving this step hasn't turned either, so its box only needs to catch up with wherever its last move
+		// took it. The box was calculated before that move, and the broadphase treats every box as being where its body is now.
+		if (idSteps[region.bodies[i]->GetId()] > 0)
+		{
+			region.bodies[i]->CalculateAABB();
+		}
+		else
+		{
+			region.bodies[i]->MoveAABB();
+		}
+	}
+}
+
+void StepPipeline::Broadphase(float dt)
+{
+	// Gather every body into one list so we can refer to them by index.
+	bodies.clear();
+	bodyRegions.clear();
+	moveSteps.clear();
+	for (int r = 0; r < world->NumRegions(); r++)
+	{
+		WorldRegion& region = world->GetRegion(r);
+		for (size_t i = 0; i < region.bodies.size(); i++)
+		{
+			bodies.push_back(region.bodies[i]);
+			bodyRegions.push_back(r);
+			moveSteps.push_back(idSteps[region.bodies[i]->GetId()]);
+		}
+	}
+
+	int numBodies = (int)bodies.size();
+
+	// A body can only hit something inside the box it sweeps out this step. A body on a slower tier sweeps out all of the steps it's
+	// catching up on, and one that's sitting this step out doesn't sweep at all.
+	sweptBoxes.resize(numBodies);
+	boxPositions.resize(numBodies);
+	for (int i = 0; i < numBodies; i++)
+	{
+		sweptBoxes[i] = SweptBounds(bodies[i]->GetAABB(), bodies[i]->GetVelocity() * dt * (float)moveSteps[i]);
+		boxPositions[i] = bodies[i]->GetPosition();
+	}
+
+	// Sort and sweep along x: after sorting by the left edge, a box can only overlap boxes that start before it ends.
+	std::vector<int> order(numBodies);
+	for (int i = 0; i < numBodies; i++)
+	{
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [this](int a, int b)
+	{
+		return sweptBoxes[a].min.x < sweptBoxes[b].min.x;
+	});
+
+	pairs.clear();
+	std::vector<int> active;
+	for (int i = 0; i < numBodies; i++)
+	{
+		int current = order[i];
+
+		// Drop anything that ends before this box starts, it can't touch this box or any box after it.
+		for (size_t j = 0; j < active.size();)
+		{
+			if (sweptBoxes[active[j]].max.x < sweptBoxes[current].min.x)
+			{
+				active[j] = active.back();
+				active.pop_back();
+			}
+			else
+			{
+				j++;
+			}
+		}
+
+		for (size_t j = 0; j < active.size(); j++)
+		{
+			if (TestAABB(sweptBoxes[current], sweptBoxes[active[j]]))
+			{
+				pairs.push_back(std::make_pair(std::min(current, active[j]), std::max(current, active[j])));
+			}
+		}
+
+		active.push_back(current);
+	}
+
+	// Keep the pair order (and so the order collisions are handled in) the same no matter how the sort broke ties.
+	std::sort(pairs.begin(), pairs.end());
+
+	// Group bodies that share a pair into islands, using a union-find.
+	std::vector<int> parent(numBodies);
+	for (int i = 0; i < numBodies; i++)
+	{
+		parent[i] = i;
+	}
+	std::function<int(int)> find = [&parent, &find](int i)
+	{
+		return parent[i] == i ? i : (parent[i] = find(parent[i]));
+	};
+	for (size_t i = 0; i < pairs.size(); i++)
+	{
+		parent[find(pairs[i].first)] = find(pairs[i].second);
+	}
+
+	// Number the islands, and put every pair and body into its island. Bodies without any pairs go into their region's free list instead.
+	std::vector<int> islandOfRoot(numBodies, -1);
+	std::vector<bool> paired(numBodies, false);
+	islandBodies.clear();
+	islandPairs.clear();
+	for (size_t i = 0; i < pairs.size(); i++)
+	{
+		int root = find(pairs[i].first);
+		if (islandOfRoot[root] < 0)
+		{
+			islandOfRoot[root] = (int)islandBodies.size();
+			islandBodies.push_back(std::vector<int>());
+			islandPairs.push_back(std::vector<std::pair<int, int>>());
+		}
+		islandPairs[islandOfRoot[root]].push_back(pairs[i]);
+		paired[pairs[i].first] = true;
+		paired[pairs[i].second] = true;
+	}
+
+	freeBodies.assign(world->NumRegions(), std::vector<int>());
+	for (int i = 0; i < numBodies; i++)
+	{
+		if (paired[i])
+		{
+			islandBodies[islandOfRoot[find(i)]].push_back(i);
+		}
+		else
+		{
+			freeBodies[bodyRegions[i]].push_back(i);
+		}
+	}
+}
+
+void StepPipeline::Solve(TaskGraph* graph, float dt)
+{
+	// Nothing reads the capture buffers while a step is running, so we can resize them for this step. Headless worlds don't need them.
+	if (rendering)
+	{
+		capturedModels.resize(bodies.size());
+		capturedTransforms.resize(bodies.size());
+		capturedBoxes.Resize((int)bodies.size());
+	}
+	islandCollisions.resize(islandBodies.size());
+	islandContacts.resize(islandBodies.size());
+
+	// Every island is independent of every other island, so each one gets its own task.
+	for (int i = 0; i < (int)islandBodies.size(); i++)
+	{
+		graph->Spawn("island[" + std::to_string(i) + "]", [this, i, dt]()
+		{
+			SolveIsland(i, dt);
+		});
+	}
+
+	// Bodies that aren't near anything just move, on the node that owns them.
+	for (int r = 0; r < (int)freeBodies.size(); r++)
+	{
+		if (freeBodies[r].empty())
+		{
+			continue;
+		}
+
+		graph->Spawn("integrate[" + std::to_string(r) + "]", [this, r, dt]()
+		{
+			Integrate(freeBodies[r], dt);
+
+			for (size_t i = 0; rendering && i < freeBodies[r].size(); i++)
+			{
+				Capture(freeBodies[r][i]);
+			}
+		}, world->GetRegion(r).node);
+	}
+}
+
+void StepPipeline::SolveIsland(int island, float dt)
+{
+	std::vector<int>& members = islandBodies[island];
+	std::vector<std::pair<int, int>>& islandPairList = islandPairs[island];
+
+	// Find the first collision in the island. We only handle one collision per island per step.
+	float collisionTime = 2.0f;
+	float normalx = 0.0f, normaly = 0.0f, normalz = 0.0f;
+	int hitA = -1, hitB = -1;
+
+	for (size_t i = 0; i < islandPairList.size(); i++)
+	{
+		int a = islandPairList[i].first;
+		int b = islandPairList[i].second;
+
+		// SweptAABB requires that the moving object be passed in first, and treats the second one as stationary.
+		// We pass in the faster of the two, and the movement of one relative to the other. Each body covers its whole move this step
+		// (which can be several steps' worth, or nothing) over the same 0 to 1 of the step, so the hit time works for both of them.
+		glm::vec3 moveA = bodies[a]->GetVelocity() * (float)moveSteps[a];
+		glm::vec3 moveB = bodies[b]->GetVelocity() * (float)moveSteps[b];
+		if (glm::length(moveA) < glm::length(moveB))
+		{
+			std::swap(a, b);
+			std::swap(moveA, moveB);
+		}
+
+		AABB boxA = bodies[a]->GetAABB();
+		AABB boxB = bodies[b]->GetAABB();
+		float nx, ny, nz;
+
+		// The velocity refers to the velocity of the moving object this frame. For perfection, you should have some sort of physics timestep setup. (See the checkTime() function).
+		float hitTime = SweptAABB(&boxA, &boxB, (moveA - moveB) * dt, nx, ny, nz);
+
+		if (hitTime < collisionTime)
+		{
+			collisionTime = hitTime;
+			normalx = nx;
+			normaly = ny;
+			normalz = nz;
+			hitA = a;
+			hitB = b;
+		}
+	}
+
+	// Since we know we'll collide at collisionTime * dt, we can define that 1.0f - collisionTime is the remaining time this frame after that collision.
+	// Thus, we'll "bounce" off the collided object, then update the rest of the object's movement by remainingTime * dt.
+	float remainingTime = 1.0f - collisionTime;
+
+	CollisionEvent& event = islandCollisions[island];
+	event.bodyA = -1;
+
+	// If remaining time is less than zero, there's no collision this frame (because collisionTime is > 1).
+	// If remaining time = 0, then the collision happens exactly at the end of this frame.
+	if (remainingTime >= 0.0f)
+	{
+		event.bodyA = bodies[hitA]->GetId();
+		event.bodyB = bodies[hitB]->GetId();
+		event.hitTime = collisionTime;
+		event.normal = glm::vec3(normalx, normaly, normalz);
+
+		// Update the objects by the collisionTime * dt (which is the part of the update before it collides with the object).
+		Integrate(members, collisionTime * dt);
+
+		// The boxes are touching now, so where they overlap is the patch of face they touch on. Its middle is where we say the contact is.
+		glm::vec3 movedA = bodies[hitA]->GetPosition() - boxPositions[hitA];
+		glm::vec3 movedB = bodies[hitB]->GetPosition() - boxPositions[hitB];
+		AABB touchA = bodies[hitA]->GetAABB();
+		AABB touchB = bodies[hitB]->GetAABB();
+		glm::vec3 overlapMin = glm::max(touchA.min + movedA, touchB.min + movedB);
+		glm::vec3 overlapMax = glm::min(touchA.max + movedA, touchB.max + movedB);
+		islandContacts[island] = (overlapMin + overlapMax) * 0.5f;
+
+		// Then change the velocities to be the "bounced" velocities. A stationary object has nothing to flip, so it stays put.
+		int hit[2] = { hitA, hitB };
+		for (int h = 0; h < 2; h++)
+		{
+			glm::vec3 velocity = bodies[hit[h]]->GetVelocity();
+
+			// If the normal is not some ridiculously small (or zero) value.
+			if (fabsf(normalx) > 0.0001f)
+			{
+				// Bounce the velocity along that axis.
+				velocity.x *= -1;
+			}
+			if (fabsf(normaly) > 0.0001f)
+			{
+				velocity.y *= -1;
+			}
+			if (fabsf(normalz) > 0.0001f)
+			{
+				velocity.z *= -1;
+			}
+
+			bodies[hit[h]]->SetVelocity(velocity);
+		}
+
+		// Now update the objects by the remainingTime * dt (which is the part of the update after the collision).
+		Integrate(members, remainingTime * dt);
+	}
+	else
+	{
+		// No collision, update normally.
+		Integrate(members, dt);
+	}
+
+	for (size_t i = 0; rendering && i < members.size(); i++)
+	{
+		Capture(members[i]);
+	}
+}
+
+void StepPipeline::Integrate(const std::vector<int>& members, float dt)
+{
+	// dt is the part of the step to move by. Bodies on a slower tier move that part of all the steps they're catching up on.
+	for (size_t i = 0; i < members.size(); i++)
+	{
+		int steps = moveSteps[members[i]];
+		if (steps > 0)
+		{
+			bodies[members[i]]->Update(dt * (float)steps);
+		}
+	}
+}
+
+void StepPipeline::Capture(int body)
+{
+	capturedModels[body] = bodies[body]->GetModel();
+	capturedTransforms[body] = *bodies[body]->GetTransform();
+
+	// The AABB was last calculated before the body moved, so move it along by however far the body went, as PublishSnapshot() does.
+	glm::vec3 moved = bodies[body]->GetPosition() - boxPositions[body];
+	AABB box = bodies[body]->GetAABB();
+	capturedBoxes.Set(body, AABB(box.min + moved, box.max + moved));
+}
+
+void StepPipeline::PrepareRenderSnapshot()
+{
+	// Update your MVP matrices based on the objects' transforms. This is split up over the worker pool (along with sorting the draws
+	// into a command list, if we have a mesh arena), whether it runs as part of a step or from FlushRenderSnapshot() on the render thread.
+	renderPrep->Prepare(capturedModels, capturedTransforms, frustumCulling ? &capturedBoxes : nullptr, viewProjection, renderItems, meshArena);
+
+	capturePending = false;
+}
+
+void StepPipeline::PublishSnapshot()
+{
+	// Move each AABB along with its body, rather than recalculating it from every vertex.
+	publishBoxes.resize(bodies.size());
+	for (size_t i = 0; i < bodies.size(); i++)
+	{
+		glm::vec3 moved = bodies[i]->GetPosition() - boxPositions[i];
+		AABB box = bodies[i]->GetAABB();
+		publishBoxes[i] = AABB(box.min + moved, box.max + moved);
+	}
+
+	WorldSnapshot* snapshot = snapshots.Acquire();
+	snapshot->Build(stepCount, bodies, publishBoxes);
+	snapshots.Publish(snapshot);
+}
+
+void StepPipeline::CaptureRenderSnapshot()
+{
+	bodies.clear();
+	for (int r = 0; r < world->NumRegions(); r++)
+	{
+		WorldRegion& region = world->GetRegion(r);
+		bodies.insert(bodies.end(), region.bodies.begin(), region.bodies.end());
+	}
+
+	capturedModels.resize(bodies.size());
+	capturedTransforms.resize(bodies.size());
+	capturedBoxes.Resize((int)bodies.size());
+	boxPositions.resize(bodies.size());
+	for (int i = 0; i < (int)bodies.size(); i++)
+	{
+		// Before the first step, a body's AABB hasn't been calculated yet, so bring it up to date with where the body is now.
+		bodies[i]->CalculateAABB();
+		boxPositions[i] = bodies[i]->GetPosition();
+		Capture(i);
+	}
+
+	capturePending = true;
+}
+
+void StepPipeline::FlushRenderSnapshot()
+{
+	if (capturePending)
+	{
+		PrepareRenderSnapshot();
+	}
+}
+
+void StepPipeline::AddDebugLines(DebugLines* lines)
+{
+	// The captured boxes were moved along with their bodies at the end of the step, so they're where the bodies are now.
+	for (int i = 0; i < capturedBoxes.Size(); i++)
+	{
+		AABB box(glm::vec3(capturedBoxes.minX[i], capturedBoxes.minY[i], capturedBoxes.minZ[i]),
+			glm::vec3(capturedBoxes.maxX[i], capturedBoxes.maxY[i], capturedBoxes.maxZ[i]));
+		lines->AddBox(box, glm::vec4(0.0f, 0.7f, 0.0f, 1.0f));
+	}
+
+	// The swept boxes are from the start of the step, before anything moved. Bodies that sat the step out didn't sweep anything.
+	for (size_t i = 0; i < sweptBoxes.size() && i < moveSteps.size(); i++)
+	{
+		if (moveSteps[i] > 0)
+		{
+			lines->AddBox(sweptBoxes[i], glm::vec4(1.0f, 0.5f, 0.0f, 1.0f));
+		}
+	}
+
+	for (size_t i = 0; i < islandCollisions.size() && i < islandContacts.size(); i++)
+	{
+		if (islandCollisions[i].bodyA >= 0)
+		{
+			lines->AddLine(islandContacts[i], islandContacts[i] + islandCollisions[i].normal * 0.1f, glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
+		}
+	}
+}
+
+bool StepPipeline::WriteSlowestStep(const std::string& fileName)
+{
+	if (slowestGraph == nullptr)
+	{
+		return false;
+	}
+	return slowestGraph->WriteCriticalPath(fileName);
+}
+
+#endif // _STEP_PIPELINE_CPP
@@ -0,0 +1,300 @@
+/*
+Title: Swept AABB-3D
+File Name: StepPipeline.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Runs one physics step as a task graph instead of one phase after another.
+For every region: boundary bounce -> rotate -> recalculate AABB. Once every region is done,
+the broadphase finds the pairs of bodies whose swept boxes overlap and groups them into islands
+(sets of bodies that could touch each other this step). Each island is then solved (swept test,
+bounce, integrate) as its own independent task. If something draws the world, the solve also
+captures a copy of the transforms and AABBs, and the step before each frame turns them into a
+render snapshot (culling against the view frustum, turning transforms into MVP matrices, and
+those into a command list for the mesh arena) alongside the publish.
+Changes that other threads asked for through the command queue are applied at the very start
+of the step, by a task on each region's node, before anything else touches that region.
+Once the solve is done, a read-only snapshot of every body is published, so that other threads
+can run raycasts and overlap queries against the last finished step while the next one runs.
+Raycasts and sweeps queued up through the query service are answered in batches by their own
+tasks, against the previous step's snapshot, alongside the rest of the step.
+Bodies far from every point of interest can be put on a slower update tier: they only move
+every few steps, by all of the time they missed at once, and sit still as obstacles in between.
+*/
+
+#ifndef _STEP_PIPELINE_H
+#define _STEP_PIPELINE_H
+
+#include "WorldPartition.h"
+#include "TaskGraph.h"
+#include "CommandQueue.h"
+#include "SnapshotManager.h"
+#include "QueryService.h"
+#include "StatePublisher.h"
+#include "ReplayRecorder.h"
+#include "RenderPrep.h"
+#include "DebugLines.h"
+#include <vector>
+#include <string>
+
+// Bodies at least distance away from every point of interest only move every interval steps.
+struct UpdateTier
+{
+	float distance;
+	int interval;
+};
+
+class StepPipeline
+{
+	WorldPartition* world;
+	JobSystem* jobs;
+
+	glm::mat4 viewProjection;
+
+	// Bodies bounce back when they go further than this from the origin on any axis.
+	glm::vec3 boundary;
+
+	// How much every body rotates per step, in radians.
+	glm::vec3 spin;
+
+	// Update tiers, sorted by distance, and the points bodies are measured from (see SetUpdateTiers()).
+	std::vector<UpdateTier> tiers;
+	std::vector<glm::vec3> pointsOfInterest;
+
+	// By body id: the step the body last moved on, and how many steps' worth of time it moves this step (0 if it sits this one out).
+	// The generation is the id's generation (see WorldPartition::IdGeneration()) when lastMoved was set, so a new body on an old id starts over.
+	std::vector<unsigned long long> lastMoved;
+	std::vector<unsigned int> lastMovedGenerations;
+	std::vector<int> idSteps;
+
+	// Changes to bodies requested by other threads, and the ones drained for the current step sorted by region.
+	CommandQueue commands;
+	std::vector<std::vector<BodyCommand*>> regionCommands;
+
+	// Every body in the world, in region order, so that the broadphase and the islands can refer to bodies by index.
+	std::vector<GameObject*> bodies;
+	std::vector<int> bodyRegions;
+	std::vector<int> moveSteps;
+	std::vector<AABB> sweptBoxes;
+
+	// Where each body was when its AABB was last calculated. The solve moves bodies without recalculating their AABBs,
+	// so the published snapshot moves each AABB along by however far its body went.
+	std::vector<glm::vec3> boxPositions;
+
+	// Broadphase output. Pairs are (lower index, higher index). Each island is a list of bodies and the pairs between them.
+	std::vector<std::pair<int, int>> pairs;
+	std::vector<std::vector<int>> islandBodies;
+	std::vector<std::vector<std::pair<int, int>>> islandPairs;
+
+	// The collision each island handled this step (bodyA is -1 if it didn't have one), and all of them together for the recorder.
+	std::vector<CollisionEvent> islandCollisions;
+	std::vector<CollisionEvent> collisions;
+
+	// Where each island's collision happened: the middle of the face the two boxes touched on. Only used for drawing.
+	std::vector<glm::vec3> islandContacts;
+
+	// Bodies that aren't near anything this step, sorted by region so they can be integrated on their own node.
+	std::vector<std::vector<int>> freeBodies;
+
+	// Transforms captured at the end of the last step, waiting to be turned into render items.
+	std::vector<Model*> capturedModels;
+	std::vector<glm::mat4> capturedTransforms;
+	CullBoxes capturedBoxes;
+	bool capturePending;
+
+	// Whether anything draws this pipeline's render items (a view-projection or mesh arena has been set). If not, nothing is captured.
+	bool rendering;
+
+	// Set by DrawAfterNextStep(), so the next step prepares its own render items.
+	bool drawNext;
+
+	// Whether objects outside the view frustum are left out of the render items (see SetFrustumCulling()).
+	bool frustumCulling;
+
+	std::vector<RenderItem> renderItems;
+
+	// Splits the render snapshot over the worker pool, and builds the command list for drawing it from the mesh arena, if there is one.
+	RenderPrep* renderPrep;
+	MeshArena* meshArena;
+
+	// Snapshots of the world at the end of each step, for queries from other threads.
+	SnapshotManager snapshots;
+	std::vector<AABB> publishBoxes;
+	unsigned long long stepCount;
+
+	// Queries from other threads, answered once per step.
+	QueryService* queries;
+
+	// Where to share every step's transforms with other processes, if anywhere.
+	StatePublisher* statePublisher;
+
+	// Where to record every step's transforms to, if anywhere.
+	ReplayRecorder* replayRecorder;
+
+	// The graph of the slowest step so far, kept around so its critical path can be written out.
+	TaskGraph* slowestGraph;
+
+	// How much work the last step was, in milliseconds (see TaskGraph::GetWorkTime()).
+	double lastStepWork;
+
+	void ApplyCommands(int region);
+	void Schedule(WorldRegion& region);
+	void Bounce(WorldRegion& region);
+	void Rotate(WorldRegion& region);
+	void RecalculateAABBs(WorldRegion& region);
+	void Broadphase(float dt);
+	void Solve(TaskGraph* graph, float dt);
+	void SolveIsland(int island, float dt);
+	void Integrate(const std::vector<int>& members, float dt);
+	void Capture(int body);
+	void PrepareRenderSnapshot();
+	void PublishSnapshot();
+
+public:
+	StepPipeline(WorldPartition* partition);
+	~StepPipeline();
+
+	void SetViewProjection(const glm::mat4& pv)
+	{
+		viewProjection = pv;
+		rendering = true;
+	}
+	void SetBoundary(glm::vec3 halfExtents)
+	{
+		boundary = halfExtents;
+	}
+	void SetSpin(glm::vec3 radiansPerStep)
+	{
+		spin = radiansPerStep;
+	}
+
+	// Bodies further than a tier's distance from every point of interest are only moved every tier.interval steps, by interval * dt at once.
+	// Their swept boxes cover the whole of that move, so they can't tunnel through anything, and in the steps in between they stay put
+	// (but other bodies still collide with them). A body that comes closer moves up to a faster tier straight away.
+	// With no tiers, or no points of interest, every body moves every step. Only change these between steps.
+	void SetUpdateTiers(const std::vector<UpdateTier>& updateTiers);
+	void SetPointsOfInterest(const std::vector<glm::vec3>& points)
+	{
+		pointsOfInterest = points;
+	}
+
+	// Other threads push changes to bodies through this queue, rather than calling SetVelocity() and friends on a GameObject directly.
+	CommandQueue* GetCommandQueue()
+	{
+		return &commands;
+	}
+
+	// Any thread can read the state of the world as of the last finished step from here, even while a step is running:
+	//   SnapshotManager::Reader snapshot = pipeline->GetSnapshots()->Read();
+	//   snapshot->Raycast(origin, direction, 10.0f, hit);
+	SnapshotManager* GetSnapshots()
+	{
+		return &snapshots;
+	}
+
+	// Once this is set, the transforms of every body are published to it at the end of each step. Pass nullptr to stop.
+	void SetStatePublisher(StatePublisher* publisher)
+	{
+		statePublisher = publisher;
+	}
+
+	// Once this is set, the transforms of every body are recorded to it at the end of each step. Pass nullptr to stop.
+	void SetReplayRecorder(ReplayRecorder* recorder)
+	{
+		replayRecorder = recorder;
+	}
+
+	// Threads that have a lot of small queries should send them through here rather than reading snapshots themselves;
+	// they get answered together, once per step, on the worker pool.
+	QueryService* GetQueryService()
+	{
+		return queries;
+	}
+
+	// Runs one physics step over the whole world, and blocks until it's done. Bodies may move to a new address at the start of it
+	// (see WorldPartition::MigrateBodies()).
+	void Step(float dt);
+
+	// Captures the current transforms of every body, as if a step had just finished. Use this before the first step.
+	void CaptureRenderSnapshot();
+
+	// Tells the pipeline that a frame will be drawn straight after the next step, so that step turns its transforms into render items
+	// while it's still running. Steps that aren't followed by a draw don't bother.
+	void DrawAfterNextStep()
+	{
+		drawNext = true;
+	}
+
+	// Turns the last captured transforms into render items right now, if that hasn't happened yet.
+	// Call this before drawing, in case the last step wasn't told about the draw (or there wasn't a step at all).
+	void FlushRenderSnapshot();
+
+	const std::vector<RenderItem>& GetRenderItems()
+	{
+		return renderItems;
+	}
+
+	// Objects whose AABBs are entirely outside the frustum of the view-projection matrix are marked as not visible in the render items,
+	// and left out of the command list. This is on by default; turn it off if the render items are used for anything other than drawing.
+	void SetFrustumCulling(bool enabled)
+	{
+		frustumCulling = enabled;
+	}
+
+	// How many objects the last render snapshot found inside the view frustum.
+	int GetNumVisible()
+	{
+		return renderPrep->NumVisible();
+	}
+
+	// Once this is set, every render snapshot also builds a command list for drawing it from the arena in one call (see RenderPrep.h),
+	// so all the GL thread has to do is pass GetRenderCommands() to MeshArena::Submit(). Pass nullptr to stop.
+	// The arena must only be used by this pipeline, and only drawn from between steps.
+	void SetMeshArena(MeshArena* arena)
+	{
+		meshArena = arena;
+		if (arena != nullptr)
+		{
+			rendering = true;
+		}
+	}
+
+	const RenderCommandList& GetRenderCommands()
+	{
+		return renderPrep->GetCommandList();
+	}
+
+	// The time the last step's tasks took, added up, in milliseconds. This is what a step costs the worker pool,
+	// no matter how many other worlds were stepping on it at the same time.
+	double GetLastStepWork()
+	{
+		return lastStepWork;
+	}
+
+	// Adds what the last step worked with to lines, for debugging: every body's AABB (green), the swept box the broadphase used for every body
+	// that moved (orange), and the normal of every collision (red), starting from where it happened. Only call this between steps.
+	void AddDebugLines(DebugLines* lines);
+
+	// Writes the task graph of the slowest step so far, with its critical path highlighted.
+	bool WriteSlowestStep(const std::string& fileName);
+};
+
+#endif //_STEP_PIPELINE_H
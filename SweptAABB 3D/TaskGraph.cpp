@@ -0,0 +1,340 @@
+/*
+Title: Swept AABB-3D
+File Name: TaskGraph.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+A dependency graph of tasks that runs on the job system. Each task starts as soon as every
+task it depends on has finished, so tasks that don't depend on each other run at the same time.
+A running task can also spawn child tasks (for work that isn't known until the task runs, like
+one task per collision island); the parent only counts as finished once its children are.
+Every task is timed, and the critical path (the chain of tasks that decided how long the whole
+graph took) can be written out as a Graphviz file.
+*/
+
+#ifndef _TASK_GRAPH_CPP
+#define _TASK_GRAPH_CPP
+
+#include "TaskGraph.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+// The task whose job is running on this thread, so Spawn() knows who the parent is.
+static thread_local void* currentTask = nullptr;
+
+TaskGraph::TaskGraph(JobSystem* jobSystem)
+{
+	jobs = jobSystem;
+	duration = 0.0;
+}
+
+double TaskGraph::Now()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - runStart).count();
+}
+
+TaskGraph::Task* TaskGraph::NewTask(const std::string& name, Job job, int node)
+{
+	std::lock_guard<std::mutex> lock(spawnMutex);
+
+	tasks.emplace_back();
+	Task* task = &tasks.back();
+	task->id = (TaskId)tasks.size() - 1;
+	task->name = name;
+	task->job = job;
+	task->node = node;
+
+	return task;
+}
+
+TaskGraph::TaskId TaskGraph::AddTask(const std::string& name, Job job, int node)
+{
+	return NewTask(name, job, node)->id;
+}
+
+void TaskGraph::AddDependency(TaskId before, TaskId after)
+{
+	tasks[before].successors.push_back(&tasks[after]);
+	tasks[after].predecessors.push_back(&tasks[before]);
+}
+
+TaskGraph::TaskId TaskGraph::Spawn(const std::string& name, Job job, int node)
+{
+	Task* parent = (Task*)currentTask;
+	Task* child = NewTask(name, job, node);
+
+	child->parent = parent;
+	child->openWork = 1;
+
+	if (parent != nullptr)
+	{
+		// The parent can't finish until this child does. The parent's own job is still running (we're inside it), so its
+		// openWork is at least 1 here and can't hit zero underneath us.
+		parent->openWork++;
+
+		std::lock_guard<std::mutex> lock(spawnMutex);
+		parent->children.push_back(child);
+	}
+
+	Launch(child);
+
+	return child->id;
+}
+
+void TaskGraph::Launch(Task* task)
+{
+	jobs->Submit([this, task]()
+	{
+		// Remember which task is running here, in case it wants to spawn children. We restore the old value afterwards because
+		// a thread that is waiting on the job system can end up running a task from inside another one.
+		void* previous = currentTask;
+		currentTask = task;
+
+		task->jobStart = Now();
+		task->job();
+		task->jobEnd = Now();
+
+		currentTask = previous;
+
+		JobFinished(task);
+	}, &counter, task->node);
+}
+
+void TaskGraph::JobFinished(Task* task)
+{
+	// The task's own work is done, but it may still be waiting on children.
+	if (--task->openWork == 0)
+	{
+		TaskFinished(task);
+	}
+}
+
+void TaskGraph::TaskFinished(Task* task)
+{
+	task->finished = Now();
+
+	// Start anything that was only waiting on us.
+	for (size_t i = 0; i < task->successors.size(); i++)
+	{
+		if (--task->successors[i]->unfinishedPredecessors == 0)
+		{
+			Launch(task->successors[i]);
+		}
+	}
+
+	// If we were a child, our parent may have been waiting on us.
+	if (task->parent != nullptr && --task->parent->openWork == 0)
+	{
+		TaskFinished(task->parent);
+	}
+}
+
+void TaskGraph::Run()
+{
+	runStart = std::chrono::high_resolution_clock::now();
+
+	// Reset the counters first, and only then launch, so that a task finishing early can't see a counter we haven't set yet.
+	std::vector<Task*> ready;
+	for (size_t i = 0; i < tasks.size(); i++)
+	{
+		tasks[i].unfinishedPredecessors = (int)tasks[i].predecessors.size();
+		tasks[i].openWork = 1;
+
+		if (tasks[i].predecessors.empty())
+		{
+			ready.push_back(&tasks[i]);
+		}
+	}
+
+	for (size_t i = 0; i < ready.size(); i++)
+	{
+		Launch(ready[i]);
+	}
+
+	// Every launch (including the ones made by finishing tasks, and spawned children) is tracked by the same counter.
+	// A task always launches its successors before its own job is counted as done, so the counter can't reach zero early.
+	jobs->Wait(&counter);
+
+	duration = Now();
+}
+
+double TaskGraph::GetWorkTime()
+{
+	double total = 0.0;
+	for (size_t i = 0; i < tasks.size(); i++)
+	{
+		total += tasks[i].jobEnd - tasks[i].jobStart;
+	}
+	return total;
+}
+
+std::vector<TaskGraph::TaskId> TaskGraph::CriticalPath()
+{
+	std::vector<TaskId> path;
+	if (tasks.empty())
+	{
+		return path;
+	}
+
+	// The path ends at whichever task finished last.
+	Task* current = &tasks[0];
+	for (size_t i = 1; i < tasks.size(); i++)
+	{
+		if (tasks[i].finished > current->finished)
+		{
+			current = &tasks[i];
+		}
+	}
+
+	// Walk backwards, each time stepping to whatever held the current task up the longest.
+	// If a child finished after its parent's own job did, that child is what the parent was waiting on.
+	// Otherwise, the task was waiting on the last of its predecessors to finish.
+	// A child has no predecessors of its own; it was started by its parent's job, so we continue from the parent's predecessors.
+	bool enteredFromChild = false;
+	while (current != nullptr)
+	{
+		Task* next = nullptr;
+
+		if (!enteredFromChild)
+		{
+			for (size_t i = 0; i < current->children.size(); i++)
+			{
+				Task* child = current->children[i];
+				if (child->finished > current->jobEnd && (next == nullptr || child->finished > next->finished))
+				{
+					next = child;
+				}
+			}
+		}
+
+		// A parent that was held up by a child gets added when we come back up from the child, so that it shows up before its children.
+		if (next != nullptr)
+		{
+			current = next;
+			continue;
+		}
+
+		path.push_back(current->id);
+
+		for (size_t i = 0; i < current->predecessors.size(); i++)
+		{
+			Task* pred = current->predecessors[i];
+			if (next == nullptr || pred->finished > next->finished)
+			{
+				next = pred;
+			}
+		}
+
+		if (next == nullptr && current->parent != nullptr)
+		{
+			// Hop up to the parent, but don't wander back down into its other children.
+			next = current->parent;
+			enteredFromChild = true;
+		}
+		else
+		{
+			enteredFromChild = false;
+		}
+
+		current = next;
+	}
+
+	std::reverse(path.begin(), path.end());
+
+	return path;
+}
+
+bool TaskGraph::WriteCriticalPath(const std::string& fileName)
+{
+	std::ofstream file(fileName, std::ios::out);
+
+	if (!file.good())
+	{
+		std::cout << "Can't write file: " << fileName.data() << std::endl;
+		return false;
+	}
+
+	std::vector<TaskId> path = CriticalPath();
+	std::vector<bool> critical(tasks.size(), false);
+	for (size_t i = 0; i < path.size(); i++)
+	{
+		critical[path[i]] = true;
+	}
+
+	file << "// Total: " << duration << " ms over " << tasks.size() << " tasks" << std::endl;
+	file << "// Critical path:";
+	for (size_t i = 0; i < path.size(); i++)
+	{
+		file << (i == 0 ? " " : " -> ") << tasks[path[i]].name;
+	}
+	file << std::endl;
+
+	file << "digraph step {" << std::endl;
+	file << "\trankdir=LR;" << std::endl;
+	file << "\tnode [shape=box, fontname=\"Helvetica\"];" << std::endl;
+
+	for (size_t i = 0; i < tasks.size(); i++)
+	{
+		Task& task = tasks[i];
+		file << "\tt" << task.id << " [label=\"" << task.name << "\\n" << (task.jobEnd - task.jobStart) << " ms";
+		if (task.node != JobSystem::AnyNode)
+		{
+			file << "\\nnode " << task.node;
+		}
+		file << "\"";
+		if (critical[i])
+		{
+			file << ", color=red, penwidth=2";
+		}
+		file << "];" << std::endl;
+
+		for (size_t j = 0; j < task.successors.size(); j++)
+		{
+			Task* succ = task.successors[j];
+			file << "\tt" << task.id << " -> t" << succ->id;
+			if (critical[i] && critical[succ->id])
+			{
+				file << " [color=red, penwidth=2]";
+			}
+			file << ";" << std::endl;
+		}
+
+		// Spawned children are drawn with dashed lines.
+		for (size_t j = 0; j < task.children.size(); j++)
+		{
+			Task* child = task.children[j];
+			file << "\tt" << task.id << " -> t" << child->id << " [style=dashed";
+			if (critical[i] && critical[child->id])
+			{
+				file << ", color=red, penwidth=2";
+			}
+			file << "];" << std::endl;
+		}
+	}
+
+	file << "}" << std::endl;
+	file.close();
+
+	return true;
+}
+
+#endif // _TASK_GRAPH_CPP
@@ -0,0 +1,138 @@
+/*
+Title: Swept AABB-3D
+File Name: TaskGraph.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+A dependency graph of tasks that runs on the job system. Each task starts as soon as every
+task it depends on has finished, so tasks that don't depend on each other run at the same time.
+A running task can also spawn child tasks (for work that isn't known until the task runs, like
+one task per collision island); the parent only counts as finished once its children are.
+Every task is timed, and the critical path (the chain of tasks that decided how long the whole
+graph took) can be written out as a Graphviz file.
+*/
+
+#ifndef _TASK_GRAPH_H
+#define _TASK_GRAPH_H
+
+#include "JobSystem.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+
+class TaskGraph
+{
+public:
+	typedef int TaskId;
+
+private:
+	struct Task
+	{
+		TaskId id;
+		std::string name;
+		Job job;
+		int node;							// The NUMA node this task is pinned to, or JobSystem::AnyNode.
+
+		std::vector<Task*> predecessors;	// Tasks that must finish before this one starts.
+		std::vector<Task*> successors;		// Tasks waiting on this one.
+		std::vector<Task*> children;		// Tasks spawned by this one while it was running.
+		Task* parent;
+
+		std::atomic<int> unfinishedPredecessors;
+		std::atomic<int> openWork;			// 1 for the task's own job, plus 1 per child that hasn't finished.
+
+		// Times in milliseconds since the start of Run().
+		double jobStart;
+		double jobEnd;
+		double finished;
+
+		Task()
+		{
+			id = 0;
+			node = JobSystem::AnyNode;
+			parent = nullptr;
+			unfinishedPredecessors = 0;
+			openWork = 0;
+			jobStart = 0.0;
+			jobEnd = 0.0;
+			finished = 0.0;
+		}
+	};
+
+	JobSystem* jobs;
+
+	// A deque never moves its elements when it grows, so the Task pointers above stay valid while children are being spawned.
+	std::deque<Task> tasks;
+	std::mutex spawnMutex;
+
+	JobCounter counter;
+	std::chrono::high_resolution_clock::time_point runStart;
+	double duration;
+
+	double Now();
+	Task* NewTask(const std::string& name, Job job, int node);
+	void Launch(Task* task);
+	void JobFinished(Task* task);
+	void TaskFinished(Task* task);
+
+public:
+	TaskGraph(JobSystem* jobSystem);
+
+	// Adds a task to the graph. It won't start until Run() is called and all of its dependencies are done.
+	TaskId AddTask(const std::string& name, Job job, int node = JobSystem::AnyNode);
+
+	// Makes after wait for before to finish.
+	void AddDependency(TaskId before, TaskId after);
+
+	// Only call this from inside a running task. Adds a child task that starts right away, and the calling task
+	// (and anything that depends on it) won't be considered finished until the child is.
+	TaskId Spawn(const std::string& name, Job job, int node = JobSystem::AnyNode);
+
+	// Runs the whole graph on the job system and blocks until every task (and every spawned child) has finished.
+	// A graph can only be run once.
+	void Run();
+
+	// Wall-clock time of the last Run(), in milliseconds.
+	double GetDuration()
+	{
+		return duration;
+	}
+
+	// The time every task's job took, added up, in milliseconds. Unlike GetDuration(), this doesn't count time the thread
+	// that called Run() spent helping with other work while it waited.
+	double GetWorkTime();
+
+	int NumTasks()
+	{
+		return (int)tasks.size();
+	}
+
+	// Returns the tasks along the critical path, in the order they ran.
+	std::vector<TaskId> CriticalPath();
+
+	// Writes the graph as a Graphviz .dot file, with the critical path drawn in red. Render it with "dot -Tsvg file.dot -o file.svg".
+	bool WriteCriticalPath(const std::string& fileName);
+};
+
+#endif //_TASK_GRAPH_H
@@ -0,0 +1,490 @@
+/*
+Title: Swept AABB-3D
+File Name: TrajectoryFile.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Exports where every body was, how fast it was going, and which bodies hit each other, step by
+step, in a columnar file for offline analysis. See TrajectoryFile.h for the layout.
+*/
+
+#ifndef _TRAJECTORY_FILE_CPP
+#define _TRAJECTORY_FILE_CPP
+
+#include "TrajectoryFile.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Starts a chunk with stats that any row will replace.
+static void ResetChunk(TrajectoryChunk& chunk)
+{
+	memset(&chunk, 0, sizeof(chunk));
+	chunk.minId = INT32_MAX;
+	chunk.maxId = INT32_MIN;
+	for (int a = 0; a < 3; a++)
+	{
+		chunk.minPosition[a] = FLT_MAX;
+		chunk.maxPosition[a] = -FLT_MAX;
+		chunk.minVelocity[a] = FLT_MAX;
+		chunk.maxVelocity[a] = -FLT_MAX;
+	}
+}
+
+TrajectoryWriter::TrajectoryWriter()
+{
+	stepsPerChunk = 64;
+	fileOffset = 0;
+	chunkSteps = 0;
+	ResetChunk(chunk);
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+	Close();
+}
+
+bool TrajectoryWriter::Open(const std::string& fileName, int chunkSize)
+{
+	// Analysis wants every step, so wait for the disk rather than dropping any.
+	if (chunkSize < 1 || !writer.Open(fileName, 4 << 20, 4, BACKPRESSURE_BLOCK))
+	{
+		return false;
+	}
+
+	stepsPerChunk = (uint32_t)chunkSize;
+	directory.clear();
+	chunkSteps = 0;
+	ResetChunk(chunk);
+
+	TrajectoryHeader header;
+	header.magic = TRAJECTORY_MAGIC;
+	header.version = TRAJECTORY_VERSION;
+	header.stepsPerChunk = stepsPerChunk;
+	header.reserved = 0;
+	writer.Write(&header, sizeof(header));
+	fileOffset = sizeof(header);
+
+	return true;
+}
+
+uint64_t TrajectoryWriter::WriteColumn(const void* data, size_t size)
+{
+	// Pad the column out to 8 bytes, so the next one starts aligned and can be read in place.
+	static const char padding[8] = { 0 };
+	uint64_t offset = fileOffset;
+	size_t padded = (size + 7) & ~(size_t)7;
+
+	writer.Write(data, size);
+	writer.Write(padding, padded - size);
+	fileOffset += padded;
+
+	return offset;
+}
+
+void TrajectoryWriter::FinishChunk()
+{
+	if (chunkSteps == 0)
+	{
+		return;
+	}
+
+	chunk.rows = (uint32_t)steps.size();
+	chunk.events = (uint32_t)eventSteps.size();
+
+	chunk.columns[TRAJECTORY_STEP] = WriteColumn(steps.data(), steps.size() * sizeof(uint64_t));
+	chunk.columns[TRAJECTORY_ID] = WriteColumn(ids.data(), ids.size() * sizeof(int32_t));
+	for (int c = TRAJECTORY_POSITION_X; c < TRAJECTORY_COLUMNS; c++)
+	{
+		std::vector<float>& column = values[c - TRAJECTORY_POSITION_X];
+		chunk.columns[c] = WriteColumn(column.data(), column.size() * sizeof(float));
+	}
+
+	chunk.eventColumns[EVENT_STEP] = WriteColumn(eventSteps.data(), eventSteps.size() * sizeof(uint64_t));
+	chunk.eventColumns[EVENT_BODY_A] = WriteColumn(eventBodies[0].data(), eventBodies[0].size() * sizeof(int32_t));
+	chunk.eventColumns[EVENT_BODY_B] = WriteColumn(eventBodies[1].data(), eventBodies[1].size() * sizeof(int32_t));
+	for (int c = EVENT_TIME; c < EVENT_COLUMNS; c++)
+	{
+		std::vector<float>& column = eventValues[c - EVENT_TIME];
+		chunk.eventColumns[c] = WriteColumn(column.data(), column.size() * sizeof(float));
+	}
+	writer.Flush();
+
+	directory.push_back(chunk);
+
+	steps.clear();
+	ids.clear();
+	for (int c = 0; c < TRAJECTORY_COLUMNS - TRAJECTORY_POSITION_X; c++)
+	{
+		values[c].clear();
+	}
+	eventSteps.clear();
+	eventBodies[0].clear();
+	eventBodies[1].clear();
+	for (int c = 0; c < EVENT_COLUMNS - EVENT_TIME; c++)
+	{
+		eventValues[c].clear();
+	}
+	chunkSteps = 0;
+	ResetChunk(chunk);
+}
+
+void TrajectoryWriter::Record(uint64_t step, const std::vector<GameObject*>& bodies, const std::vector<CollisionEvent>& collisions)
+{
+	if (!writer.Good())
+	{
+		return;
+	}
+
+	if (chunkSteps == 0)
+	{
+		chunk.firstStep = step;
+	}
+	chunk.lastStep = step;
+	chunkSteps++;
+
+	for (size_t i = 0; i < bodies.size(); i++)
+	{
+		int32_t id = bodies[i]->GetId();
+		glm::vec3 position = bodies[i]->GetPosition();
+		glm::vec3 velocity = bodies[i]->GetVelocity();
+
+		steps.push_back(step);
+		ids.push_back(id);
+		chunk.minId = std::min(chunk.minId, id);
+		chunk.maxId = std::max(chunk.maxId, id);
+		for (int a = 0; a < 3; a++)
+		{
+			values[a].push_back(position[a]);
+			values[3 + a].push_back(velocity[a]);
+			chunk.minPosition[a] = std::min(chunk.minPosition[a], position[a]);
+			chunk.maxPosition[a] = std::max(chunk.maxPosition[a], position[a]);
+			chunk.minVelocity[a] = std::min(chunk.minVelocity[a], velocity[a]);
+			chunk.maxVelocity[a] = std::max(chunk.maxVelocity[a], velocity[a]);
+		}
+	}
+
+	for (size_t i = 0; i < collisions.size(); i++)
+	{
+		eventSteps.push_back(step);
+		eventBodies[0].push_back(collisions[i].bodyA);
+		eventBodies[1].push_back(collisions[i].bodyB);
+		eventValues[0].push_back(collisions[i].hitTime);
+		eventValues[1].push_back(collisions[i].normal.x);
+		eventValues[2].push_back(collisions[i].normal.y);
+		eventValues[3].push_back(collisions[i].normal.z);
+	}
+
+	if (chunkSteps >= stepsPerChunk)
+	{
+		FinishChunk();
+	}
+}
+
+void TrajectoryWriter::Close()
+{
+	if (!writer.Good())
+	{
+		writer.Close();
+		return;
+	}
+
+	FinishChunk();
+
+	TrajectoryFooter footer;
+	footer.directory = fileOffset;
+	footer.chunkCount = (uint32_t)directory.size();
+	footer.magic = TRAJECTORY_MAGIC;
+	if (!directory.empty())
+	{
+		writer.Write(directory.data(), directory.size() * sizeof(TrajectoryChunk));
+	}
+	writer.Write(&footer, sizeof(footer));
+	writer.Close();
+
+	directory.clear();
+}
+
+TrajectoryReader::TrajectoryReader()
+{
+	data = nullptr;
+	size = 0;
+	header = nullptr;
+	chunks = nullptr;
+	chunkCount = 0;
+#ifdef _WIN32
+	file = nullptr;
+	mapping = nullptr;
+#else
+	handle = -1;
+#endif
+}
+
+TrajectoryReader::~TrajectoryReader()
+{
+	Close();
+}
+
+bool TrajectoryReader::Open(const std::string& fileName)
+{
+	if (data != nullptr)
+	{
+		return false;
+	}
+
+#ifdef _WIN32
+	file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		file = nullptr;
+		std::cout << "Can't read file: " << fileName.data() << std::endl;
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx((HANDLE)file, &fileSize);
+	size = (size_t)fileSize.QuadPart;
+	mapping = size > 0 ? CreateFileMappingA((HANDLE)file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	data = mapping != nullptr ? (const char*)MapViewOfFile((HANDLE)mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+	handle = open(fileName.c_str(), O_RDONLY);
+	if (handle < 0)
+	{
+		std::cout << "Can't read file: " << fileName.data() << std::endl;
+		return false;
+	}
+	struct stat info;
+	if (fstat(handle, &info) == 0 && info.st_size > 0)
+	{
+		size = (size_t)info.st_size;
+		void* memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, handle, 0);
+		data = memory != MAP_FAILED ? (const char*)memory : nullptr;
+	}
+#endif
+
+	if (data == nullptr)
+	{
+		std::cout << "Couldn't map file: " << fileName.data() << std::endl;
+		Close();
+		return false;
+	}
+
+	// Check everything we'll be pointing into is inside the file now, so the scans don't have to.
+	bool good = size >= sizeof(TrajectoryHeader) + sizeof(TrajectoryFooter);
+	const TrajectoryFooter* footer = good ? (const TrajectoryFooter*)(data + size - sizeof(TrajectoryFooter)) : nullptr;
+	if (good)
+	{
+		header = (const TrajectoryHeader*)data;
+		good = header->magic == TRAJECTORY_MAGIC && header->version == TRAJECTORY_VERSION && footer->magic == TRAJECTORY_MAGIC &&
+			footer->directory % 8 == 0 && footer->directory <= size - sizeof(TrajectoryFooter) &&
+			footer->chunkCount <= (size - sizeof(TrajectoryFooter) - footer->directory) / sizeof(TrajectoryChunk);
+	}
+	if (good)
+	{
+		chunks = (const TrajectoryChunk*)(data + footer->directory);
+		chunkCount = footer->chunkCount;
+
+		static const size_t columnSizes[TRAJECTORY_COLUMNS] = { 8, 4, 4, 4, 4, 4, 4, 4 };
+		static const size_t eventSizes[EVENT_COLUMNS] = { 8, 4, 4, 4, 4, 4, 4 };
+		for (uint32_t i = 0; i < chunkCount && good; i++)
+		{
+			const TrajectoryChunk& chunk = chunks[i];
+			for (int c = 0; c < TRAJECTORY_COLUMNS && good; c++)
+			{
+				good = chunk.columns[c] % 8 == 0 && chunk.columns[c] <= footer->directory &&
+					(uint64_t)chunk.rows * columnSizes[c] <= footer->directory - chunk.columns[c];
+			}
+			for (int c = 0; c < EVENT_COLUMNS && good; c++)
+			{
+				good = chunk.eventColumns[c] % 8 == 0 && chunk.eventColumns[c] <= footer->directory &&
+					(uint64_t)chunk.events * eventSizes[c] <= footer->directory - chunk.eventColumns[c];
+			}
+		}
+	}
+	if (!good)
+	{
+		std::cout << "Not a trajectory file (or it wasn't closed): " << fileName.data() << std::endl;
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void TrajectoryReader::Close()
+{
+#ifdef _WIN32
+	if (data != nullptr)
+	{
+		UnmapViewOfFile(data);
+	}
+	if (mapping != nullptr)
+	{
+		CloseHandle((HANDLE)mapping);
+	}
+	if (file != nullptr)
+	{
+		CloseHandle((HANDLE)file);
+	}
+	file = nullptr;
+	mapping = nullptr;
+#else
+	if (data != nullptr)
+	{
+		munmap((void*)data, size);
+	}
+	if (handle >= 0)
+	{
+		close(handle);
+	}
+	handle = -1;
+#endif
+
+	data = nullptr;
+	size = 0;
+	header = nullptr;
+	chunks = nullptr;
+	chunkCount = 0;
+}
+
+bool TrajectoryReader::MightHold(const TrajectoryChunk& chunk, uint64_t firstStep, uint64_t lastStep)
+{
+	return chunk.rows > 0 && chunk.lastStep >= firstStep && chunk.firstStep <= lastStep;
+}
+
+uint32_t TrajectoryReader::FirstRow(const TrajectoryChunk& chunk, uint64_t firstStep)
+{
+	// Rows are in step order, so the first one we want can be found without reading the rest.
+	const uint64_t* steps = (const uint64_t*)GetColumn(chunk.columns[TRAJECTORY_STEP]);
+	return (uint32_t)(std::lower_bound(steps, steps + chunk.rows, firstStep) - steps);
+}
+
+void TrajectoryReader::ScanRegion(uint64_t firstStep, uint64_t lastStep, const AABB& region, std::vector<TrajectorySample>& out)
+{
+	for (uint32_t i = 0; i < chunkCount; i++)
+	{
+		const TrajectoryChunk& chunk = chunks[i];
+		if (!MightHold(chunk, firstStep, lastStep) ||
+			chunk.maxPosition[0] < region.min.x || chunk.minPosition[0] > region.max.x ||
+			chunk.maxPosition[1] < region.min.y || chunk.minPosition[1] > region.max.y ||
+			chunk.maxPosition[2] < region.min.z || chunk.minPosition[2] > region.max.z)
+		{
+			continue;
+		}
+
+		const uint64_t* steps = (const uint64_t*)GetColumn(chunk.columns[TRAJECTORY_STEP]);
+		const int32_t* ids = (const int32_t*)GetColumn(chunk.columns[TRAJECTORY_ID]);
+		const float* x = (const float*)GetColumn(chunk.columns[TRAJECTORY_POSITION_X]);
+		const float* y = (const float*)GetColumn(chunk.columns[TRAJECTORY_POSITION_Y]);
+		const float* z = (const float*)GetColumn(chunk.columns[TRAJECTORY_POSITION_Z]);
+		const float* vx = (const float*)GetColumn(chunk.columns[TRAJECTORY_VELOCITY_X]);
+		const float* vy = (const float*)GetColumn(chunk.columns[TRAJECTORY_VELOCITY_Y]);
+		const float* vz = (const float*)GetColumn(chunk.columns[TRAJECTORY_VELOCITY_Z]);
+
+		// The test only reads the step and position columns; the rest are only read for rows that match.
+		for (uint32_t row = FirstRow(chunk, firstStep); row < chunk.rows && steps[row] <= lastStep; row++)
+		{
+			if (x[row] >= region.min.x && x[row] <= region.max.x && y[row] >= region.min.y && y[row] <= region.max.y &&
+				z[row] >= region.min.z && z[row] <= region.max.z)
+			{
+				TrajectorySample sample;
+				sample.step = steps[row];
+				sample.id = ids[row];
+				sample.position = glm::vec3(x[row], y[row], z[row]);
+				sample.velocity = glm::vec3(vx[row], vy[row], vz[row]);
+				out.push_back(sample);
+			}
+		}
+	}
+}
+
+void TrajectoryReader::ScanBody(int32_t id, uint64_t firstStep, uint64_t lastStep, std::vector<TrajectorySample>& out)
+{
+	for (uint32_t i = 0; i < chunkCount; i++)
+	{
+		const TrajectoryChunk& chunk = chunks[i];
+		if (!MightHold(chunk, firstStep, lastStep) || id < chunk.minId || id > chunk.maxId)
+		{
+			continue;
+		}
+
+		const uint64_t* steps = (const uint64_t*)GetColumn(chunk.columns[TRAJECTORY_STEP]);
+		const int32_t* ids = (const int32_t*)GetColumn(chunk.columns[TRAJECTORY_ID]);
+		for (uint32_t row = FirstRow(chunk, firstStep); row < chunk.rows && steps[row] <= lastStep; row++)
+		{
+			if (ids[row] == id)
+			{
+				TrajectorySample sample;
+				sample.step = steps[row];
+				sample.id = id;
+				for (int a = 0; a < 3; a++)
+				{
+					sample.position[a] = ((const float*)GetColumn(chunk.columns[TRAJECTORY_POSITION_X + a]))[row];
+					sample.velocity[a] = ((const float*)GetColumn(chunk.columns[TRAJECTORY_VELOCITY_X + a]))[row];
+				}
+				out.push_back(sample);
+			}
+		}
+	}
+}
+
+void TrajectoryReader::ScanCollisions(uint64_t firstStep, uint64_t lastStep, std::vector<TrajectoryEvent>& out)
+{
+	for (uint32_t i = 0; i < chunkCount; i++)
+	{
+		const TrajectoryChunk& chunk = chunks[i];
+		if (chunk.events == 0 || chunk.lastStep < firstStep || chunk.firstStep > lastStep)
+		{
+			continue;
+		}
+
+		const uint64_t* steps = (const uint64_t*)GetColumn(chunk.eventColumns[EVENT_STEP]);
+		const int32_t* bodyA = (const int32_t*)GetColumn(chunk.eventColumns[EVENT_BODY_A]);
+		const int32_t* bodyB = (const int32_t*)GetColumn(chunk.eventColumns[EVENT_BODY_B]);
+		const float* hitTime = (const float*)GetColumn(chunk.eventColumns[EVENT_TIME]);
+		const float* nx = (const float*)GetColumn(chunk.eventColumns[EVENT_NORMAL_X]);
+		const float* ny = (const float*)GetColumn(chunk.eventColumns[EVENT_NORMAL_Y]);
+		const float* nz = (const float*)GetColumn(chunk.eventColumns[EVENT_NORMAL_Z]);
+
+		for (uint32_t row = (uint32_t)(std::lower_bound(steps, steps + chunk.events, firstStep) - steps); row < chunk.events && steps[row] <= lastStep; row++)
+		{
+			TrajectoryEvent event;
+			event.step = steps[row];
+			event.collision.bodyA = bodyA[row];
+			event.collision.bodyB = bodyB[row];
+			event.collision.hitTime = hitTime[row];
+			event.collision.normal = glm::vec3(nx[row], ny[row], nz[row]);
+			out.push_back(event);
+		}
+	}
+}
+
+#endif // _TRAJECTORY_FILE_CPP
@@ -0,0 +1,220 @@
+/*
+Title: Swept AABB-3D
+File Name: TrajectoryFile.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Exports where every body was, how fast it was going, and which bodies hit each other, step by
+step, in a columnar file for offline analysis. Each field is stored as its own column (one
+array of the same type), and the steps are cut into chunks of stepsPerChunk steps. Every chunk
+keeps the range of steps, ids, positions and velocities it holds, so a reader that only wants
+"every body in this box between steps 1000 and 2000" can tell which chunks to skip without
+looking inside them. The file is meant to be memory mapped: TrajectoryReader reads the columns
+in place, and only the pages of the chunks a scan actually touches are ever read off the disk.
+
+Trajectory file (little-endian, every column starts on an 8-byte boundary):
+	TrajectoryHeader
+	Chunks, one after another. Each is its columns, one after another:
+		TRAJECTORY_COLUMNS columns of rows values (uint64 step, int32 id, then float position
+		x, y, z and velocity x, y, z), rows sorted by step,
+		then EVENT_COLUMNS columns of events values (uint64 step, int32 body a, int32 body b,
+		then float time, normal x, y, z).
+	TrajectoryChunk[chunkCount]	The directory: where each chunk's columns are, and its stats.
+	TrajectoryFooter			Where the directory is. Always the last 16 bytes.
+*/
+
+#ifndef _TRAJECTORY_FILE_H
+#define _TRAJECTORY_FILE_H
+
+#include "AsyncWriter.h"
+#include "Collision.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+const uint32_t TRAJECTORY_MAGIC = 0x4A415254;	// "TRAJ"
+const uint32_t TRAJECTORY_VERSION = 1;
+
+// One row per body per step.
+enum TrajectoryColumn
+{
+	TRAJECTORY_STEP,		// uint64
+	TRAJECTORY_ID,			// int32
+	TRAJECTORY_POSITION_X,	// The rest are float.
+	TRAJECTORY_POSITION_Y,
+	TRAJECTORY_POSITION_Z,
+	TRAJECTORY_VELOCITY_X,
+	TRAJECTORY_VELOCITY_Y,
+	TRAJECTORY_VELOCITY_Z,
+	TRAJECTORY_COLUMNS
+};
+
+// One row per collision.
+enum TrajectoryEventColumn
+{
+	EVENT_STEP,				// uint64
+	EVENT_BODY_A,			// int32
+	EVENT_BODY_B,			// int32
+	EVENT_TIME,				// The rest are float.
+	EVENT_NORMAL_X,
+	EVENT_NORMAL_Y,
+	EVENT_NORMAL_Z,
+	EVENT_COLUMNS
+};
+
+struct TrajectoryHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t stepsPerChunk;
+	uint32_t reserved;
+};
+
+// A directory entry. Column offsets are from the start of the file.
+struct TrajectoryChunk
+{
+	uint64_t firstStep;
+	uint64_t lastStep;
+	uint64_t columns[TRAJECTORY_COLUMNS];
+	uint64_t eventColumns[EVENT_COLUMNS];
+	uint32_t rows;
+	uint32_t events;
+
+	// Stats over every row in the chunk.
+	int32_t minId;
+	int32_t maxId;
+	float minPosition[3];
+	float maxPosition[3];
+	float minVelocity[3];
+	float maxVelocity[3];
+};
+
+struct TrajectoryFooter
+{
+	uint64_t directory;
+	uint32_t chunkCount;
+	uint32_t magic;
+};
+
+// What the reader's scans return.
+struct TrajectorySample
+{
+	uint64_t step;
+	int32_t id;
+	glm::vec3 position;
+	glm::vec3 velocity;
+};
+
+struct TrajectoryEvent
+{
+	uint64_t step;
+	CollisionEvent collision;
+};
+
+class TrajectoryWriter
+{
+	AsyncWriter writer;
+	uint32_t stepsPerChunk;
+	uint64_t fileOffset;
+	std::vector<TrajectoryChunk> directory;
+
+	// The chunk being filled, a column at a time.
+	TrajectoryChunk chunk;
+	uint32_t chunkSteps;
+	std::vector<uint64_t> steps;
+	std::vector<int32_t> ids;
+	std::vector<float> values[TRAJECTORY_COLUMNS - TRAJECTORY_POSITION_X];
+	std::vector<uint64_t> eventSteps;
+	std::vector<int32_t> eventBodies[2];
+	std::vector<float> eventValues[EVENT_COLUMNS - EVENT_TIME];
+
+	uint64_t WriteColumn(const void* data, size_t size);
+	void FinishChunk();
+
+public:
+	TrajectoryWriter();
+	~TrajectoryWriter();
+
+	// Memory use is a chunk's worth of rows, plus the writer's buffers.
+	bool Open(const std::string& fileName, int chunkSteps = 64);
+
+	// Adds one step. Call this from one thread at a time, once the step's solve is done. The chunk goes out to the disk (in the background)
+	// once it's full.
+	void Record(uint64_t step, const std::vector<GameObject*>& bodies, const std::vector<CollisionEvent>& collisions);
+
+	// Writes what's left of the last chunk, and the directory. The file can't be read until this is done.
+	void Close();
+};
+
+// Reads a trajectory file in place, memory mapped.
+class TrajectoryReader
+{
+	const char* data;
+	size_t size;
+	const TrajectoryHeader* header;
+	const TrajectoryChunk* chunks;
+	uint32_t chunkCount;
+
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#else
+	int handle;
+#endif
+
+	// Whether a chunk's stats and steps leave any chance of a match.
+	bool MightHold(const TrajectoryChunk& chunk, uint64_t firstStep, uint64_t lastStep);
+	uint32_t FirstRow(const TrajectoryChunk& chunk, uint64_t firstStep);
+
+public:
+	TrajectoryReader();
+	~TrajectoryReader();
+
+	bool Open(const std::string& fileName);
+	void Close();
+
+	uint32_t NumChunks()
+	{
+		return chunkCount;
+	}
+	const TrajectoryChunk& GetChunk(uint32_t index)
+	{
+		return chunks[index];
+	}
+
+	// A column of a chunk, straight out of the mapped file (see TrajectoryColumn and TrajectoryEventColumn for the types).
+	// Open() has already checked that every column is inside the file.
+	const void* GetColumn(uint64_t offset)
+	{
+		return data + offset;
+	}
+
+	// Every row between firstStep and lastStep (both included) whose position is inside region.
+	void ScanRegion(uint64_t firstStep, uint64_t lastStep, const AABB& region, std::vector<TrajectorySample>& out);
+
+	// Every row of one body between firstStep and lastStep, in step order.
+	void ScanBody(int32_t id, uint64_t firstStep, uint64_t lastStep, std::vector<TrajectorySample>& out);
+
+	// Every collision between firstStep and lastStep.
+	void ScanCollisions(uint64_t firstStep, uint64_t lastStep, std::vector<TrajectoryEvent>& out);
+};
+
+#endif //_TRAJECTORY_FILE_H
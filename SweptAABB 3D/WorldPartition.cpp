@@ -0,0 +1,322 @@
+/*
+Title: Swept AABB-3D
+File Name: WorldPartition.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Splits the world into a grid of spatial regions and hands each region to a NUMA node.
+Each region keeps its bodies in its own block of memory, and that block is allocated and
+first written by a worker running on the owning node, so the pages end up in that node's
+memory. Per-region work is then scheduled on the owning node's workers.
+*/
+
+#ifndef _WORLD_PARTITION_CPP
+#define _WORLD_PARTITION_CPP
+
+#include "WorldPartition.h"
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <cmath>
+
+WorldPartition::WorldPartition(JobSystem* jobSystem, AABB bounds, int numX, int numY, int numZ, int bodiesPerRegion)
+{
+	jobs = jobSystem;
+	worldBounds = bounds;
+	liveBodies = 0;
+	allocated = true;
+	regionsX = numX > 0 ? numX : 1;
+	regionsY = numY > 0 ? numY : 1;
+	regionsZ = numZ > 0 ? numZ : 1;
+
+	int numRegions = regionsX * regionsY * regionsZ;
+	int numNodes = jobs->NumNodes();
+	regions.resize(numRegions);
+
+	glm::vec3 cellSize = (bounds.max - bounds.min) / glm::vec3((float)regionsX, (float)regionsY, (float)regionsZ);
+
+	for (int z = 0; z < regionsZ; z++)
+	{
+		for (int y = 0; y < regionsY; y++)
+		{
+			for (int x = 0; x < regionsX; x++)
+			{
+				int index = x + regionsX * (y + regionsY * z);
+				WorldRegion& region = regions[index];
+
+				region.bounds.min = bounds.min + cellSize * glm::vec3((float)x, (float)y, (float)z);
+				region.bounds.max = region.bounds.min + cellSize;
+
+				// Give each node a contiguous run of regions. Since regions are numbered along x first, this keeps
+				// neighbouring regions (which exchange the most bodies) on the same node.
+				region.node = (index * numNodes) / numRegions;
+				region.capacity = bodiesPerRegion;
+			}
+		}
+	}
+
+	// Allocate each region's body memory from a worker on the region's node, and write to all of it right away.
+	// The operating system places a page on the node of whichever thread first touches it, so doing the memset
+	// here (instead of on the main thread) is what makes the memory local to the node.
+	ForEachRegion([](WorldRegion& region)
+	{
+		size_t bytes = sizeof(GameObject) * region.capacity;
+		region.memory = (char*)malloc(bytes);
+		if (region.memory == nullptr)
+		{
+			return;
+		}
+		memset(region.memory, 0, bytes);
+
+		region.bodies.reserve(region.capacity);
+	});
+
+	// A region without memory can't hold any bodies, so make sure nothing tries to put one there.
+	for (size_t i = 0; i < regions.size(); i++)
+	{
+		if (regions[i].memory == nullptr)
+		{
+			regions[i].capacity = 0;
+			allocated = false;
+		}
+	}
+	if (!allocated)
+	{
+		std::cout << "Couldn't allocate the memory for every world region." << std::endl;
+	}
+}
+
+WorldPartition::~WorldPartition()
+{
+	for (size_t i = 0; i < regions.size(); i++)
+	{
+		// The bodies were built with placement new, so we call their destructors ourselves before freeing the block.
+		for (size_t j = 0; j < regions[i].bodies.size(); j++)
+		{
+			regions[i].bodies[j]->~GameObject();
+		}
+
+		free(regions[i].memory);
+		regions[i].memory = nullptr;
+	}
+}
+
+int WorldPartition::TakeSlot(WorldRegion& region)
+{
+	// Reuse the slot of a destroyed body if there is one, otherwise take the next unused one.
+	if (!region.freeSlots.empty())
+	{
+		int slot = region.freeSlots.back();
+		region.freeSlots.pop_back();
+		return slot;
+	}
+	if (region.used < region.capacity)
+	{
+		return region.used++;
+	}
+	return -1;
+}
+
+GameObject* WorldPartition::CreateBody(Model* model, glm::vec3 position)
+{
+	int regionIndex = RegionIndexFor(position);
+	if (regionIndex < 0)
+	{
+		std::cout << "Can't create a body at a position that isn't finite." << std::endl;
+		return nullptr;
+	}
+	WorldRegion& region = regions[regionIndex];
+
+	int slot = TakeSlot(region);
+	if (slot < 0)
+	{
+		std::cout << "World region is full, can't create another body in it." << std::endl;
+		return nullptr;
+	}
+
+	// Construct the GameObject directly inside the region's node-local block.
+	GameObject* body = new (region.memory + sizeof(GameObject) * slot) GameObject(model);
+
+	body->SetPosition(position);
+	region.bodies.push_back(body);
+
+	if (!freeIds.empty())
+	{
+		body->SetId(freeIds.back());
+		freeIds.pop_back();
+		bodyTable[body->GetId()] = body;
+		bodyRegions[body->GetId()] = regionIndex;
+	}
+	else
+	{
+		body->SetId((int)bodyTable.size());
+		bodyTable.push_back(body);
+		bodyRegions.push_back(regionIndex);
+		idGenerations.push_back(0);
+	}
+	liveBodies++;
+
+	return body;
+}
+
+void WorldPartition::DestroyBody(int id)
+{
+	GameObject* body = GetBody(id);
+	if (body == nullptr)
+	{
+		return;
+	}
+
+	WorldRegion& region = regions[bodyRegions[id]];
+
+	// Swap the body with the last one in the list and pop it, since the order of a region's bodies doesn't matter.
+	std::vector<GameObject*>::iterator found = std::find(region.bodies.begin(), region.bodies.end(), body);
+	*found = region.bodies.back();
+	region.bodies.pop_back();
+
+	region.freeSlots.push_back((int)(((char*)body - region.memory) / sizeof(GameObject)));
+	body->~GameObject();
+
+	bodyTable[id] = nullptr;
+	idGenerations[id]++;
+	freeIds.push_back(id);
+	liveBodies--;
+}
+
+int WorldPartition::MigrateBodies()
+{
+	// Finding the bodies that have left only reads each region's own bodies, so every region looks through its own on its own node.
+	ForEachRegion([this](WorldRegion& region)
+	{
+		int index = (int)(&region - &regions[0]);
+		region.leaving.clear();
+		for (size_t i = 0; i < region.bodies.size(); i++)
+		{
+			int destination = RegionIndexFor(region.bodies[i]->GetPosition());
+			if (destination >= 0 && destination != index)
+			{
+				region.leaving.push_back(region.bodies[i]);
+			}
+		}
+	});
+
+	// Moving them changes two regions at once, so that part is done here, one body at a time. Only a few bodies cross a border
+	// each step. The destination's pages were first touched by its own node when it was allocated, so the copy stays on that node.
+	int moved = 0;
+	for (size_t r = 0; r < regions.size(); r++)
+	{
+		WorldRegion& source = regions[r];
+		for (size_t i = 0; i < source.leaving.size(); i++)
+		{
+			GameObject* body = source.leaving[i];
+			int destinationIndex = RegionIndexFor(body->GetPosition());
+			WorldRegion& destination = regions[destinationIndex];
+
+			int slot = TakeSlot(destination);
+			if (slot < 0)
+			{
+				continue;
+			}
+
+			GameObject* copy = new (destination.memory + sizeof(GameObject) * slot) GameObject(*body);
+			destination.bodies.push_back(copy);
+
+			std::vector<GameObject*>::iterator found = std::find(source.bodies.begin(), source.bodies.end(), body);
+			*found = source.bodies.back();
+			source.bodies.pop_back();
+			source.freeSlots.push_back((int)(((char*)body - source.memory) / sizeof(GameObject)));
+			body->~GameObject();
+
+			bodyTable[copy->GetId()] = copy;
+			bodyRegions[copy->GetId()] = destinationIndex;
+			moved++;
+		}
+		source.leaving.clear();
+	}
+
+	return moved;
+}
+
+int WorldPartition::RegionIndexFor(glm::vec3 position)
+{
+	if (!std::isfinite(position.x) || !std::isfinite(position.y) || !std::isfinite(position.z))
+	{
+		return -1;
+	}
+
+	glm::vec3 relative = (position - worldBounds.min) / (worldBounds.max - worldBounds.min);
+
+	// Clamp anything outside of the world to the edge regions. This is done before converting to int, since a float that's too big
+	// for an int doesn't convert to anything sensible. The !(a >= b) form also catches a NaN from a world with no size.
+	float cell[3] = { relative.x * regionsX, relative.y * regionsY, relative.z * regionsZ };
+	int counts[3] = { regionsX, regionsY, regionsZ };
+	int index[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (!(cell[axis] >= 0.0f))
+		{
+			index[axis] = 0;
+		}
+		else if (cell[axis] >= (float)counts[axis])
+		{
+			index[axis] = counts[axis] - 1;
+		}
+		else
+		{
+			index[axis] = std::min((int)cell[axis], counts[axis] - 1);
+		}
+	}
+
+	return index[0] + regionsX * (index[1] + regionsY * index[2]);
+}
+
+void WorldPartition::ForEachRegion(std::function<void(WorldRegion&)> fn)
+{
+	JobCounter counter;
+
+	for (size_t i = 0; i < regions.size(); i++)
+	{
+		WorldRegion* region = &regions[i];
+
+		// Pin the job to the region's node, so only that node's workers will ever read this region's memory.
+		jobs->Submit([fn, region]()
+		{
+			fn(*region);
+		}, &counter, region->node);
+	}
+
+	jobs->Wait(&counter);
+}
+
+void WorldPartition::ForEachBody(std::function<void(GameObject*)> fn)
+{
+	ForEachRegion([fn](WorldRegion& region)
+	{
+		for (size_t i = 0; i < region.bodies.size(); i++)
+		{
+			fn(region.bodies[i]);
+		}
+	});
+}
+
+#endif // _WORLD_PARTITION_CPP
@@ -0,0 +1,176 @@
+/*
+Title: Swept AABB-3D
+File Name: WorldPartition.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Splits the world into a grid of spatial regions and hands each region to a NUMA node.
+Each region keeps its bodies in its own block of memory, and that block is allocated and
+first written by a worker running on the owning node, so the pages end up in that node's
+memory. Per-region work is then scheduled on the owning node's workers. Bodies that move
+out of their region are moved into the memory of the region they moved into between steps.
+*/
+
+#ifndef _WORLD_PARTITION_H
+#define _WORLD_PARTITION_H
+
+#include "GameObject.h"
+#include "JobSystem.h"
+#include <vector>
+#include <functional>
+
+// One cell of the world grid.
+struct WorldRegion
+{
+	AABB bounds;		// The part of space this region owns.
+	int node;			// Index of the NUMA node that owns this region's memory and jobs.
+
+	char* memory;		// Node-local block that the GameObjects below live in.
+	int capacity;		// How many GameObjects fit in memory.
+	int used;			// How many slots of memory have been handed out.
+	std::vector<int> freeSlots;			// Slots below used whose body was destroyed, ready to be handed out again.
+
+	std::vector<GameObject*> bodies;	// The bodies that currently belong to this region.
+	std::vector<GameObject*> leaving;	// Bodies found outside the region by MigrateBodies(), waiting to be moved.
+
+	WorldRegion()
+	{
+		node = 0;
+		memory = nullptr;
+		capacity = 0;
+		used = 0;
+	}
+};
+
+class WorldPartition
+{
+	JobSystem* jobs;
+
+	AABB worldBounds;
+	int regionsX;
+	int regionsY;
+	int regionsZ;
+
+	std::vector<WorldRegion> regions;
+
+	// Every body ever created, indexed by its id, along with the region that owns it. Destroyed bodies leave a nullptr behind,
+	// and their ids are handed out again.
+	std::vector<GameObject*> bodyTable;
+	std::vector<int> bodyRegions;
+	std::vector<int> freeIds;
+	int liveBodies;
+
+	// Goes up every time an id's body is destroyed, so code that keeps its own data per id can tell when the id has been handed out again.
+	std::vector<unsigned int> idGenerations;
+
+	// False if a region's memory couldn't be allocated.
+	bool allocated;
+
+	// Takes a slot in the region's memory, or returns -1 if it's full.
+	int TakeSlot(WorldRegion& region);
+
+public:
+	// Splits bounds into numX * numY * numZ regions, each able to hold bodiesPerRegion bodies.
+	// Neighbouring regions are given to the same node where possible, so that nearby bodies share a node.
+	WorldPartition(JobSystem* jobSystem, AABB bounds, int numX, int numY, int numZ, int bodiesPerRegion);
+	~WorldPartition();
+
+	// False if the memory for any region couldn't be allocated. Such a world can't be used, and should just be deleted.
+	bool IsAllocated()
+	{
+		return allocated;
+	}
+
+	// Creates a body inside the memory of whichever region contains position, and gives it the next free id.
+	// Returns nullptr if that region is full, or if position isn't finite.
+	GameObject* CreateBody(Model* model, glm::vec3 position);
+
+	// Destroys a body and frees its slot and id for reuse. Don't call this while a step is running.
+	void DestroyBody(int id);
+
+	// Moves every body that has left its region into the memory of the region it's in now, so its work stays on the node that owns
+	// that part of space. A body whose new region is full stays where it is until there's room. Call this between steps: a moved
+	// body is at a new address, so nothing may hold on to a GameObject* across it (keep the id and use GetBody() instead).
+	// Returns how many bodies moved.
+	int MigrateBodies();
+
+	// Finds the region that contains the given position. Positions outside the world are clamped to the nearest edge region.
+	// Returns -1 for a position that isn't finite, since it isn't anywhere.
+	int RegionIndexFor(glm::vec3 position);
+
+	// Runs fn once per region, each on a worker of the region's node, and waits for all of them to finish.
+	void ForEachRegion(std::function<void(WorldRegion&)> fn);
+
+	// Runs fn once per body, batched by region so that every body is processed on its own node.
+	void ForEachBody(std::function<void(GameObject*)> fn);
+
+	// Looks up a body by its id. Returns nullptr if there's no such body.
+	GameObject* GetBody(int id)
+	{
+		if (id < 0 || id >= (int)bodyTable.size())
+		{
+			return nullptr;
+		}
+		return bodyTable[id];
+	}
+
+	// Returns the index of the region that owns the body with the given id.
+	int RegionOfBody(int id)
+	{
+		return bodyRegions[id];
+	}
+
+	int NumBodies()
+	{
+		return liveBodies;
+	}
+
+	// Which body the id is on: a body created with an id that was used before gets a different generation from the one before it.
+	unsigned int IdGeneration(int id)
+	{
+		return idGenerations[id];
+	}
+
+	// Every id that has been handed out is below this.
+	int IdLimit()
+	{
+		return (int)bodyTable.size();
+	}
+
+	int NumRegions()
+	{
+		return (int)regions.size();
+	}
+	WorldRegion& GetRegion(int index)
+	{
+		return regions[index];
+	}
+	AABB GetBounds()
+	{
+		return worldBounds;
+	}
+	JobSystem* GetJobSystem()
+	{
+		return jobs;
+	}
+};
+
+#endif //_WORLD_PARTITION_H
@@ -0,0 +1,228 @@
+/*
+Title: Swept AABB-3D
+File Name: WorldRegistry.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Hosts any number of independent worlds (matches, rooms, ...) in one process, all stepping on
+the same job system. Each world has a priority, which sets its share of the workers, and a step
+budget, which caps how much time it can take in one tick. Worlds are stepped in order of
+"virtual time": the time each world has spent stepping so far, divided by its share. That keeps
+a world with a lot going on from starving the others, because the more time it takes, the
+further back in the line it goes.
+*/
+
+#ifndef _WORLD_REGISTRY_CPP
+#define _WORLD_REGISTRY_CPP
+
+#include "WorldRegistry.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+WorldRegistry::WorldRegistry(JobSystem* jobSystem, int maxConcurrent)
+{
+	jobs = jobSystem;
+	nextId = 0;
+	maxConcurrentWorlds = maxConcurrent > 0 ? maxConcurrent : std::max(jobs->NumWorkers(), 1);
+}
+
+WorldRegistry::~WorldRegistry()
+{
+	for (size_t i = 0; i < worlds.size(); i++)
+	{
+		delete(worlds[i]->pipeline);
+		delete(worlds[i]->partition);
+		delete(worlds[i]);
+	}
+}
+
+HostedWorld* WorldRegistry::CreateWorld(const std::string& name, const WorldSettings& settings)
+{
+	HostedWorld* world = new HostedWorld();
+	world->id = nextId++;
+	world->name = name;
+	world->settings = settings;
+
+	world->partition = new WorldPartition(jobs, settings.bounds, settings.regionsX, settings.regionsY, settings.regionsZ, settings.bodiesPerRegion);
+	if (!world->partition->IsAllocated())
+	{
+		delete(world->partition);
+		delete(world);
+		return nullptr;
+	}
+	world->pipeline = new StepPipeline(world->partition);
+
+	// Start the new world level with the one that's furthest behind. Starting it at zero would let it take every step
+	// until it caught up with worlds that have been running for a long time.
+	world->virtualTime = 0.0;
+	for (size_t i = 0; i < worlds.size(); i++)
+	{
+		if (i == 0 || worlds[i]->virtualTime < world->virtualTime)
+		{
+			world->virtualTime = worlds[i]->virtualTime;
+		}
+	}
+
+	world->owedSteps = 0;
+	world->lastStepTime = 0.0;
+	world->averageStepTime = 0.0;
+	world->tickTime = 0.0;
+	world->stepsTaken = 0;
+	world->stepsDropped = 0;
+	world->overBudgetSteps = 0;
+
+	worlds.push_back(world);
+	return world;
+}
+
+void WorldRegistry::DestroyWorld(int id)
+{
+	for (size_t i = 0; i < worlds.size(); i++)
+	{
+		if (worlds[i]->id == id)
+		{
+			delete(worlds[i]->pipeline);
+			delete(worlds[i]->partition);
+			delete(worlds[i]);
+			worlds.erase(worlds.begin() + i);
+			return;
+		}
+	}
+
+	std::cout << "No world with id " << id << std::endl;
+}
+
+HostedWorld* WorldRegistry::GetWorld(int id)
+{
+	for (size_t i = 0; i < worlds.size(); i++)
+	{
+		if (worlds[i]->id == id)
+		{
+			return worlds[i];
+		}
+	}
+	return nullptr;
+}
+
+bool WorldRegistry::CanStep(HostedWorld* world)
+{
+	if (world->owedSteps <= 0)
+	{
+		return false;
+	}
+
+	// Every world gets its first step of the tick. After that, it only catches up while it has budget left for another step.
+	return world->tickTime == 0.0 || world->tickTime + world->averageStepTime <= world->settings.stepBudget;
+}
+
+void WorldRegistry::Tick(float dt, double frameBudget)
+{
+	std::chrono::high_resolution_clock::time_point tickStart = std::chrono::high_resolution_clock::now();
+
+	for (size_t i = 0; i < worlds.size(); i++)
+	{
+		worlds[i]->tickTime = 0.0;
+		worlds[i]->owedSteps++;
+
+		if (worlds[i]->owedSteps > worlds[i]->settings.maxOwedSteps)
+		{
+			worlds[i]->stepsDropped += worlds[i]->owedSteps - worlds[i]->settings.maxOwedSteps;
+			worlds[i]->owedSteps = worlds[i]->settings.maxOwedSteps;
+		}
+	}
+
+	// Step the worlds in waves. Each wave picks the worlds that are furthest behind their fair share, steps them side by side on the
+	// job system, and charges each of them for the time it took. A busy world's virtual time goes up quickly, so it drops to the back.
+	std::vector<HostedWorld*> ready;
+	bool firstWave = true;
+	while (true)
+	{
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tickStart).count();
+
+		// Once the frame is used up, anything still owed waits for the next tick. We always run one wave, so the worlds can't stall completely.
+		if (!firstWave && elapsed >= frameBudget)
+		{
+			break;
+		}
+		firstWave = false;
+
+		ready.clear();
+		for (size_t i = 0; i < worlds.size(); i++)
+		{
+			if (CanStep(worlds[i]))
+			{
+				ready.push_back(worlds[i]);
+			}
+		}
+		if (ready.empty())
+		{
+			break;
+		}
+
+		std::sort(ready.begin(), ready.end(), [](const HostedWorld* a, const HostedWorld* b)
+		{
+			if (a->virtualTime != b->virtualTime)
+			{
+				return a->virtualTime < b->virtualTime;
+			}
+			return a->id < b->id;
+		});
+		if ((int)ready.size() > maxConcurrentWorlds)
+		{
+			ready.resize(maxConcurrentWorlds);
+		}
+
+		// Each step runs its own task graph; while a step waits on its graph, the thread helps out with whatever else is queued,
+		// including the other worlds' tasks.
+		JobCounter counter;
+		for (size_t i = 0; i < ready.size(); i++)
+		{
+			HostedWorld* world = ready[i];
+			jobs->Submit([world, dt]()
+			{
+				world->pipeline->Step(dt);
+			}, &counter);
+		}
+		jobs->Wait(&counter);
+
+		for (size_t i = 0; i < ready.size(); i++)
+		{
+			HostedWorld* world = ready[i];
+
+			world->lastStepTime = world->pipeline->GetLastStepWork();
+			world->owedSteps--;
+			world->stepsTaken++;
+			world->tickTime += world->lastStepTime;
+			world->virtualTime += world->lastStepTime / (double)world->settings.priority;
+
+			// A running average, so that one slow step doesn't throw off the catch-up decision for long.
+			world->averageStepTime = world->stepsTaken == 1 ? world->lastStepTime : world->averageStepTime * 0.9 + world->lastStepTime * 0.1;
+
+			if (world->lastStepTime > world->settings.stepBudget)
+			{
+				world->overBudgetSteps++;
+			}
+		}
+	}
+}
+
+#endif // _WORLD_REGISTRY_CPP
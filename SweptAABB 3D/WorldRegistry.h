@@ -0,0 +1,133 @@
+/*
+Title: Swept AABB-3D
+File Name: WorldRegistry.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+Hosts any number of independent worlds (matches, rooms, ...) in one process, all stepping on
+the same job system. Each world has a priority, which sets its share of the workers, and a step
+budget, which caps how much time it can take in one tick. Worlds are stepped in order of
+"virtual time": the time each world has spent stepping so far, divided by its share. That keeps
+a world with a lot going on from starving the others, because the more time it takes, the
+further back in the line it goes.
+*/
+
+#ifndef _WORLD_REGISTRY_H
+#define _WORLD_REGISTRY_H
+
+#include "StepPipeline.h"
+#include <string>
+#include <vector>
+
+// How big a share of the workers a world gets. The value is the share's weight: a high priority world gets four times
+// as much time as a low priority one when they are both busy.
+enum WorldPriority
+{
+	WORLD_PRIORITY_LOW = 1,
+	WORLD_PRIORITY_NORMAL = 2,
+	WORLD_PRIORITY_HIGH = 4
+};
+
+struct WorldSettings
+{
+	AABB bounds;
+	int regionsX, regionsY, regionsZ;
+	int bodiesPerRegion;
+
+	WorldPriority priority;
+
+	// Time, in milliseconds, the world may spend stepping per tick. A world always gets at least one step per tick if there's
+	// time left in the frame, but it only gets to catch up on missed steps while it is under budget.
+	double stepBudget;
+
+	// The most steps a world can fall behind by. Any more than that are dropped, and the world runs slower than real time.
+	int maxOwedSteps;
+
+	WorldSettings()
+	{
+		bounds = AABB(glm::vec3(-1.25f), glm::vec3(1.25f));
+		regionsX = regionsY = regionsZ = 2;
+		bodiesPerRegion = 64;
+		priority = WORLD_PRIORITY_NORMAL;
+		stepBudget = 4.0;
+		maxOwedSteps = 4;
+	}
+};
+
+struct HostedWorld
+{
+	int id;
+	std::string name;
+	WorldSettings settings;
+
+	WorldPartition* partition;
+	StepPipeline* pipeline;
+
+	// Scheduling state. Times are in milliseconds of work done on the workers (see StepPipeline::GetLastStepWork()), rather than wall-clock
+	// time, so that a world isn't charged for time its step spent waiting while the workers were busy with another world.
+	double virtualTime;		// Time spent stepping, divided by the priority's weight.
+	int owedSteps;			// Steps the world is behind by.
+	double lastStepTime;
+	double averageStepTime;
+	double tickTime;		// Time spent stepping in the current tick.
+
+	// Statistics.
+	unsigned long long stepsTaken;
+	unsigned long long stepsDropped;
+	unsigned long long overBudgetSteps;
+};
+
+class WorldRegistry
+{
+	JobSystem* jobs;
+	std::vector<HostedWorld*> worlds;
+	int nextId;
+
+	// How many worlds step at the same time.
+	int maxConcurrentWorlds;
+
+	bool CanStep(HostedWorld* world);
+
+public:
+	// maxConcurrent is how many worlds may step at once; 0 means one per worker.
+	WorldRegistry(JobSystem* jobSystem, int maxConcurrent = 0);
+	~WorldRegistry();
+
+	// Creates a new, empty world and its step pipeline. The registry owns both. Returns nullptr if there isn't enough memory for the world.
+	HostedWorld* CreateWorld(const std::string& name, const WorldSettings& settings = WorldSettings());
+	void DestroyWorld(int id);
+
+	HostedWorld* GetWorld(int id);
+	int NumWorlds()
+	{
+		return (int)worlds.size();
+	}
+	HostedWorld* GetWorldAt(int index)
+	{
+		return worlds[index];
+	}
+
+	// Every world is owed one more step of dt. Worlds are then stepped, the ones furthest behind their fair share first, until every
+	// world is caught up or frameBudget milliseconds have gone by. Blocks until the last steps it started are done.
+	void Tick(float dt, double frameBudget);
+};
+
+#endif //_WORLD_REGISTRY_H
@@ -0,0 +1,153 @@
+/*
+Title: Swept AABB-3D
+File Name: WorldSnapshot.cpp
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+A read-only copy of the world as it was at the end of one physics step: every body's id,
+position, velocity and AABB, stored as separate arrays (one per component) so they can be
+scanned quickly. Raycasts and overlap queries run against a snapshot, so they can happen on
+any thread while the next step is busy changing the live bodies.
+*/
+
+#ifndef _WORLD_SNAPSHOT_CPP
+#define _WORLD_SNAPSHOT_CPP
+
+#include "WorldSnapshot.h"
+#include <algorithm>
+#include <limits>
+
+void WorldSnapshot::Build(unsigned long long stepNumber, const std::vector<GameObject*>& bodies, const std::vector<AABB>& boxes)
+{
+	step = stepNumber;
+
+	// Sort the bodies by the left edge of their AABB first, then copy them out in that order.
+	std::vector<int> order(bodies.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		order[i] = (int)i;
+	}
+	std::sort(order.begin(), order.end(), [&boxes](int a, int b)
+	{
+		return boxes[a].min.x < boxes[b].min.x;
+	});
+
+	size_t count = bodies.size();
+	ids.resize(count);
+	positionX.resize(count); positionY.resize(count); positionZ.resize(count);
+	velocityX.resize(count); velocityY.resize(count); velocityZ.resize(count);
+	minX.resize(count); minY.resize(count); minZ.resize(count);
+	maxX.resize(count); maxY.resize(count); maxZ.resize(count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		GameObject* body = bodies[order[i]];
+		const AABB& box = boxes[order[i]];
+		glm::vec3 position = body->GetPosition();
+		glm::vec3 velocity = body->GetVelocity();
+
+		ids[i] = body->GetId();
+		positionX[i] = position.x; positionY[i] = position.y; positionZ[i] = position.z;
+		velocityX[i] = velocity.x; velocityY[i] = velocity.y; velocityZ[i] = velocity.z;
+		minX[i] = box.min.x; minY[i] = box.min.y; minZ[i] = box.min.z;
+		maxX[i] = box.max.x; maxY[i] = box.max.y; maxZ[i] = box.max.z;
+	}
+}
+
+bool WorldSnapshot::Raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, RayHit& hit) const
+{
+	// The slab test: on each axis, work out the distances along the ray where it enters and leaves the box's slab.
+	// The ray is inside the box between the latest entry and the earliest exit, if the latest entry comes first.
+	// Dividing by a zero direction gives +/- infinity, which does the right thing for rays parallel to a slab.
+	glm::vec3 inverse = 1.0f / direction;
+
+	hit.body = -1;
+	float closest = maxDistance;
+
+	for (int i = 0; i < (int)ids.size(); i++)
+	{
+		float x1 = (minX[i] - origin.x) * inverse.x;
+		float x2 = (maxX[i] - origin.x) * inverse.x;
+		float y1 = (minY[i] - origin.y) * inverse.y;
+		float y2 = (maxY[i] - origin.y) * inverse.y;
+		float z1 = (minZ[i] - origin.z) * inverse.z;
+		float z2 = (maxZ[i] - origin.z) * inverse.z;
+
+		float entry = std::max(std::max(std::min(x1, x2), std::min(y1, y2)), std::min(z1, z2));
+		float exit = std::min(std::min(std::max(x1, x2), std::max(y1, y2)), std::max(z1, z2));
+
+		// A ray starting inside a box hits it at distance zero.
+		entry = std::max(entry, 0.0f);
+
+		if (entry <= exit && entry <= closest)
+		{
+			closest = entry;
+			hit.body = ids[i];
+		}
+	}
+
+	if (hit.body < 0)
+	{
+		return false;
+	}
+
+	hit.distance = closest;
+	hit.point = origin + direction * closest;
+	return true;
+}
+
+int WorldSnapshot::Overlap(const AABB& box, std::vector<int>& results) const
+{
+	int found = 0;
+
+	for (int i = 0; i < (int)ids.size(); i++)
+	{
+		// The boxes are sorted by their left edge, so once one starts past our right edge, so does every box after it.
+		if (minX[i] > box.max.x)
+		{
+			break;
+		}
+
+		if (maxX[i] < box.min.x || maxY[i] < box.min.y || minY[i] > box.max.y || maxZ[i] < box.min.z || minZ[i] > box.max.z)
+		{
+			continue;
+		}
+
+		results.push_back(ids[i]);
+		found++;
+	}
+
+	return found;
+}
+
+int WorldSnapshot::IndexOf(int id) const
+{
+	for (int i = 0; i < (int)ids.size(); i++)
+	{
+		if (ids[i] == id)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+#endif // _WORLD_SNAPSHOT_CPP
@@ -0,0 +1,89 @@
+/*
+Title: Swept AABB-3D
+File Name: WorldSnapshot.h
+Copyright  2015
+Original authors: Brockton Roth
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Description:
+A read-only copy of the world as it was at the end of one physics step: every body's id,
+position, velocity and AABB, stored as separate arrays (one per component) so they can be
+scanned quickly. Raycasts and overlap queries run against a snapshot, so they can happen on
+any thread while the next step is busy changing the live bodies.
+*/
+
+#ifndef _WORLD_SNAPSHOT_H
+#define _WORLD_SNAPSHOT_H
+
+#include "GameObject.h"
+#include <vector>
+
+// The result of a raycast.
+struct RayHit
+{
+	int body;			// Id of the body that was hit, or -1 if nothing was.
+	float distance;		// How far along the ray the hit is.
+	glm::vec3 point;	// Where the ray first touches the body's AABB.
+
+	RayHit()
+	{
+		body = -1;
+		distance = 0.0f;
+		point = glm::vec3(0.0f);
+	}
+};
+
+struct WorldSnapshot
+{
+	// The step this snapshot was taken at the end of.
+	unsigned long long step;
+
+	// One entry per body, all in the same order. The bodies are sorted by the left (min x) edge of their AABB,
+	// which lets an overlap query stop as soon as it reaches a box that starts past the right edge of the query box.
+	std::vector<int> ids;
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> velocityX, velocityY, velocityZ;
+	std::vector<float> minX, minY, minZ;
+	std::vector<float> maxX, maxY, maxZ;
+
+	WorldSnapshot()
+	{
+		step = 0;
+	}
+
+	int NumBodies() const
+	{
+		return (int)ids.size();
+	}
+
+	// Fills the snapshot from a list of bodies and their AABBs (boxes[i] belongs to bodies[i]), and sorts it.
+	void Build(unsigned long long stepNumber, const std::vector<GameObject*>& bodies, const std::vector<AABB>& boxes);
+
+	// Finds the closest body whose AABB the ray hits within maxDistance. Direction doesn't need to be normalized; distance is measured in
+	// multiples of it. Returns false if nothing was hit.
+	bool Raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, RayHit& hit) const;
+
+	// Adds the ids of every body whose AABB overlaps box to results, and returns how many were added.
+	int Overlap(const AABB& box, std::vector<int>& results) const;
+
+	// Index of the body with the given id, or -1. This is a linear search, so don't use it in tight loops.
+	int IndexOf(int id) const;
+};
+
+#endif //_WORLD_SNAPSHOT_H